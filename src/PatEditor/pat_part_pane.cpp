@@ -1,5 +1,6 @@
 #include "pat_part_pane.h"
 #include "../parts/parts.h"
+#include "../font_glyphs.h"
 #include "../filedialog.h"
 #include "../main_frame.h"
 #include <imgui.h>
@@ -26,6 +27,7 @@ void PatPartPane::RegeneratePartCutOutsNames()
         for(int i = 0; i < count; i++)
         {
             cutOutsDecoratedNames[i] = curInstance->parts->GetPartCutOutsDecorateName(i);
+            FontGlyphs::AddText(cutOutsDecoratedNames[i]);
         }
     }
     else
@@ -1,5 +1,6 @@
 #include "pat_partset_pane.h"
 #include "../parts/parts.h"
+#include "../font_glyphs.h"
 #include "../filedialog.h"
 #include "../main_frame.h"
 #include <imgui.h>
@@ -27,6 +28,7 @@ void PatPartSetPane::RegeneratePartSetNames()
         for(int i = 0; i < count; i++)
         {
             partSetDecoratedNames[i] = curInstance->parts->GetPartSetDecorateName(i);
+            FontGlyphs::AddText(partSetDecoratedNames[i]);
         }
     }
     else
@@ -45,6 +47,7 @@ void PatPartSetPane::RegeneratePartPropNames()
         for(int i = 0; i < count; i++)
         {
             partPropsDecoratedNames[i] = curInstance->parts->GetPartPropsDecorateName(curInstance->currState->partSet, i);
+            FontGlyphs::AddText(partPropsDecoratedNames[i]);
         }
     }
     else
@@ -159,6 +162,7 @@ void PatPartSetPane::DrawPopUp() {
                     prop->propId = i;
                 }
             }
+            partSet->Invalidate();
             if(!props->empty()) {
                 RegeneratePartPropNames();
                 RegeneratePartSetNames();
@@ -169,6 +173,7 @@ void PatPartSetPane::DrawPopUp() {
         ImGui::SameLine();
         if (ImGui::Button("Remove data only", ImVec2(120, 40))) {
             partSet->groups[curInstance->currState->partProp] = {};
+            partSet->Invalidate();
             RegeneratePartPropNames();
             RegeneratePartSetNames();
             ImGui::CloseCurrentPopup();
@@ -279,6 +284,7 @@ void PatPartSetPane::DrawPartProperty(PartSet<>* partSet)
     if(ImGui::Button("Add Prop")){
         auto item = &partSet->groups.emplace_back();
         item->propId = partSet->groups.size() - 1;
+        partSet->Invalidate();
         RegeneratePartPropNames();
         RegeneratePartSetNames();
         curInstance->currState->partProp = item->propId;
@@ -295,6 +301,7 @@ void PatPartSetPane::DrawPartProperty(PartSet<>* partSet)
             }
         }
         item->propId = curInstance->currState->partProp;
+        partSet->Invalidate();
         RegeneratePartPropNames();
         RegeneratePartSetNames();
         curInstance->currState->partProp = item->propId;
@@ -334,6 +341,7 @@ void PatPartSetPane::DrawPartProperty(PartSet<>* partSet)
         ImGui::SameLine();
         if(ImGui::Button("Paste Part Prop")){
             PartSet<>::CopyPropertyTo(props, &CopyManager::copiedParts->partProperty);
+            partSet->Invalidate();
             RegeneratePartPropNames();
             RegeneratePartSetNames();
         }
@@ -379,7 +387,8 @@ void PatPartSetPane::DrawPartProperty(PartSet<>* partSet)
                     curInstance->parts->GetPartPropsDecorateName(curInstance->currState->partSet,curInstance->currState->partProp);
         }
         ImGui::SetNextItemWidth(widthInput);
-        ImGui::DragFloat("Priority", &props->priority, 1.0f, 0.0f, 1000.0f);
+        if(ImGui::DragFloat("Priority", &props->priority, 1.0f, 0.0f, 1000.0f))
+            partSet->Invalidate();
         ImGui::Checkbox("Additive Filter", &props->additive);
         ImGui::SameLine();
         ImGui::Checkbox("Bilinear Filter", &props->filter);
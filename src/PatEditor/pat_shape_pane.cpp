@@ -1,5 +1,6 @@
 #include "pat_shape_pane.h"
 #include "../parts/parts.h"
+#include "../font_glyphs.h"
 #include "../filedialog.h"
 #include "../main_frame.h"
 #include <imgui.h>
@@ -25,6 +26,7 @@ void PatShapePane::RegenerateShapesNames()
         for(int i = 0; i < count; i++)
         {
             shapesDecoratedNames[i] = curInstance->parts->GetShapesDecorateName(i);
+            FontGlyphs::AddText(shapesDecoratedNames[i]);
         }
     }
     else
@@ -77,6 +79,7 @@ void PatShapePane::DrawPopUp() {
 
         if (ImGui::Button("OK", ImVec2(120, 40))) {
             curInstance->parts->shapes[curInstance->currState->partShape] = {};
+            curInstance->parts->meshCache.Invalidate(curInstance->currState->partShape);
             RegenerateShapesNames();
             ImGui::CloseCurrentPopup();
         }
@@ -122,6 +125,7 @@ void PatShapePane::DrawShape()
                 ImGui::EndCombo();
             }
             auto shape = &curInstance->parts->shapes[curInstance->currState->partShape];
+            bool edited = false;
             if (shape) {
                 if (ImGui::InputText("Shape name", &shape->name)) {
                     shapesDecoratedNames[curInstance->currState->partShape] = curInstance->parts->GetShapesDecorateName(curInstance->currState->partShape);
@@ -135,6 +139,7 @@ void PatShapePane::DrawShape()
                 if(ImGui::Button("Paste Shape")){
                     CopyManager::copiedParts->shape.CopyTo(shape);
                     RegenerateShapesNames();
+                    edited = true;
                 }
                 ImGui::Separator();
 
@@ -145,6 +150,7 @@ void PatShapePane::DrawShape()
                         const bool is_selected = (curInstance->currState->partShape == n);
                         if (ImGui::Selectable(shapeList[n], is_selected)) {
                             shape->type = (ShapeType) (n + 1);
+                            edited = true;
                         }
 
                         // Set the initial focus when opening the combo (scrolling + keyboard navigation focus)
@@ -159,36 +165,39 @@ void PatShapePane::DrawShape()
                     // no parameters
                 } else {
                     ImGui::SetNextItemWidth(width);
-                    ImGui::DragInt("Radius", &shape->radius, 1, 0, INT32_MAX);
+                    edited |= ImGui::DragInt("Radius", &shape->radius, 1, 0, INT32_MAX);
                     if (shape->type == ShapeType::RING || shape->type == ShapeType::ARC) {
                         ImGui::SameLine();
                         ImGui::SetNextItemWidth(width);
-                        ImGui::DragInt("Width", &shape->width, 1, 0, INT32_MAX);
+                        edited |= ImGui::DragInt("Width", &shape->width, 1, 0, INT32_MAX);
                     }
                     if (shape->type != ShapeType::SPHERE) {
                         ImGui::SetNextItemWidth(width);
-                        ImGui::DragInt("Dz", &shape->dz, 1, 0, INT32_MAX);
+                        edited |= ImGui::DragInt("Dz", &shape->dz, 1, 0, INT32_MAX);
                     }
                     if (shape->type == ShapeType::RING || shape->type == ShapeType::ARC) {
                         ImGui::SameLine();
                         ImGui::SetNextItemWidth(width);
-                        ImGui::DragInt("DRadius", &shape->dRadius, 1, 0, INT32_MAX);
+                        edited |= ImGui::DragInt("DRadius", &shape->dRadius, 1, 0, INT32_MAX);
                     }
                     ImGui::SetNextItemWidth(width);
-                    ImGui::DragInt("Vertex", &shape->vertexCount, 1, 0, INT32_MAX);
+                    edited |= ImGui::DragInt("Vertex", &shape->vertexCount, 1, 0, INT32_MAX);
                     if (shape->type == ShapeType::SPHERE || shape->type == ShapeType::CONE) {
                         ImGui::SameLine();
                         ImGui::SetNextItemWidth(width);
-                        ImGui::DragInt("Vertex 2", &shape->vertexCount2, 1, 0, INT32_MAX);
+                        edited |= ImGui::DragInt("Vertex 2", &shape->vertexCount2, 1, 0, INT32_MAX);
                     }
                     ImGui::SetNextItemWidth(width);
-                    ImGui::DragInt("Length", &shape->length, 10, 0, INT32_MAX);
+                    edited |= ImGui::DragInt("Length", &shape->length, 10, 0, INT32_MAX);
                     if (shape->type == ShapeType::SPHERE) {
                         ImGui::SameLine();
                         ImGui::SetNextItemWidth(width);
-                        ImGui::DragInt("Length 2", &shape->length2, 10, 0, INT32_MAX);
+                        edited |= ImGui::DragInt("Length 2", &shape->length2, 10, 0, INT32_MAX);
                     }
                 }
             }
+            // Its tessellated mesh is out of date
+            if (edited)
+                curInstance->parts->meshCache.Invalidate(curInstance->currState->partShape);
         }
 }
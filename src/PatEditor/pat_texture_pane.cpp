@@ -1,5 +1,6 @@
 #include "pat_texture_pane.h"
 #include "../parts/parts.h"
+#include "../font_glyphs.h"
 #include "../filedialog.h"
 #include "../main_frame.h"
 #include <imgui.h>
@@ -26,6 +27,7 @@ void PatTexturePane::RegenerateTexturesNames()
         for(int i = 0; i < count; i++)
         {
             textureDecoratedNames[i] = curInstance->parts->GetTexturesDecorateName(i);
+            FontGlyphs::AddText(textureDecoratedNames[i]);
         }
     }
     else
@@ -78,6 +80,7 @@ void PatTexturePane::DrawPopUp() {
         if (ImGui::Button("OK", ImVec2(120, 40))) {
             curInstance->parts->gfxMeta[curInstance->currState->partGraph] = {};
             RegenerateTexturesNames();
+            curInstance->parts->MarkEdited();
             ImGui::CloseCurrentPopup();
         }
         ImGui::SameLine();
@@ -109,6 +112,7 @@ void PatTexturePane::DrawTexture()
             item->id = curInstance->parts->gfxMeta.size() - 1;
             RegenerateTexturesNames();
             curInstance->currState->partGraph = item->id;
+            curInstance->parts->MarkEdited();
         }
         ImGui::SameLine();
         if(nTexture > 0 && ImGui::Button("Delete Texture")){
@@ -172,10 +176,13 @@ void PatTexturePane::DrawTexture()
                 if(ImGui::IsItemHovered())
                     Tooltip("Use this only if you see that on compression texture has bigger data size than uncompressed.");
                 if (ImGui::Button("Import Texture")) {
-                    std::string &&file = FileDialog(fileType::DDS);
+                    std::string &&file = FileDialog(fileType::TEXTURE);
                     if (!file.empty()) {
-                        std::string message = curInstance->parts->gfxMeta[curInstance->currState->partGraph].ImportTexture(file.c_str(), curInstance->parts->textures);
+                        std::string message = curInstance->parts->gfxMeta[curInstance->currState->partGraph].ImportTexture(
+                                file.c_str(), importFormat == 1, importQuality);
                         if (message.empty()) {
+                            // Cached part lists still point at the old layer
+                            curInstance->parts->MarkEdited();
                             textureDecoratedNames[curInstance->currState->partGraph] = curInstance->parts->GetTexturesDecorateName(
                                     curInstance->currState->partGraph);
                             for(auto &cutOut : curInstance->parts->cutOuts)
@@ -198,15 +205,27 @@ void PatTexturePane::DrawTexture()
                 ImGui::SameLine();
                 ImGui::TextDisabled("(?)");
                 if(ImGui::IsItemHovered())
-                    Tooltip("Textures on import need to be divisible of 128\non width and height.\nAlso DDS need to be: DXT1, DXT5 or Uncompressed.");
+                    Tooltip("DDS textures on import need to be divisible of 256\non width and height.\nAlso DDS need to be: DXT1, DXT5 or Uncompressed.\n"
+                            "PNG and TGA are padded to multiples of 256 and compressed\nwith the format and quality below.");
                 ImGui::SameLine(0, 20.f);
                 if (ImGui::Button("Export Texture")) {
                     std::string filename(gfx->name);
-                    std::string &&file = FileDialog(fileType::DDS, true, const_cast<char *>(filename.c_str()));
+                    std::string &&file = FileDialog(fileType::TEXTURE_EXPORT, true, const_cast<char *>(filename.c_str()));
                     if (!file.empty()) {
                         gfx->ExportTexture(file.c_str());
                     }
                 }
+                const char* const formatList[] = {"DXT5", "DXT1"};
+                const char* const qualityList[] = {"Fast", "Normal", "High"};
+                ImGui::SetNextItemWidth(width);
+                ImGui::Combo("Format##import", &importFormat, formatList, IM_ARRAYSIZE(formatList));
+                ImGui::SameLine();
+                ImGui::SetNextItemWidth(width);
+                ImGui::Combo("Quality##import", &importQuality, qualityList, IM_ARRAYSIZE(qualityList));
+                ImGui::SameLine();
+                ImGui::TextDisabled("(?)");
+                if(ImGui::IsItemHovered())
+                    Tooltip("Used for PNG and TGA imports. DXT1 keeps alpha only as on/off.");
                 ImGui::NewLine();
                 ImGui::SameLine(ImGui::GetWindowWidth()-220);
                 if(ImGui::Button("Copy Texture")){
@@ -216,6 +235,7 @@ void PatTexturePane::DrawTexture()
                 if(ImGui::Button("Paste Texture")){
                     CopyManager::copiedParts->gfx.CopyTo(gfx);
                     RegenerateTexturesNames();
+                    curInstance->parts->MarkEdited();
                 }
 
                 ImGui::Text("");
@@ -21,6 +21,9 @@ private:
     std::string openpopupWithId;
     std::string customPopUpMessage;
     std::string *textureDecoratedNames;
+    // How PNG and TGA imports are compressed
+    int importFormat = 0;   // 0 DXT5, 1 DXT1
+    int importQuality = 1;  // Bc::Quality
 };
 
 #endif /* PATTEXTUREPANEASDASD_H_GUARD */
@@ -1,5 +1,6 @@
 #include "pat_tool_pane.h"
 #include "../parts/parts.h"
+#include "../font_glyphs.h"
 #include "../filedialog.h"
 #include "../main_frame.h"
 #include <imgui.h>
@@ -26,6 +27,7 @@ void PatToolPane::RegeneratePartsetNames()
         for(int i = 0; i < count; i++)
         {
             partSetDecoratedNames[i] = curInstance->parts->GetPartSetDecorateName(i);
+            FontGlyphs::AddText(partSetDecoratedNames[i]);
         }
     }
     else
@@ -0,0 +1,39 @@
+#include "alloc_counter.h"
+
+#include <cstdlib>
+#include <new>
+
+//Constant initialised, so touching it from operator new needs no TLS setup.
+static thread_local uint64_t allocations = 0;
+
+uint64_t AllocCounter::Count()
+{
+	return allocations;
+}
+
+//The array and nothrow forms end up here too.
+void *operator new(size_t size)
+{
+	++allocations;
+	if(size == 0)
+		size = 1;
+	while(true)
+	{
+		if(void *p = malloc(size))
+			return p;
+		std::new_handler handler = std::get_new_handler();
+		if(!handler)
+			throw std::bad_alloc();
+		handler();
+	}
+}
+
+void operator delete(void *p) noexcept
+{
+	free(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+	free(p);
+}
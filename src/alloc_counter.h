@@ -0,0 +1,15 @@
+#ifndef ALLOC_COUNTER_H_GUARD
+#define ALLOC_COUNTER_H_GUARD
+
+#include <cstdint>
+
+// Counts calls to the global operator new, per thread. Take the difference
+// around a piece of code to see whether it touches the heap; what the sprite
+// prefetch and texture decoder threads allocate meanwhile isn't included.
+namespace AllocCounter
+{
+	//Of the calling thread.
+	uint64_t Count();
+}
+
+#endif /* ALLOC_COUNTER_H_GUARD */
@@ -0,0 +1,126 @@
+#include "atlas_packer.h"
+
+#include <algorithm>
+#include <climits>
+
+SkylinePacker::SkylinePacker(int width_, int height_)
+{
+	Reset(width_, height_);
+}
+
+void SkylinePacker::Reset(int width_, int height_)
+{
+	width = width_;
+	height = height_;
+	Clear();
+}
+
+void SkylinePacker::Clear()
+{
+	skyline.clear();
+	if(width > 0)
+		skyline.push_back(Node{0, 0, width});
+	usedArea = 0;
+}
+
+float SkylinePacker::FillRatio() const
+{
+	if(width <= 0 || height <= 0)
+		return 0.f;
+	return (float)((double)usedArea / ((double)width * height));
+}
+
+//Lowest y at which a w*h rect can sit starting on skyline node "index", -1 if it doesn't fit.
+int SkylinePacker::Fit(size_t index, int w, int h) const
+{
+	int x = skyline[index].x;
+	if(x + w > width)
+		return -1;
+
+	int y = skyline[index].y;
+	int widthLeft = w;
+	for(size_t i = index; widthLeft > 0; ++i)
+	{
+		if(i >= skyline.size())
+			return -1;
+		y = std::max(y, skyline[i].y);
+		if(y + h > height)
+			return -1;
+		widthLeft -= skyline[i].w;
+	}
+	return y;
+}
+
+bool SkylinePacker::Insert(int w, int h, Rect &out)
+{
+	if(w <= 0 || h <= 0)
+		return false;
+
+	int bestTop = INT_MAX;
+	int bestWidth = INT_MAX;
+	size_t bestIndex = skyline.size();
+	for(size_t i = 0; i < skyline.size(); ++i)
+	{
+		int y = Fit(i, w, h);
+		if(y < 0)
+			continue;
+		//Prefer the lowest top edge, then the tightest node to limit waste.
+		if(y + h < bestTop || (y + h == bestTop && skyline[i].w < bestWidth))
+		{
+			bestTop = y + h;
+			bestWidth = skyline[i].w;
+			bestIndex = i;
+		}
+	}
+
+	if(bestIndex == skyline.size())
+		return false;
+
+	out = Rect{skyline[bestIndex].x, bestTop - h, w, h};
+	AddLevel(bestIndex, out);
+	usedArea += (long long)w * h;
+	return true;
+}
+
+void SkylinePacker::Release(const Rect &rect)
+{
+	usedArea -= (long long)rect.w * rect.h;
+	if(usedArea < 0)
+		usedArea = 0;
+}
+
+void SkylinePacker::AddLevel(size_t index, const Rect &rect)
+{
+	skyline.insert(skyline.begin() + index, Node{rect.x, rect.y + rect.h, rect.w});
+
+	//Shrink or drop the nodes now covered by the new one.
+	for(size_t i = index + 1; i < skyline.size();)
+	{
+		const Node &prev = skyline[i-1];
+		Node &cur = skyline[i];
+		if(cur.x >= prev.x + prev.w)
+			break;
+
+		int shrink = prev.x + prev.w - cur.x;
+		cur.x += shrink;
+		cur.w -= shrink;
+		if(cur.w > 0)
+			break;
+		skyline.erase(skyline.begin() + i);
+	}
+	Merge();
+}
+
+void SkylinePacker::Merge()
+{
+	for(size_t i = 0; i + 1 < skyline.size();)
+	{
+		if(skyline[i].y == skyline[i+1].y)
+		{
+			skyline[i].w += skyline[i+1].w;
+			skyline.erase(skyline.begin() + i + 1);
+		}
+		else
+			++i;
+	}
+}
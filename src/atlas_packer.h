@@ -0,0 +1,50 @@
+#ifndef ATLAS_PACKER_H_GUARD
+#define ATLAS_PACKER_H_GUARD
+
+#include <cstddef>
+#include <vector>
+
+// Skyline rectangle packer (bottom-left heuristic).
+// Has no GL dependency so packing and fill ratio can be checked headless.
+class SkylinePacker
+{
+public:
+	struct Rect
+	{
+		int x, y, w, h;
+	};
+
+	SkylinePacker(int width = 0, int height = 0);
+
+	void Reset(int width, int height);
+	void Clear();
+
+	//Returns false if there's no room left for a w*h rectangle.
+	bool Insert(int w, int h, Rect &out);
+	//Skylines can't give space back, this only updates the bookkeeping.
+	//The space is reclaimed the next time the owner repacks.
+	void Release(const Rect &rect);
+
+	int Width() const { return width; }
+	int Height() const { return height; }
+	long long UsedArea() const { return usedArea; }
+	//Live rectangle area over page area.
+	float FillRatio() const;
+
+private:
+	struct Node
+	{
+		int x, y, w;
+	};
+
+	std::vector<Node> skyline;
+	int width;
+	int height;
+	long long usedArea;
+
+	int Fit(size_t index, int w, int h) const;
+	void AddLevel(size_t index, const Rect &rect);
+	void Merge();
+};
+
+#endif /* ATLAS_PACKER_H_GUARD */
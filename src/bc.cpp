@@ -0,0 +1,526 @@
+#include "bc.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+
+namespace
+{
+	//One 4x4 block, channels apart so the per pixel loops vectorize.
+	struct Block
+	{
+		float r[16], g[16], b[16];
+		float weight[16]; //1 for pixels the colour has to match, 0 for transparent ones.
+		unsigned char a[16];
+		int opaque;
+	};
+
+	struct Color
+	{
+		float r, g, b;
+	};
+
+	uint16_t To565(Color c)
+	{
+		int r = (int)(std::min(std::max(c.r, 0.f), 255.f) * 31.f / 255.f + 0.5f);
+		int g = (int)(std::min(std::max(c.g, 0.f), 255.f) * 63.f / 255.f + 0.5f);
+		int b = (int)(std::min(std::max(c.b, 0.f), 255.f) * 31.f / 255.f + 0.5f);
+		return (uint16_t)(r << 11 | g << 5 | b);
+	}
+
+	Color From565(uint16_t v)
+	{
+		int r = v >> 11, g = (v >> 5) & 63, b = v & 31;
+		return {float(r << 3 | r >> 2), float(g << 2 | g >> 4), float(b << 3 | b >> 2)};
+	}
+
+	//Fraction of c0 in each palette entry. Three colour mode has black or
+	//transparent as its last entry, never picked for opaque pixels.
+	const float fourWeights[4] = {1.f, 0.f, 2.f/3.f, 1.f/3.f};
+	const float threeWeights[4] = {1.f, 0.f, 0.5f, 0.f};
+
+	//Nearest palette entry for every pixel the colour matters for. Returns
+	//the squared error.
+	float PickIndices(const Block &block, uint16_t c0, uint16_t c1, bool three, unsigned char indices[16])
+	{
+		Color a = From565(c0), b = From565(c1);
+		const float *w = three ? threeWeights : fourWeights;
+		int entries = three ? 3 : 4;
+		float pr[4], pg[4], pb[4];
+		for(int i = 0; i < 4; ++i)
+		{
+			pr[i] = a.r * w[i] + b.r * (1 - w[i]);
+			pg[i] = a.g * w[i] + b.g * (1 - w[i]);
+			pb[i] = a.b * w[i] + b.b * (1 - w[i]);
+		}
+
+		float error = 0;
+		for(int p = 0; p < 16; ++p)
+		{
+			if(block.weight[p] == 0)
+			{
+				indices[p] = 3;
+				continue;
+			}
+			float best = 1e30f;
+			int bestIndex = 0;
+			for(int i = 0; i < entries; ++i)
+			{
+				float dr = block.r[p] - pr[i], dg = block.g[p] - pg[i], db = block.b[p] - pb[i];
+				float d = dr*dr + dg*dg + db*db;
+				if(d < best)
+				{
+					best = d;
+					bestIndex = i;
+				}
+			}
+			indices[p] = bestIndex;
+			error += best;
+		}
+		return error;
+	}
+
+	//Endpoints that best fit the pixels for the indices they have now.
+	bool LeastSquares(const Block &block, const unsigned char indices[16], bool three, Color &c0, Color &c1)
+	{
+		const float *w = three ? threeWeights : fourWeights;
+		float aa = 0, bb = 0, ab = 0;
+		Color ax{}, bx{};
+		for(int p = 0; p < 16; ++p)
+		{
+			float t = w[indices[p]] * block.weight[p];
+			float u = (1 - w[indices[p]]) * block.weight[p];
+			aa += t * t;
+			bb += u * u;
+			ab += t * u;
+			ax.r += t * block.r[p]; ax.g += t * block.g[p]; ax.b += t * block.b[p];
+			bx.r += u * block.r[p]; bx.g += u * block.g[p]; bx.b += u * block.b[p];
+		}
+		float det = aa * bb - ab * ab;
+		if(fabsf(det) < 1e-6f)
+			return false;
+		float inv = 1.f / det;
+		c0 = {(ax.r * bb - bx.r * ab) * inv, (ax.g * bb - bx.g * ab) * inv, (ax.b * bb - bx.b * ab) * inv};
+		c1 = {(bx.r * aa - ax.r * ab) * inv, (bx.g * aa - ax.g * ab) * inv, (bx.b * aa - ax.b * ab) * inv};
+		return true;
+	}
+
+	//Ends of the box around the pixels, along its diagonal that follows the
+	//colours, pulled in a little like most encoders do.
+	void BoundingBox(const Block &block, Color &c0, Color &c1)
+	{
+		Color lo{255, 255, 255}, hi{0, 0, 0}, mean{};
+		for(int p = 0; p < 16; ++p)
+		{
+			if(block.weight[p] == 0)
+				continue;
+			lo = {std::min(lo.r, block.r[p]), std::min(lo.g, block.g[p]), std::min(lo.b, block.b[p])};
+			hi = {std::max(hi.r, block.r[p]), std::max(hi.g, block.g[p]), std::max(hi.b, block.b[p])};
+			mean.r += block.r[p]; mean.g += block.g[p]; mean.b += block.b[p];
+		}
+		float n = 1.f / block.opaque;
+		mean = {mean.r * n, mean.g * n, mean.b * n};
+
+		//Red and blue against green decide which diagonal.
+		float rg = 0, bg = 0;
+		for(int p = 0; p < 16; ++p)
+		{
+			float dg = (block.g[p] - mean.g) * block.weight[p];
+			rg += (block.r[p] - mean.r) * dg;
+			bg += (block.b[p] - mean.b) * dg;
+		}
+		if(rg < 0)
+			std::swap(lo.r, hi.r);
+		if(bg < 0)
+			std::swap(lo.b, hi.b);
+
+		Color inset{(hi.r - lo.r) / 16, (hi.g - lo.g) / 16, (hi.b - lo.b) / 16};
+		c0 = {hi.r - inset.r, hi.g - inset.g, hi.b - inset.b};
+		c1 = {lo.r + inset.r, lo.g + inset.g, lo.b + inset.b};
+	}
+
+	//Ends of the pixels' spread along their principal axis.
+	void PrincipalAxis(const Block &block, int iterations, Color &c0, Color &c1)
+	{
+		Color mean{};
+		for(int p = 0; p < 16; ++p)
+		{
+			mean.r += block.r[p] * block.weight[p];
+			mean.g += block.g[p] * block.weight[p];
+			mean.b += block.b[p] * block.weight[p];
+		}
+		float n = 1.f / block.opaque;
+		mean = {mean.r * n, mean.g * n, mean.b * n};
+
+		float cov[6] = {};
+		for(int p = 0; p < 16; ++p)
+		{
+			float w = block.weight[p];
+			float r = (block.r[p] - mean.r) * w, g = (block.g[p] - mean.g) * w, b = (block.b[p] - mean.b) * w;
+			cov[0] += r*r; cov[1] += r*g; cov[2] += r*b;
+			cov[3] += g*g; cov[4] += g*b; cov[5] += b*b;
+		}
+
+		//Power iteration, from the direction with the most spread.
+		Color axis{cov[0], cov[3], cov[5]};
+		for(int i = 0; i < iterations; ++i)
+		{
+			Color next{cov[0]*axis.r + cov[1]*axis.g + cov[2]*axis.b,
+				cov[1]*axis.r + cov[3]*axis.g + cov[4]*axis.b,
+				cov[2]*axis.r + cov[4]*axis.g + cov[5]*axis.b};
+			float length = std::max(std::max(fabsf(next.r), fabsf(next.g)), fabsf(next.b));
+			if(length < 1e-6f)
+				break;
+			axis = {next.r / length, next.g / length, next.b / length};
+		}
+		float length = sqrtf(axis.r*axis.r + axis.g*axis.g + axis.b*axis.b);
+		if(length < 1e-6f)
+		{
+			c0 = c1 = mean;
+			return;
+		}
+		axis = {axis.r / length, axis.g / length, axis.b / length};
+
+		float lo = 1e30f, hi = -1e30f;
+		for(int p = 0; p < 16; ++p)
+		{
+			if(block.weight[p] == 0)
+				continue;
+			float t = (block.r[p] - mean.r)*axis.r + (block.g[p] - mean.g)*axis.g + (block.b[p] - mean.b)*axis.b;
+			lo = std::min(lo, t);
+			hi = std::max(hi, t);
+		}
+		c0 = {mean.r + axis.r*hi, mean.g + axis.g*hi, mean.b + axis.b*hi};
+		c1 = {mean.r + axis.r*lo, mean.g + axis.g*lo, mean.b + axis.b*lo};
+	}
+
+	void EncodeColor(const Block &block, bool three, int quality, unsigned char *out)
+	{
+		uint16_t c0 = 0, c1 = 0;
+		unsigned char indices[16];
+		if(block.opaque == 0)
+		{
+			//Everything transparent.
+			memset(indices, 3, sizeof(indices));
+		}
+		else
+		{
+			float bestError = 1e30f;
+			auto tryEndpoints = [&](Color a, Color b) {
+				uint16_t q0 = To565(a), q1 = To565(b);
+				unsigned char candidate[16];
+				float error = PickIndices(block, q0, q1, three, candidate);
+				if(error < bestError)
+				{
+					bestError = error;
+					c0 = q0;
+					c1 = q1;
+					memcpy(indices, candidate, sizeof(indices));
+				}
+			};
+
+			Color a, b;
+			if(quality == Bc::FAST)
+			{
+				BoundingBox(block, a, b);
+				tryEndpoints(a, b);
+			}
+			else
+			{
+				PrincipalAxis(block, quality == Bc::HIGH ? 8 : 4, a, b);
+				tryEndpoints(a, b);
+				if(quality == Bc::HIGH)
+				{
+					BoundingBox(block, a, b);
+					tryEndpoints(a, b);
+				}
+				int passes = quality == Bc::HIGH ? 4 : 1;
+				for(int i = 0; i < passes && bestError > 0; ++i)
+				{
+					float before = bestError;
+					if(!LeastSquares(block, indices, three, a, b))
+						break;
+					tryEndpoints(a, b);
+					if(bestError >= before)
+						break;
+				}
+			}
+		}
+
+		//c0 > c1 means four colours, so the order says which mode this is.
+		static const unsigned char swapped[4] = {1, 0, 3, 2};
+		if(three)
+		{
+			if(c0 > c1)
+			{
+				std::swap(c0, c1);
+				for(auto &i : indices)
+					i = i < 2 ? 1 - i : i;
+			}
+		}
+		else if(c0 < c1)
+		{
+			std::swap(c0, c1);
+			for(auto &i : indices)
+				i = swapped[i];
+		}
+		else if(c0 == c1)
+			memset(indices, 0, sizeof(indices));
+
+		uint32_t bits = 0;
+		for(int p = 0; p < 16; ++p)
+			bits |= (uint32_t)indices[p] << (p * 2);
+		out[0] = c0 & 0xff; out[1] = c0 >> 8;
+		out[2] = c1 & 0xff; out[3] = c1 >> 8;
+		out[4] = bits; out[5] = bits >> 8; out[6] = bits >> 16; out[7] = bits >> 24;
+	}
+
+	//Alpha block for the given endpoints. a0 > a1 interpolates 6 values
+	//between them, otherwise 4 and adds 0 and 255.
+	int AlphaIndices(const unsigned char *alpha, int a0, int a1, unsigned char indices[16])
+	{
+		int palette[8] = {a0, a1};
+		if(a0 > a1)
+		{
+			for(int i = 1; i < 7; ++i)
+				palette[i + 1] = ((7 - i) * a0 + i * a1 + 3) / 7;
+		}
+		else
+		{
+			for(int i = 1; i < 5; ++i)
+				palette[i + 1] = ((5 - i) * a0 + i * a1 + 2) / 5;
+			palette[6] = 0;
+			palette[7] = 255;
+		}
+		int error = 0;
+		for(int p = 0; p < 16; ++p)
+		{
+			int best = 1 << 30, bestIndex = 0;
+			for(int i = 0; i < 8; ++i)
+			{
+				int d = (alpha[p] - palette[i]) * (alpha[p] - palette[i]);
+				if(d < best)
+				{
+					best = d;
+					bestIndex = i;
+				}
+			}
+			indices[p] = bestIndex;
+			error += best;
+		}
+		return error;
+	}
+
+	void EncodeAlpha(const unsigned char *alpha, int quality, unsigned char *out)
+	{
+		int lo = 255, hi = 0;
+		for(int p = 0; p < 16; ++p)
+		{
+			lo = std::min<int>(lo, alpha[p]);
+			hi = std::max<int>(hi, alpha[p]);
+		}
+		unsigned char indices[16];
+		int a0 = hi, a1 = lo;
+		int error = AlphaIndices(alpha, a0, a1, indices);
+
+		//Blocks with fully clear or solid pixels next to soft ones can do
+		//better with 0 and 255 as exact values.
+		if(quality == Bc::HIGH && error > 0)
+		{
+			int innerLo = 255, innerHi = 0;
+			for(int p = 0; p < 16; ++p)
+			{
+				if(alpha[p] == 0 || alpha[p] == 255)
+					continue;
+				innerLo = std::min<int>(innerLo, alpha[p]);
+				innerHi = std::max<int>(innerHi, alpha[p]);
+			}
+			if(innerLo <= innerHi)
+			{
+				unsigned char candidate[16];
+				int other = AlphaIndices(alpha, innerLo, innerHi, candidate);
+				if(other < error)
+				{
+					a0 = innerLo;
+					a1 = innerHi;
+					memcpy(indices, candidate, sizeof(indices));
+				}
+			}
+		}
+
+		out[0] = a0;
+		out[1] = a1;
+		uint64_t bits = 0;
+		for(int p = 0; p < 16; ++p)
+			bits |= (uint64_t)indices[p] << (p * 3);
+		for(int i = 0; i < 6; ++i)
+			out[2 + i] = (unsigned char)(bits >> (i * 8));
+	}
+	//Decoding works on whole pixels as little endian RGBA words: a block is
+	//a palette and 16 lookups into it, no branches per pixel.
+	uint32_t Expand565(uint16_t c, int &r, int &g, int &b)
+	{
+		r = (c >> 11) & 31;
+		g = (c >> 5) & 63;
+		b = c & 31;
+		r = (r << 3) | (r >> 2);
+		g = (g << 2) | (g >> 4);
+		b = (b << 3) | (b >> 2);
+		return (uint32_t)r | (uint32_t)g << 8 | (uint32_t)b << 16 | 0xFF000000u;
+	}
+
+	uint32_t Pack(int r, int g, int b, int a)
+	{
+		return (uint32_t)r | (uint32_t)g << 8 | (uint32_t)b << 16 | (uint32_t)a << 24;
+	}
+
+	void DecodeColor(const unsigned char *in, bool fourColor, uint32_t *pixels)
+	{
+		uint16_t c0 = in[0] | in[1] << 8;
+		uint16_t c1 = in[2] | in[3] << 8;
+		int r0, g0, b0, r1, g1, b1;
+		uint32_t palette[4];
+		palette[0] = Expand565(c0, r0, g0, b0);
+		palette[1] = Expand565(c1, r1, g1, b1);
+		if(fourColor || c0 > c1)
+		{
+			palette[2] = Pack((2*r0 + r1) / 3, (2*g0 + g1) / 3, (2*b0 + b1) / 3, 255);
+			palette[3] = Pack((r0 + 2*r1) / 3, (g0 + 2*g1) / 3, (b0 + 2*b1) / 3, 255);
+		}
+		else
+		{
+			palette[2] = Pack((r0 + r1) / 2, (g0 + g1) / 2, (b0 + b1) / 2, 255);
+			palette[3] = 0;
+		}
+		uint32_t bits = in[4] | in[5] << 8 | in[6] << 16 | (uint32_t)in[7] << 24;
+		for(int p = 0; p < 16; ++p)
+			pixels[p] = palette[(bits >> (p * 2)) & 3];
+	}
+
+	void DecodeAlpha(const unsigned char *in, uint32_t *pixels)
+	{
+		int a0 = in[0], a1 = in[1];
+		uint32_t palette[8];
+		palette[0] = a0;
+		palette[1] = a1;
+		if(a0 > a1)
+		{
+			for(int i = 1; i < 7; ++i)
+				palette[i + 1] = ((7 - i) * a0 + i * a1 + 3) / 7;
+		}
+		else
+		{
+			for(int i = 1; i < 5; ++i)
+				palette[i + 1] = ((5 - i) * a0 + i * a1 + 2) / 5;
+			palette[6] = 0;
+			palette[7] = 255;
+		}
+		uint64_t bits = 0;
+		for(int i = 0; i < 6; ++i)
+			bits |= (uint64_t)in[2 + i] << (i * 8);
+		for(int p = 0; p < 16; ++p)
+			pixels[p] = (pixels[p] & 0x00FFFFFFu) | palette[(bits >> (p * 3)) & 7] << 24;
+	}
+}
+
+namespace Bc
+{
+	size_t EncodedSize(int width, int height, bool bc3)
+	{
+		return (size_t)(width / 4) * (height / 4) * (bc3 ? 16 : 8);
+	}
+
+	void Encode(std::vector<unsigned char> &out, const unsigned char *rgba, int width, int height,
+		bool bc3, int quality, int threadCount)
+	{
+		int blocksX = width / 4, blocksY = height / 4;
+		int blockSize = bc3 ? 16 : 8;
+		out.resize(EncodedSize(width, height, bc3));
+
+		//Rows of blocks are handed out one at a time.
+		std::atomic<int> nextRow(0);
+		auto worker = [&]() {
+			Block block;
+			for(int by; (by = nextRow++) < blocksY;)
+			{
+				unsigned char *dst = &out[(size_t)by * blocksX * blockSize];
+				for(int bx = 0; bx < blocksX; ++bx, dst += blockSize)
+				{
+					block.opaque = 0;
+					for(int p = 0; p < 16; ++p)
+					{
+						const unsigned char *src = rgba + ((size_t)(by*4 + p/4) * width + bx*4 + p%4) * 4;
+						block.r[p] = src[0];
+						block.g[p] = src[1];
+						block.b[p] = src[2];
+						block.a[p] = src[3];
+						//BC3 colour ignores alpha, BC1 drops what's mostly clear.
+						block.weight[p] = bc3 || src[3] >= 128 ? 1.f : 0.f;
+						block.opaque += block.weight[p] != 0;
+					}
+
+					if(bc3)
+					{
+						EncodeAlpha(block.a, quality, dst);
+						EncodeColor(block, false, quality, dst + 8);
+					}
+					else
+						EncodeColor(block, block.opaque < 16, quality, dst);
+				}
+			}
+		};
+
+		if(threadCount <= 0)
+			threadCount = std::max(1u, std::thread::hardware_concurrency());
+		threadCount = std::min(threadCount, std::max(1, blocksY));
+		std::vector<std::thread> threads;
+		for(int i = 1; i < threadCount; ++i)
+			threads.emplace_back(worker);
+		worker();
+		for(auto &thread : threads)
+			thread.join();
+	}
+
+	void Decode(unsigned char *rgba, const unsigned char *blocks, int width, int height,
+		bool bc3, int threadCount)
+	{
+		int blocksX = width / 4, blocksY = height / 4;
+		int blockSize = bc3 ? 16 : 8;
+
+		std::atomic<int> nextRow(0);
+		auto worker = [&]() {
+			uint32_t pixels[16];
+			for(int by; (by = nextRow++) < blocksY;)
+			{
+				const unsigned char *src = blocks + (size_t)by * blocksX * blockSize;
+				for(int bx = 0; bx < blocksX; ++bx, src += blockSize)
+				{
+					if(bc3)
+					{
+						DecodeColor(src + 8, true, pixels);
+						DecodeAlpha(src, pixels);
+					}
+					else
+						DecodeColor(src, false, pixels);
+
+					//Little endian words are RGBA in memory order.
+					for(int row = 0; row < 4; ++row)
+						memcpy(rgba + ((size_t)(by*4 + row) * width + bx*4) * 4, pixels + row*4, 16);
+				}
+			}
+		};
+
+		if(threadCount <= 0)
+			threadCount = std::max(1u, std::thread::hardware_concurrency());
+		threadCount = std::min(threadCount, std::max(1, blocksY));
+		std::vector<std::thread> threads;
+		for(int i = 1; i < threadCount; ++i)
+			threads.emplace_back(worker);
+		worker();
+		for(auto &thread : threads)
+			thread.join();
+	}
+}
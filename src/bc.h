@@ -0,0 +1,35 @@
+#ifndef BC_H_GUARD
+#define BC_H_GUARD
+
+#include <cstddef>
+#include <vector>
+
+// BC1 (DXT1) and BC3 (DXT5) block compression for PAT textures.
+namespace Bc
+{
+	enum Quality
+	{
+		FAST = 0,   //Bounding box endpoints
+		NORMAL = 1, //Principal axis, one least squares pass
+		HIGH = 2    //More passes, more candidates
+	};
+
+	//Bytes for a width x height image, both multiples of 4.
+	size_t EncodedSize(int width, int height, bool bc3);
+
+	//rgba is RGBA8, rows top to bottom, width and height multiples of 4.
+	//BC1 keeps pixels with alpha under 128 as transparent. Blocks are split
+	//between threads, 0 for one per core.
+	void Encode(std::vector<unsigned char> &out, const unsigned char *rgba, int width, int height,
+		bool bc3, int quality, int threads = 0);
+
+	//The other way, to RGBA8 rows top to bottom (width * height * 4 bytes).
+	//BC1 blocks in three colour mode give transparent black for index 3, BC3
+	//colour is always four colour like the GPU does it. BC3 alpha between the
+	//endpoints is rounded to nearest, decoders that truncate (squish and most
+	//tools) can be 1 lower. Threads as above.
+	void Decode(unsigned char *rgba, const unsigned char *blocks, int width, int height,
+		bool bc3, int threads = 0);
+}
+
+#endif /* BC_H_GUARD */
@@ -0,0 +1,72 @@
+#include "box_batch.h"
+#include <glad/glad.h>
+
+const char *BoxBatch::vertexSource = R"(
+#version 330 core
+layout (location = 0) in vec2 Corner;
+layout (location = 1) in vec4 Rect;
+layout (location = 2) in vec4 ColorZ;
+
+out vec4 Frag_Color;
+
+uniform mat4 ProjMtx;
+uniform float Alpha;
+
+void main()
+{
+    Frag_Color = vec4(ColorZ.rgb, Alpha);
+    gl_Position = ProjMtx * vec4(mix(Rect.xy, Rect.zw, Corner), ColorZ.w, 1);
+};
+)";
+
+//Around the box, so the same four corners work as a loop and as a fan.
+static const float unitQuad[] = {0, 0, 1, 0, 1, 1, 0, 1};
+
+BoxBatch::BoxBatch():
+quad(Vao::F2, GL_STATIC_DRAW),
+vao(Vao::F4F4, GL_STREAM_DRAW),
+instancePart(0),
+boxes(0),
+uploaded(0),
+stats{}
+{
+	quad.Prepare(sizeof(unitQuad), (void*)unitQuad);
+	quad.Load();
+}
+
+void BoxBatch::Clear()
+{
+	instances.clear();
+	boxes = 0;
+}
+
+void BoxBatch::Add(float x1, float y1, float x2, float y2, float z, const float *rgb)
+{
+	instances.insert(instances.end(), {x1, y1, x2, y2, rgb[0], rgb[1], rgb[2], z});
+	++boxes;
+	++stats.boxes;
+}
+
+void BoxBatch::Upload()
+{
+	uploaded = boxes;
+	if(!boxes)
+		return;
+
+	vao.Clear();
+	instancePart = vao.Append(instances.data(), instances.size()*sizeof(float));
+	vao.Load();
+	++stats.uploads;
+}
+
+void BoxBatch::Draw(int alphaLocation, float lineAlpha, float fillAlpha)
+{
+	if(!uploaded)
+		return;
+
+	quad.Bind();
+	glUniform1f(alphaLocation, lineAlpha);
+	vao.DrawInstances(instancePart, 4, GL_LINE_LOOP);
+	glUniform1f(alphaLocation, fillAlpha);
+	vao.DrawInstances(instancePart, 4, GL_TRIANGLE_FAN);
+}
@@ -0,0 +1,48 @@
+#ifndef BOX_BATCH_H_GUARD
+#define BOX_BATCH_H_GUARD
+
+#include "vao.h"
+#include <vector>
+
+// Collects boxes from any number of layers into one instance stream. Each
+// box is its rectangle, color and depth; the shader stretches a unit quad
+// over it, so the whole set uploads once and draws with two calls no matter
+// how many boxes there are.
+class BoxBatch
+{
+public:
+	struct Stats
+	{
+		int boxes;
+		int uploads;
+	};
+
+	//Vertex shader for the boxes, sSimple's fragment shader goes with it.
+	static const char *vertexSource;
+
+	BoxBatch();
+
+	void Clear();
+	//Corners are already in world space. rgb is the color, z the depth.
+	void Add(float x1, float y1, float x2, float y2, float z, const float *rgb);
+	int Count() const { return boxes; }
+
+	//Sends everything added since Clear() to the GPU.
+	void Upload();
+	//Outlines then fills, with the vertexSource shader already in use.
+	void Draw(int alphaLocation, float lineAlpha = 0.6f, float fillAlpha = 0.3f);
+
+	void ResetStats() { stats = {}; }
+	Stats GetStats() const { return stats; }
+
+private:
+	Vao quad;
+	Vao vao;
+	std::vector<float> instances; //x1,y1,x2,y2,r,g,b,z
+	int instancePart;
+	int boxes;
+	int uploaded;
+	Stats stats;
+};
+
+#endif /* BOX_BATCH_H_GUARD */
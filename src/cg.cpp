@@ -5,11 +5,17 @@
 #include "cg.h"
 #include "misc.h"
 
+#include <algorithm>
 #include <cstdlib>
 #include <cstring>
+#include <vector>
 
 #include <iostream>
 
+static unsigned int serialCounter = 0;
+
+void (*CG::freeHook)(const CG *cg) = nullptr;
+
 const CG_Image *CG::get_image(unsigned int n) {
 	if (n >= m_nimages) {
 		return 0;
@@ -40,10 +46,91 @@ const char *CG::get_filename(unsigned int n) {
 	return image->filename;
 }
 
+const CG_Alignment *CG::get_alignments(const CG_Image *image) {
+	if (!image || image->align_start + image->align_len > m_nalign) {
+		return 0;
+	}
+	
+	return &m_align[image->align_start];
+}
+
 int CG::get_image_count() {
 	return m_nimages;
 }
 
+static int floor16(int v) {
+	return v >= 0 ? v / 0x10 : -((0xf - v) / 0x10);
+}
+
+// Pool buffers come back dirty. Rather than zeroing the whole thing, find the
+// 16x16 tiles copy_cells is going to write and only clear the rest.
+void CG::clear_uncovered(const CG_Image *image,
+			unsigned char *pixels,
+			int x1,
+			int y1,
+			int width,
+			int height,
+			int bytesPerPixel) {
+	int gx0 = floor16(x1);
+	int gy0 = floor16(y1);
+	int gw = floor16(x1 + width - 1) - gx0 + 1;
+	int gh = floor16(y1 + height - 1) - gy0 + 1;
+	
+	thread_local std::vector<unsigned char> covered;
+	covered.assign(gw * gh, 0);
+	
+	const CG_Alignment *align = &m_align[image->align_start];
+	for (unsigned int i = 0; i < image->align_len; ++i, ++align) {
+		if ((align->x & 0xf) || (align->y & 0xf)) {
+			// Cells land off the tile grid, not worth tracking.
+			memset(pixels, 0, width * height * bytesPerPixel);
+			return;
+		}
+		
+		int w = align->width / 0x10;
+		int h = align->height / 0x10;
+		int cell_n = (align->source_y / 0x10) * 0x10 + align->source_x / 0x10;
+		const Page *im = &pages[align->source_image];
+		
+		for (int a = 0; a < h; ++a, cell_n += 0x10) {
+			int gy = align->y / 0x10 + a - gy0;
+			for (int b = 0; b < w; ++b) {
+				int gx = align->x / 0x10 + b - gx0;
+				if (cell_n + b >= 256 || im->cell[cell_n + b].start == 0) {
+					continue;
+				}
+				if (gx >= 0 && gx < gw && gy >= 0 && gy < gh) {
+					covered[gy * gw + gx] = 1;
+				}
+			}
+		}
+	}
+	
+	for (int gy = 0; gy < gh; ++gy) {
+		int top = std::max((gy0 + gy) * 0x10 - y1, 0);
+		int bottom = std::min((gy0 + gy + 1) * 0x10 - y1, height);
+		
+		for (int gx = 0; gx < gw; ++gx) {
+			if (covered[gy * gw + gx]) {
+				continue;
+			}
+			
+			// Merge horizontal runs of uncovered tiles into one memset per row.
+			int end = gx;
+			while (end + 1 < gw && !covered[gy * gw + end + 1]) {
+				++end;
+			}
+			int left = std::max((gx0 + gx) * 0x10 - x1, 0);
+			int right = std::min((gx0 + end + 1) * 0x10 - x1, width);
+			
+			for (int y = top; y < bottom; ++y) {
+				memset(pixels + (y * width + left) * bytesPerPixel, 0, (right - left) * bytesPerPixel);
+			}
+			gx = end;
+		}
+	}
+}
+
 void CG::copy_cells(const CG_Image *image,
 			const CG_Alignment *align,
 			unsigned char *pixels,
@@ -51,7 +138,7 @@ void CG::copy_cells(const CG_Image *image,
 			unsigned int y1,
 			unsigned int width,
 			unsigned int height,
-			unsigned int *palette,
+			const unsigned int *palette,
 			bool is_8bpp) {
 	int w = align->width / 0x10;
 	int h = align->height / 0x10;
@@ -76,7 +163,7 @@ void CG::copy_cells(const CG_Image *image,
 			
 			if (is_8bpp) {
 				// 8bpp -> 8bpp
-				unsigned char *src = ((unsigned char *)m_data) + cell->start + cell->offset;
+				const unsigned char *src = ((const unsigned char *)m_data) + cell->start + cell->offset;
 				int cellw = cell->width;
 				
 				dest += offset;
@@ -92,7 +179,7 @@ void CG::copy_cells(const CG_Image *image,
 			} else if (image->type_id == 4) {
 				// two pass: first 8bit palettized, second 8bit alpha
 				unsigned int *ldest = (unsigned int *)dest;
-				unsigned char *src = ((unsigned char *)m_data) + cell->start + cell->offset;
+				const unsigned char *src = ((const unsigned char *)m_data) + cell->start + cell->offset;
 				int cellw = cell->width;
 				
 				ldest += offset;
@@ -109,7 +196,7 @@ void CG::copy_cells(const CG_Image *image,
 				ldest = (unsigned int *)dest;
 				ldest += offset;
 				
-				src = ((unsigned char *)m_data) + cell->start + cell->offset;
+				src = ((const unsigned char *)m_data) + cell->start + cell->offset;
 				src += align->width * align->height;
 
 				for (int c = 0; c < 0x10; ++c) {
@@ -123,7 +210,7 @@ void CG::copy_cells(const CG_Image *image,
 			} else if (image->type_id == 1) {
 				// 32bpp bgr -> rgb
 				unsigned int *ldest = (unsigned int *)dest;
-				unsigned int *src = (unsigned int *)(m_data + cell->start + cell->offset);
+				const unsigned int *src = (const unsigned int *)(m_data + cell->start + cell->offset);
 				int cellw = cell->width;
 				
 				ldest += offset;
@@ -141,7 +228,7 @@ void CG::copy_cells(const CG_Image *image,
 			} else {
 				// palettized 8bpp -> 32bpp
 				unsigned int *ldest = (unsigned int *)dest;
-				unsigned char *src = ((unsigned char *)m_data) + cell->start + cell->offset;
+				const unsigned char *src = ((const unsigned char *)m_data) + cell->start + cell->offset;
 				int cellw = cell->width;
 				
 				ldest += offset;
@@ -163,7 +250,8 @@ void CG::copy_cells(const CG_Image *image,
 }
 			
 
-ImageData *CG::draw_texture(unsigned int n, bool to_pow2_flg, bool draw_8bpp) {
+ImageData *CG::draw_texture(unsigned int n, bool to_pow2_flg, bool draw_8bpp, const unsigned int *basePalette,
+	unsigned char *dest, size_t destSize) {
 	const CG_Image *image = get_image(n);
 	if (!image) {
 		return 0;
@@ -198,8 +286,12 @@ ImageData *CG::draw_texture(unsigned int n, bool to_pow2_flg, bool draw_8bpp) {
 		height = to_pow2(height);
 	}
 	
+	if (!basePalette) {
+		basePalette = palette;
+	}
+	
 	// check to see if we need a custom palette
-	static unsigned int custom_palette[256];
+	unsigned int custom_palette[256];
 	bool needsCustom = false;
 	if (image->bpp == 32) {
 		if (image->type_id == 3) {
@@ -223,12 +315,6 @@ ImageData *CG::draw_texture(unsigned int n, bool to_pow2_flg, bool draw_8bpp) {
 		}
 	}
 	
-	unsigned char *pixels = new unsigned char[width*height*4];
-	memset(pixels, 0, width*height*4);
-	
-	// run through all tile region data
-	const CG_Alignment *align;
-
 	bool is_8bpp;
 	
 	if (draw_8bpp && image->bpp <= 8) {
@@ -237,19 +323,27 @@ ImageData *CG::draw_texture(unsigned int n, bool to_pow2_flg, bool draw_8bpp) {
 		is_8bpp = 0;
 	}
 	
+	size_t capacity = 0;
+	bool staged = dest && (size_t)width*height*4 <= destSize;
+	unsigned char *pixels = staged ? dest : PixelPool::Acquire(width*height*4, capacity);
+	clear_uncovered(image, pixels, x1, y1, width, height, is_8bpp ? 1 : 4);
+	
+	// run through all tile region data
+	const CG_Alignment *align;
+	
 	align = &m_align[image->align_start];
 	for (unsigned int i = 0; i < image->align_len; ++i, ++align) {
-		copy_cells(image, align, pixels, x1, y1, width, height, needsCustom ? custom_palette : palette, is_8bpp);
+		copy_cells(image, align, pixels, x1, y1, width, height, needsCustom ? custom_palette : basePalette, is_8bpp);
 	}
 	
 	// finalize in texture
 	ImageData *texture;
 	
 	// NOTE: CG images use RGBA format (bgr=false), unlike PAT textures which use BGRA (bgr=true)
-	if (!(texture = new ImageData{pixels, width, height, is_8bpp, false, image->bounds_x1, image->bounds_y1}))
+	if (!(texture = new ImageData{pixels, width, height, is_8bpp, false, image->bounds_x1, image->bounds_y1, capacity, staged}))
 	{
-		delete texture;
-		delete[] pixels;
+		if (!staged)
+			PixelPool::Release(pixels, capacity);
 		texture = nullptr;
 	}
 		
@@ -279,7 +373,7 @@ void CG::build_image_table() {
 		}
 
 		const CG_Alignment *align = &m_align[image->align_start];
-		unsigned int address = ((char *)image->data) - m_data;
+		unsigned int address = ((const char *)image->data) - m_data;
 		
 		if (image->bpp == 32) {
 			if (image->type_id == 3) {
@@ -294,6 +388,12 @@ void CG::build_image_table() {
 				continue;
 			}
 
+			// The file is mapped, so cells pointing past its end would fault on decode.
+			unsigned int bytesPerPixel = image->type_id == 1 ? 4 : (image->type_id == 4 ? 2 : 1);
+			if (address + align->width * align->height * bytesPerPixel > m_data_size) {
+				break;
+			}
+
 			
 			int w = align->width / 0x10;
 			int h = align->height / 0x10;
@@ -351,6 +451,8 @@ bool CG::loadPalette(const char *name) {
 		delete[] paletteData;
 		palMax = 0;
 	}
+	paletteNumber = 0;
+	m_serial = ++serialCounter;
 
 	unsigned int size;
 	char *data;
@@ -404,6 +506,7 @@ bool CG::changePaletteNumber(int number)
 	{
 		unsigned int *d = (unsigned int *)paletteData;
 		palette = d + paletteOffset + number * 0x100;
+		paletteNumber = number;
 		return true;
 	}
 	return false;
@@ -420,25 +523,25 @@ bool CG::load(const char *name) {
 		palMax = 0;
 	}
 	
-	char *data;
-	unsigned int size;
-	
-	if (!ReadInMem(name, data, size)) {
+	if (!m_file.Open(name)) {
 		return 0;
 	}
+	const char *data = m_file.Data();
+	unsigned int size = m_file.Size();
 	
 	// verify size and header
 	if (size < 0x4f30 || memcmp(data, "BMP Cutter3", 11)) {
-		delete[] data;
+		m_file.Close();
 		
 		return 0;
 	}
 	
 	// palette data.
-	unsigned int *d = (unsigned int *)(data + 0x10);
+	const unsigned int *d = (const unsigned int *)(data + 0x10);
 	d += 1; // has palette data?
-	palette = d;
-	origPalette = d;
+	memcpy(basePalette, d, sizeof(basePalette));
+	palette = basePalette;
+	origPalette = basePalette;
 	palMax = 1;
 	d += 0x800;	// There are 8 dupe palettes. The game doesn't use them. - always included.
 
@@ -458,19 +561,19 @@ bool CG::load(const char *name) {
 	page_count = (*d) + 1;
 	m_nalign = *(d+2);
 
-	unsigned int *indices = d + 12;
+	const unsigned int *indices = d + 12;
 	unsigned int image_count = d[3];
 	
 	//was 2999
-	if (image_count >= 3000) {
-		delete[] data;
+	if (image_count >= 3000 || indices[3000] + sizeof(CG_Alignment) * m_nalign > size) {
+		m_file.Close();
 		
 		return 0;
 	}
 	
 	// alignment data
 	// store everything for lookup later
-	m_align = (CG_Alignment *)(data + indices[3000]);
+	m_align = (const CG_Alignment *)(data + indices[3000]);
 	
 	
 	m_data = data;
@@ -479,6 +582,8 @@ bool CG::load(const char *name) {
 	m_indices = indices;
 	
 	m_nimages = image_count;
+	paletteNumber = 0;
+	m_serial = ++serialCounter;
 	
 	// but wait, there's more!
 	// because of the compression added to AACC, we need to go create
@@ -493,12 +598,13 @@ bool CG::load(const char *name) {
 }
 
 void CG::free() {
+	if (freeHook) {
+		freeHook(this);
+	}
 	if (paletteData) {
 		delete[] paletteData;
 	}
-	if (m_data) {
-		delete[] m_data;
-	}
+	m_file.Close();
 	palMax = 0;
 	paletteData = nullptr;
 	m_data = nullptr;
@@ -530,6 +636,8 @@ unsigned int CG::getColorFromPal(int palIndex)
 }
 
 CG::CG() {
+	palette = nullptr;
+	origPalette = nullptr;
 	m_data = 0;
 	m_data_size = 0;
 	
@@ -1,6 +1,9 @@
 #ifndef CG_H_GUARD
 #define CG_H_GUARD
 
+#include "misc.h"
+#include "pixel_pool.h"
+
 struct ImageData
 {
 	unsigned char *pixels = nullptr;
@@ -10,10 +13,17 @@ struct ImageData
 	bool	bgr = false;  // True if pixel data is in BGR/BGRA format
 	int		offsetX;
 	int		offsetY;
+	size_t	capacity = 0; // Non-zero if pixels came from PixelPool
+	bool	staged = false; // pixels are a PixelUpload staging buffer, not ours
 
 	~ImageData()
 	{
-		delete[] pixels;
+		if(staged)
+			return;
+		if(capacity)
+			PixelPool::Release(pixels, capacity);
+		else
+			delete[] pixels;
 	}
 };
 
@@ -47,11 +57,19 @@ class CG {
 protected:
 	unsigned int	*origPalette;
 	unsigned int	*palette;
+	unsigned int	basePalette[256];	// Normalized copy, the mapped file is read-only
 	char			*paletteData = nullptr;
 	int				palMax = 0;
 	int				paletteOffset = 0;
+	int				paletteNumber = 0;
+
+	//Changes on every load/palette file so decoded sprites can be cached by it.
+	unsigned int	m_serial = 0;
 
-	char					*m_data;
+	// The .cg stays mapped instead of being read in; only the header, index and
+	// the cells actually decoded ever get paged in.
+	MappedFile				m_file;
+	const char				*m_data;
 	unsigned int			m_data_size;
 
 	const unsigned int		*m_indices;
@@ -78,6 +96,14 @@ protected:
 	Page			*pages;
 	unsigned int	page_count;
 
+	void			clear_uncovered(
+					const CG_Image *image,
+					unsigned char *pixels,
+					int x1,
+					int y1,
+					int width,
+					int height,
+					int bytesPerPixel);
 	void			copy_cells(
 					const CG_Image *image,
 					const CG_Alignment *align,
@@ -86,7 +112,7 @@ protected:
 					unsigned int y1,
 					unsigned int width,
 					unsigned int height,
-					unsigned int *palette,
+					const unsigned int *palette,
 					bool is_8bpp);
 
 	void			build_image_table();
@@ -98,13 +124,27 @@ public:
 	bool loadPalette(const char *name);
 	bool changePaletteNumber(int number);
 	int getPalNumber();
+	int getCurrentPalette() const { return paletteNumber; }
+	const unsigned int *getPalette() const { return palette; }
+	unsigned int getSerial() const { return m_serial; }
 	unsigned int getColorFromPal(int palIndex);
 
 	void free();
 
+	// Called at the start of free(), so threads still decoding from this CG can finish first.
+	static void (*freeHook)(const CG *cg);
+
 	const char *get_filename(unsigned int n);
 
-	ImageData* draw_texture(unsigned int n, bool to_pow2, bool draw_8bpp = 0);
+	// Raw header and alignment list for tools that need more than the pixels.
+	const CG_Image *get_image_header(unsigned int n) { return get_image(n); }
+	const CG_Alignment *get_alignments(const CG_Image *image);
+
+	// basePalette replaces the current palette for 8bpp images. Safe to call from
+	// several threads at once as long as nothing frees or reloads the CG meanwhile.
+	// The image is decoded into dest if it fits in destSize bytes, and is staged then.
+	ImageData* draw_texture(unsigned int n, bool to_pow2, bool draw_8bpp = 0, const unsigned int *basePalette = nullptr,
+		unsigned char *dest = nullptr, size_t destSize = 0);
 
 	int	get_image_count();
 
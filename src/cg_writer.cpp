@@ -0,0 +1,465 @@
+#include "cg_writer.h"
+#include "misc.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <unordered_map>
+
+// Offsets into the header, see CG::load.
+static constexpr size_t paletteOffset = 0x14;
+static constexpr size_t wordsOffset = 0x2014;
+static constexpr size_t indexOffset = 0x2044;
+static constexpr int maxIndices = 3000;
+
+static bool WriteFile(const char *filename, const void *data, size_t size)
+{
+	FILE *file = fopen(filename, "wb");
+	if(!file)
+	{
+		printf("Can't open %s for writing\n", filename);
+		return false;
+	}
+	bool ok = fwrite(data, 1, size, file) == size;
+	if(fclose(file) != 0 || !ok)
+	{
+		printf("Error writing %s\n", filename);
+		return false;
+	}
+	return true;
+}
+
+static uint64_t Fnv(uint64_t h, const unsigned char *data, size_t size)
+{
+	for(size_t i = 0; i < size; ++i)
+	{
+		h ^= data[i];
+		h *= 0x100000001b3ull;
+	}
+	return h;
+}
+
+static void Put32(std::vector<unsigned char> &out, unsigned int v)
+{
+	unsigned char b[4] = {(unsigned char)v, (unsigned char)(v >> 8), (unsigned char)(v >> 16), (unsigned char)(v >> 24)};
+	out.insert(out.end(), b, b + 4);
+}
+
+CGWriter::CGWriter():
+rawHeader(indexOffset, 0),
+nextPage(0),
+nextPos(0),
+cellCount(0)
+{
+	memcpy(rawHeader.data(), "BMP Cutter3", 11);
+	rawHeader[0x10] = 1;
+}
+
+void CGWriter::SetPalette(const unsigned int *palette)
+{
+	for(int i = 0; i < 8; ++i)
+		memcpy(&rawHeader[paletteOffset + i * 1024], palette, 1024);
+}
+
+int CGWriter::FindCell(uint64_t hash, int context, const std::vector<unsigned char> &payload) const
+{
+	auto it = cellLookup.find(hash);
+	if(it == cellLookup.end())
+		return -1;
+	for(int id : it->second)
+		if(cells[id].context == context && cells[id].payload == payload)
+			return id;
+	return -1;
+}
+
+int CGWriter::AllocCell(uint64_t hash, int context, const std::vector<unsigned char> &payload)
+{
+	int id = cells.size();
+	cells.push_back({nextPage, nextPos, context, payload});
+	cellLookup[hash].push_back(id);
+	if(++nextPos == 256)
+	{
+		++nextPage;
+		nextPos = 0;
+	}
+	return id;
+}
+
+int CGWriter::AddFrame(const Frame &frame)
+{
+	// Cut the frame into cells starting at its first pixel, zero filled past
+	// its edges. The decoder doesn't clip cells, so the bounds are the frame
+	// itself, only grown to whole cells.
+	int gw = frame.width > 0 ? (frame.width + 15) / 16 : 0;
+	int gh = frame.height > 0 ? (frame.height + 15) / 16 : 0;
+
+	std::vector<unsigned int> raw((size_t)gw * gh * 256, 0);
+	std::vector<char> used((size_t)gw * gh, 0);
+	for(int y = 0; y < frame.height; ++y)
+	{
+		const unsigned char *row = frame.pixels + (size_t)y * frame.stride;
+		int cy = y / 16;
+		int py = y % 16;
+		for(int x = 0; x < frame.width; ++x)
+		{
+			unsigned int v;
+			if(frame.indexed)
+				v = row[x];
+			else
+			{
+				const unsigned char *p = row + x * 4;
+				v = p[3] ? p[0] | (p[1] << 8) | (p[2] << 16) | (p[3] << 24) : 0;
+			}
+			if(!v)
+				continue;
+
+			int cx = x / 16;
+			int px = x % 16;
+			raw[((size_t)cy * gw + cx) * 256 + py * 16 + px] = v;
+			used[cy * gw + cx] = 1;
+		}
+	}
+
+	// Pick the smallest type that holds every used cell exactly.
+	int type = 0;
+	std::vector<unsigned int> palette;
+	std::unordered_map<unsigned int, int> colourIndex;
+	if(!frame.indexed)
+	{
+		bool opaque = true;
+		for(size_t c = 0; c < used.size(); ++c)
+		{
+			if(!used[c])
+				continue;
+			for(int i = 0; i < 256; ++i)
+			{
+				unsigned int v = raw[c * 256 + i];
+				if((v >> 24) != 0xff)
+					opaque = false;
+				if(!v || colourIndex.size() > 256)
+					continue;
+				if(colourIndex.emplace(v & 0xffffff, (int)palette.size()).second)
+					palette.push_back(v & 0xffffff);
+			}
+		}
+
+		if(palette.size() <= 1)
+			type = 3;
+		else if(palette.size() <= 256)
+			type = opaque ? 2 : 4;
+		else
+			type = 1;
+	}
+
+	std::vector<unsigned char> context(1, type);
+	if(type == 2 || type == 4)
+	{
+		palette.resize(256, 0);
+		for(unsigned int v : palette)
+			Put32(context, v);
+	}
+	else if(type == 3)
+		Put32(context, palette.empty() ? 0 : palette[0]);
+	int contextId = contexts.emplace(context, (int)contexts.size()).first->second;
+	uint64_t contextHash = Fnv(0xcbf29ce484222325ull, context.data(), context.size());
+
+	const int bytesPerPixel = type == 1 ? 4 : 1;
+	const int planes = type == 4 ? 2 : 1;
+
+	Image image = {};
+	image.present = true;
+	image.data.assign(context.begin() + 1, context.end());
+
+	// Walk each cell row, merging neighbours into one alignment when their
+	// cells also sit next to each other in a page row.
+	std::vector<unsigned char> payload(256 * bytesPerPixel * planes);
+	for(int cy = 0; cy < gh; ++cy)
+	{
+		int runStart = 0, runLength = 0, runFirst = -1, runLast = -1;
+		bool runCopy = false;
+		auto flush = [&]() {
+			if(!runLength)
+				return;
+			const Cell &first = cells[runFirst];
+			CG_Alignment align;
+			align.x = frame.x + runStart * 16;
+			align.y = frame.y + cy * 16;
+			align.width = runLength * 16;
+			align.height = 16;
+			align.source_x = (first.pos & 15) * 16;
+			align.source_y = (first.pos >> 4) * 16;
+			align.source_image = first.page;
+			align.copy_flag = runCopy;
+			image.aligns.push_back(align);
+
+			if(!runCopy)
+			{
+				//Region data is row major over the whole alignment, one plane after the other.
+				const int rowBytes = 16 * bytesPerPixel;
+				for(int p = 0; p < planes; ++p)
+					for(int r = 0; r < 16; ++r)
+						for(int i = 0; i < runLength; ++i)
+						{
+							const unsigned char *src = cells[runFirst + i].payload.data() + p * 256 * bytesPerPixel + r * rowBytes;
+							image.data.insert(image.data.end(), src, src + rowBytes);
+						}
+			}
+			runLength = 0;
+		};
+
+		for(int cx = 0; cx < gw; ++cx)
+		{
+			if(!used[cy * gw + cx])
+				continue;
+			const unsigned int *src = &raw[((size_t)cy * gw + cx) * 256];
+			for(int i = 0; i < 256; ++i)
+			{
+				unsigned int v = src[i];
+				switch(type)
+				{
+				case 0:
+				case 2:
+					payload[i] = type ? colourIndex[v & 0xffffff] : v;
+					break;
+				case 3:
+					payload[i] = v >> 24;
+					break;
+				case 4:
+					payload[i] = v ? colourIndex[v & 0xffffff] : 0;
+					payload[256 + i] = v >> 24;
+					break;
+				default:
+					//Stored as BGRA.
+					payload[i*4+0] = v >> 16;
+					payload[i*4+1] = v >> 8;
+					payload[i*4+2] = v;
+					payload[i*4+3] = v >> 24;
+					break;
+				}
+			}
+			++cellCount;
+
+			uint64_t hash = Fnv(contextHash, payload.data(), payload.size());
+			int id = FindCell(hash, contextId, payload);
+			bool copy = id >= 0;
+
+			//Type 4 finds the alpha plane through the drawing alignment's size,
+			//so copies only work if they match the owner. Keep both single cells.
+			bool extend = runLength && runCopy == copy && type != 4 && runStart + runLength == cx;
+			if(extend && copy)
+				extend = cells[id].page == cells[runLast].page && cells[id].pos == cells[runLast].pos + 1 && (cells[id].pos & 15);
+			else if(extend)
+				extend = nextPos & 15; //Next allocation continues the page row.
+			if(!extend)
+			{
+				flush();
+				runStart = cx;
+				runCopy = copy;
+			}
+
+			if(!copy)
+				id = AllocCell(hash, contextId, payload);
+			if(!runLength)
+				runFirst = id;
+			runLast = id;
+			++runLength;
+		}
+		flush();
+	}
+
+	CG_Image header = {};
+	strncpy(header.filename, frame.name.c_str(), sizeof(header.filename) - 1);
+	header.type_id = type;
+	header.width = frame.canvasWidth;
+	header.height = frame.canvasHeight;
+	header.bpp = type == 0 ? 8 : 32;
+	if(gw && gh)
+	{
+		header.bounds_x1 = frame.x;
+		header.bounds_y1 = frame.y;
+		header.bounds_x2 = frame.x + gw * 16 - 1;
+		header.bounds_y2 = frame.y + gh * 16 - 1;
+	}
+	else
+	{
+		//Zero sized, draw_texture skips it.
+		header.bounds_x2 = -1;
+		header.bounds_y2 = -1;
+	}
+	image.header = header;
+
+	images.push_back(std::move(image));
+	return images.size() - 1;
+}
+
+int CGWriter::AddRaw(const CG_Image *header)
+{
+	Image image = {};
+	image.present = true;
+	memcpy(&image.header, header, imageHeaderSize);
+	image.header.align_start = 0;
+	image.header.align_len = 0;
+	images.push_back(std::move(image));
+	return images.size() - 1;
+}
+
+int CGWriter::AddMissing()
+{
+	images.push_back(Image{});
+	return images.size() - 1;
+}
+
+bool CGWriter::Write(const char *filename)
+{
+	if(images.size() >= maxIndices)
+	{
+		printf("Too many images: %d, the format holds %d\n", (int)images.size(), maxIndices - 1);
+		return false;
+	}
+	if(nextPage >= 0x8000)
+	{
+		printf("Too many cell pages\n");
+		return false;
+	}
+
+	std::vector<unsigned char> out(rawHeader);
+	out.resize(headerSize, 0);
+	unsigned int *words = (unsigned int *)&out[wordsOffset];
+	unsigned int *indices = (unsigned int *)&out[indexOffset];
+
+	unsigned int alignCount = 0;
+	for(size_t i = 0; i < images.size(); ++i)
+	{
+		Image &image = images[i];
+		if(!image.present)
+			continue;
+		image.header.align_start = alignCount;
+		image.header.align_len = image.aligns.size();
+		alignCount += image.aligns.size();
+
+		indices[i] = out.size();
+		const unsigned char *header = (const unsigned char *)&image.header;
+		out.insert(out.end(), header, header + imageHeaderSize);
+		out.insert(out.end(), image.data.begin(), image.data.end());
+		words = (unsigned int *)&out[wordsOffset];
+		indices = (unsigned int *)&out[indexOffset];
+	}
+
+	words[0] = GetStats().pages - 1;
+	words[2] = alignCount;
+	words[3] = images.size();
+	indices[maxIndices] = out.size();
+	for(auto &image : images)
+	{
+		const unsigned char *a = (const unsigned char *)image.aligns.data();
+		out.insert(out.end(), a, a + image.aligns.size() * sizeof(CG_Alignment));
+	}
+
+	return WriteFile(filename, out.data(), out.size());
+}
+
+CGWriter::Stats CGWriter::GetStats() const
+{
+	Stats stats = {};
+	stats.cells = cellCount;
+	stats.uniqueCells = cells.size();
+	stats.pages = std::max(1, nextPage + (nextPos ? 1 : 0));
+	stats.bytes = headerSize;
+	for(auto &image : images)
+	{
+		if(!image.present)
+			continue;
+		++stats.images;
+		stats.alignments += image.aligns.size();
+		stats.bytes += imageHeaderSize + image.data.size() + image.aligns.size() * sizeof(CG_Alignment);
+	}
+	return stats;
+}
+
+bool CGWriter::Compact(const char *in, const char *out, Stats *before, Stats *after)
+{
+	CG cg;
+	MappedFile file;
+	if(!cg.load(in) || !file.Open(in))
+	{
+		printf("Can't load %s\n", in);
+		return false;
+	}
+
+	const unsigned int *words = (const unsigned int *)(file.Data() + wordsOffset);
+	const unsigned int *indices = (const unsigned int *)(file.Data() + indexOffset);
+	Stats old = {};
+	old.pages = words[0] + 1;
+	old.alignments = words[2];
+	old.bytes = file.Size();
+
+	CGWriter writer;
+	writer.rawHeader.assign(file.Data(), file.Data() + indexOffset);
+	for(int n = 0; n < cg.get_image_count(); ++n)
+	{
+		const CG_Image *image = cg.get_image_header(n);
+		if(!indices[n] || !image)
+		{
+			writer.AddMissing();
+			continue;
+		}
+
+		const CG_Alignment *align = cg.get_alignments(image);
+		++old.images;
+		for(unsigned int j = 0; align && j < image->align_len; ++j)
+		{
+			int count = (align[j].width / 16) * (align[j].height / 16);
+			old.cells += count;
+			if(!align[j].copy_flag)
+				old.uniqueCells += count;
+		}
+
+		//Indexed images stay indexed so palette swaps keep working.
+		bool indexed = image->bpp <= 8;
+		std::unique_ptr<ImageData> pixels;
+		if(image->type_id != -1)
+			pixels.reset(cg.draw_texture(n, false, indexed));
+		if(!pixels)
+		{
+			writer.AddRaw(image);
+			continue;
+		}
+
+		Frame frame;
+		frame.name.assign(image->filename, strnlen(image->filename, sizeof(image->filename)));
+		frame.canvasWidth = image->width;
+		frame.canvasHeight = image->height;
+		frame.x = image->bounds_x1;
+		frame.y = image->bounds_y1;
+		frame.width = image->bounds_x2 - image->bounds_x1 + 1;
+		frame.height = image->bounds_y2 - image->bounds_y1 + 1;
+		frame.stride = pixels->width * (indexed ? 1 : 4);
+		frame.indexed = indexed;
+		//Indexed images are decoded from the canvas origin.
+		frame.pixels = pixels->pixels;
+		if(indexed)
+			frame.pixels += (size_t)frame.y * frame.stride + frame.x;
+		writer.AddFrame(frame);
+	}
+
+	//Alignments are one cell row high, so a sheet whose regions span several
+	//rows and share nothing can come out bigger. It's kept as it is then.
+	Stats rewritten = writer.GetStats();
+	bool keep = rewritten.bytes >= old.bytes;
+	std::vector<char> original;
+	if(keep)
+		original.assign(file.Data(), file.Data() + file.Size());
+	if(before)
+		*before = old;
+	if(after)
+		*after = keep ? old : rewritten;
+
+	//The writer has its own copies; unmap so out can be the same file.
+	file.Close();
+	cg.free();
+	if(keep)
+		return WriteFile(out, original.data(), original.size());
+	return writer.Write(out);
+}
@@ -0,0 +1,97 @@
+#ifndef CG_WRITER_H_GUARD
+#define CG_WRITER_H_GUARD
+
+#include "cg.h"
+#include <cstdint>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Builds .cg files. Frames are cut into 16x16 cells from their first pixel,
+// identical cells are stored once and referenced through copy alignments,
+// and every frame gets the smallest image type that can hold it:
+//   0  8bpp indices into the sheet palette (indexed input)
+//   3  one colour, 8bpp alpha
+//   2  own 256 colour palette, fully opaque
+//   4  own 256 colour palette plus an alpha plane
+//   1  32bpp
+class CGWriter
+{
+public:
+	struct Frame
+	{
+		std::string name;        //Shift-JIS, at most 31 bytes.
+		int canvasWidth;         //Stored as CG_Image width/height.
+		int canvasHeight;
+		int x, y;                //Canvas position of the first pixel, kept as the bounds.
+		int width, height;
+		int stride;              //In bytes.
+		bool indexed;            //8bpp sheet palette indices, otherwise RGBA.
+		const unsigned char *pixels;
+	};
+
+	struct Stats
+	{
+		int images;
+		int cells;       //Non-empty cells over all frames.
+		int uniqueCells; //Cells actually stored.
+		int pages;
+		int alignments;
+		size_t bytes;
+	};
+
+	CGWriter();
+
+	//256 entries, written as the sheet palette.
+	void SetPalette(const unsigned int *palette);
+
+	//Images are numbered in the order they're added.
+	int AddFrame(const Frame &frame);
+	//Keeps a header without pixels, e.g. type -1 placeholders.
+	int AddRaw(const CG_Image *header);
+	//Index entry 0, the slot is unused.
+	int AddMissing();
+
+	bool Write(const char *filename);
+	Stats GetStats() const;
+
+	//Decodes every image of an existing sheet and writes it back with
+	//maximum cell reuse. Header, palettes and image bounds are kept as they
+	//are. If that isn't smaller, the sheet is copied unchanged.
+	static bool Compact(const char *in, const char *out, Stats *before, Stats *after);
+
+private:
+	static constexpr size_t headerSize = 0x4f30;
+	static constexpr size_t imageHeaderSize = 72;
+
+	struct Image
+	{
+		bool present;
+		CG_Image header; //Only the first imageHeaderSize bytes are written.
+		std::vector<unsigned char> data;
+		std::vector<CG_Alignment> aligns;
+	};
+
+	struct Cell
+	{
+		int page;
+		int pos;
+		int context; //Image type and palette the payload is only valid with.
+		std::vector<unsigned char> payload;
+	};
+
+	std::vector<unsigned char> rawHeader; //Everything up to the index table.
+	std::vector<Image> images;
+	std::vector<Cell> cells;
+	std::unordered_map<uint64_t, std::vector<int>> cellLookup;
+	std::map<std::vector<unsigned char>, int> contexts;
+	int nextPage;
+	int nextPos;
+	int cellCount;
+
+	int FindCell(uint64_t hash, int context, const std::vector<unsigned char> &payload) const;
+	int AllocCell(uint64_t hash, int context, const std::vector<unsigned char> &payload);
+};
+
+#endif /* CG_WRITER_H_GUARD */
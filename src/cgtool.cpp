@@ -0,0 +1,375 @@
+// Headless bulk CG exporter: decodes every sprite of one or more .cg files
+// to PNG on all cores and writes a manifest.json per file.
+// "cgtool compact" rewrites a .cg with duplicate cells merged, then decodes
+// every image of both sheets and checks they're the same.
+// Built as cgtool.exe. No GL involved, so it also runs on Linux.
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "cg.h"
+#include "cg_writer.h"
+#include "misc.h"
+#include "png.h"
+#include "../third_party/json/json.hpp"
+
+namespace fs = std::filesystem;
+using json = nlohmann::json;
+
+struct Sheet
+{
+	std::unique_ptr<CG> cg;
+	fs::path outDir;
+	std::string name;
+	std::vector<char> exported; //Per image, written by the workers.
+};
+
+struct Job
+{
+	int sheet;
+	int image;
+};
+
+static void Usage()
+{
+	printf("Usage: cgtool [options] <file.cg | folder>...\n"
+		"       cgtool compact <in.cg> <out.cg>\n"
+		"  -o <dir>    Output folder (default: current folder)\n"
+		"  -p <file>   Palette file, only with a single .cg\n"
+		"  -n <index>  Palette number inside the palette file\n"
+		"  -j <count>  Worker threads (default: all cores)\n"
+		"Folders are searched recursively. A .pal with the same name as the .cg\n"
+		"is used when no -p is given. With several .cg files, each goes to\n"
+		"<dir>/<cg path without extension>/, relative to the folder it was found in.\n"
+		"Names that are already taken get _2, _3 and so on.\n"
+		"compact only replaces out.cg if every image decodes the same as before.\n");
+}
+
+//Each .cg with the folder its output goes under when there are several.
+static void CollectInputs(const fs::path &path, std::vector<std::pair<fs::path, fs::path>> &out)
+{
+	std::error_code ec;
+	if(fs::is_directory(path, ec))
+	{
+		for(auto &entry : fs::recursive_directory_iterator(path, ec))
+		{
+			std::string ext = entry.path().extension().string();
+			for(auto &c : ext)
+				c = tolower(c);
+			if(entry.is_regular_file() && ext == ".cg")
+				out.push_back({entry.path(), fs::relative(entry.path(), path, ec).replace_extension()});
+		}
+	}
+	else
+		out.push_back({path, path.stem()});
+}
+
+static json MakeManifest(Sheet &sheet, int palette)
+{
+	CG *cg = sheet.cg.get();
+	json images = json::array();
+	for(int i = 0; i < cg->get_image_count(); ++i)
+	{
+		const CG_Image *image = cg->get_image_header(i);
+		if(!image)
+			continue;
+
+		std::string filename(image->filename, strnlen(image->filename, sizeof(image->filename)));
+		json entry = {
+			{"index", i},
+			{"name", sj2utf8(filename)},
+			{"type", image->type_id},
+			{"bpp", image->bpp},
+			{"offset", {image->bounds_x1, image->bounds_y1}},
+			{"size", {image->bounds_x2 - image->bounds_x1 + 1, image->bounds_y2 - image->bounds_y1 + 1}},
+		};
+		if(sheet.exported[i])
+		{
+			char png[16];
+			sprintf(png, "%04d.png", i);
+			entry["file"] = png;
+		}
+
+		json aligns = json::array();
+		const CG_Alignment *align = cg->get_alignments(image);
+		for(unsigned int j = 0; align && j < image->align_len; ++j, ++align)
+		{
+			aligns.push_back({
+				{"x", align->x}, {"y", align->y},
+				{"w", align->width}, {"h", align->height},
+				{"srcX", align->source_x}, {"srcY", align->source_y},
+				{"page", align->source_image}, {"copy", align->copy_flag},
+			});
+		}
+		entry["alignments"] = aligns;
+		images.push_back(entry);
+	}
+
+	return {
+		{"source", sheet.name},
+		{"palette", palette},
+		{"images", images},
+	};
+}
+
+static void PrintStats(const char *label, const CGWriter::Stats &stats)
+{
+	printf("%-7s %5d images %7d cells %7d stored %4d pages %7d alignments %10zu bytes\n", label,
+		stats.images, stats.cells, stats.uniqueCells, stats.pages, stats.alignments, stats.bytes);
+}
+
+//Fully transparent pixels only have to match in alpha.
+static bool SamePixels(const ImageData &a, const ImageData &b)
+{
+	if(a.is8bpp)
+		return !memcmp(a.pixels, b.pixels, (size_t)a.width * a.height);
+	const unsigned int *pa = (const unsigned int *)a.pixels;
+	const unsigned int *pb = (const unsigned int *)b.pixels;
+	for(size_t i = 0; i < (size_t)a.width * a.height; ++i)
+	{
+		if(pa[i] != pb[i] && ((pa[i] | pb[i]) >> 24))
+			return false;
+	}
+	return true;
+}
+
+//Every image has to decode to the same size, position and pixels.
+static int CompareSheets(const char *original, const char *compacted)
+{
+	CG a, b;
+	if(!a.load(original) || !b.load(compacted))
+	{
+		printf("Can't load %s or %s\n", original, compacted);
+		return 1;
+	}
+	if(a.get_image_count() != b.get_image_count())
+	{
+		printf("%d images, %d after compacting\n", a.get_image_count(), b.get_image_count());
+		return 1;
+	}
+
+	int failures = 0;
+	for(int n = 0; n < a.get_image_count(); ++n)
+	{
+		const CG_Image *ia = a.get_image_header(n);
+		const CG_Image *ib = b.get_image_header(n);
+		if(!ia || !ib)
+		{
+			if(ia || ib)
+			{
+				printf("  image %d: only in one of the sheets\n", n);
+				++failures;
+			}
+			continue;
+		}
+		if(ia->width != ib->width || ia->height != ib->height)
+		{
+			printf("  image %d: canvas %ux%u, %ux%u after\n", n, ia->width, ia->height, ib->width, ib->height);
+			++failures;
+		}
+
+		for(int indexed = 0; indexed < (ia->bpp <= 8 ? 2 : 1); ++indexed)
+		{
+			std::unique_ptr<ImageData> da(a.draw_texture(n, false, indexed));
+			std::unique_ptr<ImageData> db(b.draw_texture(n, false, indexed));
+			if(!da || !db)
+			{
+				if(da || db)
+				{
+					printf("  image %d: only decodes in one of the sheets\n", n);
+					++failures;
+				}
+				continue;
+			}
+			if(da->width != db->width || da->height != db->height || da->offsetX != db->offsetX || da->offsetY != db->offsetY)
+			{
+				printf("  image %d: %dx%d at %d,%d, %dx%d at %d,%d after\n", n, da->width, da->height, da->offsetX, da->offsetY,
+					db->width, db->height, db->offsetX, db->offsetY);
+				++failures;
+			}
+			else if(!SamePixels(*da, *db))
+			{
+				printf("  image %d: %s pixels differ\n", n, indexed ? "8bpp" : "RGBA");
+				++failures;
+			}
+		}
+	}
+	return failures;
+}
+
+static int Compact(const char *in, const char *out)
+{
+	//Written next to out first, so a bad result never replaces anything.
+	std::string temp = std::string(out) + ".tmp";
+	CGWriter::Stats before, after;
+	if(!CGWriter::Compact(in, temp.c_str(), &before, &after))
+		return 1;
+	PrintStats("Before", before);
+	PrintStats("After", after);
+
+	int failures = CompareSheets(in, temp.c_str());
+	std::error_code ec;
+	if(!failures)
+	{
+		fs::rename(temp, out, ec);
+		if(ec)
+		{
+			printf("Can't replace %s: %s\n", out, ec.message().c_str());
+			++failures;
+		}
+	}
+	if(failures)
+		fs::remove(temp, ec);
+	printf("\nResult: %d failures\n", failures);
+	return failures > 0 ? 2 : 0;
+}
+
+int main(int argc, char **argv)
+{
+	if(argc > 1 && !strcmp(argv[1], "compact"))
+	{
+		if(argc != 4)
+		{
+			Usage();
+			return 1;
+		}
+		return Compact(argv[2], argv[3]);
+	}
+
+	fs::path outRoot = ".";
+	std::string palFile;
+	int palNumber = 0;
+	int threadCount = std::thread::hardware_concurrency();
+	std::vector<std::pair<fs::path, fs::path>> inputs;
+
+	for(int i = 1; i < argc; ++i)
+	{
+		bool hasValue = i + 1 < argc;
+		if(!strcmp(argv[i], "-o") && hasValue)
+			outRoot = argv[++i];
+		else if(!strcmp(argv[i], "-p") && hasValue)
+			palFile = argv[++i];
+		else if(!strcmp(argv[i], "-n") && hasValue)
+			palNumber = atoi(argv[++i]);
+		else if(!strcmp(argv[i], "-j") && hasValue)
+			threadCount = atoi(argv[++i]);
+		else if(argv[i][0] == '-')
+		{
+			Usage();
+			return 1;
+		}
+		else
+			CollectInputs(argv[i], inputs);
+	}
+
+	if(inputs.empty())
+	{
+		Usage();
+		return 1;
+	}
+	if(!palFile.empty() && inputs.size() > 1)
+	{
+		printf("-p only works with a single .cg\n");
+		return 1;
+	}
+	if(threadCount < 1)
+		threadCount = 1;
+
+	MakeOutputPathsUnique(inputs);
+
+	//Loading only maps the files, the decoding is what gets spread out.
+	std::vector<Sheet> sheets;
+	std::vector<Job> jobs;
+	for(auto &entry : inputs)
+	{
+		const fs::path &input = entry.first;
+		Sheet sheet;
+		sheet.cg.reset(new CG);
+		sheet.name = input.filename().string();
+		if(!sheet.cg->load(input.string().c_str()))
+		{
+			printf("Can't load %s\n", input.string().c_str());
+			continue;
+		}
+
+		fs::path pal = palFile.empty() ? fs::path(input).replace_extension(".pal") : fs::path(palFile);
+		std::error_code ec;
+		if(fs::exists(pal, ec))
+		{
+			if(!sheet.cg->loadPalette(pal.string().c_str()))
+				printf("Can't load palette %s\n", pal.string().c_str());
+			else if(!sheet.cg->changePaletteNumber(palNumber))
+				printf("%s has no palette %d\n", pal.string().c_str(), palNumber);
+		}
+
+		sheet.outDir = inputs.size() > 1 ? outRoot / entry.second : outRoot;
+		fs::create_directories(sheet.outDir, ec);
+		if(ec)
+		{
+			printf("Can't create %s\n", sheet.outDir.string().c_str());
+			continue;
+		}
+
+		int count = sheet.cg->get_image_count();
+		sheet.exported.assign(count, 0);
+		for(int i = 0; i < count; ++i)
+			jobs.push_back({(int)sheets.size(), i});
+		sheets.push_back(std::move(sheet));
+	}
+
+	std::atomic<size_t> next(0);
+	std::atomic<int> written(0);
+	std::atomic<int> failed(0);
+	auto worker = [&]() {
+		std::vector<unsigned char> encoded;
+		size_t index;
+		while((index = next++) < jobs.size())
+		{
+			Sheet &sheet = sheets[jobs[index].sheet];
+			int n = jobs[index].image;
+			std::unique_ptr<ImageData> image(sheet.cg->draw_texture(n, false, false));
+			if(!image)
+				continue;
+
+			Png::Encode(encoded, image->pixels, image->width, image->height, image->width * 4);
+
+			char name[16];
+			sprintf(name, "%04d.png", n);
+			std::ofstream file(sheet.outDir / name, std::ios::binary);
+			if(file.write((const char*)encoded.data(), encoded.size()))
+			{
+				sheet.exported[n] = 1;
+				++written;
+			}
+			else
+				++failed;
+		}
+	};
+
+	std::vector<std::thread> threads;
+	for(int i = 0; i < threadCount; ++i)
+		threads.emplace_back(worker);
+	for(auto &thread : threads)
+		thread.join();
+
+	for(auto &sheet : sheets)
+	{
+		std::ofstream file(sheet.outDir / "manifest.json");
+		file << MakeManifest(sheet, palNumber).dump(1, '\t');
+		if(!file)
+		{
+			printf("Can't write manifest for %s\n", sheet.name.c_str());
+			++failed;
+		}
+	}
+
+	printf("%d sprites from %d files, %d failed\n", written.load(), (int)sheets.size(), failed.load());
+	return failed ? 1 : 0;
+}
@@ -1,6 +1,7 @@
 #include "character_instance.h"
 #include "ini.h"
 #include "misc.h"
+#include "font_glyphs.h"
 #include <filesystem>
 #include <sstream>
 #include <iomanip>
@@ -222,6 +223,7 @@ bool CharacterInstance::savePATAs(const std::string& patPath)
 void CharacterInstance::setName(const std::string& name)
 {
 	m_name = name;
+	FontGlyphs::AddText(name);
 }
 
 std::string CharacterInstance::getName() const
@@ -240,11 +242,13 @@ std::string CharacterInstance::getDisplayName() const
 void CharacterInstance::markModified()
 {
 	m_isModified = true;
+	++m_editSerial;
 }
 
 void CharacterInstance::clearModified()
 {
 	m_isModified = false;
+	++m_editSerial;
 }
 
 bool CharacterInstance::isModified() const
@@ -49,6 +49,9 @@ public:
 	void markModified();
 	void clearModified();
 	bool isModified() const;
+	// Changes every time the data is marked modified or clean, so anything
+	// drawn from it can tell it's out of date.
+	unsigned int getEditSerial() const { return m_editSerial; }
 
 	// File paths
 	const std::vector<std::string>& getHA6Paths() const;
@@ -91,6 +94,7 @@ private:
 	std::string m_patPath;         // PAT (Parts) file path
 	std::string m_topHA6Path;      // Highest-indexed .ha6 (auto-save target)
 	bool m_isModified = false;
+	unsigned int m_editSerial = 0;
 };
 
 #endif /* CHARACTER_INSTANCE_H_GUARD */
@@ -1,5 +1,6 @@
 #include "filedialog.h"
 #include "main.h"
+#include "font_glyphs.h"
 #include <commdlg.h>
 
 std::string FileDialog(int fileType, bool save, char* defaultName)
@@ -57,6 +58,18 @@ std::string FileDialog(int fileType, bool save, char* defaultName)
 	{
 		ofn.lpstrFilter = "DDS Texture files (*.dds)\0*.dds\0All\0*.*\0";
 	}
+	else if (fileType == fileType::CSV)
+	{
+		ofn.lpstrFilter = "CSV files (*.csv)\0*.csv\0All\0*.*\0";
+	}
+	else if (fileType == fileType::TEXTURE)
+	{
+		ofn.lpstrFilter = "Textures (*.dds, *.png, *.tga)\0*.dds;*.png;*.tga\0All\0*.*\0";
+	}
+	else if (fileType == fileType::TEXTURE_EXPORT)
+	{
+		ofn.lpstrFilter = "DDS Texture files (*.dds)\0*.dds\0PNG images (*.png)\0*.png\0All\0*.*\0";
+	}
 	else
 	{
 		ofn.lpstrFilter = "All\0*.*\0";
@@ -70,12 +83,10 @@ std::string FileDialog(int fileType, bool save, char* defaultName)
 		ofn.Flags = OFN_PATHMUSTEXIST | OFN_FILEMUSTEXIST;
 
 	// Display the Open dialog box. 
-	if(save)
-	{
-		if(GetSaveFileNameA(&ofn)==TRUE)
-			return ofn.lpstrFile;
-	}
-	else if (GetOpenFileNameA(&ofn)==TRUE)
-		return ofn.lpstrFile;
-	return {};
+	bool picked = save ? GetSaveFileNameA(&ofn) == TRUE : GetOpenFileNameA(&ofn) == TRUE;
+	if(!picked)
+		return {};
+	// Paths end up in titles and menus
+	FontGlyphs::AddText(ofn.lpstrFile);
+	return ofn.lpstrFile;
 }
\ No newline at end of file
@@ -10,7 +10,10 @@ enum {
 	VECTOR,
 	HPROJ,
 	PAT,
-	DDS
+	DDS,
+	CSV,
+	TEXTURE,
+	TEXTURE_EXPORT
 };
 }
 
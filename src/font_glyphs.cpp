@@ -0,0 +1,141 @@
+#include "font_glyphs.h"
+#include "framedata_labels.h"
+
+namespace FontGlyphs
+{
+	void (*rebuildHook)() = nullptr;
+
+	//What the atlas was made with, and everything seen since.
+	static ImFontGlyphRangesBuilder built;
+	static ImFontGlyphRangesBuilder seen;
+	static bool started = false;
+	static ImVector<ImWchar> ranges;
+	static Stats stats;
+
+	//Always there: kana, CJK punctuation and full width forms, and the
+	//symbols that are common in pattern names.
+	static void AddBase(ImFontGlyphRangesBuilder &builder)
+	{
+		static const ImWchar baseRanges[] = {
+			0x0020, 0x00FF, // Basic Latin + Latin-1 Supplement
+			0x3000, 0x30FF, // CJK Symbols and Punctuation, Hiragana, Katakana
+			0x31F0, 0x31FF, // Katakana Phonetic Extensions
+			0xFF00, 0xFFEF, // Halfwidth and Fullwidth Forms
+			0xFFFD, 0xFFFD, // What ImGui shows for text that isn't UTF-8, like ANSI paths
+			0,
+		};
+		static const ImWchar symbols[] = {
+			0x203B,                         // ※
+			0x2190, 0x2191, 0x2192, 0x2193, // ←↑→↓
+			0x2605, 0x2606,                 // ★☆
+			0x25CF, 0x25CB,                 // ●○
+			0x25A0, 0x25A1,                 // ■□
+			0x25C6, 0x25C7,                 // ◆◇
+			0x25B2, 0x25B3, 0x25BC, 0x25BD, // ▲△▼▽
+			0x30FB, 0x2026, 0x2015, 0x301C, // ・…―〜
+			0x26A0,                         // ⚠
+		};
+		builder.AddRanges(baseRanges);
+		for(ImWchar c : symbols)
+			builder.AddChar(c);
+	}
+
+	template<size_t N>
+	static void AddList(const char *const (&list)[N])
+	{
+		for(const char *text : list)
+			AddText(text);
+	}
+
+	static void Start()
+	{
+		AddBase(seen);
+		started = true;
+		//The labels the UI has, some are Japanese.
+		AddList(hitVectorList);
+		AddList(conditionTypes);
+		AddList(characterList);
+		AddList(hitConditions);
+		AddList(opponentStateList);
+		AddList(comparisonTypes);
+		AddList(effectTypes);
+		AddList(stateList);
+		AddList(cancelList);
+		AddList(counterList);
+		AddList(invulList);
+		AddList(hitEffectList);
+		AddList(addedEffectList);
+		AddList(vectorFlags);
+		AddList(hitStopList);
+		AddList(interpolationList);
+		AddList(animationList);
+	}
+
+	void AddText(const char *text)
+	{
+		if(!started)
+			Start();
+		//ASCII is always in.
+		for(const char *c = text; *c; ++c)
+		{
+			if((unsigned char)*c >= 0x80)
+			{
+				seen.AddText(c);
+				return;
+			}
+		}
+	}
+
+	void AddChar(unsigned int c)
+	{
+		if(!started)
+			Start();
+		//Surrogates would need 32 bit ImWchar.
+		if(c >= 0x80 && c < 0x10000 && (c < 0xD800 || c > 0xDFFF))
+			seen.AddChar((ImWchar)c);
+	}
+
+	const ImWchar *BuildRanges()
+	{
+		if(!started)
+			Start();
+		built.UsedChars = seen.UsedChars;
+		ranges.clear();
+		built.BuildRanges(&ranges);
+		stats.characters = 0;
+		for(int i = 0; i + 1 < ranges.Size; i += 2)
+			stats.characters += ranges[i + 1] - ranges[i] + 1;
+		return ranges.Data;
+	}
+
+	void RecordBuild(double ms)
+	{
+		++stats.builds;
+		stats.lastMs = ms;
+		stats.totalMs += ms;
+	}
+
+	Stats GetStats()
+	{
+		return stats;
+	}
+
+	void Update()
+	{
+		ImGuiIO &io = ImGui::GetIO();
+		bool grown = false;
+		for(int i = 0; i < seen.UsedChars.Size && !grown; ++i)
+			grown = (seen.UsedChars[i] & ~built.UsedChars[i]) != 0;
+		if(grown && rebuildHook)
+			rebuildHook();
+
+#if IMGUI_VERSION_NUM >= 19200
+		//Glyphs are rasterized as they're drawn and the texture grows with them.
+		stats.atlasWidth = io.Fonts->TexData ? io.Fonts->TexData->Width : 0;
+		stats.atlasHeight = io.Fonts->TexData ? io.Fonts->TexData->Height : 0;
+#else
+		stats.atlasWidth = io.Fonts->TexWidth;
+		stats.atlasHeight = io.Fonts->TexHeight;
+#endif
+	}
+}
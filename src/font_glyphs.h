@@ -0,0 +1,41 @@
+#ifndef FONT_GLYPHS_H_GUARD
+#define FONT_GLYPHS_H_GUARD
+
+#include <imgui.h>
+#include <string>
+
+// Which characters the font atlas has. Instead of the whole Japanese range
+// it starts with Latin, kana and the symbols pattern names use, and gets
+// every character of the text that comes in: sj2utf8 results, file names,
+// typed and pasted text. When new ones show up the fonts are rebuilt once,
+// before the next frame starts. Main thread only.
+namespace FontGlyphs
+{
+	//UTF-8.
+	void AddText(const char *text);
+	inline void AddText(const std::string &text) { AddText(text.c_str()); }
+	//Typed, from WM_CHAR. ImGui only has them between NewFrame and EndFrame.
+	void AddChar(unsigned int c);
+
+	struct Stats
+	{
+		int characters;  //In the last ranges.
+		int builds;      //Font setups since startup.
+		double lastMs;   //The last setup, rasterizing included before ImGui 1.92.
+		double totalMs;
+		int atlasWidth, atlasHeight;
+	};
+
+	//What the fonts are made with. Stays valid until the next call.
+	const ImWchar *BuildRanges();
+	//How long the fonts took to set up with the last ranges.
+	void RecordBuild(double ms);
+	Stats GetStats();
+
+	//Before the frame starts. Calls rebuildHook if there's anything new and
+	//keeps track of the atlas size.
+	void Update();
+	extern void (*rebuildHook)();
+}
+
+#endif /* FONT_GLYPHS_H_GUARD */
@@ -0,0 +1,61 @@
+#include "frame_arena.h"
+
+FrameArena::FrameArena(size_t blockSize_):
+current(0),
+offset(0),
+blockSize(blockSize_),
+stats{}
+{
+}
+
+void *FrameArena::Allocate(size_t size, size_t align)
+{
+	if(size == 0)
+		size = 1;
+	while(current < blocks.size())
+	{
+		Block &block = blocks[current];
+		size_t start = (offset + align - 1) & ~(align - 1);
+		if(start + size <= block.size)
+		{
+			offset = start + size;
+			stats.used += size;
+			return block.data.get() + start;
+		}
+		++current;
+		offset = 0;
+	}
+
+	//new[] memory is aligned for any fundamental type.
+	Block block;
+	block.size = size > blockSize ? size : blockSize;
+	block.data.reset(new unsigned char[block.size]);
+	blocks.push_back(std::move(block));
+	current = blocks.size() - 1;
+	offset = size;
+	stats.used += size;
+	stats.capacity += blocks.back().size;
+	++stats.blocks;
+	return blocks.back().data.get();
+}
+
+void FrameArena::Reset()
+{
+	//A frame that spilled into more blocks gets one block big enough for
+	//all of it next time.
+	if(blocks.size() > 1 && current > 0)
+	{
+		size_t total = 0;
+		for(const Block &block : blocks)
+			total += block.size;
+		blocks.clear();
+		Block block;
+		block.size = total;
+		block.data.reset(new unsigned char[total]);
+		blocks.push_back(std::move(block));
+		++stats.blocks;
+	}
+	current = 0;
+	offset = 0;
+	stats.used = 0;
+}
@@ -0,0 +1,66 @@
+#ifndef FRAME_ARENA_H_GUARD
+#define FRAME_ARENA_H_GUARD
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+// Bump allocator for data that only lives for one frame. Reset() rewinds it
+// and keeps the memory, so once a frame's worth has been reserved nothing
+// more is taken from the heap. Not thread safe.
+class FrameArena
+{
+public:
+	struct Stats
+	{
+		size_t used;      //Bytes handed out since the last reset.
+		size_t capacity;
+		uint64_t blocks;  //Blocks taken from the heap, ever.
+	};
+
+	explicit FrameArena(size_t blockSize = 64*1024);
+
+	void *Allocate(size_t size, size_t align);
+	//Everything handed out before becomes invalid.
+	void Reset();
+
+	Stats GetStats() const { return stats; }
+
+private:
+	struct Block
+	{
+		std::unique_ptr<unsigned char[]> data;
+		size_t size;
+	};
+
+	std::vector<Block> blocks;
+	size_t current; //Index in blocks.
+	size_t offset;  //In the current block.
+	size_t blockSize;
+	Stats stats;
+};
+
+// Standard allocator over a FrameArena. Freeing does nothing, the memory
+// comes back when the arena is reset.
+template<class T>
+struct ArenaAllocator
+{
+	typedef T value_type;
+	typedef std::true_type propagate_on_container_swap;
+	typedef std::true_type propagate_on_container_move_assignment;
+
+	FrameArena *arena;
+
+	explicit ArenaAllocator(FrameArena *arena_) noexcept: arena(arena_) {}
+	template<class U> ArenaAllocator(const ArenaAllocator<U> &other) noexcept: arena(other.arena) {}
+
+	T *allocate(size_t n) { return static_cast<T*>(arena->Allocate(n * sizeof(T), alignof(T))); }
+	void deallocate(T *, size_t) noexcept {}
+
+	template<class U> bool operator==(const ArenaAllocator<U> &other) const noexcept { return arena == other.arena; }
+	template<class U> bool operator!=(const ArenaAllocator<U> &other) const noexcept { return arena != other.arena; }
+};
+
+#endif /* FRAME_ARENA_H_GUARD */
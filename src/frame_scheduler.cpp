@@ -0,0 +1,114 @@
+#include "frame_scheduler.h"
+#include "platform.h"
+
+#include <algorithm>
+#include <cmath>
+
+//How long to keep drawing after the last event.
+constexpr double linger = 0.5;
+constexpr int pacingSamples = 240;
+
+FrameScheduler::FrameScheduler(double interval_):
+interval(interval_),
+nextFrame(0),
+activeUntil(0),
+lastFrame(-1),
+continuous(true),
+backToBack(false),
+intervalPos(0),
+windowStart(Platform::Now()),
+windowIdle(0),
+pacing{}
+{
+}
+
+void FrameScheduler::RequestFrame()
+{
+	activeUntil = std::max(activeUntil, Platform::Now() + linger);
+}
+
+bool FrameScheduler::ShouldDraw() const
+{
+	double now = Platform::Now();
+	return (continuous || now < activeUntil) && now >= nextFrame;
+}
+
+double FrameScheduler::NextDeadline() const
+{
+	if(continuous || nextFrame < activeUntil)
+		return nextFrame;
+	return -1;
+}
+
+void FrameScheduler::FrameDrawn(bool continuous_)
+{
+	double now = Platform::Now();
+
+	//Only intervals between frames that were due right after each other
+	//say anything about pacing. Waking up from idle isn't jitter.
+	if(backToBack && lastFrame >= 0)
+	{
+		double d = now - lastFrame;
+		if((int)intervals.size() < pacingSamples)
+			intervals.push_back(d);
+		else
+			intervals[intervalPos] = d;
+		intervalPos = (intervalPos + 1) % pacingSamples;
+	}
+
+	//Stay on the grid so playback speed holds. A frame that ran a little late
+	//is made up right away, after a stall or idle time we start over.
+	nextFrame += interval;
+	if(nextFrame < now - interval)
+		nextFrame = now + interval;
+	else if(nextFrame < now)
+		nextFrame = now;
+
+	continuous = continuous_;
+	backToBack = continuous || nextFrame < activeUntil;
+	lastFrame = now;
+	UpdatePacing();
+}
+
+void FrameScheduler::Wait()
+{
+	double deadline = NextDeadline();
+	if(deadline < 0)
+		backToBack = false;
+
+	double start = Platform::Now();
+	Platform::WaitUntil(deadline);
+	windowIdle += Platform::Now() - start;
+	UpdatePacing();
+}
+
+void FrameScheduler::UpdatePacing()
+{
+	double now = Platform::Now();
+	if(now - windowStart >= 1.0)
+	{
+		pacing.idle = std::min(1.0, windowIdle / (now - windowStart));
+		windowStart = now;
+		windowIdle = 0;
+	}
+
+	pacing.frames = intervals.size();
+	if(intervals.empty())
+		return;
+
+	double sum = 0;
+	double worst = 0;
+	for(double d : intervals)
+	{
+		sum += d;
+		worst = std::max(worst, std::fabs(d - interval));
+	}
+	double mean = sum / intervals.size();
+	double var = 0;
+	for(double d : intervals)
+		var += (d - mean) * (d - mean);
+
+	pacing.meanMs = mean * 1000;
+	pacing.jitterMs = std::sqrt(var / intervals.size()) * 1000;
+	pacing.worstMs = worst * 1000;
+}
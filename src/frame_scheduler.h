@@ -0,0 +1,54 @@
+#ifndef FRAME_SCHEDULER_H_GUARD
+#define FRAME_SCHEDULER_H_GUARD
+
+#include <vector>
+
+// Decides when the main loop draws. Frames are paced at a fixed interval
+// while something is going on (input, playback, background work finishing)
+// and the loop sleeps otherwise.
+class FrameScheduler
+{
+public:
+	struct Pacing
+	{
+		int frames;       //Intervals measured, only while drawing back to back.
+		double meanMs;
+		double jitterMs;  //Standard deviation of the interval.
+		double worstMs;   //Largest distance from the target interval.
+		double idle;      //Fraction of the last second spent waiting.
+	};
+
+	explicit FrameScheduler(double interval);
+
+	//Input arrived or background work finished. Keeps drawing for a little
+	//while so hover effects and tooltips settle.
+	void RequestFrame();
+
+	bool ShouldDraw() const;
+	//When the next frame is due, negative if there's nothing to draw.
+	double NextDeadline() const;
+	//continuous: the frame that was just drawn wants another one after it.
+	void FrameDrawn(bool continuous);
+	//Sleeps until NextDeadline() or an event.
+	void Wait();
+
+	Pacing GetPacing() const { return pacing; }
+
+private:
+	double interval;
+	double nextFrame;
+	double activeUntil;
+	double lastFrame;
+	bool continuous;
+	bool backToBack;
+
+	std::vector<double> intervals; //Ring, in seconds.
+	int intervalPos;
+	double windowStart;
+	double windowIdle;
+	Pacing pacing;
+
+	void UpdatePacing();
+};
+
+#endif /* FRAME_SCHEDULER_H_GUARD */
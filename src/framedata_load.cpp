@@ -2,7 +2,9 @@
 #include <iostream>
 #include <cstdint>
 #include <cstring>
+#ifdef _WIN32
 #include <windows.h>
+#endif
 #include "framedata_load.h"
 #include "misc.h"
 
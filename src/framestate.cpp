@@ -1,8 +1,12 @@
 #include "framestate.h"
 #include <tinyalloc.h>
+#ifdef _WIN32
 #include <windows.h>
 
 constexpr const wchar_t *sharedMemHandleName = L"hanteichan-shared_mem";
+#else
+#include <cstdlib>
+#endif
 
 // Global shared memory - initialized once per process
 struct SharedMemoryGlobal {
@@ -18,6 +22,7 @@ struct SharedMemoryGlobal {
 			return;
 		}
 
+#ifdef _WIN32
 		SYSTEM_INFO sInfo;
 		GetSystemInfo(&sInfo);
 
@@ -56,6 +61,13 @@ struct SharedMemoryGlobal {
 			// Just set the heap pointer without re-initializing
 			copyData = reinterpret_cast<CopyData*>((char*)memory + bufSize);
 		}
+#else
+		// No other instances to share with, a private heap works the same
+		size_t bufSize = 16 * 1024 * 1024;
+		memory = malloc(bufSize + sizeof(CopyData));
+		ta_init(memory, (char*)memory + bufSize, 65535, 256, 16, false);
+		copyData = new((char*)memory + bufSize) CopyData;
+#endif
 
 		initialized = true;
 		refCount = 1;
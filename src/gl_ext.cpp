@@ -0,0 +1,96 @@
+#include "gl_ext.h"
+
+#include <cstdint>
+#include <cstring>
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+namespace GlExt
+{
+	GenFramebuffers_t GenFramebuffers;
+	DeleteFramebuffers_t DeleteFramebuffers;
+	BindFramebuffer_t BindFramebuffer;
+	FramebufferTexture2D_t FramebufferTexture2D;
+	CheckFramebufferStatus_t CheckFramebufferStatus;
+	GenRenderbuffers_t GenRenderbuffers;
+	DeleteRenderbuffers_t DeleteRenderbuffers;
+	BindRenderbuffer_t BindRenderbuffer;
+	RenderbufferStorage_t RenderbufferStorage;
+	FramebufferRenderbuffer_t FramebufferRenderbuffer;
+	BlitFramebuffer_t BlitFramebuffer;
+	ClearBufferuiv_t ClearBufferuiv;
+	ClearBufferfi_t ClearBufferfi;
+	MapBufferRange_t MapBufferRange;
+	FenceSync_t FenceSync;
+	ClientWaitSync_t ClientWaitSync;
+	DeleteSync_t DeleteSync;
+	VertexAttribDivisor_t VertexAttribDivisor;
+	DrawArraysInstanced_t DrawArraysInstanced;
+
+	bool VersionAtLeast(int major, int minor)
+	{
+		return GLVersion.major > major || (GLVersion.major == major && GLVersion.minor >= minor);
+	}
+
+	bool HasExtension(const char *name)
+	{
+		const char *list = (const char*)glGetString(GL_EXTENSIONS);
+		if(!list)
+			return false;
+		size_t len = strlen(name);
+		for(const char *p = list; (p = strstr(p, name)); p += len)
+			if((p == list || p[-1] == ' ') && (p[len] == ' ' || p[len] == 0))
+				return true;
+		return false;
+	}
+
+	void *GetProc(const char *name)
+	{
+#ifdef _WIN32
+		void *proc = (void*)wglGetProcAddress(name);
+		//Some drivers return small values instead of null.
+		if((uintptr_t)proc <= 3 || proc == (void*)-1)
+			return nullptr;
+		return proc;
+#else
+		(void)name;
+		return nullptr;
+#endif
+	}
+
+	template<typename T>
+	static bool Load(T &proc, const char *name)
+	{
+		proc = (T)GetProc(name);
+		return proc != nullptr;
+	}
+
+	bool Init()
+	{
+		if(!VersionAtLeast(3, 3))
+			return false;
+
+		bool ok = true;
+		ok &= Load(GenFramebuffers, "glGenFramebuffers");
+		ok &= Load(DeleteFramebuffers, "glDeleteFramebuffers");
+		ok &= Load(BindFramebuffer, "glBindFramebuffer");
+		ok &= Load(FramebufferTexture2D, "glFramebufferTexture2D");
+		ok &= Load(CheckFramebufferStatus, "glCheckFramebufferStatus");
+		ok &= Load(GenRenderbuffers, "glGenRenderbuffers");
+		ok &= Load(DeleteRenderbuffers, "glDeleteRenderbuffers");
+		ok &= Load(BindRenderbuffer, "glBindRenderbuffer");
+		ok &= Load(RenderbufferStorage, "glRenderbufferStorage");
+		ok &= Load(FramebufferRenderbuffer, "glFramebufferRenderbuffer");
+		ok &= Load(BlitFramebuffer, "glBlitFramebuffer");
+		ok &= Load(ClearBufferuiv, "glClearBufferuiv");
+		ok &= Load(ClearBufferfi, "glClearBufferfi");
+		ok &= Load(MapBufferRange, "glMapBufferRange");
+		ok &= Load(FenceSync, "glFenceSync");
+		ok &= Load(ClientWaitSync, "glClientWaitSync");
+		ok &= Load(DeleteSync, "glDeleteSync");
+		ok &= Load(VertexAttribDivisor, "glVertexAttribDivisor");
+		ok &= Load(DrawArraysInstanced, "glDrawArraysInstanced");
+		return ok;
+	}
+}
@@ -0,0 +1,84 @@
+#ifndef GL_EXT_H_GUARD
+#define GL_EXT_H_GUARD
+
+#include <glad/glad.h>
+
+// GL 3.x entry points and enums the glad 2.1 headers don't have.
+// wglCreateContext gives a 3.3 compatibility context (the shaders are
+// #version 330 already), so these are loaded by name after glad. Headless
+// checks leave them null or point them at their own stubs.
+namespace GlExt
+{
+	constexpr GLenum FRAMEBUFFER = 0x8D40;
+	constexpr GLenum READ_FRAMEBUFFER = 0x8CA8;
+	constexpr GLenum DRAW_FRAMEBUFFER = 0x8CA9;
+	constexpr GLenum FRAMEBUFFER_BINDING = 0x8CA6;
+	constexpr GLenum FRAMEBUFFER_COMPLETE = 0x8CD5;
+	constexpr GLenum RENDERBUFFER = 0x8D41;
+	constexpr GLenum COLOR_ATTACHMENT0 = 0x8CE0;
+	constexpr GLenum DEPTH_STENCIL_ATTACHMENT = 0x821A;
+	constexpr GLenum DEPTH24_STENCIL8 = 0x88F0;
+	constexpr GLenum DEPTH_STENCIL = 0x84F9;
+	constexpr GLenum RG32UI = 0x823C;
+	constexpr GLenum RG_INTEGER = 0x8228;
+	constexpr GLenum TEXTURE_2D_ARRAY = 0x8C1A;
+	constexpr GLbitfield MAP_WRITE_BIT = 0x0002;
+	constexpr GLbitfield MAP_INVALIDATE_RANGE_BIT = 0x0004;
+	constexpr GLbitfield MAP_UNSYNCHRONIZED_BIT = 0x0020;
+	constexpr GLenum SYNC_GPU_COMMANDS_COMPLETE = 0x9117;
+	constexpr GLbitfield SYNC_FLUSH_COMMANDS_BIT = 0x0001;
+	constexpr GLenum ALREADY_SIGNALED = 0x911A;
+	constexpr GLenum TIMEOUT_EXPIRED = 0x911B;
+	constexpr GLenum WAIT_FAILED = 0x911D;
+
+	typedef void (APIENTRY *GenFramebuffers_t)(GLsizei n, GLuint *framebuffers);
+	typedef void (APIENTRY *DeleteFramebuffers_t)(GLsizei n, const GLuint *framebuffers);
+	typedef void (APIENTRY *BindFramebuffer_t)(GLenum target, GLuint framebuffer);
+	typedef void (APIENTRY *FramebufferTexture2D_t)(GLenum target, GLenum attachment, GLenum textarget, GLuint texture, GLint level);
+	typedef GLenum (APIENTRY *CheckFramebufferStatus_t)(GLenum target);
+	typedef void (APIENTRY *GenRenderbuffers_t)(GLsizei n, GLuint *renderbuffers);
+	typedef void (APIENTRY *DeleteRenderbuffers_t)(GLsizei n, const GLuint *renderbuffers);
+	typedef void (APIENTRY *BindRenderbuffer_t)(GLenum target, GLuint renderbuffer);
+	typedef void (APIENTRY *RenderbufferStorage_t)(GLenum target, GLenum format, GLsizei w, GLsizei h);
+	typedef void (APIENTRY *FramebufferRenderbuffer_t)(GLenum target, GLenum attachment, GLenum rbTarget, GLuint renderbuffer);
+	typedef void (APIENTRY *BlitFramebuffer_t)(GLint srcX0, GLint srcY0, GLint srcX1, GLint srcY1,
+		GLint dstX0, GLint dstY0, GLint dstX1, GLint dstY1, GLbitfield mask, GLenum filter);
+	typedef void (APIENTRY *ClearBufferuiv_t)(GLenum buffer, GLint drawbuffer, const GLuint *value);
+	typedef void (APIENTRY *ClearBufferfi_t)(GLenum buffer, GLint drawbuffer, GLfloat depth, GLint stencil);
+	typedef void *(APIENTRY *MapBufferRange_t)(GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access);
+	typedef GLsync (APIENTRY *FenceSync_t)(GLenum condition, GLbitfield flags);
+	typedef GLenum (APIENTRY *ClientWaitSync_t)(GLsync sync, GLbitfield flags, GLuint64 timeout);
+	typedef void (APIENTRY *DeleteSync_t)(GLsync sync);
+	typedef void (APIENTRY *VertexAttribDivisor_t)(GLuint index, GLuint divisor);
+	typedef void (APIENTRY *DrawArraysInstanced_t)(GLenum mode, GLint first, GLsizei count, GLsizei instances);
+
+	extern GenFramebuffers_t GenFramebuffers;
+	extern DeleteFramebuffers_t DeleteFramebuffers;
+	extern BindFramebuffer_t BindFramebuffer;
+	extern FramebufferTexture2D_t FramebufferTexture2D;
+	extern CheckFramebufferStatus_t CheckFramebufferStatus;
+	extern GenRenderbuffers_t GenRenderbuffers;
+	extern DeleteRenderbuffers_t DeleteRenderbuffers;
+	extern BindRenderbuffer_t BindRenderbuffer;
+	extern RenderbufferStorage_t RenderbufferStorage;
+	extern FramebufferRenderbuffer_t FramebufferRenderbuffer;
+	extern BlitFramebuffer_t BlitFramebuffer;
+	extern ClearBufferuiv_t ClearBufferuiv;
+	extern ClearBufferfi_t ClearBufferfi;
+	extern MapBufferRange_t MapBufferRange;
+	extern FenceSync_t FenceSync;
+	extern ClientWaitSync_t ClientWaitSync;
+	extern DeleteSync_t DeleteSync;
+	extern VertexAttribDivisor_t VertexAttribDivisor;
+	extern DrawArraysInstanced_t DrawArraysInstanced;
+
+	//Call once the context is current and glad is loaded.
+	//False if the context is older than 3.3 or something failed to load.
+	bool Init();
+
+	bool VersionAtLeast(int major, int minor);
+	bool HasExtension(const char *name);
+	void *GetProc(const char *name);
+}
+
+#endif /* GL_EXT_H_GUARD */
@@ -0,0 +1,240 @@
+#include "gl_state.h"
+#include "gl_ext.h"
+
+#include <unordered_map>
+
+namespace GlState
+{
+	constexpr int unitCount = 8;
+	constexpr GLuint unknown = ~0u;
+
+	//Sampler parameters we track per texture, -1 when unknown.
+	struct TexParams
+	{
+		GLint minFilter = -1;
+		GLint magFilter = -1;
+		GLint wrapS = -1;
+		GLint wrapT = -1;
+
+		GLint *Find(GLenum pname)
+		{
+			switch(pname)
+			{
+			case GL_TEXTURE_MIN_FILTER: return &minFilter;
+			case GL_TEXTURE_MAG_FILTER: return &magFilter;
+			case GL_TEXTURE_WRAP_S: return &wrapS;
+			case GL_TEXTURE_WRAP_T: return &wrapT;
+			}
+			return nullptr;
+		}
+	};
+
+	static void DefUseProgram(GLuint program) { glUseProgram(program); }
+	static void DefActiveTexture(GLenum unit) { glActiveTexture(unit); }
+	static void DefBindTexture(GLenum target, GLuint texture) { glBindTexture(target, texture); }
+	static void DefTexParameteri(GLenum target, GLenum pname, GLint value) { glTexParameteri(target, pname, value); }
+	static GLboolean DefIsTexture(GLuint texture) { return glIsTexture(texture); }
+	static void DefBlendFunc(GLenum src, GLenum dst) { glBlendFunc(src, dst); }
+	static void DefBlendEquation(GLenum mode) { glBlendEquation(mode); }
+	static void DefBindBuffer(GLenum target, GLuint buffer) { glBindBuffer(target, buffer); }
+
+	static const Api defaultApi = {
+		DefUseProgram, DefActiveTexture, DefBindTexture, DefTexParameteri,
+		DefIsTexture, DefBlendFunc, DefBlendEquation, DefBindBuffer,
+	};
+
+	static Api api = defaultApi;
+
+	//Zero is what a fresh context has bound, the rest starts unknown.
+	static GLuint program;
+	static int activeUnit;
+	static GLuint textures[unitCount];
+	static GLuint arrays[unitCount];
+	static bool lastArray[unitCount]; //TexParameter applies to the array.
+	static GLenum blendSrc = unknown, blendDst = unknown, blendEquation = unknown;
+	static GLuint arrayBuffer, elementBuffer, unpackBuffer;
+	static std::unordered_map<GLuint, TexParams> texParams;
+
+	static Stats frame, lastFrame;
+
+	//Counts the call and tells whether it has to be issued.
+	template<class T>
+	static bool Changes(T &cached, T value)
+	{
+		if(cached == value)
+		{
+			++frame.filtered;
+			return false;
+		}
+		cached = value;
+		++frame.issued;
+		return true;
+	}
+
+	static GLuint *BufferSlot(GLenum target)
+	{
+		switch(target)
+		{
+		case GL_ARRAY_BUFFER: return &arrayBuffer;
+		case GL_ELEMENT_ARRAY_BUFFER: return &elementBuffer;
+		case GL_PIXEL_UNPACK_BUFFER: return &unpackBuffer;
+		}
+		return nullptr;
+	}
+
+	void SetApi(const Api &api_)
+	{
+		api = api_;
+		Invalidate();
+	}
+
+	const Api &DefaultApi()
+	{
+		return defaultApi;
+	}
+
+	void Invalidate()
+	{
+		program = unknown;
+		activeUnit = -1;
+		for(int unit = 0; unit < unitCount; ++unit)
+		{
+			textures[unit] = arrays[unit] = unknown;
+			lastArray[unit] = false;
+		}
+		blendSrc = blendDst = blendEquation = unknown;
+		arrayBuffer = elementBuffer = unpackBuffer = unknown;
+		//Other code may have changed parameters of any texture.
+		texParams.clear();
+	}
+
+	void BeginFrame()
+	{
+		Invalidate();
+		lastFrame = frame;
+		frame = {};
+	}
+
+	Stats GetStats()
+	{
+		return lastFrame;
+	}
+
+	void UseProgram(GLuint program_)
+	{
+		if(Changes(program, program_))
+			api.useProgram(program_);
+	}
+
+	void BindTexture(GLuint texture, int unit)
+	{
+		if(Changes(activeUnit, unit))
+			api.activeTexture(GL_TEXTURE0 + unit);
+		lastArray[unit] = false;
+		if(Changes(textures[unit], texture))
+			api.bindTexture(GL_TEXTURE_2D, texture);
+	}
+
+	void BindTextureArray(GLuint texture, int unit)
+	{
+		if(Changes(activeUnit, unit))
+			api.activeTexture(GL_TEXTURE0 + unit);
+		lastArray[unit] = true;
+		if(Changes(arrays[unit], texture))
+			api.bindTexture(GlExt::TEXTURE_2D_ARRAY, texture);
+	}
+
+	void TexParameter(GLenum pname, GLint value)
+	{
+		bool array = activeUnit >= 0 && lastArray[activeUnit];
+		GLenum target = array ? GlExt::TEXTURE_2D_ARRAY : GL_TEXTURE_2D;
+		GLuint texture = unknown;
+		if(activeUnit >= 0)
+			texture = array ? arrays[activeUnit] : textures[activeUnit];
+		GLint *cached = nullptr;
+		if(texture != unknown)
+			cached = texParams[texture].Find(pname);
+		if(!cached)
+		{
+			++frame.issued;
+			api.texParameteri(target, pname, value);
+		}
+		else if(Changes(*cached, value))
+			api.texParameteri(target, pname, value);
+	}
+
+	void TexFilter(GLint filter)
+	{
+		TexParameter(GL_TEXTURE_MAG_FILTER, filter);
+		TexParameter(GL_TEXTURE_MIN_FILTER, filter);
+	}
+
+	bool IsTexture(GLuint texture)
+	{
+		if(texture != 0 && texParams.count(texture))
+		{
+			++frame.filtered;
+			return true;
+		}
+		++frame.issued;
+		return api.isTexture(texture);
+	}
+
+	void BlendFunc(GLenum src, GLenum dst)
+	{
+		if(blendSrc == src && blendDst == dst)
+		{
+			++frame.filtered;
+			return;
+		}
+		blendSrc = src;
+		blendDst = dst;
+		++frame.issued;
+		api.blendFunc(src, dst);
+	}
+
+	void BlendEquation(GLenum mode)
+	{
+		if(Changes(blendEquation, mode))
+			api.blendEquation(mode);
+	}
+
+	void BindBuffer(GLenum target, GLuint buffer)
+	{
+		GLuint *slot = BufferSlot(target);
+		if(!slot)
+		{
+			++frame.issued;
+			api.bindBuffer(target, buffer);
+		}
+		else if(Changes(*slot, buffer))
+			api.bindBuffer(target, buffer);
+	}
+
+	void ForgetTexture(GLuint texture)
+	{
+		texParams.erase(texture);
+		//Deleting a bound texture binds 0 in its place.
+		for(auto &bound : textures)
+			if(bound == texture)
+				bound = 0;
+		for(auto &bound : arrays)
+			if(bound == texture)
+				bound = 0;
+	}
+
+	void ForgetBuffer(GLuint buffer)
+	{
+		for(GLuint *slot : {&arrayBuffer, &elementBuffer, &unpackBuffer})
+			if(*slot == buffer)
+				*slot = 0;
+	}
+
+	void ForgetProgram(GLuint program_)
+	{
+		//A deleted program stays in use until another one replaces it, but
+		//its id may be handed out again.
+		if(program == program_)
+			program = unknown;
+	}
+}
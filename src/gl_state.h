@@ -0,0 +1,62 @@
+#ifndef GL_STATE_H_GUARD
+#define GL_STATE_H_GUARD
+
+#include <glad/glad.h>
+
+// Remembers the GL state we set and drops calls that wouldn't change it.
+// Everything in the renderer and the parts drawer goes through here, so code
+// that draws can set what it needs without worrying about the cost.
+// Anything else that touches GL (imgui) must be followed by Invalidate().
+namespace GlState
+{
+	//The calls that are actually issued. Point these somewhere else to record
+	//them without a context.
+	struct Api
+	{
+		void (*useProgram)(GLuint program);
+		void (*activeTexture)(GLenum unit);
+		void (*bindTexture)(GLenum target, GLuint texture);
+		void (*texParameteri)(GLenum target, GLenum pname, GLint value);
+		GLboolean (*isTexture)(GLuint texture);
+		void (*blendFunc)(GLenum src, GLenum dst);
+		void (*blendEquation)(GLenum mode);
+		void (*bindBuffer)(GLenum target, GLuint buffer);
+	};
+
+	struct Stats
+	{
+		int issued;
+		int filtered;
+	};
+
+	void SetApi(const Api &api);
+	const Api &DefaultApi();
+
+	//Forget everything, the next call of each kind goes through.
+	void Invalidate();
+	//Invalidates and starts counting a new frame.
+	void BeginFrame();
+	//Counters of the last full frame.
+	Stats GetStats();
+
+	void UseProgram(GLuint program);
+	//GL_TEXTURE_2D. Makes unit active.
+	void BindTexture(GLuint texture, int unit = 0);
+	//GL_TEXTURE_2D_ARRAY, bound next to the unit's 2D texture.
+	void BindTextureArray(GLuint texture, int unit = 0);
+	//Applies to the texture last bound on the active unit, 2D or array.
+	void TexParameter(GLenum pname, GLint value);
+	void TexFilter(GLint filter); //Min and mag
+	//Textures we bound ourselves are known to be alive.
+	bool IsTexture(GLuint texture);
+	void BlendFunc(GLenum src, GLenum dst);
+	void BlendEquation(GLenum mode);
+	void BindBuffer(GLenum target, GLuint buffer);
+
+	//Call right before deleting, GL ids get reused.
+	void ForgetTexture(GLuint texture);
+	void ForgetBuffer(GLuint buffer);
+	void ForgetProgram(GLuint program);
+}
+
+#endif /* GL_STATE_H_GUARD */
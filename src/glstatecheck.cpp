@@ -0,0 +1,196 @@
+// GlState check without a context: records what the cache lets through to a
+// stub GL and compares it with what has to reach the driver.
+// Built as glstatecheck.exe.
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "gl_state.h"
+#include "gl_ext.h"
+
+static std::vector<std::string> calls;
+static GLboolean textureAlive = GL_TRUE;
+
+static void Record(const char *name, long long a = 0, long long b = 0, long long c = 0)
+{
+	char text[128];
+	snprintf(text, sizeof(text), "%s %lld %lld %lld", name, a, b, c);
+	calls.push_back(text);
+}
+
+static void UseProgram(GLuint program) { Record("UseProgram", program); }
+static void ActiveTexture(GLenum unit) { Record("ActiveTexture", unit - GL_TEXTURE0); }
+static void BindTexture(GLenum target, GLuint texture) { Record("BindTexture", target, texture); }
+static void TexParameteri(GLenum target, GLenum pname, GLint value) { Record("TexParameteri", target, pname, value); }
+static GLboolean IsTexture(GLuint texture) { Record("IsTexture", texture); return textureAlive; }
+static void BlendFunc(GLenum src, GLenum dst) { Record("BlendFunc", src, dst); }
+static void BlendEquation(GLenum mode) { Record("BlendEquation", mode); }
+static void BindBuffer(GLenum target, GLuint buffer) { Record("BindBuffer", target, buffer); }
+
+static int failures = 0;
+
+//What was issued since the last check has to be exactly this.
+static void Expect(const char *what, std::vector<std::string> expected)
+{
+	if(calls != expected)
+	{
+		printf("%s: FAILED\n  expected:", what);
+		for(auto &call : expected)
+			printf(" [%s]", call.c_str());
+		printf("\n  issued:  ");
+		for(auto &call : calls)
+			printf(" [%s]", call.c_str());
+		printf("\n");
+		++failures;
+	}
+	else
+		printf("%s: ok\n", what);
+	calls.clear();
+}
+
+static std::string Call(const char *name, long long a = 0, long long b = 0, long long c = 0)
+{
+	Record(name, a, b, c);
+	std::string call = calls.back();
+	calls.pop_back();
+	return call;
+}
+
+int main()
+{
+	GlState::Api api = {
+		UseProgram, ActiveTexture, BindTexture, TexParameteri,
+		IsTexture, BlendFunc, BlendEquation, BindBuffer,
+	};
+	GlState::SetApi(api);
+	GlState::BeginFrame();
+
+	GlState::UseProgram(3);
+	GlState::UseProgram(3);
+	GlState::UseProgram(4);
+	Expect("Repeated program", {Call("UseProgram", 3), Call("UseProgram", 4)});
+
+	GlState::BindTexture(5);
+	GlState::BindTexture(5);
+	GlState::BindTexture(6, 1);
+	GlState::BindTexture(6, 1);
+	GlState::BindTexture(5);
+	Expect("Textures per unit", {
+		Call("ActiveTexture", 0), Call("BindTexture", GL_TEXTURE_2D, 5),
+		Call("ActiveTexture", 1), Call("BindTexture", GL_TEXTURE_2D, 6),
+		Call("ActiveTexture", 0)});
+
+	GlState::TexParameter(GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	GlState::TexParameter(GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	GlState::TexFilter(GL_LINEAR);
+	GlState::TexParameter(GL_TEXTURE_MAX_LEVEL, 0);
+	GlState::TexParameter(GL_TEXTURE_MAX_LEVEL, 0);
+	Expect("Parameters of one texture", {
+		Call("TexParameteri", GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR),
+		Call("TexParameteri", GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR),
+		//Untracked, always issued.
+		Call("TexParameteri", GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0),
+		Call("TexParameteri", GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0)});
+
+	GlState::BindTexture(7);
+	GlState::TexParameter(GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	GlState::BindTexture(5);
+	GlState::TexParameter(GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	Expect("Parameters are per texture", {
+		Call("BindTexture", GL_TEXTURE_2D, 7),
+		Call("TexParameteri", GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR),
+		Call("BindTexture", GL_TEXTURE_2D, 5)});
+
+	GlState::BindTextureArray(8);
+	GlState::TexFilter(GL_NEAREST);
+	GlState::BindTextureArray(8);
+	GlState::BindTexture(5);
+	GlState::TexFilter(GL_LINEAR);
+	GlState::BindTextureArray(8);
+	GlState::TexFilter(GL_NEAREST);
+	Expect("Array next to 2D texture", {
+		Call("BindTexture", GlExt::TEXTURE_2D_ARRAY, 8),
+		Call("TexParameteri", GlExt::TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST),
+		//Texture 5 is already linear, 8 already nearest.
+		Call("TexParameteri", GlExt::TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST)});
+
+	bool alive = GlState::IsTexture(5);
+	Expect("Known texture is alive", {});
+	if(!alive)
+	{
+		printf("  IsTexture(5) returned false\n");
+		++failures;
+	}
+
+	//Deleted, then the id comes back for a new texture.
+	GlState::ForgetTexture(5);
+	textureAlive = GL_FALSE;
+	alive = GlState::IsTexture(5);
+	textureAlive = GL_TRUE;
+	GlState::BindTexture(5);
+	GlState::TexParameter(GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	Expect("Forgotten texture id reused", {
+		Call("IsTexture", 5),
+		Call("BindTexture", GL_TEXTURE_2D, 5),
+		Call("TexParameteri", GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR)});
+	if(alive)
+	{
+		printf("  IsTexture(5) returned true after ForgetTexture\n");
+		++failures;
+	}
+
+	GlState::BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	GlState::BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	GlState::BlendFunc(GL_SRC_ALPHA, GL_ONE);
+	GlState::BlendEquation(GL_FUNC_ADD);
+	GlState::BlendEquation(GL_FUNC_ADD);
+	Expect("Blending", {
+		Call("BlendFunc", GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA),
+		Call("BlendFunc", GL_SRC_ALPHA, GL_ONE),
+		Call("BlendEquation", GL_FUNC_ADD)});
+
+	GlState::BindBuffer(GL_ARRAY_BUFFER, 9);
+	GlState::BindBuffer(GL_ARRAY_BUFFER, 9);
+	GlState::BindBuffer(GL_ELEMENT_ARRAY_BUFFER, 9);
+	GlState::ForgetBuffer(9);
+	GlState::BindBuffer(GL_ARRAY_BUFFER, 9);
+	GlState::BindBuffer(GL_ARRAY_BUFFER, 0);
+	Expect("Buffers", {
+		Call("BindBuffer", GL_ARRAY_BUFFER, 9),
+		Call("BindBuffer", GL_ELEMENT_ARRAY_BUFFER, 9),
+		Call("BindBuffer", GL_ARRAY_BUFFER, 9),
+		Call("BindBuffer", GL_ARRAY_BUFFER, 0)});
+
+	GlState::ForgetProgram(4);
+	GlState::UseProgram(4);
+	Expect("Forgotten program", {Call("UseProgram", 4)});
+
+	//Counted since the BeginFrame at the top: every call above that reached
+	//the stub, and the ones the cache dropped.
+	GlState::BeginFrame();
+	GlState::Stats stats = GlState::GetStats();
+	printf("Frame counters: %d issued, %d filtered\n", stats.issued, stats.filtered);
+	if(stats.issued != 28 || stats.filtered != 27)
+	{
+		printf("  expected 28 issued, 27 filtered\n");
+		++failures;
+	}
+
+	//Anything may have changed since, everything goes through once.
+	GlState::UseProgram(4);
+	GlState::BindTexture(7);
+	GlState::TexParameter(GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	GlState::BlendFunc(GL_SRC_ALPHA, GL_ONE);
+	GlState::BindBuffer(GL_ARRAY_BUFFER, 0);
+	GlState::UseProgram(4);
+	GlState::BindTexture(7);
+	Expect("New frame", {
+		Call("UseProgram", 4),
+		Call("ActiveTexture", 0), Call("BindTexture", GL_TEXTURE_2D, 7),
+		Call("TexParameteri", GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR),
+		Call("BlendFunc", GL_SRC_ALPHA, GL_ONE),
+		Call("BindBuffer", GL_ARRAY_BUFFER, 0)});
+
+	GlState::SetApi(GlState::DefaultApi());
+	printf("\nResult: %d failures\n", failures);
+	return failures > 0 ? 2 : 0;
+}
@@ -12,4 +12,30 @@ using BoxList_T = std::map<int, Hitbox, std::less<int>, Allocator<std::pair<cons
 
 using BoxList = BoxList_T<std::allocator>;
 
+//Red, green, blue and z order of each box type.
+inline const float *HitboxColor(int i)
+{
+	static constexpr float collisionColor[] 	{1, 1, 1, 1};
+	static constexpr float greenColor[] 		{0.2, 1, 0.2, 2};
+	static constexpr float shieldColor[] 		{0, 0, 1, 3}; //Not only for shield
+	static constexpr float clashColor[]			{1, 1, 0, 4};
+	static constexpr float projectileColor[] 	{0, 1, 1, 5}; //飛び道具
+	static constexpr float purple[] 			{0.5, 0, 1, 6}; //特別
+	static constexpr float redColor[] 			{1, 0.2, 0.2, 7};
+
+	if(i==0)
+		return collisionColor;
+	else if (i >= 1 && i <= 8)
+		return greenColor;
+	else if(i >=9 && i <= 10)
+		return shieldColor;
+	else if(i == 11)
+		return clashColor;
+	else if(i == 12)
+		return projectileColor;
+	else if(i>12 && i<=24)
+		return purple;
+	return redColor;
+}
+
 #endif /* HITBOX_H_GUARD */
@@ -0,0 +1,171 @@
+#include "id_picker.h"
+#include "gl_ext.h"
+#include "gl_state.h"
+
+IdPicker::IdPicker():
+readbacks{},
+next(0),
+frame(0),
+fbo(0),
+texture(0),
+depth(0),
+x(0), y(0),
+requested(false),
+lastFbo(0),
+lastViewport{}
+{
+}
+
+IdPicker::~IdPicker()
+{
+	for(Readback &readback : readbacks)
+	{
+		if(readback.buffer)
+		{
+			GlState::ForgetBuffer(readback.buffer);
+			glDeleteBuffers(1, &readback.buffer);
+		}
+	}
+	if(fbo)
+		GlExt::DeleteFramebuffers(1, &fbo);
+	if(depth)
+		GlExt::DeleteRenderbuffers(1, &depth);
+	if(texture)
+	{
+		GlState::ForgetTexture(texture);
+		glDeleteTextures(1, &texture);
+	}
+}
+
+void IdPicker::Request(int x_, int y_)
+{
+	x = x_;
+	y = y_;
+	requested = true;
+}
+
+bool IdPicker::Busy() const
+{
+	for(const Readback &readback : readbacks)
+	{
+		if(readback.pending)
+			return true;
+	}
+	return false;
+}
+
+bool IdPicker::Begin(int viewWidth, int viewHeight)
+{
+	requested = false;
+	int glY = viewHeight - 1 - y;
+	if(x < 0 || x >= viewWidth || glY < 0 || y < 0)
+		return false;
+
+	if(!fbo)
+	{
+		glGenTextures(1, &texture);
+		GlState::BindTexture(texture);
+		GlState::TexFilter(GL_NEAREST);
+		glTexImage2D(GL_TEXTURE_2D, 0, GlExt::RG32UI, 1, 1, 0, GlExt::RG_INTEGER, GL_UNSIGNED_INT, nullptr);
+		GlExt::GenRenderbuffers(1, &depth);
+		GlExt::BindRenderbuffer(GlExt::RENDERBUFFER, depth);
+		GlExt::RenderbufferStorage(GlExt::RENDERBUFFER, GlExt::DEPTH24_STENCIL8, 1, 1);
+		GlExt::BindRenderbuffer(GlExt::RENDERBUFFER, 0);
+		GlExt::GenFramebuffers(1, &fbo);
+		GlExt::BindFramebuffer(GlExt::FRAMEBUFFER, fbo);
+		GlExt::FramebufferTexture2D(GlExt::FRAMEBUFFER, GlExt::COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
+		GlExt::FramebufferRenderbuffer(GlExt::FRAMEBUFFER, GlExt::DEPTH_STENCIL_ATTACHMENT, GlExt::RENDERBUFFER, depth);
+	}
+
+	//Whatever the scene was going to, the window or the scene cache.
+	glGetIntegerv(GlExt::FRAMEBUFFER_BINDING, &lastFbo);
+	glGetIntegerv(GL_VIEWPORT, lastViewport);
+	GlExt::BindFramebuffer(GlExt::FRAMEBUFFER, fbo);
+	if(GlExt::CheckFramebufferStatus(GlExt::FRAMEBUFFER) != GlExt::FRAMEBUFFER_COMPLETE)
+	{
+		GlExt::BindFramebuffer(GlExt::FRAMEBUFFER, lastFbo);
+		return false;
+	}
+	//The view as usual, shifted so the picked pixel lands on the only one.
+	glViewport(-x, -glY, viewWidth, viewHeight);
+	//Blending and dithering don't apply to integer targets.
+	const GLuint background[4] = {};
+	GlExt::ClearBufferuiv(GL_COLOR, 0, background);
+	GlExt::ClearBufferfi(GlExt::DEPTH_STENCIL, 0, 1.f, 0);
+	targets.clear();
+	return true;
+}
+
+int IdPicker::AddTarget(const Target &target)
+{
+	//Sprites carry the id as a float vertex color, exact up to 2^24.
+	if(targets.size() >= (1 << 24) - 1)
+		return -1;
+	targets.push_back(target);
+	return targets.size() - 1;
+}
+
+void IdPicker::Id(int target, int part, int id[2])
+{
+	//0 is the background.
+	id[0] = target + 1;
+	id[1] = part + 1;
+}
+
+void IdPicker::End()
+{
+	//A slot that wasn't polled yet is dropped, the newer pick wins.
+	Readback &readback = readbacks[next];
+	next = (next + 1) % (latency + 1);
+
+	if(!readback.buffer)
+	{
+		glGenBuffers(1, &readback.buffer);
+		GlState::BindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffer);
+		glBufferData(GL_PIXEL_PACK_BUFFER, 2 * sizeof(GLuint), nullptr, GL_STREAM_READ);
+	}
+	GlState::BindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffer);
+	glReadPixels(0, 0, 1, 1, GlExt::RG_INTEGER, GL_UNSIGNED_INT, nullptr);
+	GlState::BindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	GlExt::BindFramebuffer(GlExt::FRAMEBUFFER, lastFbo);
+	glViewport(lastViewport[0], lastViewport[1], lastViewport[2], lastViewport[3]);
+
+	readback.frame = frame;
+	readback.pending = true;
+	readback.targets.swap(targets);
+}
+
+bool IdPicker::Poll(Pick &out)
+{
+	++frame;
+
+	Readback *oldest = nullptr;
+	for(Readback &readback : readbacks)
+	{
+		if(readback.pending && frame - readback.frame >= latency &&
+			(!oldest || readback.frame < oldest->frame))
+			oldest = &readback;
+	}
+	if(!oldest)
+		return false;
+	oldest->pending = false;
+
+	GLuint id[2] = {};
+	GlState::BindBuffer(GL_PIXEL_PACK_BUFFER, oldest->buffer);
+	if(auto pixel = (const GLuint*)glMapBuffer(GL_PIXEL_PACK_BUFFER, GL_READ_ONLY))
+	{
+		id[0] = pixel[0];
+		id[1] = pixel[1];
+		glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+	}
+	GlState::BindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	int target = (int)id[0] - 1;
+	out = {};
+	out.hit = target >= 0 && target < (int)oldest->targets.size();
+	out.spawn = out.hit ? oldest->targets[target].spawn : -1;
+	out.layer = out.hit ? oldest->targets[target].layer : -1;
+	out.part = out.hit ? (int)id[1] - 1 : -1;
+	return true;
+}
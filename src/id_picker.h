@@ -0,0 +1,78 @@
+#ifndef ID_PICKER_H_GUARD
+#define ID_PICKER_H_GUARD
+
+#include <cstdint>
+#include <vector>
+
+// Finds what's under the cursor with an id pass: the scene drawn again with
+// every layer and part writing which one it is to an RG32UI framebuffer of
+// its own. That framebuffer is one pixel, the viewport is moved so the wanted
+// pixel lands on it. The id is read into a pixel buffer that's only mapped a
+// few frames later, so nothing ever waits for the GPU.
+class IdPicker
+{
+public:
+	//What an id stands for.
+	struct Target
+	{
+		int spawn;  //-1 for the pattern itself.
+		int layer;  //In the frame's layers.
+	};
+
+	struct Pick
+	{
+		bool hit;   //False for the background.
+		int spawn;
+		int layer;
+		int part;   //In the part set's groups, -1 for sprites.
+	};
+
+	IdPicker();
+	~IdPicker();
+
+	//Pick the pixel at x, y (client area, from the top left) the next time
+	//the scene is drawn.
+	void Request(int x, int y);
+	bool Requested() const { return requested; }
+	//A pick was read and hasn't come back yet.
+	bool Busy() const;
+
+	//The pass. Begin binds the id framebuffer and clears it, End reads it
+	//back and puts the framebuffer and viewport back. Begin returns false if
+	//the pixel is outside the view, then there's no pass.
+	bool Begin(int viewWidth, int viewHeight);
+	//Registers what's about to be drawn. -1 if there are too many to tell apart.
+	int AddTarget(const Target &target);
+	//What to draw a part of it with, part -1 for all of it.
+	static void Id(int target, int part, int id[2]);
+	void End();
+
+	//Once per frame. Returns the oldest pick that's been read back.
+	bool Poll(Pick &out);
+
+private:
+	struct Readback
+	{
+		unsigned int buffer;
+		uint64_t frame;   //When it was read.
+		bool pending;
+		std::vector<Target> targets;
+	};
+
+	//Readbacks are mapped this many frames after they're issued.
+	static constexpr int latency = 2;
+	Readback readbacks[latency + 1];
+	int next;
+	uint64_t frame;
+
+	std::vector<Target> targets; //Of the pass being drawn.
+	unsigned int fbo;
+	unsigned int texture;
+	unsigned int depth;
+	int x, y;
+	bool requested;
+	int lastFbo;
+	int lastViewport[4];
+};
+
+#endif /* ID_PICKER_H_GUARD */
@@ -1,6 +1,7 @@
 #include "ini.h"
 #include "parts/parts.h"
 #include "misc.h"
+#include "font_glyphs.h"
 #include <sstream>
 #include <iomanip>
 #include <string>
@@ -48,6 +49,7 @@ static void ReadLine(ImGuiContext*, ImGuiSettingsHandler*, void* entry, const ch
 		// Normalize path when loading from INI for consistency
 		std::string path = normalizePath(line + 14);
 		if (!path.empty()) {
+			FontGlyphs::AddText(path);
 			gSettings.recentProjects.push_back(path);
 		}
 	}
@@ -0,0 +1,27 @@
+#ifndef LAYER_ORDER_H_GUARD
+#define LAYER_ORDER_H_GUARD
+
+#include <iterator>
+#include <utility>
+
+// Drawing order of a frame's layers, the main pattern's and its spawns'
+// together: lower z priority first (behind), equal priorities in the order
+// they were added. The editor and seqexport both sort with this, so exported
+// frames stack the same way as the viewport.
+// Insertion sort, so it's stable without the buffer std::stable_sort
+// allocates; the editor builds its layer list without heap allocations.
+// A frame has a few dozen layers at most.
+template<typename It, typename Priority>
+void SortLayersByZ(It first, It last, Priority priority)
+{
+	for(It i = first; i != last; ++i)
+	{
+		auto value = std::move(*i);
+		It j = i;
+		for(It prev = j; j != first && priority(value) < priority(*--prev); j = prev)
+			*j = std::move(*prev);
+		*j = std::move(value);
+	}
+}
+
+#endif /* LAYER_ORDER_H_GUARD */
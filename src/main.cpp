@@ -4,13 +4,20 @@
 #include "test.h"
 #include "ini.h"
 #include "version.h"
+#include "pixel_upload.h"
+#include "gl_ext.h"
+#include "profiler.h"
+#include "platform.h"
+#include "frame_scheduler.h"
+#include "parts/parts_decoder.h"
+#include "font_glyphs.h"
+#include "misc.h"
 
+#include <chrono>
 #include <iostream>
 #include <fstream>
 #include <cstring>
 #include <cstdlib>
-#include <chrono>
-#include <thread>
 #include <imgui.h>
 #include "imsearch.h"
 
@@ -30,17 +37,16 @@
 char iniLocation[512] {};
 
 ImVec2 clientRect;
+FrameScheduler frameScheduler(1/60.0);
 
 HWND mainWindowHandle;
 ContextGl *context = nullptr;
 static bool dragLeft = false, dragRight = false;
+static bool leftMoved = false;  // Left button went down and the mouse moved since
 static POINT mousePos;
 static bool justActivated = false;  // Track if window just became active
 bool init = false;
 
-// Static storage for glyph ranges (must persist until font atlas is built)
-static ImVector<ImWchar> g_fontGlyphRanges;
-
 void LoadJapaneseFonts(ImGuiIO& io)
 {
 	char winFolder[512]{};
@@ -48,81 +54,17 @@ void LoadJapaneseFonts(ImGuiIO& io)
 /* 	config.PixelSnapH = 1;
 	config.OversampleH = 1;
 	config.OversampleV = 1; */
-	
-	// Build custom glyph ranges: Japanese + special symbols (★☆●◆■ etc.)
-	// These symbols are used in pattern names but aren't in GetGlyphRangesJapanese()
-	// Store in static vector so it persists until Build() is called
-	if(g_fontGlyphRanges.empty()) {
-		ImFontGlyphRangesBuilder builder;
-		builder.AddRanges(io.Fonts->GetGlyphRangesJapanese()); // Add Japanese characters
-		
-		// Add special symbol ranges manually
-		static const ImWchar symbol_ranges[] = {
-			0x2000, 0x206F, // General Punctuation (includes ※ etc.)
-			0x2190, 0x21FF, // Arrows (includes ←↑→↓ etc.)
-			0x25A0, 0x25FF, // Geometric Shapes (includes ■●◆▲▼ etc.)
-			0x2600, 0x26FF, // Miscellaneous Symbols (includes ★☆☀☁ etc.)
-			0x3000, 0x303F, // CJK Symbols and Punctuation (includes full-width space, 、, 〜, etc.)
-			0xFF00, 0xFFEF, // Halfwidth and Fullwidth Forms (includes ？, ＠, full-width letters/numbers)
-			0,
-		};
-		builder.AddRanges(symbol_ranges); // Add special symbols
-		
-		// Explicitly add common symbols used in pattern names
-		// These are the most frequently used symbols in .ha6 files
-		builder.AddChar(0x203B); // ※ (REFERENCE MARK)
-		builder.AddChar(0x2190); // ← (LEFTWARDS ARROW)
-		builder.AddChar(0x2191); // ↑ (UPWARDS ARROW)
-		builder.AddChar(0x2192); // → (RIGHTWARDS ARROW)
-		builder.AddChar(0x2193); // ↓ (DOWNWARDS ARROW)
-		builder.AddChar(0x2605); // ★ (BLACK STAR)
-		builder.AddChar(0x2606); // ☆ (WHITE STAR)
-		builder.AddChar(0x25CF); // ● (BLACK CIRCLE)
-		builder.AddChar(0x25CB); // ○ (WHITE CIRCLE)
-		builder.AddChar(0x25A0); // ■ (BLACK SQUARE) - explicitly add this one
-		builder.AddChar(0x25A1); // □ (WHITE SQUARE)
-		builder.AddChar(0x25C6); // ◆ (BLACK DIAMOND)
-		builder.AddChar(0x25C7); // ◇ (WHITE DIAMOND)
-		builder.AddChar(0x25B2); // ▲ (BLACK UP-POINTING TRIANGLE)
-		builder.AddChar(0x25B3); // △ (WHITE UP-POINTING TRIANGLE)
-		builder.AddChar(0x25BC); // ▼ (BLACK DOWN-POINTING TRIANGLE)
-		builder.AddChar(0x25BD); // ▽ (WHITE DOWN-POINTING TRIANGLE)
-		builder.AddChar(0x3000); // 　 (IDEOGRAPHIC SPACE - full-width space)
-		
-		// Explicitly add full-width characters that are commonly used
-		builder.AddChar(0xFF00); // 　 (FULLWIDTH SPACE)
-		builder.AddChar(0xFF01); // ！ (FULLWIDTH EXCLAMATION MARK)
-		builder.AddChar(0xFF08); // （ (FULLWIDTH LEFT PARENTHESIS)
-		builder.AddChar(0xFF09); // ） (FULLWIDTH RIGHT PARENTHESIS)
-		builder.AddChar(0xFF0B); // ＋ (FULLWIDTH PLUS SIGN)
-		builder.AddChar(0xFF0D); // － (FULLWIDTH HYPHEN-MINUS)
-		builder.AddChar(0xFF10); // ０ (FULLWIDTH DIGIT ZERO)
-		builder.AddChar(0xFF11); // １ (FULLWIDTH DIGIT ONE)
-		builder.AddChar(0xFF12); // ２ (FULLWIDTH DIGIT TWO)
-		builder.AddChar(0xFF13); // ３ (FULLWIDTH DIGIT THREE)
-		builder.AddChar(0xFF14); // ４ (FULLWIDTH DIGIT FOUR)
-		builder.AddChar(0xFF15); // ５ (FULLWIDTH DIGIT FIVE)
-		builder.AddChar(0xFF16); // ６ (FULLWIDTH DIGIT SIX)
-		builder.AddChar(0xFF17); // ７ (FULLWIDTH DIGIT SEVEN)
-		builder.AddChar(0xFF18); // ８ (FULLWIDTH DIGIT EIGHT)
-		builder.AddChar(0xFF19); // ９ (FULLWIDTH DIGIT NINE)
-		builder.AddChar(0xFF1F); // ？ (FULLWIDTH QUESTION MARK)
-		builder.AddChar(0xFF20); // ＠ (FULLWIDTH COMMERCIAL AT) - explicitly add this one
-		builder.AddChar(0xFF21); // Ａ (FULLWIDTH LATIN CAPITAL LETTER A)
-		builder.AddChar(0xFF22); // Ｂ (FULLWIDTH LATIN CAPITAL LETTER B)
-		builder.AddChar(0xFF23); // Ｃ (FULLWIDTH LATIN CAPITAL LETTER C)
-		builder.AddChar(0xFF24); // Ｄ (FULLWIDTH LATIN CAPITAL LETTER D)
-		builder.AddChar(0xFF25); // Ｅ (FULLWIDTH LATIN CAPITAL LETTER E)
-		builder.AddChar(0xFF26); // Ｆ (FULLWIDTH LATIN CAPITAL LETTER F)
-		builder.AddChar(0xFF2A); // Ｊ (FULLWIDTH LATIN CAPITAL LETTER J)
-		builder.AddChar(0xFF33); // Ｓ (FULLWIDTH LATIN CAPITAL LETTER S)
-		builder.AddChar(0xFF38); // Ｘ (FULLWIDTH LATIN CAPITAL LETTER X)
-		
-		builder.BuildRanges(&g_fontGlyphRanges);
+	auto start = std::chrono::steady_clock::now();
+
+	// Called again when loaded data brings new characters
+	if(!io.Fonts->Fonts.empty()) {
+		io.FontDefault = nullptr;
+		io.Fonts->Clear();
 	}
-	
-	// Ensure ranges are valid (should not be empty)
-	const ImWchar* rangesToUse = g_fontGlyphRanges.empty() ? io.Fonts->GetGlyphRangesJapanese() : g_fontGlyphRanges.Data;
+
+	// Only the characters that are used, see FontGlyphs. Has to stay valid
+	// while the fonts are alive.
+	const ImWchar* rangesToUse = FontGlyphs::BuildRanges();
 	
 	// Try embedded Noto font first (it definitely has all the symbols we need)
 	ImFont* japaneseFont = nullptr;
@@ -176,21 +118,44 @@ void LoadJapaneseFonts(ImGuiIO& io)
 	if(japaneseFont) {
 		io.FontDefault = japaneseFont;
 		printf("[Font] Japanese font loaded with symbol support and set as default\n");
-		
-		// Debug: Check if specific glyphs are available
-		// Note: This check happens before Build(), so we can't verify glyphs yet
-		// But we can verify the ranges were set correctly
-		printf("[Font] Glyph ranges size: %d\n", g_fontGlyphRanges.Size);
-		if(g_fontGlyphRanges.Size > 0) {
-			printf("[Font] First few glyph ranges: ");
-			for(int i = 0; i < g_fontGlyphRanges.Size && i < 20; i++) {
-				printf("0x%04X ", g_fontGlyphRanges[i]);
-			}
-			printf("\n");
-		}
 	} else {
 		printf("[Font] WARNING: Failed to load Japanese font! Japanese characters may not display correctly.\n");
 	}
+
+#if IMGUI_VERSION_NUM < 19200
+	// Rasterized up front here, so the time includes it
+	io.Fonts->Build();
+#endif
+	// Shown in the profiler window
+	FontGlyphs::RecordBuild(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+}
+
+// New characters in loaded data. Between frames, so nothing is using the old fonts.
+static void RebuildFonts()
+{
+	LoadJapaneseFonts(ImGui::GetIO());
+#if IMGUI_VERSION_NUM < 19200
+	// Before the first frame the backend makes the texture itself
+	if(ImGui::GetIO().Fonts->TexID) {
+		ImGui_ImplOpenGL3_DestroyFontsTexture();
+		ImGui_ImplOpenGL3_CreateFontsTexture();
+	}
+#endif
+}
+
+// Pasting doesn't go through WM_CHAR, ImGui reads the clipboard itself.
+static void AddClipboardGlyphs(HWND hWnd)
+{
+	if(!IsClipboardFormatAvailable(CF_UNICODETEXT) || !OpenClipboard(hWnd))
+		return;
+	if(HANDLE data = GetClipboardData(CF_UNICODETEXT)) {
+		if(const wchar_t *text = (const wchar_t*)GlobalLock(data)) {
+			for(const wchar_t *c = text; *c; ++c)
+				FontGlyphs::AddChar((unsigned int)*c);
+			GlobalUnlock(data);
+		}
+	}
+	CloseClipboard();
 }
 
 
@@ -276,42 +241,33 @@ int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE, PWSTR pCmdLine, int nCmdShow
 
 	MSG msg = {};
 	bool done = false;
-	const double targetFrameTime = 0.0165; // Slightly faster than 60 FPS to compensate for overhead
-
-	using namespace std::chrono;
-	steady_clock::time_point lastFrameTime = steady_clock::now();
 
 	while (!done)
 	{
-		// Process all pending messages
+		// Process all pending messages, any of them can change what's on screen
 		while (PeekMessage(&msg, NULL, 0, 0, PM_REMOVE))
 		{
 			TranslateMessage(&msg);
 			DispatchMessage(&msg);
 			if (msg.message == WM_QUIT)
 				done = true;
+			frameScheduler.RequestFrame();
 		}
 		if (done)
 			break;
+		if (Platform::TakeWakeup())
+			frameScheduler.RequestFrame();
 
-		// Frame rate limiting - only render if enough time has passed
-		steady_clock::time_point currentTime = steady_clock::now();
-		duration<double> elapsed = duration_cast<duration<double>>(currentTime - lastFrameTime);
-		
-		if (elapsed.count() >= targetFrameTime)
+		// Draw at 60 FPS while there's something going on, otherwise sleep
+		// until the next message or until background work finishes.
+		MainFrame* mf = (MainFrame*)GetWindowLongPtr(hwnd, GWLP_USERDATA);
+		if (mf && frameScheduler.ShouldDraw())
 		{
-			MainFrame* mf = (MainFrame*)GetWindowLongPtr(hwnd, GWLP_USERDATA);
-			if(mf)
-			{
-				mf->Draw();
-			}
-			lastFrameTime = currentTime;
+			mf->Draw();
+			frameScheduler.FrameDrawn(mf->WantsFrames());
 		}
 		else
-		{
-			// Sleep for a very short time to avoid busy waiting
-			std::this_thread::sleep_for(std::chrono::microseconds(1));
-		}
+			frameScheduler.Wait();
 	}
 
 	DestroyWindow(hwnd);
@@ -340,6 +296,18 @@ LRESULT WINAPI WndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam)
 				PostQuitMessage(1);
 				return 1;
 			}
+			if(!GlExt::Init())
+			{
+				MessageBox(0, L"OpenGL 3.3 is required", L"GlExt::Init()", 0);
+				PostQuitMessage(1);
+				return 1;
+			}
+			Profiler::Init();
+			Platform::Init();
+			SpritePrefetcher::readyHook = &Platform::Wake;
+			PartTextureDecoder::readyHook = &Platform::Wake;
+			FontGlyphs::rebuildHook = &RebuildFonts;
+			sj2utf8Hook = [](const std::string &text) { FontGlyphs::AddText(text); };
 			IMGUI_CHECKVERSION();
 			ImGui::CreateContext();
 			ImSearch::CreateContext();
@@ -403,7 +371,13 @@ LRESULT WINAPI WndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam)
 			}
 		}
 		return 0;
+	case WM_CHAR:
+		// IME input arrives here too, as UTF-16
+		FontGlyphs::AddChar((unsigned int)wParam);
+		break;
 	case WM_KEYDOWN:
+		if((wParam == 'V' && GetKeyState(VK_CONTROL) < 0) || (wParam == VK_INSERT && GetKeyState(VK_SHIFT) < 0))
+			AddClipboardGlyphs(hWnd);
 		if(!ImGui::GetIO().WantCaptureKeyboard)
 		{
 			if(mf->HandleKeys(wParam))
@@ -438,6 +412,7 @@ LRESULT WINAPI WndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam)
 		if(!ImGui::GetIO().WantCaptureMouse && !justActivated)
 		{
 			dragLeft = true;
+			leftMoved = false;
 			GetCursorPos(&mousePos);
 			ScreenToClient(hWnd, &mousePos);
 			SetCapture(hWnd);
@@ -452,6 +427,8 @@ LRESULT WINAPI WndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam)
 			if(!dragRight)
 				ReleaseCapture();
 			dragLeft = false;
+			if(!leftMoved)
+				mf->LeftClick(mousePos.x, mousePos.y);
 			return 0;
 		}
 		break;
@@ -462,6 +439,8 @@ LRESULT WINAPI WndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam)
 			newMousePos.x = (short) LOWORD(lParam);
 			newMousePos.y = (short) HIWORD(lParam);
 
+			if(newMousePos.x != mousePos.x || newMousePos.y != mousePos.y)
+				leftMoved = true;
 			mf->HandleMouseDrag(newMousePos.x-mousePos.x, newMousePos.y-mousePos.y, dragRight, dragLeft);
 			mousePos = newMousePos;
 		}
@@ -501,6 +480,11 @@ LRESULT WINAPI WndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam)
 		break;
 	case WM_DESTROY:
 		delete mf;
+		SpritePrefetcher::readyHook = nullptr;
+		PartTextureDecoder::readyHook = nullptr;
+		FontGlyphs::rebuildHook = nullptr;
+		sj2utf8Hook = nullptr;
+		PixelUpload::Release();
 		ImGui_ImplOpenGL3_Shutdown();
 		ImGui_ImplWin32_Shutdown();
 		ImSearch::DestroyContext();
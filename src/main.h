@@ -12,4 +12,7 @@ extern GLFWwindow* mainWindowHandle;
 
 extern ImVec2 clientRect;
 
+class FrameScheduler;
+extern FrameScheduler frameScheduler;
+
 #endif /* MAIN_H_GUARD */
@@ -9,6 +9,9 @@
 #include "version.h"
 #include "framestate.h"
 #include "misc.h"
+#include "gl_state.h"
+#include "profiler.h"
+#include "font_glyphs.h"
 
 #include <imgui.h>
 #include <imgui_internal.h>
@@ -22,6 +25,7 @@
 
 #include <algorithm>
 #include <filesystem>
+#include <set>
 
 MainFrame::MainFrame(ContextGl *context_):
 context(context_)
@@ -44,14 +48,26 @@ void MainFrame::LoadSettings()
 
 void MainFrame::Draw()
 {
+	FontGlyphs::Update();
 	ImGui_ImplOpenGL3_NewFrame();
 	ImGui_ImplWin32_NewFrame();
 	ImGui::NewFrame();
+	//imgui drew last frame with its own state.
+	GlState::BeginFrame();
+	Profiler::BeginFrame();
+	IdPicker::Pick pick;
+	if (render.PollPick(pick))
+		ApplyPick(pick);
 	DrawUi();
 	DrawBack();
+	// After drawing, so sprites on screen this frame can't be evicted by prefetched ones
+	render.UploadPrefetched(2.0);
 	ImGui::Render();
-	
+
+	Profiler::Begin(Profiler::Ui);
 	ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+	Profiler::End(Profiler::Ui);
+	Profiler::EndFrame();
 
 	SwapBuffers(context->dc);
 
@@ -61,6 +77,17 @@ void MainFrame::Draw()
 	memcpy(gSettings.color, clearColor, sizeof(float)*3);
 }
 
+bool MainFrame::WantsFrames()
+{
+	for(auto &view : views)
+	{
+		if(view->getState().animating)
+			return true;
+	}
+	//Dragging a slider or holding a button down.
+	return ImGui::IsAnyItemActive() || render.HasPendingUploads() || render.PickPending();
+}
+
 void MainFrame::DrawPresetEffectMarkers(FrameState& state, CharacterInstance* character)
 {
 	if (!state.vizSettings.showPresetEffects) return;
@@ -147,6 +174,59 @@ void MainFrame::DrawPresetEffectMarkers(FrameState& state, CharacterInstance* ch
 	}
 }
 
+// Sprites shown by a pattern in playback order, with the sprites of its spawns
+// inserted where they get spawned.
+static void CollectPatternSprites(CharacterInstance *owner, CharacterInstance *source, int pattern, int startFrame,
+	std::vector<SpritePrefetcher::Request> &out, std::set<std::pair<const CharacterInstance*, int>> &visited, int depth)
+{
+	if (depth > 8 || !visited.insert({source, pattern}).second)
+		return;
+
+	auto seq = source->frameData.get_sequence(pattern);
+	if (!seq || seq->frames.empty())
+		return;
+
+	int count = seq->frames.size();
+	for (int n = 0; n < count; n++) {
+		int i = (startFrame + n) % count;
+		const auto& frame = seq->frames[i];
+		for (const auto& layer : frame.AF.layers) {
+			if (!layer.usePat && layer.spriteId >= 0)
+				out.push_back({&source->cg, layer.spriteId});
+		}
+
+		if (frame.EF.empty())
+			continue;
+		for (const auto& spawn : ParseSpawnedPatterns(frame.EF, i, pattern)) {
+			if (spawn.isPresetEffect)
+				continue;
+			// Same source rules as DrawBack: type 8 uses effect.ha6, the rest the main character
+			CharacterInstance *spawnSource = owner;
+			if (spawn.usesEffectHA6 && owner->effectCharacter)
+				spawnSource = owner->effectCharacter.get();
+			CollectPatternSprites(owner, spawnSource, spawn.patternId, 0, out, visited, depth + 1);
+		}
+	}
+}
+
+void MainFrame::PrefetchPattern(CharacterInstance *character, int pattern, int frame)
+{
+	if (!character->cg.m_loaded)
+		return;
+
+	uint64_t cgKey = SpriteAtlas::MakeKey(&character->cg, 0);
+	if (character == prefetchCharacter && pattern == prefetchPattern && cgKey == prefetchCgKey)
+		return;
+	prefetchCharacter = character;
+	prefetchPattern = pattern;
+	prefetchCgKey = cgKey;
+
+	std::vector<SpritePrefetcher::Request> sprites;
+	std::set<std::pair<const CharacterInstance*, int>> visited;
+	CollectPatternSprites(character, character, pattern, frame, sprites, visited, 0);
+	render.PrefetchSprites(sprites);
+}
+
 void MainFrame::DrawBack()
 {
 	render.filter = smoothRender;
@@ -161,6 +241,35 @@ void MainFrame::DrawBack()
 
 	auto* view = getActiveView();
 
+	if (view && active) {
+		PrefetchPattern(active, view->getState().pattern, view->getState().frame);
+	}
+
+	// A paused frame looks the same until something it's drawn from changes,
+	// then the copy from the last time is enough. PAT editor views also draw
+	// the panes' selection (centers, UV bounds), so those are always drawn.
+	bool cacheScene = view && active && !view->isPatEditor() && !view->getState().animating;
+	uint64_t sceneKey = 0;
+	if (cacheScene) {
+		SceneCache::Hasher inputs;
+		SceneKey(inputs, view, active);
+		sceneKey = render.SceneKey(inputs);
+		// Picking needs the layers drawn
+		if (!render.PickRequested() && render.DrawCachedScene(sceneKey)) {
+			DrawPresetEffectMarkers(view->getState(), active);
+			return;
+		}
+		render.BeginScene();
+	}
+
+	DrawScene(view, active);
+
+	if (cacheScene)
+		render.EndScene(sceneKey);
+}
+
+void MainFrame::DrawScene(CharacterView *view, CharacterInstance *active)
+{
 	// Check if we need to draw with spawned patterns
 	bool hasSpawnedPatterns = false;
 	if (view && active) {
@@ -210,10 +319,11 @@ void MainFrame::DrawBack()
 			mainLayer.alpha = mainLayer_data.rgba[3];  // Apply frame alpha
 			mainLayer.tintColor = glm::vec4(mainLayer_data.rgba[0], mainLayer_data.rgba[1], mainLayer_data.rgba[2], 1.0f);  // Apply frame RGB
 			mainLayer.isSpawned = false;
-			mainLayer.hitboxes = (layerIndex == 0) ? mainFrame.hitboxes : BoxList();  // Only layer 0 gets hitboxes
+			mainLayer.hitboxes = (layerIndex == 0) ? &mainFrame.hitboxes : nullptr;  // Only layer 0 gets hitboxes
 			mainLayer.sourceCG = &active->cg;  // Main pattern uses character CG
 			mainLayer.usePat = mainLayer_data.usePat;  // Copy PAT rendering flag from layer data
 			mainLayer.sourceParts = &active->parts;  // Main pattern uses character Parts
+			mainLayer.frameLayer = layerIndex;
 			render.AddLayer(mainLayer);
 		}
 
@@ -499,12 +609,14 @@ void MainFrame::DrawBack()
 					spawnedLayer_data.rgba[2] * spawnInfo.tintColor.b,
 					1.0f);
 				layer.isSpawned = true;
-				layer.hitboxes = (spawnLayerIndex == 0) ? spawnedFrame.hitboxes : BoxList();  // Only layer 0 gets hitboxes
+				layer.hitboxes = (spawnLayerIndex == 0) ? &spawnedFrame.hitboxes : nullptr;  // Only layer 0 gets hitboxes
 				layer.sourceCG = sourceCG;  // Use appropriate CG (character or effect.ha6)
 				layer.usePat = spawnedLayer_data.usePat;  // Copy PAT rendering flag
 				layer.sourceParts = sourceParts;  // Use appropriate Parts (character or effect.pat)
 				layer.spawnFlagset1 = spawnInfo.flagset1;
 				layer.spawnFlagset2 = spawnInfo.flagset2;
+				layer.spawnIndex = i;  // In activeSpawns or spawnedPatterns, whichever is used
+				layer.frameLayer = spawnLayerIndex;
 
 				render.AddLayer(layer);
 			}
@@ -561,10 +673,11 @@ void MainFrame::DrawBack()
 			mainLayer.alpha = mainLayer_data.rgba[3];  // Apply frame alpha
 			mainLayer.tintColor = glm::vec4(mainLayer_data.rgba[0], mainLayer_data.rgba[1], mainLayer_data.rgba[2], 1.0f);  // Apply frame RGB
 			mainLayer.isSpawned = false;
-			mainLayer.hitboxes = (layerIndex == 0) ? mainFrame.hitboxes : BoxList();  // Only layer 0 gets hitboxes
+			mainLayer.hitboxes = (layerIndex == 0) ? &mainFrame.hitboxes : nullptr;  // Only layer 0 gets hitboxes
 			mainLayer.sourceCG = &active->cg;  // Main pattern uses character CG
 			mainLayer.usePat = mainLayer_data.usePat;  // Copy PAT rendering flag from layer data
 			mainLayer.sourceParts = &active->parts;  // Main pattern uses character Parts
+			mainLayer.frameLayer = layerIndex;
 			render.AddLayer(mainLayer);
 		}
 
@@ -577,6 +690,92 @@ void MainFrame::DrawBack()
 	}
 }
 
+void MainFrame::SceneKey(SceneCache::Hasher &h, CharacterView *view, CharacterInstance *active)
+{
+	auto& state = view->getState();
+	h.Add(view);
+	h.Add(state.pattern);
+	h.Add(state.frame);
+	h.Add(state.spriteId);
+	h.Add(state.currentTick);
+	h.Add(clearColor);
+	h.Add(state.renderMode);
+
+	// One by one, the struct has padding. The timeline ones don't draw
+	// in the viewport.
+	const auto& viz = state.vizSettings;
+	h.Add(viz.showSpawnedPatterns);
+	h.Add(viz.showPresetEffects);
+	h.Add(viz.presetEffectsAllFrames);
+	h.Add(viz.autoDetect);
+	h.Add(viz.showOffsetLines);
+	h.Add(viz.showLabels);
+	h.Add(viz.animateWithMain);
+	h.Add(viz.enableTint);
+	h.Add(viz.spawnedOpacity);
+
+	// Sprites change with the palette or when the CG is reloaded, parts when
+	// the PAT is loaded or edited. Edits to patterns other than the current
+	// frame only show up through the edit serial.
+	for (CharacterInstance* character : {active, active->effectCharacter.get()}) {
+		if (!character)
+			continue;
+		h.Add(character->cg.getSerial());
+		h.Add(character->cg.getCurrentPalette());
+		h.Add(character->getEditSerial());
+		h.Add(character->parts.loaded);
+		h.Add(character->parts.DataSerial());
+		h.Add(character->parts.partHighlight);
+		h.Add(character->parts.highlightOpacity);
+	}
+
+	// The frame being edited. Other patterns only show up through spawns,
+	// and going to one of them to edit it changes the key anyway.
+	auto seq = active->frameData.get_sequence(state.pattern);
+	if (seq && state.frame >= 0 && state.frame < (int)seq->frames.size()) {
+		auto& frame = seq->frames[state.frame];
+		h.Add(frame.AF.priority);
+		h.Add(frame.AF.AFRT);
+		for (const auto& layer : frame.AF.layers) {
+			h.Add(layer.spriteId);
+			h.Add(layer.usePat);
+			h.Add(layer.offset_x);
+			h.Add(layer.offset_y);
+			h.Add(layer.blend_mode);
+			h.Add(layer.rgba);
+			h.Add(layer.rotation);
+			h.Add(layer.scale);
+		}
+		for (const auto& box : frame.hitboxes) {
+			h.Add(box.first);
+			h.Add(box.second.xy);
+		}
+	}
+
+	for (const auto& spawn : state.spawnedPatterns) {
+		h.Add(spawn.patternId);
+		h.Add(spawn.visible);
+		h.Add(spawn.alpha);
+		h.Add(spawn.tintColor);
+		h.Add(spawn.offsetX);
+		h.Add(spawn.offsetY);
+		h.Add(spawn.flagset1);
+		h.Add(spawn.angle);
+		h.Add(spawn.spawnTick);
+	}
+	for (const auto& spawn : state.activeSpawns) {
+		h.Add(spawn.patternId);
+		h.Add(spawn.currentFrame);
+		h.Add(spawn.currentZPriority);
+		h.Add(spawn.alpha);
+		h.Add(spawn.tintColor);
+		h.Add(spawn.offsetX);
+		h.Add(spawn.offsetY);
+		h.Add(spawn.flagset1);
+		h.Add(spawn.angle);
+	}
+}
+
 
 // ============================================================================
 // UI Implementation - extracted to ui/main_ui_impl.h for better organization
@@ -6,6 +6,7 @@
 #include "right_pane.h"
 #include "box_pane.h"
 #include "about.h"
+#include "profiler_window.h"
 #include "vectors.h"
 #include "character_instance.h"
 #include "character_view.h"
@@ -27,12 +28,16 @@ public:
 	~MainFrame();
 	
 	void Draw();
+	// Whether the next frame should come right after this one even without input.
+	bool WantsFrames();
 	void UpdateBackProj(float x, float y);
 	void HandleMouseDrag(int x, int y, bool dragRight, bool dragLeft);
 	bool HandleKeys(uint64_t vkey);
 	void HandleMouseWheel(bool isIncrease);
 
 	void RightClick(int x, int y);
+	// A click that didn't drag, selects what's under it.
+	void LeftClick(int x, int y);
 	void LoadSettings();
 
 private:
@@ -70,8 +75,12 @@ private:
 	int countViewsForCharacter(CharacterInstance* character);
 
 	void DrawBack();
+	void DrawScene(CharacterView *view, CharacterInstance *active);
+	void SceneKey(SceneCache::Hasher &h, CharacterView *view, CharacterInstance *active);
 	void DrawUi();
+	void PrefetchPattern(CharacterInstance *character, int pattern, int frame);
 	void DrawPresetEffectMarkers(FrameState& state, CharacterInstance* character);
+	void ApplyPick(const IdPicker::Pick &pick);
 	void Menu(unsigned int errorId);
 
 	void RenderUpdate();
@@ -85,6 +94,11 @@ private:
 
 	int mDeltaX = 0, mDeltaY = 0;
 
+	// Last pattern handed to the sprite prefetcher
+	CharacterInstance *prefetchCharacter = nullptr;
+	int prefetchPattern = -1;
+	uint64_t prefetchCgKey = 0;
+
 	// View close confirmation
 	int pendingCloseViewIndex = -1;
 	bool shouldOpenUnsavedDialog = false;
@@ -121,6 +135,7 @@ private:
 	void updateStateReference();
 
 	AboutWindow aboutWindow;
+	ProfilerWindow profilerWindow;
 };
 
 
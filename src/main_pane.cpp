@@ -2,6 +2,7 @@
 #include "pattern_disp.h"
 #include "frame_disp.h"
 #include "misc.h"
+#include "font_glyphs.h"
 #include <imgui.h>
 #include "imsearch.h"	
 
@@ -23,6 +24,7 @@ void MainPane::RegenerateNames()
 		for(int i = 0; i < count; i++)
 		{
 			decoratedNames[i] = frameData->GetDecoratedName(i);
+			FontGlyphs::AddText(decoratedNames[i]);
 		}
 	}
 	else
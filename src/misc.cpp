@@ -1,9 +1,24 @@
 #include "misc.h"
+#ifdef _WIN32
 #include <windows.h>
+#else
+#include <fcntl.h>
+#include <iconv.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdio>
+#endif
 #include <string>
 #include <algorithm>
 #include <cctype>
+#include <cstdio>
+#include <set>
 
+void (*sj2utf8Hook)(const std::string &utf8) = nullptr;
+
+#ifdef _WIN32
 bool ReadInMem(const char *filename, char *&data, unsigned int &size)
 {
 	auto file = CreateFileA(filename, GENERIC_READ, 0, nullptr, OPEN_EXISTING,
@@ -34,6 +49,58 @@ bool ReadInMem(const char *filename, char *&data, unsigned int &size)
 	return true;
 }	
 
+MappedFile::MappedFile(): data(nullptr), size(0), file(INVALID_HANDLE_VALUE), mapping(nullptr)
+{
+}
+
+bool MappedFile::Open(const char *filename)
+{
+	Close();
+
+	//Others may read, rename or delete it while it's mapped, but not write to it.
+	file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS, nullptr);
+	if(file == INVALID_HANDLE_VALUE)
+		return false;
+
+	DWORD fileSize = GetFileSize(file, nullptr);
+	if(fileSize == INVALID_FILE_SIZE || fileSize == 0)
+	{
+		Close();
+		return false;
+	}
+
+	mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if(!mapping)
+	{
+		Close();
+		return false;
+	}
+
+	data = (const char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if(!data)
+	{
+		Close();
+		return false;
+	}
+	size = fileSize;
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if(data)
+		UnmapViewOfFile(data);
+	if(mapping)
+		CloseHandle(mapping);
+	if(file != INVALID_HANDLE_VALUE)
+		CloseHandle(file);
+	data = nullptr;
+	mapping = nullptr;
+	file = INVALID_HANDLE_VALUE;
+	size = 0;
+}
+
 
 // Shift-JIS (CP932) <-> UTF-8 conversion using Windows API
 // Much faster and smaller than maintaining a 3000+ line conversion table!
@@ -87,6 +154,8 @@ std::string sj2utf8(const std::string &input)
 
 	// Resize to actual converted length
 	output.resize(result2);
+	if(sj2utf8Hook)
+		sj2utf8Hook(output);
 	return output;
 }
 
@@ -125,6 +194,124 @@ std::string utf82sj(const std::string &input)
 	output.resize(result);
 	return output;
 }
+#else
+bool ReadInMem(const char *filename, char *&data, unsigned int &size)
+{
+	data = nullptr;
+	size = 0;
+	FILE *file = fopen(filename, "rb");
+	if(!file)
+		return false;
+
+	fseek(file, 0, SEEK_END);
+	long fileSize = ftell(file);
+	fseek(file, 0, SEEK_SET);
+	if(fileSize < 0)
+	{
+		fclose(file);
+		return false;
+	}
+
+	data = new char[fileSize];
+	if(fread(data, 1, fileSize, file) != (size_t)fileSize)
+	{
+		delete[] data;
+		data = nullptr;
+		fclose(file);
+		return false;
+	}
+	size = fileSize;
+	fclose(file);
+	return true;
+}
+
+MappedFile::MappedFile(): data(nullptr), size(0)
+{
+}
+
+bool MappedFile::Open(const char *filename)
+{
+	Close();
+
+	int fd = open(filename, O_RDONLY);
+	if(fd < 0)
+		return false;
+
+	struct stat st;
+	if(fstat(fd, &st) != 0 || st.st_size == 0)
+	{
+		close(fd);
+		return false;
+	}
+
+	void *view = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd); // The mapping keeps its own reference
+	if(view == MAP_FAILED)
+		return false;
+
+	madvise(view, st.st_size, MADV_RANDOM);
+	data = (const char*)view;
+	size = st.st_size;
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if(data)
+		munmap((void*)data, size);
+	data = nullptr;
+	size = 0;
+}
+
+// Same conversions through iconv, for the headless tools.
+static std::string ConvertCodepage(const std::string &input, const char *to, const char *from)
+{
+	if(input.empty())
+		return std::string();
+
+	iconv_t cd = iconv_open(to, from);
+	if(cd == (iconv_t)-1)
+		return std::string();
+
+	std::string output(input.size()*4, 0);
+	char *in = const_cast<char*>(input.data());
+	size_t inLeft = input.size();
+	char *out = &output[0];
+	size_t outLeft = output.size();
+	while(inLeft > 0)
+	{
+		if(iconv(cd, &in, &inLeft, &out, &outLeft) == (size_t)-1)
+		{
+			if(errno != EILSEQ && errno != EINVAL)
+				break;
+			// Skip the bad byte like MultiByteToWideChar does without MB_ERR_INVALID_CHARS
+			++in;
+			--inLeft;
+		}
+	}
+	iconv_close(cd);
+	output.resize(output.size() - outLeft);
+	return output;
+}
+
+std::string sj2utf8(const std::string &input)
+{
+	std::string output = ConvertCodepage(input, "UTF-8", "CP932");
+	if(sj2utf8Hook && !output.empty())
+		sj2utf8Hook(output);
+	return output;
+}
+
+std::string utf82sj(const std::string &input)
+{
+	return ConvertCodepage(input, "CP932", "UTF-8");
+}
+#endif
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
 
 // Normalize path separators for consistency
 std::string normalizePath(const std::string& path)
@@ -147,4 +334,25 @@ std::string normalizePath(const std::string& path)
 	return normalized;
 }
 
-
+void MakeOutputPathsUnique(std::vector<std::pair<std::filesystem::path, std::filesystem::path>> &inputs)
+{
+	std::set<std::string> outNames;
+	for(auto &entry : inputs)
+	{
+		std::filesystem::path name = entry.second;
+		for(int n = 2; ; ++n)
+		{
+			std::string key = name.generic_string();
+			for(auto &c : key)
+				c = tolower(c);
+			if(outNames.insert(key).second)
+				break;
+			name = entry.second;
+			name += "_" + std::to_string(n);
+		}
+		if(inputs.size() > 1 && name != entry.second)
+			printf("%s: goes to %s, %s is taken\n", entry.first.string().c_str(),
+				name.string().c_str(), entry.second.string().c_str());
+		entry.second = name;
+	}
+}
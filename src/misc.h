@@ -1,7 +1,10 @@
 #ifndef MISC_H
 #define MISC_H
 
+#include <filesystem>
 #include <string>
+#include <utility>
+#include <vector>
 
 static inline int to_pow2(int a) {
 	int v = 1;
@@ -14,12 +17,50 @@ static inline int to_pow2(int a) {
 
 bool ReadInMem(const char *filename, char *&data, unsigned int &size);
 
+// Read-only memory mapping of a whole file. The OS reads pages in when they're
+// touched and can drop them again under memory pressure.
+// The file stays open until Close. Meanwhile it can be replaced by renaming
+// another file over it, but opening it for writing fails, saving over it in
+// place included.
+class MappedFile
+{
+public:
+	MappedFile();
+	~MappedFile();
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	bool Open(const char *filename);
+	void Close();
+
+	const char *Data() const { return data; }
+	unsigned int Size() const { return size; }
+	bool IsOpen() const { return data != nullptr; }
+
+private:
+	const char *data;
+	unsigned int size;
+#ifdef _WIN32
+	void *file;
+	void *mapping;
+#endif
+};
+
 std::string sj2utf8(const std::string &input);
+// Called with every sj2utf8 result. The editor collects the characters its
+// fonts need through it. Main thread only.
+extern void (*sj2utf8Hook)(const std::string &utf8);
 std::string utf82sj(const std::string &input);
 
 // Normalize path separators for consistency (converts backslashes to forward slashes,
 // normalizes drive letters, removes trailing slashes)
 std::string normalizePath(const std::string& path);
 
+// For the headless tools: each input with the output path it goes to.
+// Same named inputs from different places would write over each other, so
+// later ones get _2, _3... Folders on Windows don't care about case, so
+// neither does this.
+void MakeOutputPathsUnique(std::vector<std::pair<std::filesystem::path, std::filesystem::path>> &inputs);
+
 
 #endif
@@ -0,0 +1,129 @@
+// SkylinePacker check without a context: packs a fixed set of sprite sized
+// rectangles into atlas pages, checks that every one lands inside the page
+// and that none overlap, and prints how full the pages got.
+// Built as packcheck.exe.
+#include <cstdio>
+#include <random>
+#include <vector>
+#include "atlas_packer.h"
+
+static int failures = 0;
+
+static void Fail(const char *what, int page, const SkylinePacker::Rect &a, const SkylinePacker::Rect &b)
+{
+	if(failures++ < 10)
+		printf("  page %d: %s (%d,%d %dx%d) (%d,%d %dx%d)\n", page, what, a.x, a.y, a.w, a.h, b.x, b.y, b.w, b.h);
+}
+
+static bool Overlap(const SkylinePacker::Rect &a, const SkylinePacker::Rect &b)
+{
+	return a.x < b.x + b.w && b.x < a.x + a.w && a.y < b.y + b.h && b.y < a.y + a.h;
+}
+
+//Every placed rectangle is inside the page, the requested size and alone.
+static void CheckPage(int page, const SkylinePacker &packer, const std::vector<SkylinePacker::Rect> &placed,
+	const std::vector<SkylinePacker::Rect> &wanted)
+{
+	long long area = 0;
+	for(size_t i = 0; i < placed.size(); ++i)
+	{
+		const auto &r = placed[i];
+		area += (long long)r.w * r.h;
+		if(r.w != wanted[i].w || r.h != wanted[i].h)
+			Fail("wrong size", page, r, wanted[i]);
+		if(r.x < 0 || r.y < 0 || r.x + r.w > packer.Width() || r.y + r.h > packer.Height())
+			Fail("outside the page", page, r, r);
+		for(size_t j = 0; j < i; ++j)
+			if(Overlap(r, placed[j]))
+				Fail("overlap", page, r, placed[j]);
+	}
+	if(area != packer.UsedArea())
+	{
+		printf("  page %d: used area %lld, rectangles add up to %lld\n", page, packer.UsedArea(), area);
+		++failures;
+	}
+}
+
+//Fills pages of the given size in order, a new page when one is full.
+static void Pack(int pageSize, const std::vector<SkylinePacker::Rect> &rects)
+{
+	std::vector<float> fills;
+	SkylinePacker packer(pageSize, pageSize);
+	std::vector<SkylinePacker::Rect> placed, wanted;
+	auto finish = [&]() {
+		CheckPage(fills.size(), packer, placed, wanted);
+		fills.push_back(packer.FillRatio());
+		packer.Clear();
+		placed.clear();
+		wanted.clear();
+	};
+
+	for(const auto &rect : rects)
+	{
+		SkylinePacker::Rect out;
+		if(!packer.Insert(rect.w, rect.h, out))
+		{
+			finish();
+			if(!packer.Insert(rect.w, rect.h, out))
+			{
+				Fail("doesn't fit an empty page", fills.size(), rect, rect);
+				continue;
+			}
+		}
+		placed.push_back(out);
+		wanted.push_back(rect);
+	}
+	float last = packer.FillRatio();
+	finish();
+
+	//The last page is only partly used, leave it out of the average.
+	double full = 0;
+	for(size_t i = 0; i + 1 < fills.size(); ++i)
+		full += fills[i];
+	if(fills.size() > 1)
+		full /= fills.size() - 1;
+	printf("%dx%d: %zu rectangles on %zu pages, %.1f%% filled (last page %.1f%%)\n",
+		pageSize, pageSize, rects.size(), fills.size(), full * 100, last * 100);
+}
+
+int main()
+{
+	//Sprite sized: mostly small effects and parts, some full characters.
+	std::mt19937 random(26);
+	std::vector<SkylinePacker::Rect> rects;
+	for(int i = 0; i < 3000; ++i)
+	{
+		int size = random() % 10 ? 16 + random() % 112 : 128 + random() % 256;
+		int w = size + random() % 32;
+		int h = size + random() % 64;
+		//Padding the atlas adds around every sprite.
+		rects.push_back({0, 0, w + 2, h + 2});
+	}
+
+	Pack(1024, rects);
+	Pack(2048, rects);
+
+	//Released space is only given back by Clear.
+	SkylinePacker packer(64, 64);
+	SkylinePacker::Rect a, b, c;
+	if(!packer.Insert(64, 32, a) || !packer.Insert(64, 32, b) || packer.Insert(1, 1, c))
+	{
+		printf("  a 64x64 page doesn't take exactly two 64x32 rectangles\n");
+		++failures;
+	}
+	packer.Release(a);
+	if(packer.UsedArea() != 64 * 32 || packer.FillRatio() != 0.5f)
+	{
+		printf("  after a release: used area %lld, fill %.3f\n", packer.UsedArea(), packer.FillRatio());
+		++failures;
+	}
+	packer.Clear();
+	if(packer.UsedArea() != 0 || !packer.Insert(64, 64, c))
+	{
+		printf("  a cleared page isn't empty\n");
+		++failures;
+	}
+
+	printf("\nResult: %d failures\n", failures);
+	return failures > 0 ? 2 : 0;
+}
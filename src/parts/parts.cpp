@@ -1,6 +1,8 @@
 #include "parts.h"
 #include "../misc.h"
 #include "../cg.h"
+#include "../gl_state.h"
+#include "parts_mesh.h"
 
 #include <algorithm>
 #include <iostream>
@@ -15,8 +17,16 @@
 #define VAL(X) ((const char*)&X)
 #define PTR(X) ((const char*)X)
 
-Parts::Parts(CG* cgRef) : cg(cgRef), partVertices(Vao::F3F4, GL_STATIC_DRAW)
+Parts::Parts(CG* cgRef) : cg(cgRef), partVertices(Vao::F3F4, GL_STREAM_DRAW)
 {
+    // Lists are handed out by pointer, the vector must never reallocate.
+    commandCache.reserve(maxCommandLists);
+}
+
+void Parts::DropCommands()
+{
+    commandCache.clear();
+    ++dataSerial;
 }
 
 Parts::~Parts()
@@ -25,6 +35,83 @@ Parts::~Parts()
     delete[] data;
 }
 
+PartTextureArrays::Layer Parts::TextureFor(int gfxIndex)
+{
+    if (gfxIndex < 0 || gfxIndex >= gfxMeta.size())
+        return {0, 0};
+    auto& gfx = gfxMeta[gfxIndex];
+    if (gfx.uploaded)
+        return textureArrays.Get(gfxIndex);
+
+    if (gfx.packed) {
+        decoder.Demand({gfxIndex, gfx.packed, gfx.packedSize, gfx.imageSize});
+        PartTextureArrays::Layer placeholder = textureArrays.Get(placeholderId);
+        if (!placeholder.texture) {
+            // Faint grey, so parts still show where they are
+            char pixels[4 * 4 * 4];
+            for (int i = 0; i < sizeof(pixels); i += 4) {
+                pixels[i] = pixels[i + 1] = pixels[i + 2] = (char)0x80;
+                pixels[i + 3] = 0x40;
+            }
+            placeholder = textureArrays.Upload(placeholderId, 4, 4, PartTextureArrays::BGRA, pixels);
+        }
+        return placeholder;
+    }
+
+    // Empty slot
+    if (!gfx.Pixels())
+        return {0, 0};
+    gfx.uploaded = true;
+    return textureArrays.Upload(gfxIndex, gfx.w, gfx.h, gfx.ArrayFormat(), gfx.Pixels());
+}
+
+void Parts::PrefetchTextures(int pattern)
+{
+    if (pattern < 0 || pattern >= partSets.size())
+        return;
+    for (const auto& part : partSets[pattern].groups) {
+        if (part.ppId < 0 || part.ppId >= cutOuts.size())
+            continue;
+        int gfxIndex = cutOuts[part.ppId].texture;
+        if (gfxIndex < 0 || gfxIndex >= gfxMeta.size())
+            continue;
+        const auto& gfx = gfxMeta[gfxIndex];
+        if (gfx.packed)
+            decoder.Queue({gfxIndex, gfx.packed, gfx.packedSize, gfx.imageSize});
+    }
+}
+
+void Parts::PumpTextures()
+{
+    bool uploaded = false;
+    PartTextureDecoder::Result result;
+    while (decoder.PopReady(result)) {
+        auto gfx = GetPartGfx(result.index);
+        // Replaced or decoded by EnsureDecoded in the meantime
+        if (!gfx || gfx->packed != result.source) {
+            delete[] result.imageData;
+            continue;
+        }
+        gfx->packed = nullptr;
+        if (!result.imageData) {
+            printf("[Parts] Texture %d has broken compressed data\n", result.index);
+            gfx->imageSize = 0;
+            continue;
+        }
+        memcpy(gfx->ddsHeader, result.header, sizeof(gfx->ddsHeader));
+        gfx->imageData = result.imageData;
+        gfx->s3tc = (unsigned char*)gfx->imageData;
+        textureArrays.Upload(result.index, gfx->w, gfx->h, gfx->ArrayFormat(), gfx->Pixels());
+        gfx->uploaded = true;
+        uploaded = true;
+    }
+    // Lists built with the placeholder have to pick the texture up. They're
+    // only made stale, not freed: lists built earlier in the same pass may
+    // still be waiting to be executed.
+    if (uploaded)
+        ++dataSerial;
+}
+
 unsigned int* Parts::MainLoad(unsigned int* data, const unsigned int* data_end)
 {
     while (data < data_end) {
@@ -102,17 +189,18 @@ bool Parts::Load(const char* name)
         return false;
     }
 
-    // Free old data
+    // Free old data, the decoder may still be reading it
+    decoder.Cancel();
     delete[] this->data;
     this->data = loadData;
-    for (auto& tex : textures)
-        delete tex;
-    textures.clear();
+    textureArrays.Clear();
     partSets.clear();
     cutOuts.clear();
     gfxMeta.clear();
     shapes.clear();
     partVertices.Clear();
+    meshCache.Clear();
+    DropCommands();
 
     // Parse file
     MainLoad(d + 1, d_end);
@@ -123,61 +211,10 @@ bool Parts::Load(const char* name)
         if (!ps.groups.empty()) nonEmptyPartSets++;
     }
 
-    // Load textures into OpenGL
-    for (size_t idx = 0; idx < gfxMeta.size(); idx++)
-    {
-        auto& gfx = gfxMeta[idx];
-        
-        textures.push_back(new Texture);
-        if (gfx.s3tc)
-        {
-            if (gfx.type == 21)
-            {
-                // Uncompressed BGRA (type 21 uses BGRA format)
-                textures.back()->LoadDirect((char*)gfx.s3tc, gfx.w, gfx.h, true);
-                // Default to GL_NEAREST; filtering will be applied per-part based on PRFL flag
-                textures.back()->Apply(false, false);  // repeat=false, linearFilter=false
-            }
-            else
-            {
-                // Compressed (DXT1 or DXT5)
-                size_t compressedSize;
-                if (gfx.type == 5)
-                    compressedSize = gfx.w * gfx.h;
-                else if (gfx.type == 1)
-                    compressedSize = (gfx.w * gfx.h) * 3 / 6;
-                else
-                    assert(0 && "Unknown compression type");
-
-                textures.back()->LoadCompressed((char*)gfx.s3tc, gfx.w, gfx.h, compressedSize, gfx.type);
-                // LoadCompressed creates texture internally, set default filtering
-                // Actual filtering will be applied per-part based on PRFL flag in DrawPart()
-                glBindTexture(GL_TEXTURE_2D, textures.back()->id);
-                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-            }
-            if (!gfx.dontDelete)
-                delete[](gfx.s3tc - 128);
-        }
-        else if (gfx.data)
-        {
-            // PGTX data is also in BGRA format
-            textures.back()->LoadDirect(gfx.data, gfx.w, gfx.h, true);
-            // Default to GL_NEAREST; filtering will be applied per-part based on PRFL flag
-            textures.back()->Apply(false, false);  // repeat=false, linearFilter=false
-        }
-        else
-        {
-            // No texture data - empty slot
-        }
-
-        // Validate texture was created before storing ID
-        if (textures.back() && textures.back()->id != 0) {
-            gfx.textureIndex = textures.back()->id;
-        } else {
-            gfx.textureIndex = 0;
-        }
-    }
+    // Textures are decoded and uploaded when they're first drawn, see
+    // TextureFor. Their arrays are sized for all of them now.
+    for (const auto& gfx : gfxMeta)
+        textureArrays.Reserve(gfx.w, gfx.h, gfx.ArrayFormat());
 
     filePath = name;
 
@@ -204,13 +241,14 @@ bool Parts::Load(const char* name)
 
 void Parts::Free()
 {
-    for (auto& tex : textures)
-        delete tex;
-    textures.clear();
+    decoder.Cancel();
+    textureArrays.Clear();
     partSets.clear();
     cutOuts.clear();
     shapes.clear();
     gfxMeta.clear();
+    meshCache.Clear();
+    DropCommands();
     loaded = false;
 }
 
@@ -232,6 +270,8 @@ void Parts::updateCGReference(CG* cgRef)
 
 void Parts::updatePatEditorReferences(FrameState* state, RenderMode* mode)
 {
+    // What the editor shows is part of CommandKey and its edits bump
+    // dataSerial, cached lists stay good.
     currState = state;
     renderMode = mode;
 }
@@ -349,106 +389,60 @@ std::string Parts::GetTexturesDecorateName(int n) {
 
 // Parts.cpp continues in next message due to length...
 // Parts rendering implementation - append to parts.cpp or include
-// This file contains the Draw() and DrawPart() methods which are the most complex
+// This file contains the Draw() path (building and replaying part commands), the most complex part
 
 #include "parts.h"
 #include <glm/gtc/matrix_transform.hpp>
 
-void Parts::DrawPart(int i, bool useLinearFilter)
+PartTextureArrays::Layer Parts::PartTexture(int i)
 {
     // Safety: Don't render if Parts is being freed or unloaded
     if (!loaded || cutOuts.empty() || gfxMeta.empty()) {
-        return;
+        return {0, 0};
     }
 
     // Validate cutOut index
     if (i < 0 || i >= cutOuts.size()) {
-        printf("[DrawPart] Invalid cutOut index: %d (size=%zu)\n", i, cutOuts.size());
-        return;
+        printf("[PartTexture] Invalid cutOut index: %d (size=%zu)\n", i, cutOuts.size());
+        return {0, 0};
     }
 
     auto& cutout = cutOuts[i];
 
     // Validate texture index (must be >= 0 and < gfxMeta.size())
     if (cutout.texture < 0 || cutout.texture >= gfxMeta.size()) {
-        printf("[DrawPart] Invalid texture index: %d (gfxMeta.size=%zu)\n", cutout.texture, gfxMeta.size());
-        return;
-    }
-
-    // Validate that the texture was actually created
-    if (gfxMeta[cutout.texture].textureIndex == 0) {
-        static bool warnedOnce = false;
-        if (!warnedOnce) {
-            printf("[DrawPart] WARNING: Texture %d has ID 0 (not created)\n", cutout.texture);
-            warnedOnce = true;
-        }
-        return;  // Texture not loaded, skip silently
+        printf("[PartTexture] Invalid texture index: %d (gfxMeta.size=%zu)\n", cutout.texture, gfxMeta.size());
+        return {0, 0};
     }
 
     // Determine which texture to use
-    curTexId = gfxMeta[cutout.texture].textureIndex;
+    PartTextureArrays::Layer layer = TextureFor(cutout.texture);
+    if (layer.texture == 0)
+        return layer;  // Empty slot, skip silently
 
     // Override texture in TEXTURE_VIEW mode (show currently selected texture)
     if (renderMode && currState && *renderMode == RenderMode::TEXTURE_VIEW && !currState->animating) {
-        auto gfx = GetPartGfx(currState->partGraph);
-        if (gfx != nullptr && gfx->textureIndex != 0) {
-            curTexId = gfx->textureIndex;
-        }
+        PartTextureArrays::Layer selected = TextureFor(currState->partGraph);
+        if (selected.texture)
+            layer = selected;
     }
 
     // Override texture in UV_SETTING_VIEW mode (show texture from current cutout)
     if (renderMode && currState && *renderMode == RenderMode::UV_SETTING_VIEW && !currState->animating) {
         auto cutoutSelected = GetCutOut(currState->partCutOut);
         if (cutoutSelected != nullptr) {
-            auto gfx = GetPartGfx(cutoutSelected->texture);
-            if (gfx != nullptr && gfx->textureIndex != 0) {
-                curTexId = gfx->textureIndex;
-            }
+            PartTextureArrays::Layer selected = TextureFor(cutoutSelected->texture);
+            if (selected.texture)
+                layer = selected;
         }
     }
 
-    // Validate texture ID before binding
-    if (curTexId != 0 && !glIsTexture(curTexId)) {
-        static bool warnedOnce = false;
-        if (!warnedOnce) {
-            printf("[DrawPart] WARNING: Texture ID %d is not a valid OpenGL texture\n", curTexId);
-            warnedOnce = true;
-        }
-        return;  // Invalid texture, skip rendering
-    }
-
-    // Clear any pending GL errors before binding
-    while (glGetError() != GL_NO_ERROR);
-
-    // Bind texture
-    glBindTexture(GL_TEXTURE_2D, curTexId);
-    
-    // Apply filtering based on part property's PRFL flag
-    // PRFL flag: 0 = GL_NEAREST (no filtering), non-zero = GL_LINEAR (bilinear filtering)
-    if (useLinearFilter) {
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    } else {
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    }
-
-    // Check for OpenGL errors after binding (only on errors)
-    GLenum err = glGetError();
-    if (err != GL_NO_ERROR) {
-        printf("[TEXTURE RENDER] GL ERROR 0x%X after binding texture %d\n", err, curTexId);
-    }
-    
-    partVertices.Draw(0);
+    // The arrays are ours, the id is always a live texture.
+    return layer;
 }
 
-void Parts::Draw(int pattern, int nextPattern, float interpolationFactor,
-    std::function<void(glm::mat4)> setMatrix,
-    std::function<void(float, float, float)> setAddColor,
-    std::function<void(char)> setFlip,
-    float color[4])
+const Parts::CommandList* Parts::BuildCommands(int pattern, int nextPattern, float interpolationFactor, const float color[4])
 {
-    curTexId = -1;
 
     // Safety: Don't render if Parts is being freed or unloaded
     if (!loaded || partSets.empty() || cutOuts.empty()) {
@@ -458,7 +452,7 @@ void Parts::Draw(int pattern, int nextPattern, float interpolationFactor,
                 loaded, partSets.size(), cutOuts.size());
             warnedUnloaded = true;
         }
-        return;
+        return nullptr;
     }
 
     // Validate pattern indices
@@ -466,20 +460,67 @@ void Parts::Draw(int pattern, int nextPattern, float interpolationFactor,
        nextPattern < 0 || nextPattern >= partSets.size()) {
         printf("[Parts::Draw] ERROR: Invalid pattern indices: pattern=%d, next=%d, partSets.size=%zu\n",
             pattern, nextPattern, partSets.size());
-        return;
+        return nullptr;
     }
-    
+
+    PumpTextures();
+    if (nextPattern != pattern)
+        PrefetchTextures(nextPattern);
+
     if (partSets[pattern].groups.empty()) {
-        return;
+        return nullptr;
     }
 
-    // Sort groups by priority (higher priority = draw first)
-    auto copyGroups = partSets[pattern].groups;
-    // Note: No reverse() needed - stable_sort with rbegin/rend handles ordering
-    std::stable_sort(copyGroups.rbegin(), copyGroups.rend(),
-        [](const PartProperty &a, const PartProperty &b) {
-            return a.priority < b.priority;
-    });
+    // Everything the commands depend on besides the data itself
+    CommandKey key{};
+    key.pattern = pattern;
+    key.nextPattern = nextPattern;
+    key.interpolation = interpolationFactor;
+    memcpy(key.color, color, sizeof(key.color));
+    key.highlight = partHighlight;
+    key.highlightOpacity = highlightOpacity;
+    key.palette = cg ? cg->getCurrentPalette() : -1;
+    key.cgSerial = cg ? cg->getSerial() : 0;
+    key.dataSerial = dataSerial;
+    key.meshGeneration = meshCache.Generation();
+    // The PatEditor panes edit the data in place and bump dataSerial
+    // (MarkEdited); which texture or cutout they show goes in here.
+    if (currState) {
+        key.editorMode = renderMode ? (int)*renderMode : 0;
+        key.editorGraph = currState->partGraph;
+        key.editorCutOut = currState->partCutOut;
+        key.editorAnimating = currState->animating;
+    }
+
+    for (auto& cached : commandCache) {
+        if (!memcmp(&cached.key, &key, sizeof(key))) {
+            cached.lastUse = ++commandUse;
+            ++commandStats.reused;
+            return &cached;
+        }
+    }
+    CommandList* list = nullptr;
+    if (commandCache.size() < maxCommandLists) {
+        list = &commandCache.emplace_back();
+    } else {
+        list = &commandCache[0];
+        for (auto& cached : commandCache) {
+            if (cached.lastUse < list->lastUse)
+                list = &cached;
+        }
+    }
+    list->lastUse = ++commandUse;
+    list->key = key;
+    list->commands.clear();
+    list->stream.clear();
+    list->placeholders = 0;
+    ++commandStats.built;
+
+    // Drawing order (higher priority = draw first) is kept by the PartSet
+    // and only rebuilt after it's edited.
+    auto& partSet = partSets[pattern];
+    const std::vector<int>& drawOrder = partSet.DrawOrder();
+    size_t partCount = drawOrder.size();
 
     constexpr float tau = glm::pi<float>() * 2.f;
 
@@ -496,16 +537,18 @@ void Parts::Draw(int pattern, int nextPattern, float interpolationFactor,
 
     // TEXTURE_VIEW/UV_SETTING_VIEW: Clear parts and create single dummy part
     // This renders the texture with default properties (no transforms) for raw display
-    if (renderMode && currState && *renderMode != DEFAULT && !currState->animating) {
-        copyGroups.clear();
-        auto prop = &copyGroups.emplace_back();
-        prop->ppId = 0;  // Use cutout 0 (will be overridden below)
+    PartProperty dummyPart;
+    bool useDummyPart = renderMode && currState && *renderMode != DEFAULT && !currState->animating;
+    if (useDummyPart) {
+        dummyPart.ppId = 0;  // Use cutout 0 (will be overridden below)
         // All other PartProperty fields use defaults:
         //   position (0,0), scale (1,1), rotation (0,0,0), no flip, full opacity
+        partCount = 1;
     }
 
-    for (auto& part : copyGroups)
+    for (size_t partIndex = 0; partIndex < partCount; partIndex++)
     {
+        const PartProperty& part = useDummyPart ? dummyPart : partSet.groups[drawOrder[partIndex]];
         // Skip unused or invalid parts silently
         if (part.ppId < 0 || part.ppId >= cutOuts.size()) {
             continue;
@@ -573,24 +616,18 @@ void Parts::Draw(int pattern, int nextPattern, float interpolationFactor,
         glm::vec4 bgra = glm::vec4(part.bgra[0], part.bgra[1], part.bgra[2], opacity);
 
         Shape outShape = currentShape; // Copy for potential interpolation
+        bool shapeInterpolated = false;
 
         // Prevent crash on invalid shapes
         if(outShape.type != ShapeType::PLANE && outShape.type != ShapeType::UNK2 &&
             outShape.vertexCount == 0)
-            return;
+            break;
         if((outShape.type == ShapeType::SPHERE || outShape.type == ShapeType::CONE) &&
            outShape.vertexCount2 == 0)
-            return;
+            break;
 
         // Interpolation between frames
         if (interpolationFactor < 1 && !partSets[nextPattern].groups.empty()) {
-            auto copyNextGroups = partSets[nextPattern].groups;
-            std::reverse(copyNextGroups.begin(), copyNextGroups.end());
-            std::stable_sort(copyNextGroups.rbegin(), copyNextGroups.rend(),
-                [](const PartProperty &a, const PartProperty &b) {
-                    return a.priority < b.priority;
-            });
-
             auto mix = [interpolationFactor](float a, float b) {
                 return a * interpolationFactor + b * (1 - interpolationFactor);
             };
@@ -604,28 +641,27 @@ void Parts::Draw(int pattern, int nextPattern, float interpolationFactor,
                 return mix(a, b);
             };
 
-            auto nextPart = std::find_if(copyNextGroups.begin(), copyNextGroups.end(),
-                [&part](const auto& pt) {return pt.propId == part.propId; });
+            const PartProperty* nextPart = partSets[nextPattern].FindProp(part.propId);
 
-            if (nextPart != copyNextGroups.end() && (*nextPart).ppId < cutOuts.size()) {
-                auto nextCutout = cutOuts[(*nextPart).ppId];
+            if (nextPart && nextPart->ppId < cutOuts.size()) {
+                auto nextCutout = cutOuts[nextPart->ppId];
                 if (nextCutout.shapeIndex < shapes.size()) {
                     Shape nextShape = shapes[nextCutout.shapeIndex];
 
-                    offset[0] = mix(offset[0], (*nextPart).x);
-                    offset[1] = mix(offset[1], (*nextPart).y);
-                    rotation[0] = mixRotation(rotation[0], (*nextPart).rotation[1]);
-                    rotation[1] = mixRotation(rotation[1], (*nextPart).rotation[2]);
-                    rotation[2] = mixRotation(rotation[2], (*nextPart).rotation[3]);
-                    scale[0] = mix(scale[0], (*nextPart).scaleX);
-                    scale[1] = mix(scale[1], (*nextPart).scaleY);
-                    bgra[0] = mix(bgra[0], (*nextPart).bgra[0]);
-                    bgra[1] = mix(bgra[1], (*nextPart).bgra[1]);
-                    bgra[2] = mix(bgra[2], (*nextPart).bgra[2]);
+                    offset[0] = mix(offset[0], nextPart->x);
+                    offset[1] = mix(offset[1], nextPart->y);
+                    rotation[0] = mixRotation(rotation[0], nextPart->rotation[1]);
+                    rotation[1] = mixRotation(rotation[1], nextPart->rotation[2]);
+                    rotation[2] = mixRotation(rotation[2], nextPart->rotation[3]);
+                    scale[0] = mix(scale[0], nextPart->scaleX);
+                    scale[1] = mix(scale[1], nextPart->scaleY);
+                    bgra[0] = mix(bgra[0], nextPart->bgra[0]);
+                    bgra[1] = mix(bgra[1], nextPart->bgra[1]);
+                    bgra[2] = mix(bgra[2], nextPart->bgra[2]);
                     
                     // Interpolate opacity with same highlighting logic
-                    float opacityNext = partHighlight == -1 || partHighlight == (*nextPart).propId ?
-                        (*nextPart).bgra[3] : highlightOpacity * 255.f;
+                    float opacityNext = partHighlight == -1 || partHighlight == nextPart->propId ?
+                        nextPart->bgra[3] : highlightOpacity * 255.f;
                     bgra[3] = mix(bgra[3], opacityNext);
 
                     if ((int)currentShape.type > 2 && nextShape.type == currentShape.type) {
@@ -635,6 +671,7 @@ void Parts::Draw(int pattern, int nextPattern, float interpolationFactor,
                         outShape.length2 = mix(outShape.length2, nextShape.length2);
                         outShape.radius = mix(outShape.radius, nextShape.radius);
                         outShape.width = mix(outShape.width, nextShape.width);
+                        shapeInterpolated = true;
                     }
                 }
             }
@@ -646,26 +683,22 @@ void Parts::Draw(int pattern, int nextPattern, float interpolationFactor,
         view = glm::rotate(view, -rotation[1] * tau, glm::vec3(0.0, 1.f, 0.f));
         view = glm::rotate(view, -rotation[0] * tau, glm::vec3(1.0, 0.f, 0.f));
         view = glm::rotate(view, rotation[2] * tau, glm::vec3(0.0, 0.f, 1.f));
-        
-        setFlip(part.flip);
-        
         view = glm::scale(view, glm::vec3(scale[0], scale[1], 1.f));
-        setMatrix(view);
-
-        // Disable depth test for proper alpha blending of 2D sprites
-        glDisable(GL_DEPTH_TEST);
-        glDepthMask(GL_FALSE);
 
-        // Set blending mode
-        if (part.additive)
-            glBlendFunc(GL_SRC_ALPHA, GL_ONE);
-        else
-            glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        PartCommand command;
+        command.view = view;
+        command.group = useDummyPart ? -1 : drawOrder[partIndex];
+        command.flip = part.flip;
+        command.additive = part.additive;
+        command.linearFilter = part.filter;
+        // Note: addColor BGR->RGB swap when passing to shader
+        command.addColor[0] = part.addColor[2] / 255.f;
+        command.addColor[1] = part.addColor[1] / 255.f;
+        command.addColor[2] = part.addColor[0] / 255.f;
 
         // Apply color (including palette color if applicable)
-        float newColor[4];
+        float* newColor = command.color;
         memcpy(newColor, color, sizeof(float) * 4);
-        
         // Debug first part render only
         static bool debugOnce = true;
         if (debugOnce) {
@@ -702,14 +735,11 @@ void Parts::Draw(int pattern, int nextPattern, float interpolationFactor,
             debugOnce = false;
         }
 
-        glVertexAttrib4fv(2, newColor);
-        // Note: addColor BGR->RGB swap when passing to shader
-        setAddColor(part.addColor[2] / 255.f, part.addColor[1] / 255.f, part.addColor[0] / 255.f);
-
-        // Generate vertices based on shape type
-        std::vector<float> vertexData;
-        auto size = 0;
-
+        // Generate vertices based on shape type. Curved shapes come from the
+        // mesh cache unless they're being interpolated, then they change
+        // every frame and are streamed like planes.
+        command.mesh = nullptr;
+        command.streamFirst = list->stream.size();
         switch (outShape.type)
         {
         case ShapeType::PLANE:
@@ -726,126 +756,140 @@ void Parts::Draw(int pattern, int nextPattern, float interpolationFactor,
                 point[i].p = float(cutout.uv[0] + cutout.uv[2] * (1 - tX[i])) / width;
                 point[i].q = float(cutout.uv[1] + cutout.uv[3] * (1 - tY[i])) / height;
             }
-            partVertices.Prepare(6 * 7 * sizeof(float), &point[0]);
+            list->stream.insert(list->stream.end(), &point[0].x, &point[0].x + 6 * 7);
             break;
         }
-        case ShapeType::RING:
-        {
-            // Cylindrical ring
-            float angle = 0;
-            float delta = glm::pi<float>() * outShape.length / 5000 / outShape.vertexCount;
-            vertexData.resize(size + 6 * outShape.vertexCount * 7);
-            for (int i = 0; i < outShape.vertexCount; i++) {
-                for (int j = 0; j < 6; j++)
-                {
-                    point[j].x = float(outShape.radius - ((i + tY[j] == outShape.vertexCount && outShape.length == 10000) ? 0 : float(outShape.dRadius * (i + tY[j])) / outShape.vertexCount)) * glm::sin(angle + delta * tY[j]);
-                    point[j].y = -float(outShape.radius - ((i + tY[j] == outShape.vertexCount && outShape.length == 10000) ? 0 : float(outShape.dRadius * (i + tY[j])) / outShape.vertexCount)) * glm::cos(angle + delta * tY[j]);
-                    point[j].z = float(outShape.width * -(tX[j] * 2 - 1) - float(outShape.dz * (i + tY[j])) / outShape.vertexCount);
-                    point[j].s = float(cutout.uv[0] + cutout.uv[2] * (tX[j])) / width;
-                    point[j].t = float(cutout.uv[1] + 1.0f * cutout.uv[3] * (i + tY[j]) / outShape.vertexCount) / height;
-                    point[j].p = float(cutout.uv[0] + cutout.uv[2] * (1 - tX[j])) / width;
-                    point[j].q = float(cutout.uv[1] + 1.0f * cutout.uv[3] * (outShape.vertexCount - i - tY[j]) / outShape.vertexCount) / height;
-                }
-                angle += delta;
-                memcpy(&vertexData[size + 6 * 7 * i], point, sizeof(point));
+        default:
+            if (shapeInterpolated) {
+                TessellateShape(outShape, cutout.uv, shapeVertices);
+                if (shapeVertices.empty())
+                    continue;
+                list->stream.insert(list->stream.end(), shapeVertices.begin(), shapeVertices.end());
             }
-            partVertices.Prepare(6 * 7 * outShape.vertexCount * sizeof(float), &vertexData[0]);
-            break;
-        }
-        case ShapeType::ARC:
-        {
-            // Curved arc surface
-            float angle = 0;
-            float delta = glm::pi<float>() * outShape.length / 5000 / outShape.vertexCount;
-            vertexData.resize(size + 6 * outShape.vertexCount * 7);
-            for (int i = 0; i < outShape.vertexCount; i++) {
-                for (int j = 0; j < 6; j++)
-                {
-                    point[j].x = float((outShape.radius - (1 - tX[j]) * outShape.width - ((i + tY[j] == outShape.vertexCount && outShape.length == 10000) ? 0 : float(outShape.dRadius * (i + tY[j])) / outShape.vertexCount)) * glm::sin(angle + delta * tY[j]));
-                    point[j].y = -float((outShape.radius - (1 - tX[j]) * outShape.width - ((i + tY[j] == outShape.vertexCount && outShape.length == 10000) ? 0 : float(outShape.dRadius * (i + tY[j])) / outShape.vertexCount)) * glm::cos(angle + delta * tY[j]));
-                    point[j].z = -float(outShape.dz * (i + tY[j])) / outShape.vertexCount;
-                    point[j].s = float(cutout.uv[0] + cutout.uv[2] * (tX[j])) / width;
-                    point[j].t = float(cutout.uv[1] + 1.0f * cutout.uv[3] * (i + tY[j]) / outShape.vertexCount) / height;
-                    point[j].p = float(cutout.uv[0] + cutout.uv[2] * (1 - tX[j])) / width;
-                    point[j].q = float(cutout.uv[1] + 1.0f * cutout.uv[3] * (outShape.vertexCount - i - tY[j]) / outShape.vertexCount) / height;
-                }
-                angle += delta;
-                memcpy(&vertexData[size + 6 * 7 * i], point, sizeof(point));
+            else {
+                command.mesh = meshCache.Get(cutout.shapeIndex, outShape, cutout.uv);
+                if (!command.mesh)
+                    continue;
             }
-            partVertices.Prepare(6 * 7 * outShape.vertexCount * sizeof(float), &vertexData[0]);
             break;
         }
-        case ShapeType::SPHERE:
-        {
-            // Spherical surface
-            float angle = 0;
-            float delta = glm::pi<float>() * outShape.length / 5000 / outShape.vertexCount;
-            float angle2 = 0;
-            float delta2 = glm::pi<float>() * outShape.length2 / 10000 / outShape.vertexCount2;
-            vertexData.resize(size + 6 * outShape.vertexCount * outShape.vertexCount2 * 7);
-            for (int i = 0; i < outShape.vertexCount; i++) {
-                angle2 = 0;
-                for (int j = 0; j < outShape.vertexCount2; j++) {
-                    for (int k = 0; k < 6; k++)
-                    {
-                        point[k].x = float((outShape.radius) * glm::sin(angle2 + delta2 * tX[k]) * glm::sin(angle + delta * tY[k]));
-                        point[k].y = float((outShape.radius) * glm::sin(angle2 + delta2 * tX[k]) * glm::cos(angle + delta * tY[k]));
-                        point[k].z = outShape.radius * glm::cos(angle2 + delta2 * tX[k]);
-                        point[k].s = float(cutout.uv[0] + float(cutout.uv[2] * (i + tY[k])) / outShape.vertexCount) / width;
-                        point[k].t = float(cutout.uv[1] + float(cutout.uv[3] * (j + tX[k]) / outShape.vertexCount2)) / height;
-                        point[k].p = float(cutout.uv[0] + float(cutout.uv[2] * (outShape.vertexCount - i - tY[k])) / outShape.vertexCount) / width;
-                        point[k].q = float(cutout.uv[1] + float(cutout.uv[3] * (outShape.vertexCount2 - j - tX[k]) / outShape.vertexCount2)) / height;
-                    }
-                    memcpy(&vertexData[size + 6 * 7 * (outShape.vertexCount2 * i + j)], point, sizeof(point));
-                    angle2 += delta2;
-                }
-                angle += delta;
-            }
-            partVertices.Prepare(6 * 7 * outShape.vertexCount * outShape.vertexCount2 * sizeof(float), &vertexData[0]);
-            break;
+
+        command.streamCount = list->stream.size() - command.streamFirst;
+
+        command.texture = PartTexture(part.ppId);
+        if (command.texture.texture == 0) {
+            list->stream.resize(command.streamFirst);
+            continue;
         }
-        case ShapeType::CONE:
+        list->commands.push_back(command);
+        PartTextureArrays::Layer placeholder = textureArrays.Get(placeholderId);
+        if (command.texture.texture == placeholder.texture && command.texture.layer == placeholder.layer)
+            ++list->placeholders;
+    }
+
+    return list;
+}
+
+void Parts::ExecuteCommands(const CommandList& list,
+    const std::function<void(glm::mat4)>& setMatrix,
+    const std::function<void(float, float, float)>& setAddColor,
+    const std::function<void(char)>& setFlip,
+    const std::function<void(int)>& setPart)
+{
+    const CommandList* lists[] = {&list};
+    ExecuteCommands(lists, 1, nullptr, setMatrix, setAddColor, setFlip, setPart);
+}
+
+void Parts::ExecuteCommands(const CommandList* const* lists, size_t count,
+    const std::function<void(size_t)>& setList,
+    const std::function<void(glm::mat4)>& setMatrix,
+    const std::function<void(float, float, float)>& setAddColor,
+    const std::function<void(char)>& setFlip,
+    const std::function<void(int)>& setPart)
+{
+    size_t total = 0;
+    for (size_t i = 0; i < count; i++)
+        total += lists[i]->commands.size();
+    if (!total)
+        return;
+
+    // Planes and interpolated shapes of every list go up in one load, in
+    // command order.
+    partVertices.Clear();
+    for (size_t i = 0; i < count; i++) {
+        const CommandList& list = *lists[i];
+        for (const auto& command : list.commands) {
+            if (!command.mesh)
+                partVertices.Append(&list.stream[command.streamFirst], command.streamCount * sizeof(float));
+        }
+    }
+    partVertices.Load();
+
+    // Disable depth test for proper alpha blending of 2D sprites
+    glDisable(GL_DEPTH_TEST);
+    glDepthMask(GL_FALSE);
+    glDisableVertexAttribArray(3);
+
+    Vao* bound = nullptr;
+    int streamed = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        if (setList)
+            setList(i);
+        for (const auto& command : lists[i]->commands)
         {
-            // Conical surface
-            float angle = 0;
-            float delta = glm::pi<float>() * outShape.length / 5000 / outShape.vertexCount;
-            vertexData.resize(size + 6 * outShape.vertexCount * outShape.vertexCount2 * 7);
-            float w = float(outShape.radius) / outShape.vertexCount2;
-            for (int i = 0; i < outShape.vertexCount; i++) {
-                for (int j = 0; j < outShape.vertexCount2; j++) {
-                    for (int k = 0; k < 6; k++) {
-                        point[k].x = -w * (outShape.vertexCount2 - 1 - j + tX[k]) * glm::sin(angle + delta * tY[k]);
-                        point[k].y = -w * (outShape.vertexCount2 - 1 - j + tX[k]) * glm::cos(angle + delta * tY[k]);
-                        point[k].z = -outShape.dz * float(j + (1 - tX[k])) / outShape.vertexCount2;
-                        point[k].s = float(cutout.uv[0] + 1.0f * cutout.uv[2] * (i + tY[k]) / outShape.vertexCount) / width;
-                        point[k].t = float(cutout.uv[1] + 1.0f * cutout.uv[3] * (1 + j - tX[k]) / outShape.vertexCount2) / height;
-                        point[k].p = float(cutout.uv[0] + 1.0f * cutout.uv[2] * (outShape.vertexCount - i - tY[k]) / outShape.vertexCount) / width;
-                        point[k].q = float(cutout.uv[1] + 1.0f * cutout.uv[3] * (outShape.vertexCount2 - 1 - j + tX[k]) / outShape.vertexCount2) / height;
-                    }
-                    memcpy(&vertexData[size + 6 * 7 * (outShape.vertexCount2 * i + j)], point, sizeof(point));
-                }
-                angle += delta;
+            setMatrix(command.view);
+            setFlip(command.flip);
+            if (setPart)
+                setPart(command.group);
+
+            // Set blending mode
+            if (command.additive)
+                GlState::BlendFunc(GL_SRC_ALPHA, GL_ONE);
+            else
+                GlState::BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+            glVertexAttrib4fv(2, command.color);
+            setAddColor(command.addColor[0], command.addColor[1], command.addColor[2]);
+
+            // Consecutive parts usually share a buffer and a texture, GlState
+            // drops the repeated binds.
+            Vao* mesh = command.mesh ? command.mesh : &partVertices;
+            if (mesh != bound) {
+                mesh->Bind();
+                bound = mesh;
             }
-            partVertices.Prepare(6 * 7 * outShape.vertexCount * outShape.vertexCount2 * sizeof(float), &vertexData[0]);
-            break;
-        }
-        default:
-            continue;
-        }
+            // The layer is a constant attribute like the color
+            curTexId = command.texture.texture;
+            GlState::BindTextureArray(command.texture.texture);
+            glVertexAttrib1f(3, (float)command.texture.layer);
+            // Filter flag from part property (PRFL): 0 = GL_NEAREST, non-zero = GL_LINEAR
+            GlState::TexFilter(command.linearFilter ? GL_LINEAR : GL_NEAREST);
 
-        // Render the part
-        partVertices.Load();
-        partVertices.Bind();
-        // Pass the filter flag from part property (PRFL) to control texture filtering
-        DrawPart(part.ppId, part.filter);
-        partVertices.Clear();
+            mesh->Draw(command.mesh ? 0 : streamed++);
+        }
     }
-    
+    partVertices.Clear();
+
     // Restore depth test state
     glEnable(GL_DEPTH_TEST);
     glDepthMask(GL_TRUE);
 }
 
+int Parts::Draw(int pattern, int nextPattern, float interpolationFactor,
+    std::function<void(glm::mat4)> setMatrix,
+    std::function<void(float, float, float)> setAddColor,
+    std::function<void(char)> setFlip,
+    float color[4])
+{
+    curTexId = -1;
+    const CommandList* list = BuildCommands(pattern, nextPattern, interpolationFactor, color);
+    if (!list)
+        return 0;
+    ExecuteCommands(*list, setMatrix, setAddColor, setFlip);
+    return list->placeholders;
+}
+
 bool Parts::Save(const char* filename)
 {
     // Validate that we have data to save
@@ -882,9 +926,13 @@ bool Parts::Save(const char* filename)
     }
     if(!hasData) return false;
 
-    std::ofstream file(filename, std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
-    if (!file.is_open())
-        return false;
+    // Saving writes the decoded data
+    for (auto& gfx : gfxMeta)
+        gfx.EnsureDecoded();
+
+    // Everything is put together in memory and written in one go, the
+    // savers below write a few bytes at a time.
+    std::ostringstream file(std::ios_base::out | std::ios_base::binary);
 
     // Write header
     char header[32] = "PAniDataFile";
@@ -949,8 +997,13 @@ bool Parts::Save(const char* filename)
     }
 
     file.write("_END", 4);
-    file.close();
-    return true;
+
+    std::ofstream out(filename, std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+    if (!out.is_open())
+        return false;
+    const std::string& bytes = file.str();
+    out.write(bytes.data(), bytes.size());
+    return out.good();
 }
 
 void Parts::SetHighlightOpacity(float opacity)
@@ -2,14 +2,17 @@
 #define PARTS_H_GUARD
 
 #include "../cg.h"
-#include "../texture.h"
 #include "../vao.h"
 #include "../enums.h"
 #include "../framestate.h"
 #include "parts_texture.h"
+#include "parts_texture_array.h"
 #include "parts_shape.h"
 #include "parts_part.h"
 #include "parts_partset.h"
+#include "parts_mesh.h"
+#include "parts_decoder.h"
+#include <cstdint>
 #include <vector>
 #include <functional>
 #include <glm/mat4x4.hpp>
@@ -26,8 +29,55 @@ public:
     std::vector<CutOut<>> cutOuts;
     std::vector<Shape<>> shapes;
     std::vector<PartGfx<>> gfxMeta;
-    std::vector<Texture*> textures;
     Vao partVertices;
+    ShapeMeshCache meshCache;
+    std::vector<float> shapeVertices;  // Interpolated shapes, rebuilt every draw
+
+    // One part as it's drawn: everything BuildCommands works out, so a
+    // frame that doesn't change only has to be replayed.
+    struct PartCommand {
+        glm::mat4 view;
+        float color[4];
+        float addColor[3];
+        PartTextureArrays::Layer texture;
+        Vao* mesh;                 // From meshCache, nullptr if streamed
+        size_t streamFirst;        // Floats in CommandList::stream
+        size_t streamCount;
+        int group;                 // In the PartSet's groups, -1 in the texture views
+        char flip;
+        bool additive;
+        bool linearFilter;
+    };
+    // Inputs of a command list besides the data. Compared with memcmp,
+    // so it's zero initialised before it's filled.
+    struct CommandKey {
+        int pattern;
+        int nextPattern;
+        float interpolation;
+        float color[4];
+        int highlight;
+        float highlightOpacity;
+        int palette;
+        unsigned int cgSerial;
+        unsigned int dataSerial;
+        uint64_t meshGeneration;
+        // What an attached PatEditor view shows, all 0 without one
+        int editorMode;
+        int editorGraph;
+        int editorCutOut;
+        int editorAnimating;
+    };
+    struct CommandList {
+        CommandKey key;
+        uint64_t lastUse = 0;
+        std::vector<PartCommand> commands;
+        std::vector<float> stream;  // Vertices of planes and interpolated shapes
+        int placeholders = 0;       // Commands drawn with the placeholder texture
+    };
+    struct CommandStats {
+        uint64_t built;
+        uint64_t reused;
+    };
 
     int curTexId = -1;
     bool loaded = false;
@@ -45,13 +95,46 @@ public:
     bool Save(const char* filename);
     unsigned int* MainLoad(unsigned int* data, const unsigned int* data_end);
 
-    // Rendering
-    void Draw(int pattern, int nextPattern, float interpolationFactor,
+    // Rendering. Returns how many parts were drawn with the placeholder, the
+    // frame isn't final while that's not 0.
+    int Draw(int pattern, int nextPattern, float interpolationFactor,
         std::function<void(glm::mat4)> setMatrix,
         std::function<void(float, float, float)> setAddColor,
         std::function<void(char)> setFlip,
         float color[4]);
-    void DrawPart(int id, bool useLinearFilter = false);
+    // Draw() in two steps. The list stays valid for the next
+    // maxBatchedLists builds. Returns nullptr if there's nothing to draw.
+    const CommandList* BuildCommands(int pattern, int nextPattern, float interpolationFactor, const float color[4]);
+    // setPart, if given, is called with each command's group before it's drawn.
+    void ExecuteCommands(const CommandList& list,
+        const std::function<void(glm::mat4)>& setMatrix,
+        const std::function<void(float, float, float)>& setAddColor,
+        const std::function<void(char)>& setFlip,
+        const std::function<void(int)>& setPart = nullptr);
+    // Several lists of this Parts in one pass, with a single vertex upload.
+    // setList is called with a list's index before its commands. Up to
+    // maxBatchedLists built in a row stay valid together.
+    void ExecuteCommands(const CommandList* const* lists, size_t count,
+        const std::function<void(size_t)>& setList,
+        const std::function<void(glm::mat4)>& setMatrix,
+        const std::function<void(float, float, float)>& setAddColor,
+        const std::function<void(char)>& setFlip,
+        const std::function<void(int)>& setPart = nullptr);
+    static constexpr size_t maxBatchedLists = 16;
+    // Array layer a cutout is drawn with, texture 0 if it can't be.
+    PartTextureArrays::Layer PartTexture(int i);
+    // Array layer of a gfxMeta entry, uploaded on first use. Returns a
+    // placeholder while the entry is still being decompressed, texture 0 if
+    // empty.
+    PartTextureArrays::Layer TextureFor(int gfxIndex);
+    // Starts decompressing the textures a pattern needs.
+    void PrefetchTextures(int pattern);
+    CommandStats GetCommandStats() const { return commandStats; }
+    // Bumped whenever what the parts draw changes: loading, freeing,
+    // textures finishing their upload and MarkEdited.
+    unsigned int DataSerial() const { return dataSerial; }
+    // Called after the PatEditor changed the data in place.
+    void MarkEdited() { ++dataSerial; }
 
     // Accessors
     PartSet<>* GetPartSet(unsigned int n);
@@ -75,6 +158,23 @@ public:
 
     // PatEditor
     void SetHighlightOpacity(float opacity);
+
+private:
+    // Lists for frames drawn lately, least recently used goes first.
+    static constexpr size_t maxCommandLists = 32;
+    std::vector<CommandList> commandCache;
+    uint64_t commandUse = 0;
+    CommandStats commandStats = {};
+    unsigned int dataSerial = 0;  // See DataSerial
+
+    PartTextureDecoder decoder;
+    PartTextureArrays textureArrays;
+    // Id of the placeholder in textureArrays, gfxMeta indices are >= 0
+    static constexpr int placeholderId = -1;
+
+    void DropCommands();
+    // Uploads what the decoder finished since the last frame.
+    void PumpTextures();
 };
 
 #endif /* PARTS_H_GUARD */
@@ -0,0 +1,86 @@
+#include "parts_codec.h"
+
+#include <cstdint>
+#include <cstring>
+
+bool PatRleDecode(const unsigned char* in, size_t inSize, unsigned char* out, size_t outSize)
+{
+    const unsigned char* end = in + inSize;
+    unsigned char* outEnd = out + outSize;
+    while (in < end)
+    {
+        // Literals go up to the next run, memchr looks at many bytes at once.
+        const unsigned char* marker = (const unsigned char*)memchr(in, 0, end - in);
+        const unsigned char* literalEnd = marker ? marker : end;
+        size_t literals = literalEnd - in;
+        if (literals > size_t(outEnd - out))
+            return false;
+        memcpy(out, in, literals);
+        out += literals;
+        in = literalEnd;
+        if (!marker)
+            break;
+
+        if (end - in < 3)
+            return false;
+        size_t count = in[2];
+        if (count > size_t(outEnd - out))
+            return false;
+        memset(out, in[1], count);
+        out += count;
+        in += 3;
+    }
+    return true;
+}
+
+// How many bytes from p on equal *p, 8 at a time while it can.
+static size_t RunLength(const unsigned char* p, const unsigned char* end)
+{
+    const unsigned char* start = p;
+    uint64_t pattern = 0x0101010101010101ull * *p;
+    while (end - p >= 8) {
+        uint64_t word;
+        memcpy(&word, p, 8);
+        if (word != pattern)
+            break;
+        p += 8;
+    }
+    unsigned char value = *start;
+    while (p < end && *p == value)
+        ++p;
+    return p - start;
+}
+
+void PatRleEncode(const unsigned char* in, size_t size, std::vector<unsigned char>& out)
+{
+    // Worst case is all lone zeros, 3 bytes each.
+    size_t start = out.size();
+    out.resize(start + size * 3);
+    unsigned char* o = out.data() + start;
+
+    const unsigned char* end = in + size;
+    while (in < end)
+    {
+        unsigned char value = *in;
+        size_t run = (end - in > 1 && in[1] == value) ? RunLength(in, end) : 1;
+        in += run;
+
+        for (; run > 255; run -= 255) {
+            o[0] = 0;
+            o[1] = value;
+            o[2] = 255;
+            o += 3;
+        }
+        if (run >= 4 || value == 0) {
+            o[0] = 0;
+            o[1] = value;
+            o[2] = (unsigned char)run;
+            o += 3;
+        }
+        else {
+            for (size_t i = 0; i < run; ++i)
+                *o++ = value;
+        }
+    }
+    out.resize(o - out.data());
+}
@@ -0,0 +1,18 @@
+#ifndef PARTS_CODEC_H_GUARD
+#define PARTS_CODEC_H_GUARD
+
+#include <cstddef>
+#include <vector>
+
+// RLE used for PGT2 texture data. A 0 byte starts a run: 0, value, count.
+// Anything else is a literal byte. Zeros are always stored as runs, other
+// values only when repeated 4 times or more, runs are 255 bytes at most.
+
+// Returns false if the data is cut short or doesn't fit in outSize bytes.
+bool PatRleDecode(const unsigned char* in, size_t inSize, unsigned char* out, size_t outSize);
+
+// Appends the encoded bytes to out. Same output as the old byte by byte
+// encoder, so saved files don't change.
+void PatRleEncode(const unsigned char* in, size_t size, std::vector<unsigned char>& out);
+
+#endif // PARTS_CODEC_H_GUARD
@@ -0,0 +1,114 @@
+#include "parts_decoder.h"
+#include "parts_texture.h"
+
+void (*PartTextureDecoder::readyHook)() = nullptr;
+
+PartTextureDecoder::~PartTextureDecoder()
+{
+    Cancel();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        quit = true;
+    }
+    wake.notify_all();
+    if (worker.joinable())
+        worker.join();
+}
+
+bool PartTextureDecoder::Known(const Job& job, bool moveToFront)
+{
+    if (busy == job.source)
+        return true;
+    for (const auto& result : ready) {
+        if (result.source == job.source)
+            return true;
+    }
+    for (auto it = queue.begin(); it != queue.end(); ++it) {
+        if (it->source == job.source) {
+            if (moveToFront && it != queue.begin()) {
+                Job found = *it;
+                queue.erase(it);
+                queue.push_front(found);
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+void PartTextureDecoder::Start()
+{
+    if (!worker.joinable())
+        worker = std::thread(&PartTextureDecoder::Work, this);
+}
+
+void PartTextureDecoder::Queue(const Job& job)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (Known(job, false))
+            return;
+        queue.push_back(job);
+        Start();
+    }
+    wake.notify_one();
+}
+
+void PartTextureDecoder::Demand(const Job& job)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (Known(job, true))
+            return;
+        queue.push_front(job);
+        Start();
+    }
+    wake.notify_one();
+}
+
+bool PartTextureDecoder::PopReady(Result& out)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (ready.empty())
+        return false;
+    out = ready.front();
+    ready.pop_front();
+    return true;
+}
+
+void PartTextureDecoder::Cancel()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    queue.clear();
+    done.wait(lock, [this] { return busy == nullptr; });
+    for (auto& result : ready)
+        delete[] result.imageData;
+    ready.clear();
+}
+
+void PartTextureDecoder::Work()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        wake.wait(lock, [this] { return quit || !queue.empty(); });
+        if (quit)
+            return;
+
+        Job job = queue.front();
+        queue.pop_front();
+        busy = job.source;
+        lock.unlock();
+
+        Result result;
+        result.index = job.index;
+        result.source = job.source;
+        result.imageData = PartGfx<>::Unpack(job.source, job.size, job.imageSize, result.header);
+
+        lock.lock();
+        busy = nullptr;
+        ready.push_back(result);
+        done.notify_all();
+        if (readyHook)
+            readyHook();
+    }
+}
@@ -0,0 +1,61 @@
+#ifndef PARTS_DECODER_H_GUARD
+#define PARTS_DECODER_H_GUARD
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+// Decodes compressed PGT2 textures on a worker thread, started the first
+// time something is queued. Decoded data waits in a ready list until the
+// main thread takes it; nothing here touches GL or the Parts' vectors.
+class PartTextureDecoder {
+public:
+    struct Job {
+        int index;                    // In Parts::gfxMeta
+        const unsigned char* source;  // Packed data in the loaded file
+        int size;
+        int imageSize;                // Decoded, without "DDS " and the header
+    };
+    struct Result {
+        int index;
+        const unsigned char* source;  // Tells if the texture was replaced meanwhile
+        char header[124];
+        char* imageData;              // new[], nullptr if the data was broken
+    };
+
+    PartTextureDecoder() = default;
+    ~PartTextureDecoder();
+
+    // Behind anything already queued, for textures that will be needed soon.
+    void Queue(const Job& job);
+    // Needed now: decoded before anything queued.
+    void Demand(const Job& job);
+    // Oldest first. Returns false if nothing is ready. The caller owns imageData.
+    bool PopReady(Result& out);
+
+    // Drops queued and ready work and waits for the texture being decoded.
+    // Needed before the file data goes away.
+    void Cancel();
+
+    // Called from the worker whenever a texture becomes ready.
+    static void (*readyHook)();
+
+private:
+    std::thread worker;
+    std::deque<Job> queue;
+    std::deque<Result> ready;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    const unsigned char* busy = nullptr;  // Source being decoded
+    bool quit = false;
+
+    // With the mutex held. False if it's queued, being decoded or ready.
+    bool Known(const Job& job, bool moveToFront);
+    void Start();
+    void Work();
+};
+
+#endif // PARTS_DECODER_H_GUARD
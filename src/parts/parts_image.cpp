@@ -0,0 +1,150 @@
+#include "parts_image.h"
+#include "../bc.h"
+
+#include <cstdint>
+#include <cstring>
+
+static unsigned int Read32(const unsigned char* p)
+{
+    unsigned int v;
+    memcpy(&v, p, 4);
+    return v;
+}
+
+size_t PatImageSize(int type, int w, int h)
+{
+    switch (type) {
+    case 1: return (size_t)w * h / 2;
+    case 5: return (size_t)w * h;
+    case 21: return (size_t)w * h * 4;
+    }
+    return 0;
+}
+
+std::vector<PatTexture> PatFindTextures(const unsigned char* file, size_t size)
+{
+    std::vector<PatTexture> found;
+    size_t pos = 0;
+    while (pos + 8 <= size) {
+        if (memcmp(file + pos, "PGST", 4)) {
+            ++pos;
+            continue;
+        }
+        PatTexture tex{};
+        tex.id = Read32(file + pos + 4);
+        bool hasImage = false;
+        size_t p = pos + 8;
+        size_t next = pos + 1;
+        while (p + 4 <= size) {
+            const unsigned char* tag = file + p;
+            p += 4;
+            if (!memcmp(tag, "PGNM", 4)) {
+                if (p + 32 > size)
+                    break;
+                tex.name.assign((const char*)file + p, strnlen((const char*)file + p, 32));
+                p += 32;
+            }
+            else if (!memcmp(tag, "PGTP", 4) || !memcmp(tag, "PGTE", 4))
+                p += 4;
+            else if (!memcmp(tag, "PGT2", 4)) {
+                if (p + 40 > size)
+                    break;
+                unsigned int someSize = Read32(file + p);
+                tex.w = Read32(file + p + 4);
+                tex.h = Read32(file + p + 8);
+                const unsigned char* typeTag = file + p + 12;
+                if (Read32(typeTag) == 21)
+                    tex.type = 21;
+                else if (!memcmp(typeTag, "DXT1", 4))
+                    tex.type = 1;
+                else if (!memcmp(typeTag, "DXT5", 4))
+                    tex.type = 5;
+                else
+                    break;
+                if (tex.w <= 0 || tex.h <= 0 || tex.w > 16384 || tex.h > 16384)
+                    break;
+
+                size_t area = (size_t)tex.w * tex.h;
+                bool raw = (tex.type == 5 && someSize == area + 128) ||
+                    (tex.type == 1 && someSize == area / 2 + 128) || someSize == area * 4 + 128;
+                if (raw) {
+                    // "DDS ", the header, then the image
+                    size_t dds = p + 24;
+                    if (dds + someSize > size)
+                        break;
+                    tex.packed = false;
+                    tex.offset = dds + 128;
+                    tex.imageSize = someSize - 128;
+                    tex.size = tex.imageSize;
+                    p = dds + someSize;
+                }
+                else {
+                    size_t cSize = Read32(file + p + 32), oSize = Read32(file + p + 36);
+                    if (oSize < 128 || p + 40 + cSize > size)
+                        break;
+                    tex.packed = true;
+                    tex.offset = p + 40;
+                    tex.imageSize = oSize - 128;
+                    tex.size = cSize;
+                    p += 40 + cSize;
+                }
+                tex.data = file + tex.offset;
+                hasImage = true;
+            }
+            else if (!memcmp(tag, "PGTX", 4)) {
+                if (p + 12 > size)
+                    break;
+                tex.w = Read32(file + p);
+                tex.h = Read32(file + p + 4);
+                if (Read32(file + p + 8) != 32 || tex.w <= 0 || tex.h <= 0 || tex.w > 16384 || tex.h > 16384)
+                    break;
+                tex.type = 21;
+                tex.packed = false;
+                tex.offset = p + 12;
+                tex.imageSize = (size_t)tex.w * tex.h * 4;
+                tex.size = tex.imageSize;
+                if (tex.offset + tex.size > size)
+                    break;
+                tex.data = file + tex.offset;
+                p = tex.offset + tex.size;
+                hasImage = true;
+            }
+            else if (!memcmp(tag, "PGED", 4)) {
+                if (hasImage) {
+                    found.push_back(tex);
+                    next = p;
+                }
+                break;
+            }
+            // Anything else is skipped like PgLoad does.
+        }
+        pos = next;
+    }
+    return found;
+}
+
+bool PatDecodeImage(const unsigned char* image, size_t size, int type, int w, int h,
+    std::vector<unsigned char>& rgba, int threads)
+{
+    size_t expected = PatImageSize(type, w, h);
+    if (!expected || size < expected)
+        return false;
+    rgba.resize((size_t)w * h * 4);
+
+    if (type == 21) {
+        // BGRA words to RGBA, a shift and mask per pixel that vectorizes.
+        size_t count = (size_t)w * h;
+        for (size_t i = 0; i < count; ++i) {
+            uint32_t v;
+            memcpy(&v, image + i * 4, 4);
+            v = (v & 0xFF00FF00u) | ((v >> 16) & 0xFFu) | ((v & 0xFFu) << 16);
+            memcpy(&rgba[i * 4], &v, 4);
+        }
+        return true;
+    }
+
+    if (w % 4 || h % 4)
+        return false;
+    Bc::Decode(rgba.data(), image, w, h, type == 5, threads);
+    return true;
+}
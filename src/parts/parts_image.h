@@ -0,0 +1,37 @@
+#ifndef PARTS_IMAGE_H_GUARD
+#define PARTS_IMAGE_H_GUARD
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// PAT textures without GL or a loaded Parts: finding them in the raw file and
+// decoding them to RGBA on the CPU, for exporting and tools.
+
+// A texture as it's stored in the file.
+struct PatTexture {
+    int id;                      // PGST index
+    std::string name;            // PGNM, Shift-JIS, may be empty
+    int w, h;
+    int type;                    // 1 DXT1, 5 DXT5, 21 BGRA (PGT2 type 21 and MBAA PGTX)
+    const unsigned char* data;   // Image data, or the RLE stream if packed
+    size_t size;
+    bool packed;                 // PGT2 RLE, see PatRleDecode
+    size_t imageSize;            // Image data once unpacked, without "DDS " and the header
+    size_t offset;               // Of data in the file
+};
+
+// Walks the PG tags like PartGfx::PgLoad, from every PGST in the file. The
+// other sections aren't parsed, so every offset is tried.
+std::vector<PatTexture> PatFindTextures(const unsigned char* file, size_t size);
+
+// Bytes of image data a texture of this type and size has.
+size_t PatImageSize(int type, int w, int h);
+
+// Image data (unpacked, without the DDS header) to RGBA8, rows top to
+// bottom. BC blocks are split between threads, 0 for one per core. False
+// for unknown types or data that's too short.
+bool PatDecodeImage(const unsigned char* image, size_t size, int type, int w, int h,
+    std::vector<unsigned char>& rgba, int threads = 0);
+
+#endif // PARTS_IMAGE_H_GUARD
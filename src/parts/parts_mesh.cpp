@@ -0,0 +1,197 @@
+#include "parts_mesh.h"
+
+#include <cstring>
+#include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
+
+void TessellateShape(const Shape<>& shape, const int uv[4], std::vector<float>& out)
+{
+    // Triangle indices for generating geometry
+    constexpr int tX[] = { 0,1,1, 1,0,0 };
+    constexpr int tY[] = { 0,0,1, 1,1,0 };
+
+    struct {
+        float x, y, z, s, t, p, q;
+    } point[6];
+
+    float width = 256.f;   // Texture UV width
+    float height = 256.f;  // Texture UV height
+
+    out.clear();
+    switch (shape.type)
+    {
+    case ShapeType::RING:
+    {
+        // Cylindrical ring
+        float angle = 0;
+        float delta = glm::pi<float>() * shape.length / 5000 / shape.vertexCount;
+        out.resize(6 * shape.vertexCount * 7);
+        for (int i = 0; i < shape.vertexCount; i++) {
+            for (int j = 0; j < 6; j++)
+            {
+                point[j].x = float(shape.radius - ((i + tY[j] == shape.vertexCount && shape.length == 10000) ? 0 : float(shape.dRadius * (i + tY[j])) / shape.vertexCount)) * glm::sin(angle + delta * tY[j]);
+                point[j].y = -float(shape.radius - ((i + tY[j] == shape.vertexCount && shape.length == 10000) ? 0 : float(shape.dRadius * (i + tY[j])) / shape.vertexCount)) * glm::cos(angle + delta * tY[j]);
+                point[j].z = float(shape.width * -(tX[j] * 2 - 1) - float(shape.dz * (i + tY[j])) / shape.vertexCount);
+                point[j].s = float(uv[0] + uv[2] * (tX[j])) / width;
+                point[j].t = float(uv[1] + 1.0f * uv[3] * (i + tY[j]) / shape.vertexCount) / height;
+                point[j].p = float(uv[0] + uv[2] * (1 - tX[j])) / width;
+                point[j].q = float(uv[1] + 1.0f * uv[3] * (shape.vertexCount - i - tY[j]) / shape.vertexCount) / height;
+            }
+            angle += delta;
+            memcpy(&out[6 * 7 * i], point, sizeof(point));
+        }
+        break;
+    }
+    case ShapeType::ARC:
+    {
+        // Curved arc surface
+        float angle = 0;
+        float delta = glm::pi<float>() * shape.length / 5000 / shape.vertexCount;
+        out.resize(6 * shape.vertexCount * 7);
+        for (int i = 0; i < shape.vertexCount; i++) {
+            for (int j = 0; j < 6; j++)
+            {
+                point[j].x = float((shape.radius - (1 - tX[j]) * shape.width - ((i + tY[j] == shape.vertexCount && shape.length == 10000) ? 0 : float(shape.dRadius * (i + tY[j])) / shape.vertexCount)) * glm::sin(angle + delta * tY[j]));
+                point[j].y = -float((shape.radius - (1 - tX[j]) * shape.width - ((i + tY[j] == shape.vertexCount && shape.length == 10000) ? 0 : float(shape.dRadius * (i + tY[j])) / shape.vertexCount)) * glm::cos(angle + delta * tY[j]));
+                point[j].z = -float(shape.dz * (i + tY[j])) / shape.vertexCount;
+                point[j].s = float(uv[0] + uv[2] * (tX[j])) / width;
+                point[j].t = float(uv[1] + 1.0f * uv[3] * (i + tY[j]) / shape.vertexCount) / height;
+                point[j].p = float(uv[0] + uv[2] * (1 - tX[j])) / width;
+                point[j].q = float(uv[1] + 1.0f * uv[3] * (shape.vertexCount - i - tY[j]) / shape.vertexCount) / height;
+            }
+            angle += delta;
+            memcpy(&out[6 * 7 * i], point, sizeof(point));
+        }
+        break;
+    }
+    case ShapeType::SPHERE:
+    {
+        // Spherical surface
+        float angle = 0;
+        float delta = glm::pi<float>() * shape.length / 5000 / shape.vertexCount;
+        float angle2 = 0;
+        float delta2 = glm::pi<float>() * shape.length2 / 10000 / shape.vertexCount2;
+        out.resize(6 * shape.vertexCount * shape.vertexCount2 * 7);
+        for (int i = 0; i < shape.vertexCount; i++) {
+            angle2 = 0;
+            for (int j = 0; j < shape.vertexCount2; j++) {
+                for (int k = 0; k < 6; k++)
+                {
+                    point[k].x = float((shape.radius) * glm::sin(angle2 + delta2 * tX[k]) * glm::sin(angle + delta * tY[k]));
+                    point[k].y = float((shape.radius) * glm::sin(angle2 + delta2 * tX[k]) * glm::cos(angle + delta * tY[k]));
+                    point[k].z = shape.radius * glm::cos(angle2 + delta2 * tX[k]);
+                    point[k].s = float(uv[0] + float(uv[2] * (i + tY[k])) / shape.vertexCount) / width;
+                    point[k].t = float(uv[1] + float(uv[3] * (j + tX[k]) / shape.vertexCount2)) / height;
+                    point[k].p = float(uv[0] + float(uv[2] * (shape.vertexCount - i - tY[k])) / shape.vertexCount) / width;
+                    point[k].q = float(uv[1] + float(uv[3] * (shape.vertexCount2 - j - tX[k]) / shape.vertexCount2)) / height;
+                }
+                memcpy(&out[6 * 7 * (shape.vertexCount2 * i + j)], point, sizeof(point));
+                angle2 += delta2;
+            }
+            angle += delta;
+        }
+        break;
+    }
+    case ShapeType::CONE:
+    {
+        // Conical surface
+        float angle = 0;
+        float delta = glm::pi<float>() * shape.length / 5000 / shape.vertexCount;
+        out.resize(6 * shape.vertexCount * shape.vertexCount2 * 7);
+        float w = float(shape.radius) / shape.vertexCount2;
+        for (int i = 0; i < shape.vertexCount; i++) {
+            for (int j = 0; j < shape.vertexCount2; j++) {
+                for (int k = 0; k < 6; k++) {
+                    point[k].x = -w * (shape.vertexCount2 - 1 - j + tX[k]) * glm::sin(angle + delta * tY[k]);
+                    point[k].y = -w * (shape.vertexCount2 - 1 - j + tX[k]) * glm::cos(angle + delta * tY[k]);
+                    point[k].z = -shape.dz * float(j + (1 - tX[k])) / shape.vertexCount2;
+                    point[k].s = float(uv[0] + 1.0f * uv[2] * (i + tY[k]) / shape.vertexCount) / width;
+                    point[k].t = float(uv[1] + 1.0f * uv[3] * (1 + j - tX[k]) / shape.vertexCount2) / height;
+                    point[k].p = float(uv[0] + 1.0f * uv[2] * (shape.vertexCount - i - tY[k]) / shape.vertexCount) / width;
+                    point[k].q = float(uv[1] + 1.0f * uv[3] * (shape.vertexCount2 - 1 - j + tX[k]) / shape.vertexCount2) / height;
+                }
+                memcpy(&out[6 * 7 * (shape.vertexCount2 * i + j)], point, sizeof(point));
+            }
+            angle += delta;
+        }
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+bool ShapeMeshCache::Key::operator==(const Key& other) const
+{
+    return shapeIndex == other.shapeIndex &&
+        !memcmp(params, other.params, sizeof(params)) &&
+        !memcmp(uv, other.uv, sizeof(uv));
+}
+
+size_t ShapeMeshCache::KeyHash::operator()(const Key& key) const
+{
+    // FNV-1a over the fields, there's no padding between them.
+    uint64_t hash = 0xcbf29ce484222325ull;
+    const unsigned char* bytes = (const unsigned char*)&key;
+    for (size_t i = 0; i < sizeof(Key); i++)
+        hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+    return (size_t)hash;
+}
+
+ShapeMeshCache::ShapeMeshCache() : useCounter(0), generation(0)
+{
+}
+
+Vao* ShapeMeshCache::Get(int shapeIndex, const Shape<>& shape, const int uv[4])
+{
+    Key key{shapeIndex,
+        {(int)shape.type, shape.vertexCount, shape.vertexCount2, shape.length, shape.length2,
+         shape.radius, shape.dRadius, shape.width, shape.dz},
+        {uv[0], uv[1], uv[2], uv[3]}};
+
+    auto found = meshes.find(key);
+    if (found != meshes.end()) {
+        found->second.lastUse = ++useCounter;
+        return found->second.vao.get();
+    }
+
+    TessellateShape(shape, uv, scratch);
+    if (scratch.empty())
+        return nullptr;
+
+    if (meshes.size() >= maxMeshes) {
+        auto oldest = meshes.begin();
+        for (auto it = meshes.begin(); it != meshes.end(); ++it) {
+            if (it->second.lastUse < oldest->second.lastUse)
+                oldest = it;
+        }
+        meshes.erase(oldest);
+        ++generation;
+    }
+
+    // Prepare keeps the pointer until Load copies it into the buffer.
+    Entry& entry = meshes[key];
+    entry.vao.reset(new Vao(Vao::F3F4, GL_STATIC_DRAW));
+    entry.vao->Prepare(scratch.size() * sizeof(float), scratch.data());
+    entry.vao->Load();
+    entry.lastUse = ++useCounter;
+    return entry.vao.get();
+}
+
+void ShapeMeshCache::Invalidate(int shapeIndex)
+{
+    for (auto it = meshes.begin(); it != meshes.end();) {
+        if (it->first.shapeIndex == shapeIndex) {
+            it = meshes.erase(it);
+            ++generation;
+        }
+        else
+            ++it;
+    }
+}
+
+void ShapeMeshCache::Clear()
+{
+    meshes.clear();
+    ++generation;
+}
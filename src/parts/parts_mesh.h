@@ -0,0 +1,56 @@
+#ifndef PARTS_MESH_H_GUARD
+#define PARTS_MESH_H_GUARD
+
+#include "parts_shape.h"
+#include "../vao.h"
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+// Vertices (x,y,z,s,t,p,q) of a RING, ARC, SPHERE or CONE shape with a
+// cutout's UV rectangle (L, T, W, H) mapped over it. Nothing for planes.
+void TessellateShape(const Shape<> &shape, const int uv[4], std::vector<float> &out);
+
+// Tessellated shapes kept in static vertex buffers, so drawing a part only
+// needs its transform. Keyed by shape index plus everything the vertices
+// are made from; the shape pane invalidates a shape when it's edited.
+class ShapeMeshCache {
+public:
+    ShapeMeshCache();
+
+    // Built the first time a shape is drawn with this cutout. Returns
+    // nullptr for shapes without vertices.
+    Vao* Get(int shapeIndex, const Shape<>& shape, const int uv[4]);
+    void Invalidate(int shapeIndex);
+    void Clear();
+
+    // Changes whenever a mesh is dropped, anything holding Vao pointers
+    // from Get() has to fetch them again.
+    uint64_t Generation() const { return generation; }
+
+private:
+    // Meshes not drawn for a while go when there are more than this.
+    static constexpr size_t maxMeshes = 256;
+
+    struct Key {
+        int shapeIndex;
+        int params[9];
+        int uv[4];
+        bool operator==(const Key& other) const;
+    };
+    struct KeyHash {
+        size_t operator()(const Key& key) const;
+    };
+    struct Entry {
+        std::unique_ptr<Vao> vao;
+        uint64_t lastUse;
+    };
+
+    std::unordered_map<Key, Entry, KeyHash> meshes;
+    std::vector<float> scratch;
+    uint64_t useCounter;
+    uint64_t generation;
+};
+
+#endif // PARTS_MESH_H_GUARD
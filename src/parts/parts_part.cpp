@@ -117,7 +117,7 @@ unsigned int* CutOut<>::PpLoad(unsigned int* data, const unsigned int* data_end,
 }
 
 template<>
-void CutOut<>::Save(std::ofstream &file, const CutOut *cutOut)
+void CutOut<>::Save(std::ostream &file, const CutOut *cutOut)
 {
     if(!cutOut->name.empty()) {
         file.write("PPNA", 4);
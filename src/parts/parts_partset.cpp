@@ -41,6 +41,7 @@ unsigned int* PartSet<>::P_Load(unsigned int* data, const unsigned int* data_end
             }
 
             data = PartSet<>::PrLoad(data, data_end, id, propId, partSet);
+            partSet->Invalidate();
         }
         else if (!memcmp(buf, "P_ED", 4)) {
             // PartSet end
@@ -211,7 +212,7 @@ void PartSet<std::allocator>::CopyPropertyTo(PartProperty *propDst, PartProperty
 }
 
 template<>
-void PartSet<>::Save(std::ofstream &file, const PartSet *partSet)
+void PartSet<>::Save(std::ostream &file, const PartSet *partSet)
 {
     if(!partSet->name.empty()) {
         file.write("PANA", 4);
@@ -332,6 +333,7 @@ void PartSet<>::CopyPartSetTo(PartSet *partSet)
 {
     partSet->name = name;
     partSet->groups.clear();
+    partSet->Invalidate();
     for(size_t i = 0; i < groups.size(); ++i){
         auto prop = &partSet->groups.emplace_back();
         auto srcProp = &groups[i];
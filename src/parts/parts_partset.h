@@ -2,6 +2,7 @@
 #define PARTS_PARTSET_H_GUARD
 
 #include <vector>
+#include <algorithm>
 #include <functional>
 #include <glm/mat4x4.hpp>
 #include <string>
@@ -39,13 +40,68 @@ public:
     static unsigned int* PrLoad(unsigned int* data, const unsigned int* data_end, int groupId, int propId, PartSet<>* partSet);
 
     // Saving
-    static void Save(std::ofstream &file, const PartSet *partSet);
+    static void Save(std::ostream &file, const PartSet *partSet);
     static bool IsModifiedData(const PartSet *partSet);
     static bool IsModifiedPropData(const PartProperty *prop);
 
     // Utilities
     static void CopyPropertyTo(PartProperty *propDst, PartProperty *propSrc);
     void CopyPartSetTo(PartSet *partSet);
+
+    // Indices into groups in drawing order (higher priority first).
+    const std::vector<int>& DrawOrder()
+    {
+        if (!tablesValid)
+            BuildTables();
+        return drawOrder;
+    }
+
+    // Property with this propId and the highest priority, the last one listed
+    // among equal priorities. nullptr if none.
+    const PartProperty* FindProp(int propId)
+    {
+        if (!tablesValid)
+            BuildTables();
+        if (propId < 0 || propId >= (int)propIndex.size() || propIndex[propId] < 0)
+            return nullptr;
+        return &groups[propIndex[propId]];
+    }
+
+    // Call after adding, removing or reordering groups, or after changing a
+    // priority or propId.
+    void Invalidate() { tablesValid = false; }
+
+private:
+    std::vector<int> drawOrder;
+    std::vector<int> propIndex; // propId -> index in groups, -1 if unused
+    bool tablesValid = false;
+
+    void BuildTables()
+    {
+        drawOrder.resize(groups.size());
+        for (size_t i = 0; i < groups.size(); i++)
+            drawOrder[i] = i;
+        // Same order Parts::Draw always used: higher priority first, equal
+        // priorities in the order they are listed.
+        std::stable_sort(drawOrder.rbegin(), drawOrder.rend(),
+            [this](int a, int b) {
+                return groups[a].priority < groups[b].priority;
+        });
+
+        propIndex.clear();
+        for (int i : drawOrder) {
+            int propId = groups[i].propId;
+            if (propId < 0)
+                continue;
+            if (propId >= (int)propIndex.size())
+                propIndex.resize(propId + 1, -1);
+            // Interpolation always matched the highest priority property with
+            // this propId, and the last one listed among equal priorities.
+            if (propIndex[propId] < 0 || groups[propIndex[propId]].priority == groups[i].priority)
+                propIndex[propId] = i;
+        }
+        tablesValid = true;
+    }
 };
 
 #endif // PARTS_PARTSET_H_GUARD
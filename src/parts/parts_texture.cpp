@@ -1,37 +1,48 @@
 #include "parts_texture.h"
-#include "../texture.h"
-#include <glad/glad.h>
+#include "parts_codec.h"
+#include "parts_image.h"
+#include "../bc.h"
+#include "../png.h"
+#include "../tga.h"
+#include <cctype>
 #include <cstring>
 #include <cassert>
 #include <algorithm>
+#include <chrono>
 #include <iostream>
 
 template<>
 bool PartGfx<>::Decrappress(unsigned char* cdata, unsigned char* outData, size_t csize, size_t outSize)
 {
-    // Custom RLE-like decompression
-    // Format: If byte is 0, next two bytes are: value, count
-    // Otherwise: byte is literal value
-    size_t wi = 0;
-    for (size_t i = 0; i < csize; ++i)
-    {
-        if (wi > outSize)
-            return false;
-
-        if (cdata[i] == 0)
-        {
-            ++i;
-            // cdata[i] = value, cdata[i+1] = count
-            for (size_t j = 0; j < cdata[i + 1]; ++j)
-                outData[wi++] = cdata[i];
-            i += 1;
-        }
-        else
-        {
-            outData[wi++] = cdata[i];
-        }
-    }
+    return PatRleDecode(cdata, csize, outData, outSize);
+}
 
+template<>
+char* PartGfx<>::Unpack(const unsigned char* packed, int packedSize, int imageSize, char header[124])
+{
+    std::vector<unsigned char> out(imageSize + 128);
+    if (!Decrappress((unsigned char*)packed, out.data(), packedSize, out.size()))
+        return nullptr;
+    memcpy(header, out.data() + 4, 124);
+    char* imageData = new char[imageSize];
+    memcpy(imageData, out.data() + 128, imageSize);
+    return imageData;
+}
+
+template<>
+bool PartGfx<>::EnsureDecoded()
+{
+    if (!packed)
+        return true;
+    char* decoded = Unpack(packed, packedSize, imageSize, ddsHeader);
+    packed = nullptr;
+    if (!decoded) {
+        printf("[PartGfx] Texture %d has broken compressed data\n", id);
+        imageSize = 0;
+        return false;
+    }
+    imageData = decoded;
+    s3tc = (unsigned char*)imageData;
     return true;
 }
 
@@ -130,7 +141,8 @@ unsigned int* PartGfx<>::PgLoad(unsigned int *data, const unsigned int *data_end
                 auto movepos = tex.w * tex.h + 0x20;
                 data += movepos;
             }
-            // Handle compressed data
+            // Handle compressed data. Decoded when it's first drawn, see
+            // Parts::TextureFor, or when something needs the pixels.
             else
             {
                 tex.noCompress = false;
@@ -139,19 +151,9 @@ unsigned int* PartGfx<>::PgLoad(unsigned int *data, const unsigned int *data_end
                 data += 6;
 
                 unsigned char* cData = (unsigned char*)data;
-                auto oData = new unsigned char[oSize];
-                bool result = Decrappress(cData, oData, cSize, oSize);
-                assert(result && "Decompression failed");
-
-                char* header = new char[124];
+                tex.packed = cData;
+                tex.packedSize = cSize;
                 tex.imageSize = oSize - 128;
-                tex.imageData = new char[tex.imageSize];
-                std::copy(oData + 4, oData + 128, header);
-                std::memcpy(tex.ddsHeader, header, 124);
-                tex.s3tc = (unsigned char*)(oData + 128);
-                std::copy(oData + 128, oData + tex.imageSize + 128, tex.imageData);
-
-                delete[] header;
 
                 cData += cSize;
                 data = (unsigned int*)cData;
@@ -193,19 +195,95 @@ PartGfx<>* GetTexture(unsigned int n, std::vector<PartGfx<>>* gfxMeta)
 }
 
 template<>
-Texture* PartGfx<>::GetTextureFromId(std::vector<Texture*> textures)
+std::string PartGfx<>::EncodeImage(const char *filename, bool png, bool dxt1, int quality)
 {
-    for (auto tex : textures) {
-        if (textureIndex == tex->id)
-            return tex;
+    std::vector<unsigned char> rgba;
+    int srcW, srcH;
+    if (!(png ? Png::Read(filename, rgba, srcW, srcH) : Tga::Read(filename, rgba, srcW, srcH)))
+        return png ? "Unable to read the PNG (interlaced ones aren't supported)" : "Unable to read the TGA";
+
+    // PAT textures come in steps of 256, the image goes top left and the
+    // rest stays transparent so UVs in pixels still match.
+    int padW = (srcW + 255) / 256 * 256;
+    int padH = (srcH + 255) / 256 * 256;
+    std::vector<unsigned char> padded((size_t)padW * padH * 4, 0);
+    for (int y = 0; y < srcH; ++y)
+        memcpy(&padded[(size_t)y * padW * 4], &rgba[(size_t)y * srcW * 4], (size_t)srcW * 4);
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<unsigned char> blocks;
+    Bc::Encode(blocks, padded.data(), padW, padH, !dxt1, quality);
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    printf("[IMAGE IMPORT] %dx%d padded to %dx%d, DXT%d quality %d in %.1f ms\n",
+        srcW, srcH, padW, padH, dxt1 ? 1 : 5, quality, ms);
+
+    if (name.empty()) {
+        std::string path = filename;
+        name = path.substr(path.find_last_of("/\\") + 1);
     }
-    return nullptr;
+    w = padW;
+    h = padH;
+    uvBpp[0] = w / 256;
+    uvBpp[1] = h / 256;
+    pgte[0] = w;
+    pgte[1] = h;
+    type = dxt1 ? 1 : 5;
+
+    // Same header an exporter would write: one level, linear size
+    DDS_HEADER header{};
+    header.size = 124;
+    header.flags = 0x1 | 0x2 | 0x4 | 0x1000 | 0x80000; // CAPS, HEIGHT, WIDTH, PIXELFORMAT, LINEARSIZE
+    header.height = h;
+    header.width = w;
+    header.pitchOrLinearSize = blocks.size();
+    header.ddspf.size = 32;
+    header.ddspf.flags = 0x4; // FOURCC
+    memcpy(&header.ddspf.fourCC, dxt1 ? "DXT1" : "DXT5", 4);
+    header.caps = 0x1000; // TEXTURE
+    static_assert(sizeof(header) == sizeof(ddsHeader), "DDS header is 124 bytes");
+    memcpy(ddsHeader, &header, sizeof(ddsHeader));
+
+    packed = nullptr;  // Anything still being decoded is stale now
+    imageSize = blocks.size();
+    imageData = new char[imageSize];
+    memcpy(imageData, blocks.data(), imageSize);
+    s3tc = (unsigned char*)imageData;
+    return "";
+}
+
+template<>
+PartTextureArrays::Format PartGfx<>::ArrayFormat() const
+{
+    // Uncompressed BGRA: type 21, or PGTX data from MBAA
+    if ((s3tc || packed) && type != 21)
+        return type == 1 ? PartTextureArrays::DXT1 : PartTextureArrays::DXT5;
+    return PartTextureArrays::BGRA;
+}
+
+template<>
+const void* PartGfx<>::Pixels() const
+{
+    if (packed)
+        return nullptr;
+    if (s3tc)
+        return s3tc;
+    return imageData ? imageData : data;
 }
 
 template<>
-std::string PartGfx<>::ImportTexture(const char *filename, std::vector<Texture*> textures)
+std::string PartGfx<>::ImportTexture(const char *filename, bool dxt1, int quality)
 {
     std::string path = filename;
+    std::string extension = path.substr(std::min(path.size(), path.find_last_of('.')));
+    for (auto& c : extension)
+        c = tolower(c);
+    if (extension == ".png" || extension == ".tga") {
+        std::string message = EncodeImage(filename, extension == ".png", dxt1, quality);
+        if (message.empty())
+            uploaded = false;
+        return message;
+    }
+
     char* data;
     unsigned int size;
 
@@ -259,66 +337,46 @@ std::string PartGfx<>::ImportTexture(const char *filename, std::vector<Texture*>
     // Copy image data
     data += 128;
     s3tc = (unsigned char*)data;
+    packed = nullptr;
     imageSize = size - 128;
     imageData = new char[imageSize];
     std::copy(data, data + imageSize, imageData);
 
-    // Load into OpenGL texture
-    auto texture = GetTextureFromId(textures);
-    if (!texture) {
-        texture = new Texture;
-        textures.push_back(texture);
-    }
-
-    printf("[DDS IMPORT] Loading texture: w=%d, h=%d, type=%d, s3tc=%p\n", w, h, type, s3tc);
-
-    if (s3tc)
-    {
-        if (type == 21)
-        {
-            // Uncompressed RGB/BGRA
-            printf("[DDS IMPORT] Loading uncompressed RGB/BGRA texture\n");
-            textures.back()->LoadDirect((char*)s3tc, w, h, true);  // BGRA format
-            // Default to GL_NEAREST; filtering will be applied per-part based on PRFL flag
-            textures.back()->Apply(false, false);  // repeat=false, linearFilter=false
-        }
-        else
-        {
-            // Compressed (DXT1 or DXT5)
-            size_t compressedSize;
-            if (type == 5)
-                compressedSize = w * h; // DXT5
-            else if (type == 1)
-                compressedSize = (w * h) * 3 / 6; // DXT1
-            else
-                assert(0 && "Unknown compression type");
-
-            printf("[DDS IMPORT] Loading compressed DXT%d texture, size=%zu\n", (type == 1 ? 1 : 5), compressedSize);
-            textures.back()->LoadCompressed((char*)s3tc, w, h, compressedSize, type);
-            // LoadCompressed creates texture internally, set default filtering
-            // Actual filtering will be applied per-part based on PRFL flag in DrawPart()
-            glBindTexture(GL_TEXTURE_2D, textures.back()->id);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-        }
-    }
-    else
-    {
-        printf("[DDS IMPORT] Loading fallback uncompressed texture\n");
-        textures.back()->LoadDirect(data, w, h, true);  // BGRA format
-        // Default to GL_NEAREST; filtering will be applied per-part based on PRFL flag
-        textures.back()->Apply(false, false);  // repeat=false, linearFilter=false
-    }
-
-    textureIndex = textures.back()->id;
-    printf("[DDS IMPORT] Final texture ID: %u\n", textureIndex);
-
+    uploaded = false;
+    printf("[DDS IMPORT] %dx%d type=%d\n", w, h, type);
     return ""; // Success
 }
 
+template<>
+bool PartGfx<>::DecodeRgba(std::vector<unsigned char> &rgba)
+{
+    if (!EnsureDecoded())
+        return false;
+    // PGTX from MBAA is BGRA straight from the file
+    const char* image = imageData ? imageData : data;
+    int textureType = imageData ? type : 21;
+    size_t size = imageData ? imageSize : PatImageSize(21, w, h);
+    if (!image)
+        return false;
+    return PatDecodeImage((const unsigned char*)image, size, textureType, w, h, rgba);
+}
+
 template<>
 void PartGfx<>::ExportTexture(const char *filename)
 {
+    std::string path = filename;
+    std::string extension = path.substr(std::min(path.size(), path.find_last_of('.')));
+    for (auto& c : extension)
+        c = tolower(c);
+    if (extension == ".png") {
+        std::vector<unsigned char> rgba;
+        if (!DecodeRgba(rgba) || !Png::Write(filename, rgba.data(), w, h, w * 4))
+            printf("[PartGfx] Unable to export texture %d to %s\n", id, filename);
+        return;
+    }
+
+    if (!EnsureDecoded())
+        return;
     std::ofstream file(filename, std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
     if (!file.is_open())
         return;
@@ -332,102 +390,23 @@ void PartGfx<>::ExportTexture(const char *filename)
 }
 
 template<>
-void PartGfx<>::CompressDDS(std::ofstream &file, const PartGfx *gfx, std::streampos pgt2A)
+void PartGfx<>::CompressDDS(const PartGfx *gfx, std::vector<unsigned char> &out)
 {
-    // Custom RLE-like compression
-    // Format: 0x00 <value> <count> for runs, or literal bytes
-    bool compressionActive = false;
-    char fixedVals[2] = {static_cast<char>(0), static_cast<char>(255)};
-    int count = 1;
-    int compressSize = 4;
-    char currentVal;
-    char nextVal;
-
-    file.write("DDS\x20", 4);
-
-    for (int i = 0; i < gfx->imageSize + 124; ++i)
-    {
-        if (!compressionActive) {
-            currentVal = i < 124 ? gfx->ddsHeader[i] : gfx->imageData[i - 124];
-            compressionActive = true;
-        }
-        else {
-            nextVal = i < 124 ? gfx->ddsHeader[i] : gfx->imageData[i - 124];
-
-            // Increase count if same value
-            if (currentVal == nextVal)
-            {
-                count += 1;
-                if (count > 255)
-                {
-                    // Max run length reached, write it
-                    file.write(VAL(fixedVals[0]), 1);
-                    file.write(VAL(currentVal), 1);
-                    file.write(VAL(fixedVals[1]), 1);
-                    --i;
-                    compressionActive = false;
-                    compressSize += 3;
-                    count = 1;
-                }
-            }
-            // Write repetition
-            else if (count >= 4 || currentVal == 0)
-            {
-                file.write(VAL(fixedVals[0]), 1);
-                file.write(VAL(currentVal), 1);
-                file.write(VAL(count), 1);
-                --i;
-                compressionActive = false;
-                compressSize += 3;
-                count = 1;
-            }
-            // Write values as-is (not worth compressing)
-            else
-            {
-                for (int c = 0; c < count; ++c)
-                {
-                    file.write(VAL(currentVal), 1);
-                }
-                --i;
-                compressionActive = false;
-                compressSize += count;
-                count = 1;
-            }
-        }
-    }
-
-    // Write remaining data
-    if (currentVal == 0 || count >= 4)
-    {
-        file.write(VAL(fixedVals[0]), 1);
-        file.write(VAL(currentVal), 1);
-        file.write(VAL(count), 1);
-        compressSize += 3;
-    }
-    else
-    {
-        for (int c = 0; c < count; ++c)
-        {
-            file.write(VAL(currentVal), 1);
-        }
-        compressSize += count;
-    }
-
-    // Go back and write the sizes in PGT2 header
-    auto currentPos = file.tellp();
-    file.seekp(pgt2A);
-    int otherCompress = compressSize + 16;
-    file.write(VAL(otherCompress), 4);
-    file.seekp(7 * 4, std::ios_base::cur);
-    file.write(VAL(compressSize), 4);
-    file.seekp(currentPos);
+    // The magic is stored as is, the header and image are one RLE stream.
+    std::vector<unsigned char> raw(124 + gfx->imageSize);
+    memcpy(raw.data(), gfx->ddsHeader, 124);
+    if (gfx->imageSize > 0)
+        memcpy(raw.data() + 124, gfx->imageData, gfx->imageSize);
+
+    out.clear();
+    out.reserve(raw.size() + 4);
+    out.insert(out.end(), {'D', 'D', 'S', ' '});
+    PatRleEncode(raw.data(), raw.size(), out);
 }
 
 template<>
-void PartGfx<>::Save(std::ofstream &file, const PartGfx *gfx)
+void PartGfx<>::Save(std::ostream &file, const PartGfx *gfx)
 {
-    std::streampos pointer;
-
     // Save name if present
     if (!gfx->name.empty()) {
         file.write("PGNM", 4);
@@ -456,19 +435,19 @@ void PartGfx<>::Save(std::ofstream &file, const PartGfx *gfx)
 
     if (!gfx->noCompress)
     {
-        // Save with compression
+        // Save with compression, sizes go in the header so it's encoded first
         totalSize += 128;
-        pointer = file.tellp();
-        int pgt2[9]{0,
+        std::vector<unsigned char> compressed;
+        PartGfx::CompressDDS(gfx, compressed);
+        int compressSize = compressed.size();
+        int pgt2[10]{compressSize + 16,
                     gfx->w,
                     gfx->h,
                     typeName,
                     4, 3, 17828863,
-                    0, 0};
-        file.write(PTR(&pgt2), 9 * 4);
-        file.write(VAL(totalSize), 4);
-        // CompressDDS writes both necessary sizes in PGT2
-        PartGfx::CompressDDS(file, gfx, pointer);
+                    0, compressSize, totalSize};
+        file.write(PTR(&pgt2), 10 * 4);
+        file.write(PTR(compressed.data()), compressed.size());
     }
     else
     {
@@ -498,6 +477,8 @@ bool PartGfx<>::IsModifiedData(const PartGfx *gfx)
 template<>
 void PartGfx<>::CopyTo(PartGfx *gfx)
 {
+    // The copy can outlive the file the packed data is in.
+    EnsureDecoded();
     gfx->name = name;
     gfx->w = w;
     gfx->h = h;
@@ -507,7 +488,7 @@ void PartGfx<>::CopyTo(PartGfx *gfx)
     gfx->pgte[1] = pgte[1];
     gfx->s3tc = s3tc;
     gfx->noCompress = noCompress;
-    gfx->textureIndex = textureIndex;
+    gfx->uploaded = false;  // Into the other Parts' arrays when it's drawn
     memcpy(gfx->ddsHeader, ddsHeader, 124);
     gfx->imageSize = imageSize;
     gfx->imageData = imageData;
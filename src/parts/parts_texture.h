@@ -8,7 +8,7 @@
 #include <fstream>
 #include <cstdint>
 #include "../misc.h"
-#include "../texture.h"
+#include "parts_texture_array.h"
 
 #define VAL(X) ((const char*)&X)
 #define PTR(X) ((const char*)X)
@@ -56,7 +56,7 @@ public:
     int uvBpp[2]{};                 // UV coordinates (in multiples of 256)
     int bpp = 0;                    // Bits per pixel
     int type = 0;                   // Texture type (1=DXT1, 5=DXT5, 21=RGB)
-    int textureIndex = 0;           // GL texture ID
+    bool uploaded = false;          // Has its layer in the Parts' texture arrays
     int pgte[2]{};                  // Unknown (stored as short[2])
 
     // DDS compression data
@@ -66,22 +66,40 @@ public:
     int imageSize = 0;              // Size of image data
     bool dontDelete = false;        // If true, don't delete s3tc (points to original file data)
     bool noCompress = false;        // If true, don't compress on save
+    const unsigned char* packed = nullptr;  // PGT2 data not decoded yet, in the loaded file
+    int packedSize = 0;
 
     // Loading
     static unsigned int* PgLoad(unsigned int *data, const unsigned int *data_end, int id, std::vector<PartGfx<>>* gfxMeta);
     static PartGfx<>* GetTexture(unsigned int n, std::vector<PartGfx<>>* gfxMeta);
 
     // Texture management
-    Texture* GetTextureFromId(std::vector<Texture*> textures);
-    std::string ImportTexture(const char *filename, std::vector<Texture*> textures);
+    // DDS as is; PNG and TGA are padded to steps of 256 and block compressed
+    // (dxt1 or DXT5, quality from Bc::Quality).
+    // Uploaded again the next time it's drawn.
+    std::string ImportTexture(const char *filename, bool dxt1 = false, int quality = 1);
+    std::string EncodeImage(const char *filename, bool png, bool dxt1, int quality);
+    // What the image is uploaded as, known before packed data is decoded.
+    PartTextureArrays::Format ArrayFormat() const;
+    // The image as ArrayFormat() takes it, nullptr if there's none (yet).
+    const void* Pixels() const;
+    // PNG when the name ends in .png, otherwise DDS as stored.
     void ExportTexture(const char *filename);
+    // The pixels as RGBA8, decoded on the CPU. False if there's no image.
+    bool DecodeRgba(std::vector<unsigned char> &rgba);
 
     // Compression/decompression
+    // Decoded image data (new[]) from packed PGT2 data, the DDS header goes
+    // in header. nullptr if the data is broken.
+    static char* Unpack(const unsigned char* packed, int packedSize, int imageSize, char header[124]);
+    // Decodes packed data now if it's still there. Anything that reads
+    // imageData or ddsHeader calls this first.
+    bool EnsureDecoded();
     static bool Decrappress(unsigned char* cdata, unsigned char* outData, size_t csize, size_t outSize);
-    static void CompressDDS(std::ofstream &file, const PartGfx *gfx, std::streampos pgt2A);
+    static void CompressDDS(const PartGfx *gfx, std::vector<unsigned char> &out);  // "DDS ", then the RLE stream
 
     // Saving
-    static void Save(std::ofstream &file, const PartGfx *gfx);
+    static void Save(std::ostream &file, const PartGfx *gfx);
     static bool IsModifiedData(const PartGfx *gfx);
 
     // Utilities
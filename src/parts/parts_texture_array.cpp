@@ -0,0 +1,137 @@
+#include "parts_texture_array.h"
+#include "../gl_ext.h"
+#include "../gl_state.h"
+
+#include <algorithm>
+
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT1_EXT 0x83F1
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
+static GLenum InternalFormat(PartTextureArrays::Format format)
+{
+    switch (format) {
+    case PartTextureArrays::DXT1: return GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;
+    case PartTextureArrays::DXT5: return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+    default: return GL_RGBA8;
+    }
+}
+
+bool PartTextureArrays::Kind::operator==(const Kind& other) const
+{
+    return w == other.w && h == other.h && format == other.format;
+}
+
+PartTextureArrays::~PartTextureArrays()
+{
+    Clear();
+}
+
+size_t PartTextureArrays::LayerSize(int w, int h, Format format)
+{
+    switch (format) {
+    case DXT1: return (size_t)w * h / 2;
+    case DXT5: return (size_t)w * h;
+    default: return (size_t)w * h * 4;
+    }
+}
+
+void PartTextureArrays::Reserve(int w, int h, Format format)
+{
+    if (w <= 0 || h <= 0)
+        return;
+    ++pools[PoolOf({w, h, format})].reserved;
+}
+
+int PartTextureArrays::PoolOf(const Kind& kind)
+{
+    for (size_t i = 0; i < pools.size(); i++) {
+        if (pools[i].kind == kind)
+            return i;
+    }
+    pools.push_back({kind, 0, {}, {}});
+    return pools.size() - 1;
+}
+
+PartTextureArrays::Layer PartTextureArrays::Allocate(Pool& pool)
+{
+    if (!pool.free.empty()) {
+        Layer layer = pool.free.back();
+        pool.free.pop_back();
+        return layer;
+    }
+    if (pool.arrays.empty() || pool.arrays.back().used == pool.arrays.back().capacity) {
+        int capacity = pool.arrays.empty() ? std::max(pool.reserved, 1) : growBy;
+        capacity = std::min(capacity, maxLayers);
+        const Kind& kind = pool.kind;
+
+        Array array{0, capacity, 0};
+        glGenTextures(1, &array.texture);
+        GlState::BindTextureArray(array.texture);
+        GlState::TexParameter(GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        GlState::TexParameter(GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        // The parts pick theirs when they're drawn (PRFL)
+        GlState::TexFilter(GL_NEAREST);
+        GlState::TexParameter(GL_TEXTURE_MAX_LEVEL, 0);
+        GlState::BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        if (kind.format == BGRA) {
+            glTexImage3D(GlExt::TEXTURE_2D_ARRAY, 0, GL_RGBA8, kind.w, kind.h, capacity, 0,
+                GL_BGRA, GL_UNSIGNED_BYTE, nullptr);
+        } else {
+            glCompressedTexImage3D(GlExt::TEXTURE_2D_ARRAY, 0, InternalFormat(kind.format), kind.w, kind.h, capacity, 0,
+                LayerSize(kind.w, kind.h, kind.format) * capacity, nullptr);
+        }
+        pool.arrays.push_back(array);
+    }
+    Array& array = pool.arrays.back();
+    return {array.texture, array.used++};
+}
+
+PartTextureArrays::Layer PartTextureArrays::Upload(int id, int w, int h, Format format, const void* pixels)
+{
+    if (w <= 0 || h <= 0 || !pixels)
+        return {0, 0};
+
+    int pool = PoolOf({w, h, format});
+    auto it = slots.find(id);
+    if (it != slots.end() && it->second.pool != pool) {
+        pools[it->second.pool].free.push_back(it->second.layer);
+        slots.erase(it);
+        it = slots.end();
+    }
+    if (it == slots.end())
+        it = slots.emplace(id, Slot{pool, Allocate(pools[pool])}).first;
+
+    Layer layer = it->second.layer;
+    GlState::BindTextureArray(layer.texture);
+    GlState::BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    if (format == BGRA) {
+        glTexSubImage3D(GlExt::TEXTURE_2D_ARRAY, 0, 0, 0, layer.layer, w, h, 1,
+            GL_BGRA, GL_UNSIGNED_BYTE, pixels);
+    } else {
+        glCompressedTexSubImage3D(GlExt::TEXTURE_2D_ARRAY, 0, 0, 0, layer.layer, w, h, 1,
+            InternalFormat(format), LayerSize(w, h, format), pixels);
+    }
+    return layer;
+}
+
+PartTextureArrays::Layer PartTextureArrays::Get(int id) const
+{
+    auto it = slots.find(id);
+    return it == slots.end() ? Layer{0, 0} : it->second.layer;
+}
+
+void PartTextureArrays::Clear()
+{
+    for (auto& pool : pools) {
+        for (auto& array : pool.arrays) {
+            GlState::ForgetTexture(array.texture);
+            glDeleteTextures(1, &array.texture);
+        }
+    }
+    pools.clear();
+    slots.clear();
+}
@@ -0,0 +1,74 @@
+#ifndef PARTS_TEXTURE_ARRAY_H_GUARD
+#define PARTS_TEXTURE_ARRAY_H_GUARD
+
+#include <cstddef>
+#include <unordered_map>
+#include <vector>
+
+// The textures of a .pat as layers of GL_TEXTURE_2D_ARRAYs, one kind of array
+// per size and format, so the parts of a pattern mostly draw without changing
+// the binding. The first array of a kind has room for every texture of that
+// kind the file has. Textures imported later go into further, smaller arrays:
+// compressed layers can't be copied over to a bigger one.
+class PartTextureArrays {
+public:
+    enum Format {
+        BGRA = 0,
+        DXT1 = 1,
+        DXT5 = 5,
+    };
+
+    struct Layer {
+        unsigned int texture;  // 0 if nothing was uploaded
+        int layer;
+    };
+
+    PartTextureArrays() = default;
+    PartTextureArrays(const PartTextureArrays&) = delete;
+    PartTextureArrays& operator=(const PartTextureArrays&) = delete;
+    ~PartTextureArrays();
+
+    // One more texture of this kind is coming. Call before the first upload.
+    void Reserve(int w, int h, Format format);
+    // Uploads the pixels of texture id, replacing what it had. It keeps its
+    // layer while it stays the same kind.
+    Layer Upload(int id, int w, int h, Format format, const void* pixels);
+    Layer Get(int id) const;
+    void Clear();
+
+    static size_t LayerSize(int w, int h, Format format);
+
+private:
+    struct Kind {
+        int w, h;
+        Format format;
+        bool operator==(const Kind& other) const;
+    };
+    struct Array {
+        unsigned int texture;
+        int capacity;
+        int used;
+    };
+    struct Pool {
+        Kind kind;
+        int reserved;
+        std::vector<Array> arrays;
+        std::vector<Layer> free;  // Left by textures that changed kind
+    };
+    struct Slot {
+        int pool;
+        Layer layer;
+    };
+
+    // Layers of every array after a kind's first, and the most in any array.
+    static constexpr int growBy = 8;
+    static constexpr int maxLayers = 256;
+
+    std::vector<Pool> pools;
+    std::unordered_map<int, Slot> slots;
+
+    int PoolOf(const Kind& kind);
+    Layer Allocate(Pool& pool);
+};
+
+#endif // PARTS_TEXTURE_ARRAY_H_GUARD
@@ -0,0 +1,152 @@
+// PAT texture codec check: finds every RLE compressed texture in the given
+// .pat files, checks PatRleDecode/PatRleEncode against the old byte by byte
+// codec and times both. Built as patcodec.exe.
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "misc.h"
+#include "parts/parts_codec.h"
+#include "parts/parts_image.h"
+
+// The codec as it was in PartGfx::Decrappress and PartGfx::CompressDDS.
+static void OldDecode(const unsigned char* cdata, unsigned char* outData, size_t csize)
+{
+	size_t wi = 0;
+	for (size_t i = 0; i < csize; ++i) {
+		if (cdata[i] == 0) {
+			++i;
+			for (size_t j = 0; j < cdata[i + 1]; ++j)
+				outData[wi++] = cdata[i];
+			i += 1;
+		}
+		else
+			outData[wi++] = cdata[i];
+	}
+}
+
+static void OldEncode(const unsigned char* in, size_t size, std::vector<unsigned char>& out)
+{
+	bool active = false;
+	int count = 1;
+	unsigned char currentVal = 0, nextVal;
+	auto run = [&](int n) { out.push_back(0); out.push_back(currentVal); out.push_back((unsigned char)n); };
+	for (int i = 0; i < (int)size; ++i) {
+		if (!active) {
+			currentVal = in[i];
+			active = true;
+		}
+		else {
+			nextVal = in[i];
+			if (currentVal == nextVal) {
+				if (++count > 255) {
+					run(255);
+					--i;
+					active = false;
+					count = 1;
+				}
+			}
+			else {
+				if (count >= 4 || currentVal == 0)
+					run(count);
+				else
+					out.insert(out.end(), count, currentVal);
+				--i;
+				active = false;
+				count = 1;
+			}
+		}
+	}
+	if (currentVal == 0 || count >= 4)
+		run(count);
+	else
+		out.insert(out.end(), count, currentVal);
+}
+
+template<class F>
+static double Time(int iterations, F f)
+{
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < iterations; ++i)
+		f();
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char** argv)
+{
+	int iterations = 10;
+	std::vector<std::string> files;
+	for (int i = 1; i < argc; ++i) {
+		if (!strcmp(argv[i], "-n") && i + 1 < argc)
+			iterations = std::max(1, atoi(argv[++i]));
+		else
+			files.push_back(argv[i]);
+	}
+	if (files.empty()) {
+		std::cerr << "usage: patcodec [-n iterations] <file.pat>...\n";
+		return 1;
+	}
+
+	int failures = 0;
+	double oldDecode = 0, newDecode = 0, oldEncode = 0, newEncode = 0;
+	size_t totalBytes = 0;
+	for (const std::string& name : files) {
+		char* data;
+		unsigned int size;
+		if (!ReadInMem(name.c_str(), data, size)) {
+			std::cerr << name << ": can't read\n";
+			++failures;
+			continue;
+		}
+		std::vector<PatTexture> textures = PatFindTextures((const unsigned char*)data, size);
+		textures.erase(std::remove_if(textures.begin(), textures.end(), [](const PatTexture& tex) { return !tex.packed; }),
+			textures.end());
+		std::cout << name << ": " << textures.size() << " compressed textures\n";
+
+		for (size_t t = 0; t < textures.size(); ++t) {
+			const PatTexture& tex = textures[t];
+			size_t oSize = tex.imageSize + 128, cSize = tex.size;
+			//The old decoder can write a run past the end.
+			std::vector<unsigned char> before(oSize + 256), after(oSize);
+			OldDecode(tex.data, before.data(), cSize);
+			bool ok = PatRleDecode(tex.data, cSize, after.data(), after.size());
+			if (!ok || memcmp(before.data(), after.data(), oSize)) {
+				std::cerr << "  texture " << t << " at " << tex.offset << ": decoded data differs\n";
+				++failures;
+				continue;
+			}
+
+			//"DDS " is stored as is, the rest is one stream.
+			std::vector<unsigned char> oldOut, newOut;
+			OldEncode(after.data() + 4, oSize - 4, oldOut);
+			PatRleEncode(after.data() + 4, oSize - 4, newOut);
+			if (oldOut != newOut) {
+				std::cerr << "  texture " << t << " at " << tex.offset << ": encoded data differs\n";
+				++failures;
+				continue;
+			}
+			bool sameAsFile = newOut.size() + 4 == cSize && !memcmp(newOut.data(), tex.data + 4, newOut.size());
+			std::cout << "  texture " << t << ": " << oSize << " -> " << cSize << " bytes, "
+				<< (sameAsFile ? "re-encodes identically" : "file was written by another encoder") << "\n";
+
+			oldDecode += Time(iterations, [&] { OldDecode(tex.data, before.data(), cSize); });
+			newDecode += Time(iterations, [&] { PatRleDecode(tex.data, cSize, after.data(), after.size()); });
+			oldEncode += Time(iterations, [&] { oldOut.clear(); OldEncode(after.data() + 4, oSize - 4, oldOut); });
+			newEncode += Time(iterations, [&] { newOut.clear(); PatRleEncode(after.data() + 4, oSize - 4, newOut); });
+			totalBytes += oSize;
+		}
+		delete[] data;
+	}
+
+	if (totalBytes) {
+		double mb = double(totalBytes) * iterations / (1024 * 1024);
+		std::cout << "\nDecode: old " << mb / oldDecode << " MB/s, new " << mb / newDecode << " MB/s\n";
+		std::cout << "Encode: old " << mb / oldEncode << " MB/s, new " << mb / newEncode << " MB/s\n";
+		std::cout << "(old encoder without the one byte file writes it used to do)\n";
+	}
+	std::cout << "\nResult: " << failures << " failures\n";
+	return failures > 0 ? 2 : 0;
+}
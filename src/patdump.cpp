@@ -0,0 +1,196 @@
+// Dumps every texture of every .pat in the given folders (and their
+// subfolders) or files to PNG, decoded on the CPU.
+// Built as patdump.exe. No GL involved, so it also runs on Linux.
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "misc.h"
+#include "png.h"
+#include "parts/parts_codec.h"
+#include "parts/parts_image.h"
+
+namespace fs = std::filesystem;
+
+struct Job
+{
+	size_t file;     //In the list of .pat files.
+	PatTexture texture;
+	fs::path out;
+};
+
+static void Usage()
+{
+	printf("Usage: patdump [options] <folder | file.pat>...\n"
+		"  -o <dir>      Output folder (default: current folder)\n"
+		"  -j <count>    Worker threads (default: all cores)\n"
+		"Textures go to <dir>/<pat path without extension>/<id>_<name>.png\n"
+		"Folders that are already taken get _2, _3 and so on.\n");
+}
+
+//Texture names are Shift-JIS and can be anything.
+static std::string FileName(const PatTexture &texture)
+{
+	std::string name = sj2utf8(texture.name);
+	for(auto &c : name)
+	{
+		if((unsigned char)c < 32 || strchr("/\\:*?\"<>|", c))
+			c = '_';
+	}
+	//Names of imported textures keep their extension.
+	if(name.size() > 4)
+	{
+		std::string tail = name.substr(name.size() - 4);
+		for(auto &c : tail)
+			c = tolower(c);
+		if(tail == ".dds" || tail == ".png" || tail == ".tga")
+			name.resize(name.size() - 4);
+	}
+	std::string out = std::to_string(texture.id);
+	if(!name.empty())
+		out += "_" + name;
+	return out + ".png";
+}
+
+static bool Dump(const Job &job)
+{
+	const PatTexture &tex = job.texture;
+	std::vector<unsigned char> unpacked;
+	const unsigned char *image = tex.data;
+	if(tex.packed)
+	{
+		//"DDS " and the header come first.
+		unpacked.resize(tex.imageSize + 128);
+		if(!PatRleDecode(tex.data, tex.size, unpacked.data(), unpacked.size()))
+			return false;
+		image = unpacked.data() + 128;
+	}
+
+	//One texture per thread already, so decode it on this one.
+	std::vector<unsigned char> rgba;
+	if(!PatDecodeImage(image, tex.imageSize, tex.type, tex.w, tex.h, rgba, 1))
+		return false;
+	return Png::Write(job.out.string().c_str(), rgba.data(), tex.w, tex.h, tex.w * 4);
+}
+
+int main(int argc, char **argv)
+{
+	fs::path outDir = ".";
+	int threadCount = std::thread::hardware_concurrency();
+	std::vector<fs::path> args;
+
+	for(int i = 1; i < argc; ++i)
+	{
+		bool hasValue = i + 1 < argc;
+		if(!strcmp(argv[i], "-o") && hasValue)
+			outDir = argv[++i];
+		else if(!strcmp(argv[i], "-j") && hasValue)
+			threadCount = atoi(argv[++i]);
+		else if(argv[i][0] == '-')
+		{
+			Usage();
+			return 1;
+		}
+		else
+			args.push_back(argv[i]);
+	}
+	if(args.empty())
+	{
+		Usage();
+		return 1;
+	}
+	if(threadCount < 1)
+		threadCount = 1;
+
+	//Each .pat with the path its textures go under.
+	std::vector<std::pair<fs::path, fs::path>> pats;
+	int failures = 0;
+	for(const fs::path &arg : args)
+	{
+		std::error_code ec;
+		if(fs::is_directory(arg, ec))
+		{
+			for(fs::recursive_directory_iterator it(arg, ec), end; !ec && it != end; it.increment(ec))
+			{
+				std::string extension = it->path().extension().string();
+				for(auto &c : extension)
+					c = tolower(c);
+				if(extension == ".pat" && it->is_regular_file(ec))
+					pats.push_back({it->path(), fs::relative(it->path(), arg, ec).replace_extension()});
+			}
+		}
+		else if(fs::is_regular_file(arg, ec))
+			pats.push_back({arg, arg.stem()});
+		else
+		{
+			printf("%s: not found\n", arg.string().c_str());
+			++failures;
+		}
+	}
+	std::sort(pats.begin(), pats.end());
+	MakeOutputPathsUnique(pats);
+
+	auto start = std::chrono::steady_clock::now();
+	std::vector<MappedFile> files(pats.size());
+	std::vector<Job> jobs;
+	for(size_t i = 0; i < pats.size(); ++i)
+	{
+		const fs::path &pat = pats[i].first;
+		if(!files[i].Open(pat.string().c_str()))
+		{
+			printf("%s: can't read\n", pat.string().c_str());
+			++failures;
+			continue;
+		}
+		auto textures = PatFindTextures((const unsigned char*)files[i].Data(), files[i].Size());
+		printf("%s: %zu textures\n", pat.string().c_str(), textures.size());
+		if(textures.empty())
+			continue;
+
+		fs::path dir = outDir / pats[i].second;
+		std::error_code ec;
+		fs::create_directories(dir, ec);
+		for(const PatTexture &texture : textures)
+			jobs.push_back({i, texture, dir / fs::u8path(FileName(texture))});
+	}
+
+	std::atomic<size_t> next(0);
+	std::atomic<int> failed(0);
+	std::atomic<size_t> pixels(0);
+	std::mutex printMutex;
+	auto worker = [&]() {
+		size_t i;
+		while((i = next++) < jobs.size())
+		{
+			const Job &job = jobs[i];
+			if(Dump(job))
+			{
+				pixels += (size_t)job.texture.w * job.texture.h;
+				continue;
+			}
+			++failed;
+			std::lock_guard<std::mutex> lock(printMutex);
+			printf("%s: texture %d (%dx%d, type %d) at %zu failed\n", pats[job.file].first.string().c_str(),
+				job.texture.id, job.texture.w, job.texture.h, job.texture.type, job.texture.offset);
+		}
+	};
+	std::vector<std::thread> threads;
+	for(int i = 0; i < std::min<int>(threadCount, (int)jobs.size()); ++i)
+		threads.emplace_back(worker);
+	for(auto &thread : threads)
+		thread.join();
+	failures += failed;
+
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	printf("\n%zu files, %zu textures (%.1f Mpixels) in %.2f s, %d failures\n",
+		pats.size(), jobs.size() - failed, pixels / 1e6, seconds, failures);
+	return failures > 0 ? 2 : 0;
+}
@@ -0,0 +1,87 @@
+#include "pixel_pool.h"
+
+#include <mutex>
+#include <vector>
+
+namespace PixelPool
+{
+	//4 KB up to 64 MB. Anything bigger goes straight to the heap.
+	constexpr int minClass = 12;
+	constexpr int maxClass = 26;
+	constexpr int classCount = maxClass - minClass + 1;
+	//Keeps a burst of huge sprites from pinning memory forever.
+	constexpr size_t maxPooledBytes = 128u << 20;
+
+	static std::mutex mutex;
+	static std::vector<unsigned char*> freeLists[classCount];
+	static Stats stats;
+
+	static int SizeClass(size_t size)
+	{
+		int c = minClass;
+		while(c <= maxClass && ((size_t)1 << c) < size)
+			++c;
+		return c;
+	}
+
+	unsigned char *Acquire(size_t size, size_t &capacity)
+	{
+		int c = SizeClass(size);
+		std::lock_guard<std::mutex> lock(mutex);
+		++stats.acquires;
+		if(c > maxClass)
+		{
+			++stats.allocations;
+			capacity = size;
+			return new unsigned char[size];
+		}
+
+		capacity = (size_t)1 << c;
+		auto &list = freeLists[c - minClass];
+		if(!list.empty())
+		{
+			unsigned char *buffer = list.back();
+			list.pop_back();
+			stats.pooledBytes -= capacity;
+			return buffer;
+		}
+
+		++stats.allocations;
+		return new unsigned char[capacity];
+	}
+
+	void Release(unsigned char *buffer, size_t capacity)
+	{
+		if(!buffer)
+			return;
+
+		int c = SizeClass(capacity);
+		std::lock_guard<std::mutex> lock(mutex);
+		++stats.releases;
+		if(c > maxClass || ((size_t)1 << c) != capacity || stats.pooledBytes + capacity > maxPooledBytes)
+		{
+			delete[] buffer;
+			return;
+		}
+		freeLists[c - minClass].push_back(buffer);
+		stats.pooledBytes += capacity;
+	}
+
+	void Trim()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		for(auto &list : freeLists)
+		{
+			for(unsigned char *buffer : list)
+				delete[] buffer;
+			list.clear();
+		}
+		stats.pooledBytes = 0;
+	}
+
+	Stats GetStats()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return stats;
+	}
+}
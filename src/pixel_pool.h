@@ -0,0 +1,29 @@
+#ifndef PIXEL_POOL_H_GUARD
+#define PIXEL_POOL_H_GUARD
+
+#include <cstddef>
+#include <cstdint>
+
+// Recycles decode buffers by power-of-two size class so scrubbing through
+// sprites doesn't allocate (or fragment the heap) on every decode.
+// Buffers are handed out uninitialized. Thread safe.
+namespace PixelPool
+{
+	struct Stats
+	{
+		uint64_t acquires;
+		uint64_t allocations; //Acquires the pool couldn't serve from a free list.
+		uint64_t releases;
+		size_t pooledBytes;   //Currently sitting in free lists.
+	};
+
+	//capacity receives the real size of the buffer, pass it back to Release.
+	unsigned char *Acquire(size_t size, size_t &capacity);
+	void Release(unsigned char *buffer, size_t capacity);
+
+	//Frees everything in the free lists.
+	void Trim();
+	Stats GetStats();
+}
+
+#endif /* PIXEL_POOL_H_GUARD */
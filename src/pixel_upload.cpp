@@ -0,0 +1,199 @@
+#include "pixel_upload.h"
+#include "cg.h"
+#include "gl_ext.h"
+#include "gl_state.h"
+
+#include <cstring>
+
+namespace PixelUpload
+{
+	//Enough that a buffer is rarely reused while its last transfer is in flight.
+	constexpr int ringSize = 4;
+	//Whole atlas pages on a repack go straight from client memory, rare
+	//enough that the driver's copy doesn't matter and the ring stays small.
+	constexpr size_t maxRingBuffer = 4*1024*1024;
+	//Decode workers and the results waiting for the UI thread.
+	constexpr int stagingCount = 8;
+
+	struct Buffer
+	{
+		GLuint id;
+		size_t size;
+		GLsync fence; //After the last upload that read it.
+		unsigned char *mapped; //Staging buffers only.
+	};
+
+	static Buffer ring[ringSize];
+	static Buffer staging[stagingCount];
+	static int next;
+	static Stats stats;
+
+	//True once the GPU is done with the last upload from buffer.
+	static bool Idle(Buffer &buffer)
+	{
+		if(!buffer.fence)
+			return true;
+		if(GlExt::ClientWaitSync(buffer.fence, GlExt::SYNC_FLUSH_COMMANDS_BIT, 0) == GlExt::TIMEOUT_EXPIRED)
+			return false;
+		GlExt::DeleteSync(buffer.fence);
+		buffer.fence = nullptr;
+		return true;
+	}
+
+	//Reads from the bound, unmapped buffer and fences it.
+	static void Upload(Buffer &buffer, int x, int y, int width, int height, GLenum format)
+	{
+		glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, width, height, format, GL_UNSIGNED_BYTE, nullptr);
+		buffer.fence = GlExt::FenceSync(GlExt::SYNC_GPU_COMMANDS_COMPLETE, 0);
+		//Everything else passes client pointers, don't leave the buffer bound.
+		GlState::BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	}
+
+	static Buffer *FindStaging(const void *pixels)
+	{
+		if(!pixels)
+			return nullptr;
+		for(auto &buffer : staging)
+			if(buffer.mapped == pixels)
+				return &buffer;
+		return nullptr;
+	}
+
+	void SubImage(int x, int y, int width, int height, GLenum format, const void *pixels)
+	{
+		if(!pixels || width <= 0 || height <= 0)
+			return;
+
+		size_t size = (size_t)width * height * 4;
+		++stats.uploads;
+		stats.bytes += size;
+
+		if(Buffer *buffer = FindStaging(pixels))
+		{
+			GlState::BindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer->id);
+			buffer->mapped = nullptr;
+			if(glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER))
+			{
+				++stats.staged;
+				Upload(*buffer, x, y, width, height, format);
+				return;
+			}
+			//The store got lost (a display mode change can do that) and the
+			//worker's copy with it. The sprite stays blank until it's evicted.
+			GlState::BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+			return;
+		}
+
+		Buffer &buffer = ring[next];
+		next = (next + 1) % ringSize;
+		//Still being read: the driver's copy of client memory beats waiting.
+		if(size <= maxRingBuffer && Idle(buffer))
+		{
+			if(!buffer.id)
+				glGenBuffers(1, &buffer.id);
+			GlState::BindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer.id);
+			//Grows a few times, then the same storage is reused.
+			if(buffer.size < size)
+			{
+				buffer.size = size;
+				glBufferData(GL_PIXEL_UNPACK_BUFFER, size, nullptr, GL_STREAM_DRAW);
+			}
+			//The fence has passed, nothing reads the storage anymore.
+			void *mapped = GlExt::MapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size,
+				GlExt::MAP_WRITE_BIT | GlExt::MAP_INVALIDATE_RANGE_BIT | GlExt::MAP_UNSYNCHRONIZED_BIT);
+			if(mapped)
+			{
+				memcpy(mapped, pixels, size);
+				if(glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER))
+				{
+					Upload(buffer, x, y, width, height, format);
+					return;
+				}
+			}
+			GlState::BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		}
+
+		++stats.direct;
+		glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, width, height, format, GL_UNSIGNED_BYTE, pixels);
+	}
+
+	unsigned char *MapStaging()
+	{
+		for(auto &buffer : staging)
+		{
+			if(buffer.mapped || !Idle(buffer))
+				continue;
+			if(!buffer.id)
+			{
+				glGenBuffers(1, &buffer.id);
+				GlState::BindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer.id);
+				buffer.size = stagingSize;
+				glBufferData(GL_PIXEL_UNPACK_BUFFER, stagingSize, nullptr, GL_STREAM_DRAW);
+			}
+			else
+				GlState::BindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer.id);
+			//Stays mapped while unbound, the workers write into it from there.
+			buffer.mapped = (unsigned char*)GlExt::MapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, stagingSize,
+				GlExt::MAP_WRITE_BIT | GlExt::MAP_INVALIDATE_RANGE_BIT | GlExt::MAP_UNSYNCHRONIZED_BIT);
+			GlState::BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+			return buffer.mapped;
+		}
+		return nullptr;
+	}
+
+	void Unmap(const void *pixels)
+	{
+		Buffer *buffer = FindStaging(pixels);
+		if(!buffer)
+			return;
+		GlState::BindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer->id);
+		glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+		GlState::BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		buffer->mapped = nullptr;
+	}
+
+	void Unstage(ImageData &image, bool keep)
+	{
+		if(!image.staged)
+			return;
+		unsigned char *copy = nullptr;
+		size_t capacity = 0;
+		//Already uploaded if the buffer isn't mapped anymore.
+		if(keep && FindStaging(image.pixels))
+		{
+			size_t size = (size_t)image.width * image.height * 4;
+			copy = PixelPool::Acquire(size, capacity);
+			memcpy(copy, image.pixels, size);
+		}
+		Unmap(image.pixels);
+		image.pixels = copy;
+		image.capacity = capacity;
+		image.staged = false;
+	}
+
+	static void Delete(Buffer &buffer)
+	{
+		if(buffer.fence)
+			GlExt::DeleteSync(buffer.fence);
+		//Deleting a mapped buffer unmaps it.
+		if(buffer.id)
+		{
+			GlState::ForgetBuffer(buffer.id);
+			glDeleteBuffers(1, &buffer.id);
+		}
+		buffer = {};
+	}
+
+	void Release()
+	{
+		for(auto &buffer : ring)
+			Delete(buffer);
+		for(auto &buffer : staging)
+			Delete(buffer);
+	}
+
+	Stats GetStats()
+	{
+		return stats;
+	}
+}
@@ -0,0 +1,52 @@
+#ifndef PIXEL_UPLOAD_H_GUARD
+#define PIXEL_UPLOAD_H_GUARD
+
+#include <cstddef>
+#include <cstdint>
+#include <glad/glad.h>
+
+struct ImageData;
+
+// Streams texel uploads through pixel unpack buffers.
+// SubImage copies into a small ring; each buffer is fenced after the
+// glTexSubImage2D that reads it and only written again once the fence has
+// passed, so the call returns without the driver copying out of our memory
+// first and the transfer overlaps with the rest of the frame.
+// Staging buffers are mapped ahead of time and handed to the decode workers,
+// which write sprites straight into them; uploading one is then only an
+// unmap on this thread.
+namespace PixelUpload
+{
+	struct Stats
+	{
+		uint64_t uploads;
+		uint64_t bytes;
+		uint64_t direct; //Uploads that fell back to client memory.
+		uint64_t staged; //Uploads the workers wrote into the buffer themselves.
+	};
+
+	//What a staging buffer holds, a 512x512 sprite.
+	constexpr size_t stagingSize = 512*512*4;
+
+	//Same as glTexSubImage2D on the texture bound to the active unit.
+	//pixels can be freed as soon as this returns. If they're in a staging
+	//buffer, the upload reads from it and the buffer is free again.
+	void SubImage(int x, int y, int width, int height, GLenum format, const void *pixels);
+
+	//Maps a free staging buffer of stagingSize bytes for any thread to write.
+	//nullptr if every one is handed out or the GPU still reads it.
+	unsigned char *MapStaging();
+	//Hands a staging buffer back without uploading it. Does nothing if
+	//pixels isn't a mapped one.
+	void Unmap(const void *pixels);
+	//Gives an image decoded into a staging buffer its own copy of the
+	//pixels when keep is set, and hands the buffer back either way.
+	void Unstage(ImageData &image, bool keep);
+
+	//Deletes the buffers. Call while the context is still current and no
+	//thread writes into a staging buffer anymore.
+	void Release();
+	Stats GetStats();
+}
+
+#endif /* PIXEL_UPLOAD_H_GUARD */
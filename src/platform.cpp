@@ -0,0 +1,126 @@
+#include "platform.h"
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <condition_variable>
+#endif
+
+namespace Platform
+{
+	static std::atomic<bool> wakeup(false);
+
+	double Now()
+	{
+		using namespace std::chrono;
+		return duration<double>(steady_clock::now().time_since_epoch()).count();
+	}
+
+	bool TakeWakeup()
+	{
+		return wakeup.exchange(false);
+	}
+
+#ifdef _WIN32
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x2
+#endif
+
+	static HANDLE wakeEvent;
+	static HANDLE timer;
+	static bool preciseTimer;
+	static std::once_flag initOnce;
+
+	void Init()
+	{
+		//A worker's Wake can come before the main thread's first wait.
+		std::call_once(initOnce, []{
+			wakeEvent = CreateEventW(nullptr, FALSE, FALSE, nullptr);
+			//Windows 10 1803 and later. Older timers tick every 15.6 ms.
+			timer = CreateWaitableTimerExW(nullptr, nullptr, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+			preciseTimer = timer != nullptr;
+			if(!timer)
+				timer = CreateWaitableTimerW(nullptr, FALSE, nullptr);
+		});
+	}
+
+	void WaitUntil(double deadline)
+	{
+		Init();
+		//A coarse timer wakes us a bit early and we yield for the rest.
+		constexpr double coarseMargin = 0.002;
+
+		DWORD count = 1;
+		HANDLE handles[2] = {wakeEvent, timer};
+		if(deadline >= 0)
+		{
+			double wait = deadline - Now() - (preciseTimer ? 0 : coarseMargin);
+			if(wait <= 0)
+			{
+				std::this_thread::yield();
+				return;
+			}
+			LARGE_INTEGER due;
+			due.QuadPart = -(LONGLONG)(wait * 1e7); //Relative, in 100 ns.
+			if(!SetWaitableTimer(timer, &due, 0, nullptr, nullptr, FALSE))
+			{
+				std::this_thread::yield();
+				return;
+			}
+			count = 2;
+		}
+
+		DWORD result = MsgWaitForMultipleObjectsEx(count, handles, INFINITE, QS_ALLINPUT, MWMO_INPUTAVAILABLE);
+		if(count == 2)
+			CancelWaitableTimer(timer);
+
+		if(result == WAIT_OBJECT_0 + 1 && !preciseTimer)
+		{
+			while(Now() < deadline && !wakeup)
+				std::this_thread::yield();
+		}
+	}
+
+	void Wake()
+	{
+		Init();
+		wakeup = true;
+		SetEvent(wakeEvent);
+	}
+#else
+	//The editor is Windows only, platformcheck runs this.
+	static std::mutex mutex;
+	static std::condition_variable wakeVar;
+
+	void Init()
+	{
+	}
+
+	void WaitUntil(double deadline)
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		if(deadline < 0)
+		{
+			wakeVar.wait(lock, []{ return wakeup.load(); });
+			return;
+		}
+
+		using namespace std::chrono;
+		auto until = steady_clock::time_point(duration_cast<steady_clock::duration>(duration<double>(deadline)));
+		wakeVar.wait_until(lock, until, []{ return wakeup.load(); });
+	}
+
+	void Wake()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			wakeup = true;
+		}
+		wakeVar.notify_all();
+	}
+#endif
+}
@@ -0,0 +1,26 @@
+#ifndef PLATFORM_H_GUARD
+#define PLATFORM_H_GUARD
+
+// The few OS services the main loop needs to sleep instead of spin.
+// Windows waits on the message queue and a high resolution waitable timer,
+// everything else on a condition variable fed by Wake().
+namespace Platform
+{
+	//Creates what WaitUntil and Wake use. Call it on the main thread before
+	//Wake is handed to other threads. Later calls do nothing.
+	void Init();
+
+	//Monotonic, in seconds.
+	double Now();
+
+	//Blocks until the deadline (on the Now() clock) passes, a window message
+	//arrives or Wake() is called. A negative deadline waits with no timeout.
+	void WaitUntil(double deadline);
+
+	//Ends a WaitUntil early. Safe from any thread.
+	void Wake();
+	//Whether Wake() was called since the last time this was asked.
+	bool TakeWakeup();
+}
+
+#endif /* PLATFORM_H_GUARD */
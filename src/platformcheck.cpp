@@ -0,0 +1,136 @@
+// Platform wait and wake check: timed waits, wakes from other threads, and
+// the idle FrameScheduler::Wait the main loop does. Runs the branch of
+// platform.cpp of whatever it's built on, the waitable timer and event on
+// Windows, the condition variable elsewhere. A lost wakeup would block
+// forever, so a watchdog ends the run after a while.
+// Built as platformcheck.exe.
+#include <cstdio>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <random>
+#include <thread>
+#include "platform.h"
+#include "frame_scheduler.h"
+
+//Timers may fire a little early or late, and the machine may be busy.
+static const double early = 0.001, late = 0.25;
+
+static int failures = 0;
+
+static void Check(const char *what, bool ok, double elapsed)
+{
+	if(ok)
+		printf("%s: ok (%.1f ms)\n", what, elapsed * 1000);
+	else
+	{
+		printf("%s: FAILED (%.1f ms)\n", what, elapsed * 1000);
+		++failures;
+	}
+}
+
+static double Wait(double deadline)
+{
+	double start = Platform::Now();
+	Platform::WaitUntil(deadline);
+	return Platform::Now() - start;
+}
+
+static void WakeAfter(double seconds)
+{
+	std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+	Platform::Wake();
+}
+
+int main()
+{
+	static std::atomic<bool> done(false);
+	std::thread([]{
+		std::this_thread::sleep_for(std::chrono::seconds(60));
+		if(!done)
+		{
+			printf("\nStill waiting after 60 s, a wakeup got lost\n");
+			fflush(stdout);
+			std::_Exit(2);
+		}
+	}).detach();
+
+	Platform::Init();
+	Platform::TakeWakeup();
+
+	double elapsed = Wait(Platform::Now() - 1);
+	Check("Deadline already passed", elapsed < late, elapsed);
+
+	elapsed = Wait(Platform::Now() + 0.03);
+	Check("Timed wait", elapsed >= 0.03 - early && elapsed < 0.03 + late, elapsed);
+
+	//Wake can come before the wait it's meant for.
+	Platform::Wake();
+	elapsed = Wait(Platform::Now() + 1);
+	Check("Wake before the wait", elapsed < late, elapsed);
+	bool first = Platform::TakeWakeup(), second = Platform::TakeWakeup();
+	Check("Wakeup taken once", first && !second, 0);
+
+	//Nothing left over from the wake above.
+	elapsed = Wait(Platform::Now() + 0.03);
+	Check("No stale wakeup", elapsed >= 0.03 - early && elapsed < 0.03 + late, elapsed);
+
+	std::thread worker(WakeAfter, 0.03);
+	elapsed = Wait(-1);
+	worker.join();
+	Check("Worker ends an untimed wait", elapsed >= 0.03 - early && Platform::TakeWakeup(), elapsed);
+
+	worker = std::thread(WakeAfter, 0.03);
+	elapsed = Wait(Platform::Now() + 10);
+	worker.join();
+	Check("Worker ends a timed wait", elapsed >= 0.03 - early && elapsed < 0.03 + late && Platform::TakeWakeup(), elapsed);
+
+	//The worker wakes right before, during or after the wait starts.
+	{
+		const int rounds = 2000;
+		std::atomic<int> go(0);
+		worker = std::thread([&go]{
+			std::mt19937 random(1);
+			for(int round = 1; round <= rounds; ++round)
+			{
+				while(go.load() < round)
+					std::this_thread::yield();
+				for(int spin = random() % 64; spin > 0; --spin)
+					std::this_thread::yield();
+				Platform::Wake();
+			}
+		});
+		double start = Platform::Now();
+		int lost = 0;
+		for(int round = 1; round <= rounds; ++round)
+		{
+			go = round;
+			Platform::WaitUntil(-1);
+			if(!Platform::TakeWakeup())
+				++lost;
+		}
+		worker.join();
+		Check("Wakes racing the wait", lost == 0, Platform::Now() - start);
+	}
+
+	//What the main loop does with nothing to draw: sleep until a worker is done.
+	{
+		FrameScheduler scheduler(1 / 60.0);
+		scheduler.FrameDrawn(false);
+		bool idle = scheduler.NextDeadline() < 0;
+		worker = std::thread(WakeAfter, 0.05);
+		double start = Platform::Now();
+		scheduler.Wait();
+		elapsed = Platform::Now() - start;
+		worker.join();
+		bool woken = Platform::TakeWakeup();
+		if(woken)
+			scheduler.RequestFrame();
+		Check("Idle scheduler sleeps until woken", idle && woken && elapsed >= 0.05 - early &&
+			scheduler.NextDeadline() >= 0, elapsed);
+	}
+
+	done = true;
+	printf("\nResult: %d failures\n", failures);
+	return failures > 0 ? 2 : 0;
+}
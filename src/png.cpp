@@ -0,0 +1,794 @@
+#include "png.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace
+{
+	struct CrcTable
+	{
+		uint32_t v[256];
+		CrcTable()
+		{
+			for(uint32_t n = 0; n < 256; ++n)
+			{
+				uint32_t c = n;
+				for(int k = 0; k < 8; ++k)
+					c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+				v[n] = c;
+			}
+		}
+	};
+
+	uint32_t Crc(uint32_t crc, const unsigned char *data, size_t size)
+	{
+		static const CrcTable table;
+		crc = ~crc;
+		for(size_t i = 0; i < size; ++i)
+			crc = table.v[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+		return ~crc;
+	}
+
+	uint32_t Adler(const unsigned char *data, size_t size)
+	{
+		uint32_t a = 1, b = 0;
+		while(size)
+		{
+			//5552 is the most bytes that can be summed before b overflows.
+			size_t n = size < 5552 ? size : 5552;
+			size -= n;
+			while(n--)
+			{
+				a += *data++;
+				b += a;
+			}
+			a %= 65521;
+			b %= 65521;
+		}
+		return (b << 16) | a;
+	}
+
+	void Put32(std::vector<unsigned char> &out, uint32_t v)
+	{
+		out.push_back(v >> 24);
+		out.push_back(v >> 16);
+		out.push_back(v >> 8);
+		out.push_back(v);
+	}
+
+	class BitWriter
+	{
+	public:
+		BitWriter(std::vector<unsigned char> &out): out(out), bits(0), count(0) {}
+
+		void Put(uint32_t value, int n)
+		{
+			bits |= value << count;
+			count += n;
+			while(count >= 8)
+			{
+				out.push_back(bits & 0xff);
+				bits >>= 8;
+				count -= 8;
+			}
+		}
+
+		//Huffman codes go in most significant bit first.
+		void PutCode(uint32_t code, int n)
+		{
+			uint32_t rev = 0;
+			for(int i = 0; i < n; ++i)
+				rev |= ((code >> i) & 1) << (n - 1 - i);
+			Put(rev, n);
+		}
+
+		void Flush()
+		{
+			if(count)
+				out.push_back(bits & 0xff);
+			bits = 0;
+			count = 0;
+		}
+
+	private:
+		std::vector<unsigned char> &out;
+		uint32_t bits;
+		int count;
+	};
+
+	const int lengthBase[29] = {3,4,5,6,7,8,9,10,11,13,15,17,19,23,27,31,35,43,51,59,67,83,99,115,131,163,195,227,258};
+	const int lengthExtra[29] = {0,0,0,0,0,0,0,0,1,1,1,1,2,2,2,2,3,3,3,3,4,4,4,4,5,5,5,5,0};
+	const int distBase[30] = {1,2,3,4,5,7,9,13,17,25,33,49,65,97,129,193,257,385,513,769,1025,1537,2049,3073,4097,6145,8193,12289,16385,24577};
+	const int distExtra[30] = {0,0,0,0,1,1,2,2,3,3,4,4,5,5,6,6,7,7,8,8,9,9,10,10,11,11,12,12,13,13};
+
+	void PutSymbol(BitWriter &bw, int v)
+	{
+		if(v < 144)
+			bw.PutCode(0x30 + v, 8);
+		else if(v < 256)
+			bw.PutCode(0x190 + v - 144, 9);
+		else if(v < 280)
+			bw.PutCode(v - 256, 7);
+		else
+			bw.PutCode(0xc0 + v - 280, 8);
+	}
+
+	void PutMatch(BitWriter &bw, int length, int distance)
+	{
+		int l = 28;
+		while(lengthBase[l] > length)
+			--l;
+		PutSymbol(bw, 257 + l);
+		bw.Put(length - lengthBase[l], lengthExtra[l]);
+
+		int d = 29;
+		while(distBase[d] > distance)
+			--d;
+		bw.PutCode(d, 5);
+		bw.Put(distance - distBase[d], distExtra[d]);
+	}
+
+	//Single fixed Huffman block with hash chain LZ77. Sprites are mostly flat
+	//colour and transparency, dynamic tables wouldn't buy much.
+	void Deflate(std::vector<unsigned char> &out, const unsigned char *data, size_t size)
+	{
+		constexpr int windowBits = 15;
+		constexpr int windowSize = 1 << windowBits;
+		constexpr int hashBits = 15;
+		constexpr int maxChain = 32;
+		constexpr int minMatch = 3;
+		constexpr int maxMatch = 258;
+
+		std::vector<int> head(1 << hashBits, -1);
+		std::vector<int> prev(windowSize, -1);
+		auto hash = [data](size_t p) {
+			uint32_t v = data[p] | (data[p+1] << 8) | (data[p+2] << 16);
+			return (v * 2654435761u) >> (32 - hashBits);
+		};
+		auto insert = [&](size_t p) {
+			if(p + minMatch > size)
+				return;
+			uint32_t h = hash(p);
+			prev[p & (windowSize-1)] = head[h];
+			head[h] = (int)p;
+		};
+
+		BitWriter bw(out);
+		bw.Put(1, 1); //Final block
+		bw.Put(1, 2); //Fixed Huffman
+
+		size_t pos = 0;
+		while(pos < size)
+		{
+			int bestLen = 0;
+			int bestDist = 0;
+			if(pos + minMatch <= size)
+			{
+				int limit = (int)std::min<size_t>(maxMatch, size - pos);
+				int cand = head[hash(pos)];
+				int chain = maxChain;
+				while(cand >= 0 && pos - cand <= windowSize && chain--)
+				{
+					const unsigned char *a = data + pos;
+					const unsigned char *b = data + cand;
+					if(b[bestLen] == a[bestLen])
+					{
+						int len = 0;
+						while(len < limit && a[len] == b[len])
+							++len;
+						if(len > bestLen)
+						{
+							bestLen = len;
+							bestDist = (int)(pos - cand);
+							if(len == limit)
+								break;
+						}
+					}
+					int next = prev[cand & (windowSize-1)];
+					if(next >= cand) //Slot was reused by a newer position.
+						break;
+					cand = next;
+				}
+			}
+
+			if(bestLen >= minMatch)
+			{
+				PutMatch(bw, bestLen, bestDist);
+				for(int i = 0; i < bestLen; ++i)
+					insert(pos + i);
+				pos += bestLen;
+			}
+			else
+			{
+				PutSymbol(bw, data[pos]);
+				insert(pos);
+				++pos;
+			}
+		}
+		PutSymbol(bw, 256);
+		bw.Flush();
+	}
+
+	int Paeth(int a, int b, int c)
+	{
+		int p = a + b - c;
+		int pa = abs(p - a), pb = abs(p - b), pc = abs(p - c);
+		if(pa <= pb && pa <= pc)
+			return a;
+		return pb <= pc ? b : c;
+	}
+
+	void Chunk(std::vector<unsigned char> &out, const char *type, const unsigned char *data, size_t size)
+	{
+		Put32(out, (uint32_t)size);
+		size_t start = out.size();
+		out.insert(out.end(), type, type + 4);
+		out.insert(out.end(), data, data + size);
+		Put32(out, Crc(0, out.data() + start, size + 4));
+	}
+}
+
+namespace
+{
+	const unsigned char signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+
+	void Header(std::vector<unsigned char> &out, int width, int height)
+	{
+		out.assign(signature, signature + 8);
+		unsigned char ihdr[13] = {
+			(unsigned char)(width >> 24), (unsigned char)(width >> 16), (unsigned char)(width >> 8), (unsigned char)width,
+			(unsigned char)(height >> 24), (unsigned char)(height >> 16), (unsigned char)(height >> 8), (unsigned char)height,
+			8, 6, 0, 0, 0 //8 bit RGBA, no interlace
+		};
+		Chunk(out, "IHDR", ihdr, sizeof(ihdr));
+	}
+}
+
+namespace Png
+{
+	void Compress(std::vector<unsigned char> &out, const unsigned char *rgba, int width, int height, int stride)
+	{
+		//Filter each row with whichever filter gives the smallest absolute sum.
+		const int rowSize = width * 4;
+		std::vector<unsigned char> filtered((size_t)(rowSize + 1) * height);
+		std::vector<unsigned char> candidate(rowSize);
+		std::vector<unsigned char> zero(rowSize, 0);
+		for(int y = 0; y < height; ++y)
+		{
+			const unsigned char *row = rgba + (size_t)y * stride;
+			const unsigned char *up = y ? rgba + (size_t)(y-1) * stride : zero.data();
+			unsigned char *dst = &filtered[(size_t)y * (rowSize + 1)];
+
+			long bestSum = -1;
+			for(int f = 0; f < 5; ++f)
+			{
+				long sum = 0;
+				for(int i = 0; i < rowSize; ++i)
+				{
+					int a = i >= 4 ? row[i-4] : 0;
+					int b = up[i];
+					int c = i >= 4 ? up[i-4] : 0;
+					int v;
+					switch(f)
+					{
+					case 0: v = row[i]; break;
+					case 1: v = row[i] - a; break;
+					case 2: v = row[i] - b; break;
+					case 3: v = row[i] - ((a + b) >> 1); break;
+					default: v = row[i] - Paeth(a, b, c); break;
+					}
+					candidate[i] = (unsigned char)v;
+					sum += (signed char)candidate[i] < 0 ? -(signed char)candidate[i] : candidate[i];
+				}
+				if(bestSum < 0 || sum < bestSum)
+				{
+					bestSum = sum;
+					dst[0] = f;
+					memcpy(dst + 1, candidate.data(), rowSize);
+				}
+			}
+		}
+
+		out.assign({0x78, 0x01});
+		Deflate(out, filtered.data(), filtered.size());
+		Put32(out, Adler(filtered.data(), filtered.size()));
+	}
+
+	void Encode(std::vector<unsigned char> &out, const unsigned char *rgba, int width, int height, int stride)
+	{
+		std::vector<unsigned char> zlib;
+		Compress(zlib, rgba, width, height, stride);
+		Header(out, width, height);
+		Chunk(out, "IDAT", zlib.data(), zlib.size());
+		Chunk(out, "IEND", nullptr, 0);
+	}
+
+	bool Write(const char *filename, const unsigned char *rgba, int width, int height, int stride)
+	{
+		std::vector<unsigned char> data;
+		Encode(data, rgba, width, height, stride);
+
+		FILE *file = fopen(filename, "wb");
+		if(!file)
+			return false;
+		bool ok = fwrite(data.data(), 1, data.size(), file) == data.size();
+		return fclose(file) == 0 && ok;
+	}
+
+	Apng::Apng():
+	file(nullptr),
+	width(0), height(0),
+	frames(0), written(0),
+	sequence(0),
+	ok(false)
+	{
+	}
+
+	Apng::~Apng()
+	{
+		if(file)
+			fclose(file);
+	}
+
+	bool Apng::Put(const std::vector<unsigned char> &data)
+	{
+		ok = ok && fwrite(data.data(), 1, data.size(), file) == data.size();
+		return ok;
+	}
+
+	bool Apng::Open(const char *filename, int width_, int height_, int frames_, int delayNum, int delayDen)
+	{
+		file = fopen(filename, "wb");
+		if(!file)
+			return false;
+		ok = true;
+		width = width_;
+		height = height_;
+		frames = frames_;
+		written = 0;
+		sequence = 0;
+		delay[0] = delayNum;
+		delay[1] = delayDen;
+
+		std::vector<unsigned char> out;
+		Header(out, width, height);
+		std::vector<unsigned char> actl;
+		Put32(actl, frames);
+		Put32(actl, 0); //Loop forever
+		Chunk(out, "acTL", actl.data(), actl.size());
+		return Put(out);
+	}
+
+	bool Apng::AddFrame(const std::vector<unsigned char> &compressed)
+	{
+		if(!file || written >= frames)
+			return false;
+
+		std::vector<unsigned char> out;
+		std::vector<unsigned char> fctl;
+		Put32(fctl, sequence++);
+		Put32(fctl, width);
+		Put32(fctl, height);
+		Put32(fctl, 0); //x, y
+		Put32(fctl, 0);
+		fctl.insert(fctl.end(), {
+			(unsigned char)(delay[0] >> 8), (unsigned char)delay[0],
+			(unsigned char)(delay[1] >> 8), (unsigned char)delay[1],
+			0, 0 //No dispose, replace instead of blending
+		});
+		Chunk(out, "fcTL", fctl.data(), fctl.size());
+
+		//The first frame doubles as the still image.
+		if(written == 0)
+			Chunk(out, "IDAT", compressed.data(), compressed.size());
+		else
+		{
+			std::vector<unsigned char> fdat;
+			Put32(fdat, sequence++);
+			fdat.insert(fdat.end(), compressed.begin(), compressed.end());
+			Chunk(out, "fdAT", fdat.data(), fdat.size());
+		}
+		++written;
+		return Put(out);
+	}
+
+	bool Apng::Close()
+	{
+		if(!file)
+			return false;
+		std::vector<unsigned char> out;
+		Chunk(out, "IEND", nullptr, 0);
+		Put(out);
+		bool result = fclose(file) == 0 && ok && written == frames;
+		file = nullptr;
+		return result;
+	}
+}
+
+namespace
+{
+	class BitReader
+	{
+	public:
+		BitReader(const unsigned char *data, size_t size): data(data), size(size), pos(0), bits(0), count(0) {}
+
+		//Past the end reads zeros, see Broken.
+		void Fill(int n)
+		{
+			while(count < n)
+			{
+				if(pos < size)
+					bits |= (uint64_t)data[pos] << count;
+				++pos;
+				count += 8;
+			}
+		}
+
+		uint32_t Peek(int n) { Fill(n); return (uint32_t)(bits & ((1ull << n) - 1)); }
+		void Drop(int n) { bits >>= n; count -= n; }
+		uint32_t Get(int n) { uint32_t v = Peek(n); Drop(n); return v; }
+
+		void AlignToByte() { Drop(count & 7); }
+		//Only after AlignToByte, the buffered bytes are given back first.
+		bool Copy(std::vector<unsigned char> &out, size_t n)
+		{
+			for(; n && count >= 8; --n)
+				out.push_back((unsigned char)Get(8));
+			if(n > size - std::min(pos, size))
+				return false;
+			out.insert(out.end(), data + pos, data + pos + n);
+			pos += n;
+			return true;
+		}
+
+		//Used more bits than there are.
+		bool Broken() const { return pos*8 - count > size*8; }
+
+	private:
+		const unsigned char *data;
+		size_t size, pos;
+		uint64_t bits;
+		int count;
+	};
+
+	//Canonical Huffman code as one lookup table indexed by the next
+	//maxBits bits, entries are symbol << 4 | code length.
+	struct Huffman
+	{
+		std::vector<uint16_t> table;
+		int maxBits;
+
+		bool Build(const unsigned char *lengths, int n)
+		{
+			int counts[16] = {};
+			maxBits = 1;
+			for(int i = 0; i < n; ++i)
+			{
+				++counts[lengths[i]];
+				maxBits = std::max<int>(maxBits, lengths[i]);
+			}
+			counts[0] = 0;
+			int next[16] = {};
+			int code = 0;
+			for(int len = 1; len < 16; ++len)
+			{
+				code = (code + counts[len-1]) << 1;
+				next[len] = code;
+				if(next[len] + counts[len] > (1 << len))
+					return false; //Oversubscribed
+			}
+			table.assign((size_t)1 << maxBits, 0);
+			for(int sym = 0; sym < n; ++sym)
+			{
+				int len = lengths[sym];
+				if(!len)
+					continue;
+				int c = next[len]++;
+				int rev = 0;
+				for(int i = 0; i < len; ++i)
+					rev |= ((c >> i) & 1) << (len - 1 - i);
+				for(int i = rev; i < (1 << maxBits); i += 1 << len)
+					table[i] = (uint16_t)(sym << 4 | len);
+			}
+			return true;
+		}
+
+		//-1 for a code that isn't in the table.
+		int Decode(BitReader &br) const
+		{
+			uint16_t e = table[br.Peek(maxBits)];
+			if(!(e & 15))
+				return -1;
+			br.Drop(e & 15);
+			return e >> 4;
+		}
+	};
+
+	bool InflateBlock(BitReader &br, std::vector<unsigned char> &out, const Huffman &lit, const Huffman &dist)
+	{
+		for(;;)
+		{
+			int sym = lit.Decode(br);
+			if(sym < 0 || br.Broken())
+				return false;
+			if(sym < 256)
+			{
+				out.push_back((unsigned char)sym);
+				continue;
+			}
+			if(sym == 256)
+				return true;
+			sym -= 257;
+			if(sym >= 29)
+				return false;
+			int length = lengthBase[sym] + br.Get(lengthExtra[sym]);
+			int d = dist.Decode(br);
+			if(d < 0 || d >= 30)
+				return false;
+			size_t distance = distBase[d] + br.Get(distExtra[d]);
+			if(distance > out.size())
+				return false;
+			size_t from = out.size() - distance;
+			for(int i = 0; i < length; ++i)
+				out.push_back(out[from + i]);
+		}
+	}
+
+	bool Inflate(std::vector<unsigned char> &out, const unsigned char *data, size_t size)
+	{
+		if(size < 2 || (data[0] & 15) != 8 || ((data[0] << 8) | data[1]) % 31)
+			return false;
+		BitReader br(data + 2, size - 2);
+
+		static Huffman fixedLit, fixedDist;
+		static bool fixedBuilt = [] {
+			unsigned char lengths[288];
+			std::fill(lengths, lengths + 144, 8);
+			std::fill(lengths + 144, lengths + 256, 9);
+			std::fill(lengths + 256, lengths + 280, 7);
+			std::fill(lengths + 280, lengths + 288, 8);
+			fixedLit.Build(lengths, 288);
+			std::fill(lengths, lengths + 30, 5);
+			fixedDist.Build(lengths, 30);
+			return true;
+		}();
+		(void)fixedBuilt;
+
+		bool last;
+		do
+		{
+			last = br.Get(1);
+			int type = br.Get(2);
+			if(type == 0)
+			{
+				br.AlignToByte();
+				uint32_t len = br.Get(16);
+				uint32_t nlen = br.Get(16);
+				if((len ^ 0xffff) != nlen || !br.Copy(out, len) || br.Broken())
+					return false;
+			}
+			else if(type == 1)
+			{
+				if(!InflateBlock(br, out, fixedLit, fixedDist))
+					return false;
+			}
+			else if(type == 2)
+			{
+				int nlit = br.Get(5) + 257;
+				int ndist = br.Get(5) + 1;
+				int nclen = br.Get(4) + 4;
+				static const int order[19] = {16,17,18,0,8,7,9,6,10,5,11,4,12,3,13,2,14,1,15};
+				unsigned char clen[19] = {};
+				for(int i = 0; i < nclen; ++i)
+					clen[order[i]] = br.Get(3);
+				Huffman clenCode;
+				if(!clenCode.Build(clen, 19))
+					return false;
+
+				unsigned char lengths[320] = {};
+				int n = 0;
+				while(n < nlit + ndist)
+				{
+					int sym = clenCode.Decode(br);
+					if(sym < 0 || br.Broken())
+						return false;
+					int repeat = 1, value = sym;
+					if(sym == 16)
+					{
+						if(!n)
+							return false;
+						value = lengths[n-1];
+						repeat = 3 + br.Get(2);
+					}
+					else if(sym == 17)
+						value = 0, repeat = 3 + br.Get(3);
+					else if(sym == 18)
+						value = 0, repeat = 11 + br.Get(7);
+					if(n + repeat > nlit + ndist)
+						return false;
+					while(repeat--)
+						lengths[n++] = value;
+				}
+				Huffman lit, dist;
+				if(!lit.Build(lengths, nlit) || !dist.Build(lengths + nlit, ndist))
+					return false;
+				if(!InflateBlock(br, out, lit, dist))
+					return false;
+			}
+			else
+				return false;
+		} while(!last);
+		return !br.Broken();
+	}
+
+	uint32_t Get32(const unsigned char *p)
+	{
+		return (uint32_t)p[0] << 24 | p[1] << 16 | p[2] << 8 | p[3];
+	}
+}
+
+namespace Png
+{
+	bool Decode(std::vector<unsigned char> &rgba, int &width, int &height, const unsigned char *data, size_t size)
+	{
+		if(size < 8 || memcmp(data, signature, 8))
+			return false;
+
+		int depth = 0, colorType = -1, interlace = 0;
+		width = height = 0;
+		std::vector<unsigned char> idat;
+		unsigned char palette[256][4];
+		for(auto &entry : palette)
+			entry[0] = entry[1] = entry[2] = 0, entry[3] = 255;
+		int transparent[3] = {-1, -1, -1}; //tRNS colour key for grey and RGB
+
+		size_t pos = 8;
+		while(pos + 12 <= size)
+		{
+			uint32_t length = Get32(data + pos);
+			const unsigned char *type = data + pos + 4;
+			const unsigned char *body = data + pos + 8;
+			if(length > size - pos - 12)
+				return false;
+			pos += 12 + length;
+
+			if(!memcmp(type, "IHDR", 4) && length >= 13)
+			{
+				width = Get32(body);
+				height = Get32(body + 4);
+				depth = body[8];
+				colorType = body[9];
+				interlace = body[12];
+			}
+			else if(!memcmp(type, "PLTE", 4))
+			{
+				for(uint32_t i = 0; i < length / 3 && i < 256; ++i)
+					memcpy(palette[i], body + i*3, 3);
+			}
+			else if(!memcmp(type, "tRNS", 4))
+			{
+				if(colorType == 3)
+				{
+					for(uint32_t i = 0; i < length && i < 256; ++i)
+						palette[i][3] = body[i];
+				}
+				else
+				{
+					for(uint32_t i = 0; i < 3 && i*2 + 1 < length; ++i)
+						transparent[i] = body[i*2] << 8 | body[i*2 + 1];
+				}
+			}
+			else if(!memcmp(type, "IDAT", 4))
+				idat.insert(idat.end(), body, body + length);
+			else if(!memcmp(type, "IEND", 4))
+				break;
+		}
+
+		//Interlaced images aren't worth the code for what this reads.
+		const int channelsOf[7] = {1, 0, 3, 1, 2, 0, 4};
+		if(width <= 0 || height <= 0 || width > 16384 || height > 16384 || interlace ||
+			colorType < 0 || colorType > 6 || !channelsOf[colorType])
+			return false;
+		if(depth != 8 && depth != 16 && !(depth < 8 && (colorType == 0 || colorType == 3) && (depth == 1 || depth == 2 || depth == 4)))
+			return false;
+
+		int channels = channelsOf[colorType];
+		size_t rowSize = ((size_t)width * channels * depth + 7) / 8;
+		int bpp = std::max(1, channels * depth / 8);
+
+		std::vector<unsigned char> raw;
+		raw.reserve((rowSize + 1) * height);
+		if(!Inflate(raw, idat.data(), idat.size()) || raw.size() < (rowSize + 1) * height)
+			return false;
+
+		//Undo the filters in place, row by row.
+		std::vector<unsigned char> zero(rowSize, 0);
+		for(int y = 0; y < height; ++y)
+		{
+			unsigned char *row = &raw[(rowSize + 1) * y];
+			int filter = row[0];
+			++row;
+			const unsigned char *up = y ? &raw[(rowSize + 1) * (y-1) + 1] : zero.data();
+			for(size_t i = 0; i < rowSize; ++i)
+			{
+				int a = i >= (size_t)bpp ? row[i-bpp] : 0;
+				int b = up[i];
+				int c = i >= (size_t)bpp ? up[i-bpp] : 0;
+				switch(filter)
+				{
+				case 0: break;
+				case 1: row[i] += a; break;
+				case 2: row[i] += b; break;
+				case 3: row[i] += (a + b) >> 1; break;
+				case 4: row[i] += Paeth(a, b, c); break;
+				default: return false;
+				}
+			}
+		}
+
+		rgba.resize((size_t)width * height * 4);
+		for(int y = 0; y < height; ++y)
+		{
+			const unsigned char *row = &raw[(rowSize + 1) * y + 1];
+			unsigned char *dst = &rgba[(size_t)width * 4 * y];
+			for(int x = 0; x < width; ++x, dst += 4)
+			{
+				//Sample c of pixel x, full value and scaled to 8 bits.
+				auto sample = [&](int c, int &full) {
+					size_t bit = ((size_t)x * channels + c) * depth;
+					if(depth == 16)
+					{
+						full = row[bit/8] << 8 | row[bit/8 + 1];
+						return full >> 8;
+					}
+					if(depth == 8)
+						return full = row[bit/8];
+					full = (row[bit/8] >> (8 - depth - bit % 8)) & ((1 << depth) - 1);
+					return colorType == 3 ? full : full * 255 / ((1 << depth) - 1);
+				};
+				int full[4];
+				switch(colorType)
+				{
+				case 0:
+					dst[0] = dst[1] = dst[2] = sample(0, full[0]);
+					dst[3] = full[0] == transparent[0] ? 0 : 255;
+					break;
+				case 2:
+					for(int c = 0; c < 3; ++c)
+						dst[c] = sample(c, full[c]);
+					dst[3] = full[0] == transparent[0] && full[1] == transparent[1] && full[2] == transparent[2] ? 0 : 255;
+					break;
+				case 3:
+					memcpy(dst, palette[sample(0, full[0])], 4);
+					break;
+				case 4:
+					dst[0] = dst[1] = dst[2] = sample(0, full[0]);
+					dst[3] = sample(1, full[1]);
+					break;
+				default:
+					for(int c = 0; c < 4; ++c)
+						dst[c] = sample(c, full[c]);
+					break;
+				}
+			}
+		}
+		return true;
+	}
+
+	bool Read(const char *filename, std::vector<unsigned char> &rgba, int &width, int &height)
+	{
+		FILE *file = fopen(filename, "rb");
+		if(!file)
+			return false;
+		std::vector<unsigned char> data;
+		unsigned char buffer[65536];
+		size_t n;
+		while((n = fread(buffer, 1, sizeof(buffer), file)) > 0)
+			data.insert(data.end(), buffer, buffer + n);
+		fclose(file);
+		return Decode(rgba, width, height, data.data(), data.size());
+	}
+}
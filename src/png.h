@@ -0,0 +1,51 @@
+#ifndef PNG_H_GUARD
+#define PNG_H_GUARD
+
+#include <cstdio>
+#include <vector>
+
+// Minimal PNG encoder for RGBA8 images, and a decoder for non-interlaced
+// ones of any colour type. Self contained (own deflate), so the command line
+// tools don't need zlib. Thread safe, no shared state.
+namespace Png
+{
+	//Pixels are RGBA in memory order, stride is in bytes.
+	void Encode(std::vector<unsigned char> &out, const unsigned char *rgba, int width, int height, int stride);
+	bool Write(const char *filename, const unsigned char *rgba, int width, int height, int stride);
+	//Just the zlib stream of the image data. Slow part of Encode, safe to run
+	//for several frames at once.
+	void Compress(std::vector<unsigned char> &out, const unsigned char *rgba, int width, int height, int stride);
+
+	//Any bit depth and colour type, converted to RGBA8 with tRNS applied.
+	//False for interlaced or broken files.
+	bool Decode(std::vector<unsigned char> &rgba, int &width, int &height, const unsigned char *data, size_t size);
+	bool Read(const char *filename, std::vector<unsigned char> &rgba, int &width, int &height);
+
+	//Animated PNG written to disk one frame at a time. Every frame covers the
+	//whole image and replaces the one before it.
+	class Apng
+	{
+	public:
+		Apng();
+		~Apng();
+
+		//delayNum/delayDen seconds per frame. The frame count has to be known up front.
+		bool Open(const char *filename, int width, int height, int frames, int delayNum, int delayDen);
+		//Takes what Compress made, frames in order.
+		bool AddFrame(const std::vector<unsigned char> &compressed);
+		//False if anything failed to write or fewer frames were added than promised.
+		bool Close();
+
+	private:
+		FILE *file;
+		int width, height;
+		int frames, written;
+		unsigned int sequence;
+		int delay[2];
+		bool ok;
+
+		bool Put(const std::vector<unsigned char> &data);
+	};
+}
+
+#endif /* PNG_H_GUARD */
@@ -0,0 +1,314 @@
+#include "profiler.h"
+
+#include "gl_ext.h"
+#include <windows.h>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+
+//Not in the 2.1 headers.
+constexpr GLenum GL_TIME_ELAPSED_ = 0x88BF;
+constexpr GLenum GL_DEBUG_OUTPUT_ = 0x92E0;
+constexpr GLenum GL_DEBUG_TYPE_ERROR_ = 0x824C;
+constexpr GLenum GL_DEBUG_SEVERITY_HIGH_ = 0x9146;
+constexpr GLenum GL_DEBUG_SEVERITY_NOTIFICATION_ = 0x826B;
+
+typedef void (APIENTRY *DebugProc)(GLenum source, GLenum type, GLuint id, GLenum severity,
+	GLsizei length, const GLchar *message, const void *user);
+typedef void (APIENTRY *DebugMessageCallback_t)(DebugProc callback, const void *user);
+
+namespace Profiler
+{
+	using Clock = std::chrono::steady_clock;
+
+	//Frames a query result may take to arrive before its slot is reused.
+	constexpr int inFlight = 4;
+	constexpr int historySize = 1024;
+	constexpr size_t maxMessages = 64;
+
+	struct Slot
+	{
+		uint64_t frame;
+		std::vector<GLuint> queries[PassCount];
+		int used[PassCount];
+		bool pending;
+	};
+
+	struct Record
+	{
+		uint64_t frame;
+		Times times;
+	};
+
+	static bool timers;
+	static bool debugOutput;
+	static Slot slots[inFlight];
+	static Record history[historySize];
+	static uint64_t frame;
+	static Clock::time_point frameStart;
+	static Clock::time_point passStart[PassCount];
+	static int gpuPass = -1;
+
+	static std::mutex messageMutex;
+	static std::vector<Message> messages;
+
+	static const char *names[PassCount] = {"Grid", "PAT parts", "CG sprites", "Hitboxes", "ImGui"};
+	static const char *csvNames[PassCount] = {"grid", "parts", "sprites", "hitboxes", "ui"};
+
+	static double Ms(Clock::duration d)
+	{
+		return std::chrono::duration<double, std::milli>(d).count();
+	}
+
+	static void AddMessage(const std::string &text, bool error)
+	{
+		std::lock_guard<std::mutex> lock(messageMutex);
+		for(auto &message : messages)
+		{
+			if(message.text == text)
+			{
+				++message.count;
+				return;
+			}
+		}
+		if(messages.size() >= maxMessages)
+			messages.erase(messages.begin());
+		messages.push_back(Message{text, 1, error});
+		printf("[GL] %s\n", text.c_str());
+	}
+
+	//May be called from a driver thread.
+	static void APIENTRY OnDebugMessage(GLenum source, GLenum type, GLuint id, GLenum severity,
+		GLsizei length, const GLchar *message, const void *user)
+	{
+		if(severity == GL_DEBUG_SEVERITY_NOTIFICATION_)
+			return;
+		std::string text(message, length < 0 ? strlen(message) : length);
+		AddMessage(text, type == GL_DEBUG_TYPE_ERROR_ || severity == GL_DEBUG_SEVERITY_HIGH_);
+	}
+
+	void Init()
+	{
+		using GlExt::HasExtension;
+		timers = GlExt::VersionAtLeast(3, 3) || HasExtension("GL_ARB_timer_query") || HasExtension("GL_EXT_timer_query");
+
+		bool khr = GlExt::VersionAtLeast(4, 3) || HasExtension("GL_KHR_debug");
+		auto callback = (DebugMessageCallback_t)GlExt::GetProc(khr ? "glDebugMessageCallback" : "glDebugMessageCallbackARB");
+		if(callback && (khr || HasExtension("GL_ARB_debug_output")))
+		{
+			if(khr)
+				glEnable(GL_DEBUG_OUTPUT_);
+			callback(OnDebugMessage, nullptr);
+			debugOutput = true;
+		}
+	}
+
+	bool HasGpuTimers()
+	{
+		return timers;
+	}
+
+	bool HasDebugOutput()
+	{
+		return debugOutput;
+	}
+
+	static Record &RecordOf(uint64_t f)
+	{
+		return history[f % historySize];
+	}
+
+	//Picks up whatever query results are ready, never waits for them.
+	static void Collect()
+	{
+		for(Slot &slot : slots)
+		{
+			if(!slot.pending)
+				continue;
+
+			bool ready = true;
+			for(int p = 0; p < PassCount && ready; ++p)
+			{
+				if(slot.used[p] == 0)
+					continue;
+				GLuint available = 0;
+				glGetQueryObjectuiv(slot.queries[p][slot.used[p]-1], GL_QUERY_RESULT_AVAILABLE, &available);
+				ready = available != 0;
+			}
+			if(!ready)
+				continue;
+
+			slot.pending = false;
+			Record &record = RecordOf(slot.frame);
+			if(record.frame != slot.frame)
+				continue;
+			for(int p = 0; p < PassCount; ++p)
+			{
+				if(slot.used[p] == 0)
+					continue;
+				double ms = 0;
+				for(int i = 0; i < slot.used[p]; ++i)
+				{
+					GLuint ns = 0;
+					glGetQueryObjectuiv(slot.queries[p][i], GL_QUERY_RESULT, &ns);
+					ms += ns / 1e6;
+				}
+				record.times.gpuMs[p] = ms;
+			}
+		}
+	}
+
+	void BeginFrame()
+	{
+		++frame;
+		if(timers)
+			Collect();
+
+		//Results older than the ring never arrived in time, drop them.
+		Slot &slot = slots[frame % inFlight];
+		slot.frame = frame;
+		slot.pending = false;
+		memset(slot.used, 0, sizeof(slot.used));
+
+		Record &record = RecordOf(frame);
+		record.frame = frame;
+		for(int p = 0; p < PassCount; ++p)
+		{
+			record.times.cpuMs[p] = 0;
+			record.times.gpuMs[p] = -1;
+		}
+		record.times.frameMs = 0;
+		frameStart = Clock::now();
+	}
+
+	void EndFrame()
+	{
+		RecordOf(frame).times.frameMs = Ms(Clock::now() - frameStart);
+
+		Slot &slot = slots[frame % inFlight];
+		for(int p = 0; p < PassCount; ++p)
+			slot.pending |= slot.used[p] > 0;
+
+		//Without a callback, poll once per frame rather than after every pass.
+		if(!debugOutput)
+		{
+			for(int i = 0; i < 8; ++i)
+			{
+				GLenum err = glGetError();
+				if(err == GL_NO_ERROR)
+					break;
+				char text[32];
+				sprintf(text, "GL error 0x%X", err);
+				AddMessage(text, true);
+			}
+		}
+	}
+
+	void Begin(Pass pass)
+	{
+		passStart[pass] = Clock::now();
+		if(!timers || gpuPass >= 0)
+			return;
+
+		Slot &slot = slots[frame % inFlight];
+		auto &queries = slot.queries[pass];
+		if(slot.used[pass] == (int)queries.size())
+		{
+			GLuint query;
+			glGenQueries(1, &query);
+			queries.push_back(query);
+		}
+		glBeginQuery(GL_TIME_ELAPSED_, queries[slot.used[pass]++]);
+		gpuPass = pass;
+	}
+
+	void End(Pass pass)
+	{
+		RecordOf(frame).times.cpuMs[pass] += Ms(Clock::now() - passStart[pass]);
+		if(gpuPass == pass)
+		{
+			glEndQuery(GL_TIME_ELAPSED_);
+			gpuPass = -1;
+		}
+	}
+
+	const char *PassName(Pass pass)
+	{
+		return names[pass];
+	}
+
+	Times Average(int frames)
+	{
+		Times sum{};
+		int gpuCount[PassCount] = {};
+		int count = 0;
+		//The current frame is still being recorded.
+		for(uint64_t f = frame - 1; f > 0 && count < frames && f + historySize > frame; --f)
+		{
+			const Record &record = RecordOf(f);
+			if(record.frame != f)
+				break;
+			for(int p = 0; p < PassCount; ++p)
+			{
+				sum.cpuMs[p] += record.times.cpuMs[p];
+				if(record.times.gpuMs[p] >= 0)
+				{
+					sum.gpuMs[p] += record.times.gpuMs[p];
+					++gpuCount[p];
+				}
+			}
+			sum.frameMs += record.times.frameMs;
+			++count;
+		}
+
+		for(int p = 0; p < PassCount; ++p)
+		{
+			sum.cpuMs[p] = count ? sum.cpuMs[p] / count : 0;
+			sum.gpuMs[p] = gpuCount[p] ? sum.gpuMs[p] / gpuCount[p] : -1;
+		}
+		sum.frameMs = count ? sum.frameMs / count : 0;
+		return sum;
+	}
+
+	std::vector<Message> GetMessages()
+	{
+		std::lock_guard<std::mutex> lock(messageMutex);
+		return messages;
+	}
+
+	void ClearMessages()
+	{
+		std::lock_guard<std::mutex> lock(messageMutex);
+		messages.clear();
+	}
+
+	bool DumpCsv(const char *path)
+	{
+		FILE *file = fopen(path, "w");
+		if(!file)
+			return false;
+
+		fprintf(file, "frame,frame_ms");
+		for(int p = 0; p < PassCount; ++p)
+			fprintf(file, ",%s_cpu_ms,%s_gpu_ms", csvNames[p], csvNames[p]);
+		fprintf(file, "\n");
+
+		uint64_t first = frame >= historySize ? frame - historySize + 1 : 1;
+		for(uint64_t f = first; f < frame; ++f)
+		{
+			const Record &record = RecordOf(f);
+			if(record.frame != f)
+				continue;
+			fprintf(file, "%llu,%.4f", (unsigned long long)f, record.times.frameMs);
+			for(int p = 0; p < PassCount; ++p)
+			{
+				fprintf(file, ",%.4f,", record.times.cpuMs[p]);
+				if(record.times.gpuMs[p] >= 0)
+					fprintf(file, "%.4f", record.times.gpuMs[p]);
+			}
+			fprintf(file, "\n");
+		}
+		return fclose(file) == 0;
+	}
+}
@@ -0,0 +1,66 @@
+#ifndef PROFILER_H_GUARD
+#define PROFILER_H_GUARD
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// CPU and GPU time per render pass, plus GL errors and debug messages.
+// GPU times come from timer queries read back a few frames later, so
+// nothing here waits on the driver.
+namespace Profiler
+{
+	enum Pass
+	{
+		Grid,
+		Parts,
+		Sprites,
+		Hitboxes,
+		Ui,
+		PassCount
+	};
+
+	struct Times
+	{
+		double cpuMs[PassCount];
+		double gpuMs[PassCount]; //Negative until the result arrives, or without timer queries.
+		double frameMs;
+	};
+
+	struct Message
+	{
+		std::string text;
+		int count;  //Identical messages are folded.
+		bool error;
+	};
+
+	//Call once the context is current and glad is loaded.
+	void Init();
+	bool HasGpuTimers();
+	bool HasDebugOutput();
+
+	void BeginFrame();
+	void EndFrame();
+
+	//Passes don't nest, a pass started inside another gets no GPU time.
+	void Begin(Pass pass);
+	void End(Pass pass);
+
+	struct Scope
+	{
+		Pass pass;
+		Scope(Pass pass_): pass(pass_) { Begin(pass); }
+		~Scope() { End(pass); }
+	};
+
+	const char *PassName(Pass pass);
+	//Mean over the last frames with results.
+	Times Average(int frames = 60);
+	std::vector<Message> GetMessages();
+	void ClearMessages();
+
+	//Every recorded frame, one row each.
+	bool DumpCsv(const char *path);
+}
+
+#endif /* PROFILER_H_GUARD */
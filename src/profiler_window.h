@@ -0,0 +1,129 @@
+#ifndef PROFILER_WINDOW_H_GUARD
+#define PROFILER_WINDOW_H_GUARD
+
+#include "profiler.h"
+#include "main.h"
+#include "frame_scheduler.h"
+#include "render.h"
+#include "gl_state.h"
+#include "pixel_pool.h"
+#include "pixel_upload.h"
+#include "font_glyphs.h"
+#include "filedialog.h"
+#include <windows.h>
+#include <imgui.h>
+
+//Pass timings, renderer counters and GL messages.
+class ProfilerWindow
+{
+public:
+	bool isVisible = false;
+
+	void Draw(Render &render)
+	{
+		if(!isVisible)
+			return;
+
+		if(!ImGui::Begin("Render profiler", &isVisible))
+		{
+			ImGui::End();
+			return;
+		}
+
+		Profiler::Times times = Profiler::Average();
+		ImGui::Text("Frame %.3f ms (CPU, last 60 frames)", times.frameMs);
+		if(!Profiler::HasGpuTimers())
+			ImGui::TextDisabled("No timer queries, GPU times unavailable");
+
+		if(ImGui::BeginTable("passes", 3, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg))
+		{
+			ImGui::TableSetupColumn("Pass");
+			ImGui::TableSetupColumn("CPU ms");
+			ImGui::TableSetupColumn("GPU ms");
+			ImGui::TableHeadersRow();
+			for(int p = 0; p < Profiler::PassCount; ++p)
+			{
+				ImGui::TableNextRow();
+				ImGui::TableNextColumn();
+				ImGui::TextUnformatted(Profiler::PassName((Profiler::Pass)p));
+				ImGui::TableNextColumn();
+				ImGui::Text("%.3f", times.cpuMs[p]);
+				ImGui::TableNextColumn();
+				if(times.gpuMs[p] >= 0)
+					ImGui::Text("%.3f", times.gpuMs[p]);
+				else
+					ImGui::TextDisabled("-");
+			}
+			ImGui::EndTable();
+		}
+
+		FrameScheduler::Pacing pacing = frameScheduler.GetPacing();
+		ImGui::Text("Pacing: %.3f ms mean, %.3f ms jitter, %.3f ms worst over %d frames",
+			pacing.meanMs, pacing.jitterMs, pacing.worstMs, pacing.frames);
+		ImGui::Text("Idle %.0f%% of the last second", pacing.idle * 100);
+
+		if(ImGui::Button("Save CSV..."))
+		{
+			std::string path = FileDialog(fileType::CSV, true);
+			if(!path.empty() && !Profiler::DumpCsv(path.c_str()))
+				MessageBoxA(nullptr, "Couldn't write the file", "Render profiler", MB_ICONWARNING);
+		}
+
+		if(ImGui::CollapsingHeader("Counters", ImGuiTreeNodeFlags_DefaultOpen))
+		{
+			auto atlas = render.GetAtlasStats();
+			ImGui::Text("Atlas: %d sprites in %d pages, %.1f%% used, %d evictions, %d repacks",
+				atlas.sprites, atlas.pages,
+				atlas.pageTexels ? 100.0 * atlas.usedTexels / atlas.pageTexels : 0.0,
+				atlas.evictions, atlas.repacks);
+			auto batch = render.GetBatchStats();
+			ImGui::Text("Sprite batch: %d sprites, %d draws", batch.sprites, batch.draws);
+			auto boxes = render.GetBoxStats();
+			ImGui::Text("Boxes: %d in %d uploads", boxes.boxes, boxes.uploads);
+			auto layers = render.GetLayerStats();
+			ImGui::Text("Layers: %d, %llu heap allocations, arena %.1f of %.1f KB in %llu blocks", layers.layers,
+				(unsigned long long)layers.allocations, layers.arena.used / 1024.0, layers.arena.capacity / 1024.0,
+				(unsigned long long)layers.arena.blocks);
+			auto scene = render.GetSceneStats();
+			ImGui::Text("Scene cache: %d hits, %d redraws, %d incomplete", scene.hits, scene.captures, scene.skipped);
+			auto vao = Vao::GetStats();
+			ImGui::Text("Vertex buffers: %d, %.1f KB, %d ring laps, %d fence waits", vao.buffers, vao.bytes / 1024.0,
+				vao.wraps, vao.waits);
+			auto gl = GlState::GetStats();
+			ImGui::Text("GL state calls: %d issued, %d filtered", gl.issued, gl.filtered);
+			auto upload = PixelUpload::GetStats();
+			ImGui::Text("Texel uploads: %llu, %.1f MB, %llu decoded in place, %llu direct", (unsigned long long)upload.uploads,
+				upload.bytes / 1048576.0, (unsigned long long)upload.staged, (unsigned long long)upload.direct);
+			auto pool = PixelPool::GetStats();
+			ImGui::Text("Pixel pool: %llu acquires, %llu allocations, %.1f MB pooled",
+				(unsigned long long)pool.acquires, (unsigned long long)pool.allocations,
+				pool.pooledBytes / 1048576.0);
+			auto fonts = FontGlyphs::GetStats();
+			ImGui::Text("Fonts: %d characters, atlas %dx%d (%.1f MB), set up %d times, last %.1f ms, %.1f ms total",
+				fonts.characters, fonts.atlasWidth, fonts.atlasHeight,
+				fonts.atlasWidth * fonts.atlasHeight * 4 / 1048576.0, fonts.builds, fonts.lastMs, fonts.totalMs);
+		}
+
+		if(ImGui::CollapsingHeader("GL messages", ImGuiTreeNodeFlags_DefaultOpen))
+		{
+			if(!Profiler::HasDebugOutput())
+				ImGui::TextDisabled("No debug output, errors are polled once per frame");
+			if(ImGui::SmallButton("Clear"))
+				Profiler::ClearMessages();
+			for(const auto &message : Profiler::GetMessages())
+			{
+				ImVec4 color = message.error ? ImVec4(1, 0.4f, 0.4f, 1) : ImGui::GetStyleColorVec4(ImGuiCol_Text);
+				ImGui::TextColored(color, "%s", message.text.c_str());
+				if(message.count > 1)
+				{
+					ImGui::SameLine();
+					ImGui::TextDisabled("x%d", message.count);
+				}
+			}
+		}
+
+		ImGui::End();
+	}
+};
+
+#endif /* PROFILER_WINDOW_H_GUARD */
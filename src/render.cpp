@@ -5,17 +5,19 @@
 #include <glm/gtc/type_ptr.hpp>
 #include <glm/gtc/constants.hpp>
 #include <algorithm>
+#include <chrono>
+#include <unordered_set>
 
-//Error
-#include <windows.h>
 #include <glad/glad.h>
-#include <sstream>
 
 #include "hitbox.h"
 #include "parts/parts.h"
 #include "enums.h"  // For RenderMode enum
-
-constexpr int maxBoxes = 33;
+#include "gl_state.h"
+#include "pixel_upload.h"
+#include "profiler.h"
+#include "alloc_counter.h"
+#include "layer_order.h"
 
 const char* simpleSrcVert = R"(
 #version 330 core
@@ -82,15 +84,18 @@ void main()
 };
 )";
 
-// Parts shader with flip support, additive color, and vertex color tinting
+// Parts shader with flip support, additive color, and vertex color tinting.
+// Textures are layers of an array, the layer is a constant attribute.
 const char* partsSrcVert = R"(
 #version 330 core
 layout (location = 0) in vec3 Position;
 layout (location = 1) in vec4 UV;
 layout (location = 2) in vec4 Color;
+layout (location = 3) in float Layer;
 
 out vec2 Frag_UV;
 out vec4 Frag_Color;
+flat out float Frag_Layer;
 
 uniform mat4 ProjMtx;
 uniform int flip;
@@ -104,28 +109,65 @@ void main()
         Frag_UV = UV.st;
     }
     Frag_Color = Color;
+    Frag_Layer = Layer;
     gl_Position = ProjMtx * vec4(Position, 1);
 }
 )";
 
 const char* partsSrcFrag = R"(
 #version 330 core
-uniform sampler2D Texture;
+uniform sampler2DArray Texture;
 uniform vec3 addColor;
 
 in vec2 Frag_UV;
 in vec4 Frag_Color;
+flat in float Frag_Layer;
 out vec4 FragColor;
 
 void main()
 {
-    vec4 col = texture(Texture, Frag_UV);
+    vec4 col = texture(Texture, vec3(Frag_UV, Frag_Layer));
     col.rgba *= Frag_Color;  // Apply vertex color tint (BGRA color from part)
     col.rgb += addColor;     // Apply additive color
     FragColor = col;
 }
 )";
 
+// Id pass: integer ids where the texture isn't see-through. Sprites get theirs
+// as the vertex color, parts as a uniform.
+const char* spriteIdSrcFrag = R"(
+#version 330 core
+uniform sampler2D Texture;
+
+in vec2 Frag_UV;
+in vec4 Frag_Color;
+out uvec2 FragId;
+
+void main()
+{
+    if (texture(Texture, Frag_UV.st).a < 0.5)
+        discard;
+    FragId = uvec2(Frag_Color.rg + 0.5);
+};
+)";
+
+const char* partsIdSrcFrag = R"(
+#version 330 core
+uniform sampler2DArray Texture;
+uniform ivec2 Id;
+
+in vec2 Frag_UV;
+in vec4 Frag_Color;
+flat in float Frag_Layer;
+out uvec2 FragId;
+
+void main()
+{
+    if (texture(Texture, vec3(Frag_UV, Frag_Layer)).a < 0.5)
+        discard;
+    FragId = uvec2(Id);
+}
+)";
 
 Render::Render():
 cg(nullptr),
@@ -142,9 +184,19 @@ imageVertex{
 	256, 512,  	0, 1,
 	256, 256,  	0, 0,
 },
+standalones{},
+standalone(-1),
+standaloneUse(0),
+spritePage(-1),
+idSprites(false),
+sceneMisses(0),
+sceneBound(false),
 colorRgba{1,1,1,1},
 curImageId(-1),
-quadsToDraw(0),
+renderLayers(ArenaAllocator<RenderLayer>(&layerArena)),
+currentLayerIndex(0),
+layerStats{},
+layerAllocStart(0),
 x(0), offsetX(0),
 y(0), offsetY(0),
 rotX(0), rotY(0), rotZ(0),
@@ -157,6 +209,11 @@ blendingMode(normal)
 
 	sSimple.Use();
 
+	sBox.BindAttrib("Corner", 0);
+	sBox.BindAttrib("Rect", 1);
+	sBox.BindAttrib("ColorZ", 2);
+	sBox.LoadShader(BoxBatch::vertexSource, simpleSrcFrag, true);
+
 	sTextured.BindAttrib("Position", 0);
 	sTextured.BindAttrib("UV", 1);
 	sTextured.BindAttrib("Color", 2);
@@ -166,14 +223,32 @@ blendingMode(normal)
 	sPartShader.BindAttrib("Position", 0);
 	sPartShader.BindAttrib("UV", 1);
 	sPartShader.BindAttrib("Color", 2);
+	sPartShader.BindAttrib("Layer", 3);
 	sPartShader.LoadShader(partsSrcVert, partsSrcFrag, true);
 
+	sPartId.BindAttrib("Position", 0);
+	sPartId.BindAttrib("UV", 1);
+	sPartId.BindAttrib("Color", 2);
+	sPartId.BindAttrib("Layer", 3);
+	sPartId.LoadShader(partsSrcVert, partsIdSrcFrag, true);
+
+	sSpriteId.BindAttrib("Position", 0);
+	sSpriteId.BindAttrib("UV", 1);
+	sSpriteId.BindAttrib("Color", 2);
+	sSpriteId.LoadShader(texturedSrcVert, spriteIdSrcFrag, true);
+
 	lAlphaS = sSimple.GetLoc("Alpha");
 	lProjectionS = sSimple.GetLoc("ProjMtx");
+	lAlphaBox = sBox.GetLoc("Alpha");
+	lProjectionBox = sBox.GetLoc("ProjMtx");
 	lProjectionT = sTextured.GetLoc("ProjMtx");
 	lProjectionParts = sPartShader.GetLoc("ProjMtx");
 	lFlipParts = sPartShader.GetLoc("flip");
 	lAddColorParts = sPartShader.GetLoc("addColor");
+	lProjectionPartId = sPartId.GetLoc("ProjMtx");
+	lFlipPartId = sPartId.GetLoc("flip");
+	lIdPart = sPartId.GetLoc("Id");
+	lProjectionSpriteId = sSpriteId.GetLoc("ProjMtx");
 
 	vSprite.Prepare(sizeof(imageVertex), imageVertex);
 	vSprite.Load();
@@ -193,27 +268,20 @@ blendingMode(normal)
 		0, 0, -1,	1,1,1,
 	};
 
-	geoParts[LINES] = vGeometry.Prepare(sizeof(lines), lines);
-	geoParts[BOXES] = vGeometry.Prepare(sizeof(float)*6*4*maxBoxes, nullptr);
+	geoLines = vGeometry.Prepare(sizeof(lines), lines);
 	vGeometry.Load();
-	vGeometry.InitQuads(geoParts[BOXES]);
 
 	UpdateProj(clientRect.x, clientRect.y);
 
 	glViewport(0, 0, clientRect.x, clientRect.y);
 	glEnable(GL_BLEND);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	GlState::BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 	glEnable(GL_DEPTH_TEST);
 }
 
 void Render::DrawGridLines()
 {
-	if(int err = glGetError())
-	{
-		std::stringstream ss;
-		ss << "GL Error: 0x" << std::hex << err << "\n";
-		MessageBoxA(nullptr, ss.str().c_str(), "GL Error", MB_ICONSTOP);
-	}
+	Profiler::Scope pass(Profiler::Grid);
 
 	//Lines only
 	glm::mat4 view = glm::mat4(1.f);
@@ -224,21 +292,13 @@ void Render::DrawGridLines()
 	// Ensure sSimple shader is active and vertex attributes are enabled
 	sSimple.Use();
 	glUniform1f(lAlphaS, 0.25f);
-	SetMatrix(lProjectionS);
+	SetSimpleMatrix();
 	vGeometry.Bind();
-	vGeometry.Draw(geoParts[LINES], 0, GL_LINES);
+	vGeometry.Draw(geoLines, 0, GL_LINES);
 }
 
 void Render::Draw()
 {
-	if(int err = glGetError())
-	{
-		std::stringstream ss;
-		ss << "GL Error: 0x" << std::hex << err << "\n";
-		MessageBoxA(nullptr, ss.str().c_str(), "GL Error", MB_ICONSTOP);
-		//PostQuitMessage(1);
-	}
-
 
 	//Lines
 	glm::mat4 view = glm::mat4(1.f);
@@ -246,9 +306,9 @@ void Render::Draw()
 	view = glm::translate(view, glm::vec3(x,y,0.f));
 	SetModelView(std::move(view));
 	glUniform1f(lAlphaS, 0.25f);
-	SetMatrix(lProjectionS);
+	SetSimpleMatrix();
 	vGeometry.Bind();
-	vGeometry.Draw(geoParts[LINES], 0, GL_LINES);
+	vGeometry.Draw(geoLines, 0, GL_LINES);
 
 	// Check if we should use Parts rendering
 	// Debug: Only print when renderMode changes
@@ -301,7 +361,7 @@ void Render::Draw()
 
 		// Draw Parts with interpolation (wrapped in try-catch for crash diagnosis)
 		try {
-			m_parts->Draw(curPattern, curNextPattern, curInterp, setMatrix, setAddColor, setFlip, colorRgba);
+			sceneMisses += m_parts->Draw(curPattern, curNextPattern, curInterp, setMatrix, setAddColor, setFlip, colorRgba);
 		} catch (const std::exception& e) {
 			printf("[Render] EXCEPTION in Parts::Draw: %s\n", e.what());
 			return;
@@ -312,11 +372,7 @@ void Render::Draw()
 
 		// Draw hitboxes after Parts
 		sSimple.Use();
-		vGeometry.Bind();
-		glUniform1f(lAlphaS, 0.6f);
-		vGeometry.DrawQuads(GL_LINE_LOOP, quadsToDraw);
-		glUniform1f(lAlphaS, 0.3f);
-		vGeometry.DrawQuads(GL_TRIANGLE_FAN, quadsToDraw);
+		DrawBoxes();
 
 		return;  // Skip sprite rendering
 	}
@@ -344,74 +400,45 @@ void Render::Draw()
 	SetModelView(std::move(view));
 	sTextured.Use();
 	SetMatrix(lProjectionT);
-	if(texture.isApplied)
+	if(BindSprite())
 	{
-		SetBlendingMode();
+		SetBlendingMode(blendingMode);
 		glDisableVertexAttribArray(2);
 		glVertexAttrib4fv(2, colorRgba);
 		vSprite.Bind();
 		vSprite.Draw(0);
 	}
 	//Reset state
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-	glBlendEquation(GL_FUNC_ADD);
+	GlState::BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	GlState::BlendEquation(GL_FUNC_ADD);
 
 	//Boxes
 	sSimple.Use();
-	vGeometry.Bind();
-	glUniform1f(lAlphaS, 0.6f);
-	vGeometry.DrawQuads(GL_LINE_LOOP, quadsToDraw);
-	glUniform1f(lAlphaS, 0.3f);
-	vGeometry.DrawQuads(GL_TRIANGLE_FAN, quadsToDraw);
+	DrawBoxes();
 }
 
 void Render::DrawSpriteOnly(bool drawHitboxes)
 {
-	if(int err = glGetError())
-	{
-		std::stringstream ss;
-		ss << "GL Error: 0x" << std::hex << err << "\n";
-		MessageBoxA(nullptr, ss.str().c_str(), "GL Error", MB_ICONSTOP);
-	}
-
 	// Disable depth write so layers don't occlude each other
 	// We still depth TEST against the background, but don't write to depth buffer
 	glDepthMask(GL_FALSE);
 
 	//Sprite (with full transform including offset)
-	constexpr float tau = glm::pi<float>()*2.f;
-	glm::mat4 view = glm::mat4(1.f);
-	view = glm::scale(view, glm::vec3(scale, scale, 1.f));
-	view = glm::translate(view, glm::vec3(x,y,0.f));
-	// Apply scale and rotations based on AFRT flag
-	if (AFRT) {
-		// AFRT=true: Scale → X → Y → Z (PR #39 order - fixes pattern 15)
-		view = glm::scale(view, glm::vec3(scaleX,scaleY,0));
-		view = glm::rotate(view, rotX*tau, glm::vec3(1.0, 0.f, 0.f));
-		view = glm::rotate(view, rotY*tau, glm::vec3(0.0, 1.f, 0.f));
-		view = glm::rotate(view, rotZ*tau, glm::vec3(0.0, 0.f, 1.f));
-	} else {
-		// AFRT=false: Scale → Z → Y → X (EXACT original pre-PR#39 order)
-		view = glm::scale(view, glm::vec3(scaleX,scaleY,0));
-		view = glm::rotate(view, rotZ*tau, glm::vec3(0.0, 0.f, 1.f));
-		view = glm::rotate(view, rotY*tau, glm::vec3(0.0, 1.f, 0.f));
-		view = glm::rotate(view, rotX*tau, glm::vec3(1.0, 0.f, 0.f));
-	}
-	view = glm::translate(view, glm::vec3(-128+offsetX,-224+offsetY,0.f));
+	glm::mat4 view = SpriteModelView();
 	SetModelView(std::move(view));
 	sTextured.Use();
 	SetMatrix(lProjectionT);
-	if(texture.isApplied)
+	if(BindSprite())
 	{
-		SetBlendingMode();
+		SetBlendingMode(blendingMode);
 		glDisableVertexAttribArray(2);
 		glVertexAttrib4fv(2, colorRgba);
 		vSprite.Bind();
 		vSprite.Draw(0);
 	}
 	//Reset state
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-	glBlendEquation(GL_FUNC_ADD);
+	GlState::BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	GlState::BlendEquation(GL_FUNC_ADD);
 
 	// Draw hitboxes if requested
 	if (drawHitboxes) {
@@ -422,12 +449,8 @@ void Render::DrawSpriteOnly(bool drawHitboxes)
 		view = glm::translate(view, glm::vec3(x,y,0.f));
 		SetModelView(std::move(view));
 		sSimple.Use();
-		SetMatrix(lProjectionS);
-		vGeometry.Bind();
-		glUniform1f(lAlphaS, 0.6f);
-		vGeometry.DrawQuads(GL_LINE_LOOP, quadsToDraw);
-		glUniform1f(lAlphaS, 0.3f);
-		vGeometry.DrawQuads(GL_TRIANGLE_FAN, quadsToDraw);
+		SetSimpleMatrix();
+		DrawBoxes();
 	}
 
 	// Re-enable depth write
@@ -439,11 +462,41 @@ void Render::SetModelView(glm::mat4&& view_)
 	view = std::move(view_);
 }
 
+glm::mat4 Render::SpriteModelView() const
+{
+	constexpr float tau = glm::pi<float>()*2.f;
+	glm::mat4 view = glm::mat4(1.f);
+	view = glm::scale(view, glm::vec3(scale, scale, 1.f));
+	view = glm::translate(view, glm::vec3(x,y,0.f));
+	// Apply scale and rotations based on AFRT flag
+	if (AFRT) {
+		// AFRT=true: Scale → X → Y → Z (PR #39 order - fixes pattern 15)
+		view = glm::scale(view, glm::vec3(scaleX,scaleY,0));
+		view = glm::rotate(view, rotX*tau, glm::vec3(1.0, 0.f, 0.f));
+		view = glm::rotate(view, rotY*tau, glm::vec3(0.0, 1.f, 0.f));
+		view = glm::rotate(view, rotZ*tau, glm::vec3(0.0, 0.f, 1.f));
+	} else {
+		// AFRT=false: Scale → Z → Y → X (EXACT original pre-PR#39 order)
+		view = glm::scale(view, glm::vec3(scaleX,scaleY,0));
+		view = glm::rotate(view, rotZ*tau, glm::vec3(0.0, 0.f, 1.f));
+		view = glm::rotate(view, rotY*tau, glm::vec3(0.0, 1.f, 0.f));
+		view = glm::rotate(view, rotX*tau, glm::vec3(1.0, 0.f, 0.f));
+	}
+	view = glm::translate(view, glm::vec3(-128+offsetX,-224+offsetY,0.f));
+	return view;
+}
+
 void Render::SetMatrix(int lProjection)
 {
 	glUniformMatrix4fv(lProjection, 1, GL_FALSE, glm::value_ptr(projection*view));
 }
 
+void Render::SetSimpleMatrix()
+{
+	simpleMatrix = projection*view;
+	glUniformMatrix4fv(lProjectionS, 1, GL_FALSE, glm::value_ptr(simpleMatrix));
+}
+
 void Render::SetMatrixPersp(int lProjection, glm::mat4 partView, glm::mat4 pre)
 {
 	// Apply perspective projection for PAT rendering (like sosfiro)
@@ -497,37 +550,308 @@ void Render::SwitchImage(int id)
 	if(cg && (id != curImageId || id == -1) && cg->m_loaded)
 	{
 		curImageId = id;
-
-		if (texture.isApplied) {
-			texture.Unapply();
-		}
+		spritePage = -1;
+		standalone = -1;
 
 		if(id>=0)
 		{
-			ImageData *image = cg->draw_texture(id, false, false);
-			if(!image)
+			const SpriteAtlas::Entry *entry = atlas.Find(cg, id);
+			if(!entry)
 			{
-				return;
+				uint64_t key = SpriteAtlas::MakeKey(cg, id);
+				if(UseStandalone(key) || brokenSprites.count(key))
+					return;
+				ImageData *image = nullptr;
+				auto late = lateImages.find(key);
+				if(late != lateImages.end())
+				{
+					image = late->second.release();
+					lateImages.erase(late);
+				}
+				else if(asyncSprites && prefetcher.Demand({cg, id}))
+				{
+					// Shows up once UploadPrefetched gets it, try again next time.
+					if(std::find(demanded.begin(), demanded.end(), key) == demanded.end())
+					{
+						// Requests dropped by a new Submit are never delivered
+						if(demanded.size() >= 64)
+							demanded.erase(demanded.begin());
+						demanded.push_back(key);
+					}
+					curImageId = -1;
+					++sceneMisses;
+					return;
+				}
+				else
+					image = cg->draw_texture(id, false, false);
+				if(!image)
+				{
+					return;
+				}
+
+				// Validate image dimensions before applying to avoid GL_INVALID_VALUE
+				if(image->width <= 0 || image->height <= 0)
+				{
+					delete image;
+					return;
+				}
+
+				// Inserting can evict or move what's already queued
+				FlushSprites();
+				entry = atlas.Insert(cg, id, image);
+				if(!entry)
+				{
+					// Doesn't fit in a page, use a texture of its own
+					AddStandalone(key, image);
+					return;
+				}
+				delete image;
 			}
 
-			texture.Load(image);
+			spritePage = entry->page;
+			AdjustImageQuad(entry->offsetX, entry->offsetY, entry->rect.w, entry->rect.h, entry->uv);
+			vSprite.UpdateBuffer(0, imageVertex);
+		}
+
+	}
+}
+
+bool Render::UseStandalone(uint64_t key)
+{
+	for(int i = 0; i < maxStandalones; ++i)
+	{
+		Standalone &s = standalones[i];
+		if(!s.texture.isApplied || s.key != key)
+			continue;
+		s.lastUsed = ++standaloneUse;
+		if(s.linearFilter != filter)
+		{
+			GlState::BindTexture(s.texture.id);
+			GlState::TexFilter(filter ? GL_LINEAR : GL_NEAREST);
+			s.linearFilter = filter;
+		}
+		standalone = i;
+		AdjustImageQuad(s.offsetX, s.offsetY, s.width, s.height);
+		vSprite.UpdateBuffer(0, imageVertex);
+		return true;
+	}
+	return false;
+}
+
+void Render::AddStandalone(uint64_t key, ImageData *image)
+{
+	// Free slot, or the one used longest ago
+	int slot = 0;
+	for(int i = 0; i < maxStandalones; ++i)
+	{
+		if(!standalones[i].texture.isApplied)
+		{
+			slot = i;
+			break;
+		}
+		if(standalones[i].lastUsed < standalones[slot].lastUsed)
+			slot = i;
+	}
+
+	Standalone &s = standalones[slot];
+	if(s.texture.isApplied)
+	{
+		// Queued sprites may still be using it
+		FlushSprites();
+		s.texture.Unapply();
+	}
+	s.key = key;
+	s.offsetX = image->offsetX;
+	s.offsetY = image->offsetY;
+	s.width = image->width;
+	s.height = image->height;
+	s.linearFilter = filter;
+	s.texture.Load(image);
+	s.texture.Apply(false, filter);
+	s.texture.Unload();
+	s.lastUsed = ++standaloneUse;
+
+	standalone = slot;
+	AdjustImageQuad(s.offsetX, s.offsetY, s.width, s.height);
+	vSprite.UpdateBuffer(0, imageVertex);
+}
+
+bool Render::BindSprite()
+{
+	if(spritePage >= 0)
+	{
+		atlas.BindPage(spritePage, filter);
+		return true;
+	}
+	if(standalone >= 0)
+	{
+		GlState::BindTexture(standalones[standalone].texture.id);
+		return true;
+	}
+	return false;
+}
+
+void Render::QueueSprite()
+{
+	unsigned int texture = 0;
+	if(spritePage < 0)
+	{
+		if(standalone < 0)
+			return;
+		texture = standalones[standalone].texture.id;
+	}
+
+	glm::mat4 view = SpriteModelView();
+	SpriteBatch::Vertex quad[6];
+	for(int i = 0; i < 6; ++i)
+	{
+		const float *v = &imageVertex[i*4];
+		glm::vec4 p = view * glm::vec4(v[0], v[1], 0.f, 1.f);
+		quad[i] = {p.x, p.y, v[2], v[3], colorRgba[0], colorRgba[1], colorRgba[2], colorRgba[3]};
+	}
+	spriteBatch.Add(spritePage, texture, blendingMode, quad);
+}
+
+void Render::FlushSprites()
+{
+	if(spriteBatch.Empty())
+		return;
+	bool ids = idSprites;
+
+	// Same state DrawSpriteOnly uses, positions are already in view space
+	glDepthMask(GL_FALSE);
+	(ids ? sSpriteId : sTextured).Use();
+	glUniformMatrix4fv(ids ? lProjectionSpriteId : lProjectionT, 1, GL_FALSE, glm::value_ptr(projection));
+	spriteBatch.Flush([this](const SpriteBatch::Run &run) {
+		if(run.page >= 0)
+			atlas.BindPage(run.page, filter);
+		else
+			GlState::BindTexture(run.texture);
+		GlState::BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+		GlState::BlendEquation(GL_FUNC_ADD);
+		SetBlendingMode(run.blend);
+	});
+	GlState::BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	GlState::BlendEquation(GL_FUNC_ADD);
+	glDepthMask(GL_TRUE);
+}
+
+uint64_t Render::SceneKey(SceneCache::Hasher inputs) const
+{
+	inputs.Add(x);
+	inputs.Add(y);
+	inputs.Add(scale);
+	inputs.Add(filter);
+	inputs.Add(colorRgba);
+	inputs.Add(highLightN);
+	inputs.Add(clientRect.x);
+	inputs.Add(clientRect.y);
+	return inputs.Get();
+}
 
-			// Validate image dimensions before applying to avoid GL_INVALID_VALUE
-			if(texture.image->width > 0 && texture.image->height > 0)
+bool Render::DrawCachedScene(uint64_t key)
+{
+	if(!scene.Valid(key, clientRect.x, clientRect.y))
+		return false;
+	scene.CountHit();
+	scene.Present();
+	return true;
+}
+
+void Render::BeginScene()
+{
+	sceneMisses = 0;
+	sceneBound = scene.Begin(clientRect.x, clientRect.y);
+}
+
+void Render::EndScene(uint64_t key)
+{
+	if(!sceneBound)
+		return;
+	sceneBound = false;
+	// Sprites that were still being decoded are missing from it
+	scene.End(key, sceneMisses == 0);
+	scene.Present();
+}
+
+void Render::PrefetchSprites(const std::vector<SpritePrefetcher::Request> &sprites)
+{
+	// Roughly what fits in the atlas at once; past that we'd evict our own prefetches.
+	constexpr size_t maxRequests = 192;
+
+	std::vector<SpritePrefetcher::Request> pending;
+	std::unordered_set<uint64_t> seen;
+	for(const auto &sprite : sprites)
+	{
+		if(!sprite.cg || !sprite.cg->m_loaded || sprite.id < 0)
+			continue;
+		uint64_t key = SpriteAtlas::MakeKey(sprite.cg, sprite.id);
+		if(atlas.Contains(key) || !seen.insert(key).second)
+			continue;
+		pending.push_back(sprite);
+		if(pending.size() >= maxRequests)
+			break;
+	}
+	prefetcher.Submit(pending);
+}
+
+void Render::UploadPrefetched(double budgetMs)
+{
+	auto start = std::chrono::steady_clock::now();
+	SpritePrefetcher::Result result;
+	while(prefetcher.PopReady(result))
+	{
+		if(!result.image || result.image->width <= 0 || result.image->height <= 0)
+		{
+			if(result.image)
+				PixelUpload::Unstage(*result.image, false);
+			demanded.erase(std::remove(demanded.begin(), demanded.end(), result.key), demanded.end());
+			if(brokenSprites.size() >= 1024)
+				brokenSprites.clear();
+			brokenSprites.insert(result.key);
+			continue;
+		}
+		// Staged images go to the page straight from the worker's buffer
+		bool placed = atlas.Insert(result.key, result.image.get()) != nullptr;
+		auto wanted = std::find(demanded.begin(), demanded.end(), result.key);
+		// Too big for a page, or the frame's sprites fill every page
+		bool late = !placed && wanted != demanded.end();
+		PixelUpload::Unstage(*result.image, late);
+		if(wanted != demanded.end())
+		{
+			demanded.erase(wanted);
+			if(late)
 			{
-				texture.Apply(false, filter);
-				AdjustImageQuad(texture.image->offsetX, texture.image->offsetY, texture.image->width, texture.image->height);
-				vSprite.UpdateBuffer(0, imageVertex);
+				if(lateImages.size() >= 8)
+					lateImages.clear();
+				lateImages[result.key] = std::move(result.image);
 			}
-
-			texture.Unload();
 		}
+		result.image.reset();
+
+		std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+		if(elapsed.count() >= budgetMs)
+			break;
+	}
 
+	// Mapped buffers for the workers to decode into, the rest of the staging
+	// buffers sit in results waiting for the next call
+	constexpr size_t stagingBuffers = 4;
+	while(prefetcher.Supplied() < stagingBuffers)
+	{
+		unsigned char *buffer = PixelUpload::MapStaging();
+		if(!buffer)
+			break;
+		prefetcher.Supply(buffer, PixelUpload::stagingSize);
 	}
 }
 
-void Render::AdjustImageQuad(int x, int y, int w, int h)
+void Render::AdjustImageQuad(int x, int y, int w, int h, const float *uv)
 {
+	constexpr float fullUv[] = {0, 0, 1, 1};
+	if(!uv)
+		uv = fullUv;
+
 	w+=x;
 	h+=y;
 
@@ -536,75 +860,44 @@ void Render::AdjustImageQuad(int x, int y, int w, int h)
 
 	imageVertex[1] = imageVertex[5] = imageVertex[21] = y;
 	imageVertex[9] = imageVertex[13] = imageVertex[17] = h;
+
+	imageVertex[2] = imageVertex[18] = imageVertex[22] = uv[0];
+	imageVertex[6] = imageVertex[10] = imageVertex[14] = uv[2];
+
+	imageVertex[3] = imageVertex[7] = imageVertex[23] = uv[1];
+	imageVertex[11] = imageVertex[15] = imageVertex[19] = uv[3];
 }
 
 void Render::GenerateHitboxVertices(const BoxList &hitboxes)
 {
-	int size = hitboxes.size();
-	if(size <= 0)
-	{
-		quadsToDraw = 0;
-		return;
-	}
-	static Hitbox **lastHitbox = 0;
-	static int lastSize = 0;
+	boxBatch.Clear();
+	AddHitboxes(hitboxes, 0, 0);
+	boxBatch.Upload();
+}
 
-	const float *color;
+void Render::AddHitboxes(const BoxList &hitboxes, float dx, float dy)
+{
 	//red, green, blue, z order
-	constexpr float collisionColor[] 	{1, 1, 1, 1};
-	constexpr float greenColor[] 		{0.2, 1, 0.2, 2};
-	constexpr float shieldColor[] 		{0, 0, 1, 3}; //Not only for shield
-	constexpr float clashColor[]		{1, 1, 0, 4};
-	constexpr float projectileColor[] 	{0, 1, 1, 5}; //飛び道具
-	constexpr float purple[] 			{0.5, 0, 1, 6}; //特別
-	constexpr float redColor[] 			{1, 0.2, 0.2, 7};
 	constexpr float hiLightColor[]		{1, 0.5, 1, 10};
 
-	constexpr int tX[] = {0,1,1,0};
-	constexpr int tY[] = {0,0,1,1};
-
-	int floats = size*4*6; //4 Vertices with 6 attributes.
-	if(clientQuads.size() < floats)
-		clientQuads.resize(floats);
-	
-	int dataI = 0;
 	for(const auto &boxPair : hitboxes)
 	{
 		int i = boxPair.first;
 		const Hitbox& hitbox = boxPair.second;
+		const float *color = highLightN == i ? hiLightColor : HitboxColor(i);
 
-		if (highLightN == i)
-			color = hiLightColor;
-		else if(i==0)
-			color = collisionColor;
-		else if (i >= 1 && i <= 8)
-			color = greenColor;
-		else if(i >=9 && i <= 10)
-			color = shieldColor;
-		else if(i == 11)
-			color = clashColor;
-		else if(i == 12)
-			color = projectileColor;
-		else if(i>12 && i<=24)
-			color = purple;
-		else
-			color = redColor;
-
-		
-		for(int j = 0; j < 4*6; j+=6)
-		{
-			//X, Y, Z, R, G, B
-			clientQuads[dataI+j+0] = hitbox.xy[0] + (hitbox.xy[2]-hitbox.xy[0])*tX[j/6];
-			clientQuads[dataI+j+1] = hitbox.xy[1] + (hitbox.xy[3]-hitbox.xy[1])*tY[j/6];
-			clientQuads[dataI+j+2] = color[3]+1000.f;
-			clientQuads[dataI+j+3] = color[0];
-			clientQuads[dataI+j+4] = color[1];
-			clientQuads[dataI+j+5] = color[2];
-		}
-		dataI += 4*6;
+		boxBatch.Add(hitbox.xy[0] + dx, hitbox.xy[1] + dy, hitbox.xy[2] + dx, hitbox.xy[3] + dy,
+			color[3]+1000.f, color);
 	}
-	quadsToDraw = size;
-	vGeometry.UpdateBuffer(geoParts[BOXES], clientQuads.data(), dataI*sizeof(float));
+}
+
+void Render::DrawBoxes()
+{
+	// Called with sSimple in use, and callers expect it to stay that way
+	sBox.Use();
+	glUniformMatrix4fv(lProjectionBox, 1, GL_FALSE, glm::value_ptr(simpleMatrix));
+	boxBatch.Draw(lAlphaBox, 0.6f, 0.3f);
+	sSimple.Use();
 }
 
 bool Render::GeneratePartCenterVertices()
@@ -656,7 +949,7 @@ bool Render::GeneratePartCenterVertices()
 		propX, propY - lineSize, 1,    color[0], color[1], color[2],  // Bottom arm
 	};
 
-	vGeometry.UpdateBuffer(geoParts[LINES], lines, sizeof(lines));
+	vGeometry.UpdateBuffer(geoLines, lines, sizeof(lines));
 	return true;
 }
 
@@ -712,30 +1005,16 @@ bool Render::GenerateUVRectangleVertices()
 	constexpr float uvRectColor[] = {0.0f, 1.0f, 1.0f};  // Cyan
 	constexpr float zOrder = 100.0f;  // Draw on top
 
-	// Triangle vertex indices for a quad
-	constexpr int tX[] = {0,1,1,0};
-	constexpr int tY[] = {0,0,1,1};
-
-	// Generate quad vertices (4 vertices with 6 attributes each: X, Y, Z, R, G, B)
-	float rectQuad[4*6];
-	for(int j = 0; j < 4*6; j+=6)
-	{
-		rectQuad[j+0] = x1 + (x2-x1)*tX[j/6];  // X
-		rectQuad[j+1] = y1 + (y2-y1)*tY[j/6];  // Y
-		rectQuad[j+2] = zOrder;                 // Z (draw on top)
-		rectQuad[j+3] = uvRectColor[0];        // R
-		rectQuad[j+4] = uvRectColor[1];        // G
-		rectQuad[j+5] = uvRectColor[2];        // B
-	}
-
-	quadsToDraw = 1;
-	vGeometry.UpdateBuffer(geoParts[BOXES], rectQuad, sizeof(rectQuad));
+	boxBatch.Clear();
+	boxBatch.Add(x1, y1, x2, y2, zOrder, uvRectColor);
+	boxBatch.Upload();
 	return true;
 }
 
 void Render::DontDraw()
 {
-	quadsToDraw = 0;
+	boxBatch.Clear();
+	boxBatch.Upload();
 	// Reset lines buffer to show only grid (no part origin markers)
 	float lines[]
 	{
@@ -748,14 +1027,14 @@ void Render::DontDraw()
 		0, 0, -1,	1,1,1,
 		0, 0, -1,	1,1,1,
 	};
-	vGeometry.UpdateBuffer(geoParts[LINES], lines, sizeof(lines));
+	vGeometry.UpdateBuffer(geoLines, lines, sizeof(lines));
 }
 
 void Render::ClearTexture()
 {
-	if (texture.isApplied) {
-		texture.Unapply();
-	}
+	// The standalone textures stay, their keys change with the CG
+	standalone = -1;
+	spritePage = -1;
 	curImageId = -1;
 }
 
@@ -773,9 +1052,9 @@ void Render::SetImageColor(float *rgba)
 	}
 }
 
-void Render::SetBlendingMode()
+void Render::SetBlendingMode(int mode)
 {
-	switch (blendingMode)
+	switch (mode)
 	{
 	default:
 	case normal:
@@ -784,11 +1063,11 @@ void Render::SetBlendingMode()
 		break;
 	case additive:
 		//glBlendEquation(GL_FUNC_ADD);
-		glBlendFunc(GL_SRC_ALPHA, GL_ONE);
+		GlState::BlendFunc(GL_SRC_ALPHA, GL_ONE);
 		break;
 	case subtractive:
-		glBlendFunc(GL_SRC_ALPHA, GL_ONE);
-		glBlendEquation(GL_FUNC_REVERSE_SUBTRACT);
+		GlState::BlendFunc(GL_SRC_ALPHA, GL_ONE);
+		GlState::BlendEquation(GL_FUNC_REVERSE_SUBTRACT);
 		break;
 	}
 }
@@ -796,7 +1075,14 @@ void Render::SetBlendingMode()
 // Multi-layer rendering support
 void Render::ClearLayers()
 {
-	renderLayers.clear();
+	layerAllocStart = AllocCounter::Count();
+
+	// Last frame's list goes away with the arena. Reserving as many layers
+	// as last time means the list doesn't grow in steady state.
+	size_t lastCount = renderLayers.size();
+	std::vector<RenderLayer, ArenaAllocator<RenderLayer>>(ArenaAllocator<RenderLayer>(&layerArena)).swap(renderLayers);
+	layerArena.Reset();
+	renderLayers.reserve(lastCount);
 	currentLayerIndex = 0;
 }
 
@@ -807,28 +1093,31 @@ void Render::AddLayer(const RenderLayer& layer)
 
 void Render::SortLayersByZPriority(int mainPatternPriority)
 {
-	// Sort layers by Z-priority
-	// Lower priority = draw first (behind)
-	// Higher priority = draw last (in front)
-	std::sort(renderLayers.begin(), renderLayers.end(),
-		[mainPatternPriority](const RenderLayer& a, const RenderLayer& b) {
-			// Calculate effective priorities based on game logic
-			int priorityA = a.zPriority;
-			int priorityB = b.zPriority;
-
-			// Handle special projectile priority logic if needed
-			// (For now using raw priority values)
-
-			return priorityA < priorityB;  // Lower draws first
-		});
+	// Lower priority draws first (behind), ties keep the order they were
+	// added in. Same order seqexport uses.
+	// Handle special projectile priority logic here if needed
+	// (for now using raw priority values)
+	SortLayersByZ(renderLayers.begin(), renderLayers.end(),
+		[](const RenderLayer& layer) { return layer.zPriority; });
 }
 
 void Render::DrawLayers()
 {
+	layerStats.layers = renderLayers.size();
+	layerStats.allocations = AllocCounter::Count() - layerAllocStart;
+	layerStats.arena = layerArena.GetStats();
+
 	if (renderLayers.empty()) {
+		if (picker.Requested())
+			DrawIds();
 		return;
 	}
 
+	// Sprites looked up from here on are kept in the atlas for this frame
+	atlas.BeginFrame();
+	spriteBatch.ResetStats();
+	boxBatch.ResetStats();
+
 	// Save original Parts pointer to restore later
 	Parts* origParts = m_parts;
 
@@ -845,17 +1134,58 @@ void Render::DrawLayers()
 	// If we have PAT layers, render them per-layer
 	if (hasPatLayers)
 	{
+		Profiler::Scope pass(Profiler::Parts);
 		constexpr float tau = glm::pi<float>()*2.f;
 
-		// Ensure no shader is active before starting (prevents GL_INVALID_OPERATION when switching Parts)
-		glUseProgram(0);
-
 		// Save original render state
 		int origX = x;
 		int origY = y;
 		int origOffsetX = offsetX;
 		int origOffsetY = offsetY;
 
+		// One shader and one state reset for every PAT layer. Consecutive
+		// layers of the same Parts are executed together with a single
+		// vertex upload.
+		sPartShader.Use();
+		glDisableVertexAttribArray(2);
+
+		// Callback to set matrix transform with layer-specific transforms
+		auto setMatrix = [this](glm::mat4 partMatrix) {
+			glm::mat4 rview = projection;
+			rview = glm::scale(rview, glm::vec3(scale, scale, 1.f));
+			rview = glm::translate(rview, glm::vec3(x + offsetX, y + offsetY, 0));
+			rview = glm::translate(rview, glm::vec3(0, 0, 1024.f));
+			rview *= invOrtho;
+			SetMatrixPersp(lProjectionParts, partMatrix, rview);
+		};
+
+		auto setAddColor = [this](float r, float g, float b) {
+			glUniform3f(lAddColorParts, r, g, b);
+		};
+
+		auto setFlip = [this](char flip) {
+			glUniform1i(lFlipParts, (int)flip);
+		};
+
+		const Parts::CommandList* batchLists[Parts::maxBatchedLists];
+		const RenderLayer* batchLayers[Parts::maxBatchedLists];
+		size_t batched = 0;
+		Parts* batchParts = nullptr;
+
+		// Apply layer-specific position offsets
+		auto setList = [&](size_t i) {
+			const RenderLayer& layer = *batchLayers[i];
+			x = origX + layer.spawnOffsetX;
+			y = origY + layer.spawnOffsetY;
+			offsetX = layer.frameOffsetX;
+			offsetY = layer.frameOffsetY;
+		};
+		auto flush = [&]() {
+			if (batched)
+				batchParts->ExecuteCommands(batchLists, batched, setList, setMatrix, setAddColor, setFlip);
+			batched = 0;
+		};
+
 		for (const auto& layer : renderLayers)
 		{
 			// Skip if not a PAT layer, or if fully transparent, or if invalid sprite ID
@@ -870,7 +1200,13 @@ void Render::DrawLayers()
 				continue;
 			}
 
-			// Switch Parts if needed (BEFORE starting shader)
+			// Lists of a batch all come from one Parts
+			if (layerParts != batchParts) {
+				flush();
+				batchParts = layerParts;
+			}
+
+			// Switch Parts if needed
 			bool switchedParts = false;
 			if (layerParts != m_parts) {
 				SetParts(layerParts);
@@ -878,39 +1214,12 @@ void Render::DrawLayers()
 
 				// Copy state pointers from original Parts to layer Parts for TEXTURE_VIEW support
 				// Effect Parts don't have their own views, so they inherit state from main character
-				if (origParts && origParts->renderMode && origParts->currState) {
+				if (origParts && origParts->renderMode && origParts->currState &&
+					(m_parts->currState != origParts->currState || m_parts->renderMode != origParts->renderMode)) {
 					m_parts->updatePatEditorReferences(origParts->currState, origParts->renderMode);
 				}
 			}
 
-			// Start shader and setup for this layer
-			sPartShader.Use();
-			glDisableVertexAttribArray(2);
-
-			// Apply layer-specific position offsets
-			x = origX + layer.spawnOffsetX;
-			y = origY + layer.spawnOffsetY;
-			offsetX = layer.frameOffsetX;
-			offsetY = layer.frameOffsetY;
-
-			// Callback to set matrix transform with layer-specific transforms
-			auto setMatrix = [this](glm::mat4 partMatrix) {
-				glm::mat4 rview = projection;
-				rview = glm::scale(rview, glm::vec3(scale, scale, 1.f));
-				rview = glm::translate(rview, glm::vec3(x + offsetX, y + offsetY, 0));
-				rview = glm::translate(rview, glm::vec3(0, 0, 1024.f));
-				rview *= invOrtho;
-				SetMatrixPersp(lProjectionParts, partMatrix, rview);
-			};
-
-			auto setAddColor = [this](float r, float g, float b) {
-				glUniform3f(lAddColorParts, r, g, b);
-			};
-
-			auto setFlip = [this](char flip) {
-				glUniform1i(lFlipParts, (int)flip);
-			};
-
 			// Render layer color
 			float layerColor[4] = {
 				layer.tintColor.r,
@@ -919,22 +1228,27 @@ void Render::DrawLayers()
 				layer.alpha
 			};
 
-			// Draw this layer's PAT
-			m_parts->Draw(layer.spriteId, layer.spriteId, 0.0f, setMatrix, setAddColor, setFlip, layerColor);
-
-			// Reset GL state after Parts::Draw() to prevent GL_INVALID_OPERATION
-			glBindBuffer(GL_ARRAY_BUFFER, 0);  // Unbind VBO
-			glBindTexture(GL_TEXTURE_2D, 0);    // Unbind texture
-			glUseProgram(0);                    // Disable shader
-
-			// Clear any pending GL errors from PAT rendering
-			while (glGetError() != GL_NO_ERROR);
+			if (const Parts::CommandList* list = m_parts->BuildCommands(layer.spriteId, layer.spriteId, 0.0f, layerColor)) {
+				// Parts still waiting for their texture keep the scene from being cached
+				sceneMisses += list->placeholders;
+				batchLists[batched] = list;
+				batchLayers[batched] = &layer;
+				++batched;
+				if (batched == Parts::maxBatchedLists)
+					flush();
+			}
 
 			// Restore Parts if we switched
 			if (switchedParts) {
 				SetParts(origParts);
 			}
 		}
+		flush();
+
+		// Reset GL state after the parts to prevent GL_INVALID_OPERATION
+		GlState::BindBuffer(GL_ARRAY_BUFFER, 0);  // Unbind VBO
+		GlState::BindTexture(0);                  // Unbind texture
+		GlState::UseProgram(0);                   // Disable shader
 
 		// Restore render state
 		x = origX;
@@ -968,6 +1282,7 @@ void Render::DrawLayers()
 	Parts* origCGParts = m_parts;
 
 	// Draw each layer (CG sprites only - PAT layers already rendered above)
+	Profiler::Begin(Profiler::Sprites);
 	for (const auto& layer : renderLayers)
 	{
 		// Skip if fully transparent
@@ -988,24 +1303,7 @@ void Render::DrawLayers()
 			SetParts(layer.sourceParts);
 		}
 
-		// Apply layer-specific transforms (spawn offset + frame offset)
-		// TODO: Implement positioning flags:
-		//   flagset1 & 0x10: Coordinates relative to camera
-		//   flagset2 & 0x100: Position relative to opponent
-		//   flagset2 & 0x200: Position relative to (-32768, 0)
-		// For now, using basic relative positioning
-		x = origX + layer.spawnOffsetX;
-		y = origY + layer.spawnOffsetY;
-		offsetX = layer.frameOffsetX;
-		offsetY = layer.frameOffsetY;
-
-		// Apply layer scale and rotation
-		scaleX = layer.scaleX;
-		scaleY = layer.scaleY;
-		rotX = layer.rotX;
-		rotY = layer.rotY;
-		rotZ = layer.rotZ;
-		AFRT = layer.AFRT;
+		SetLayerTransform(layer, origX, origY);
 
 		// Apply blend mode
 		switch (layer.blendMode)
@@ -1027,46 +1325,41 @@ void Render::DrawLayers()
 		colorRgba[2] = layer.tintColor.b * origColorRgba[2];
 		colorRgba[3] = layer.alpha * origColorRgba[3];
 
-		// Generate hitboxes for this layer
-		GenerateHitboxVertices(layer.hitboxes);
-
-		// Switch to this layer's sprite and draw sprite WITHOUT hitboxes
-		// (Hitboxes will be drawn in a second pass to ensure they're on top)
+		// Queue this layer's sprite, hitboxes are drawn in a second pass
+		// to ensure they're on top. Adjacent layers sharing an atlas page and
+		// blend mode end up in the same draw call.
 		SwitchImage(layer.spriteId);
-		DrawSpriteOnly(false);
+		QueueSprite();
 	}
-
-	// Second pass: Draw all hitboxes on top of all sprites
+	FlushSprites();
+	batchStats = spriteBatch.GetStats();
+	Profiler::End(Profiler::Sprites);
+
+	// Second pass: all layers' hitboxes on top of all sprites, uploaded once
+	// with the spawn offsets baked in (no offsetX/offsetY for boxes).
+	Profiler::Begin(Profiler::Hitboxes);
+	boxBatch.Clear();
 	for (const auto& layer : renderLayers)
 	{
 		// Skip if it's a PAT layer (hitboxes handled separately for PAT)
-		if (layer.usePat) continue;
-
-		// Only draw hitboxes if this layer has any
-		if (layer.hitboxes.empty()) continue;
-
-		// Apply layer-specific position for hitboxes (no offsetX/offsetY for boxes)
-		x = origX + layer.spawnOffsetX;
-		y = origY + layer.spawnOffsetY;
-
-		// Generate hitbox vertices for this layer
-		GenerateHitboxVertices(layer.hitboxes);
+		if (layer.usePat || !layer.hitboxes) continue;
+		AddHitboxes(*layer.hitboxes, layer.spawnOffsetX, layer.spawnOffsetY);
+	}
+	boxBatch.Upload();
 
-		// Draw hitboxes
+	if (boxBatch.Count())
+	{
 		glDepthMask(GL_FALSE);
 		glm::mat4 view = glm::mat4(1.f);
 		view = glm::scale(view, glm::vec3(scale, scale, 1.f));
-		view = glm::translate(view, glm::vec3(x, y, 0.f));
+		view = glm::translate(view, glm::vec3(origX, origY, 0.f));
 		SetModelView(std::move(view));
 		sSimple.Use();
-		SetMatrix(lProjectionS);
-		vGeometry.Bind();
-		glUniform1f(lAlphaS, 0.6f);
-		vGeometry.DrawQuads(GL_LINE_LOOP, quadsToDraw);
-		glUniform1f(lAlphaS, 0.3f);
-		vGeometry.DrawQuads(GL_TRIANGLE_FAN, quadsToDraw);
+		SetSimpleMatrix();
+		DrawBoxes();
 		glDepthMask(GL_TRUE);
 	}
+	Profiler::End(Profiler::Hitboxes);
 
 	// Restore original CG and Parts
 	if (cg != origCG) {
@@ -1092,4 +1385,135 @@ void Render::DrawLayers()
 	colorRgba[1] = origColorRgba[1];
 	colorRgba[2] = origColorRgba[2];
 	colorRgba[3] = origColorRgba[3];
-}
\ No newline at end of file
+
+	if (picker.Requested())
+		DrawIds();
+}
+
+void Render::SetLayerTransform(const RenderLayer& layer, int baseX, int baseY)
+{
+	// Apply layer-specific transforms (spawn offset + frame offset)
+	// TODO: Implement positioning flags:
+	//   flagset1 & 0x10: Coordinates relative to camera
+	//   flagset2 & 0x100: Position relative to opponent
+	//   flagset2 & 0x200: Position relative to (-32768, 0)
+	// For now, using basic relative positioning
+	x = baseX + layer.spawnOffsetX;
+	y = baseY + layer.spawnOffsetY;
+	offsetX = layer.frameOffsetX;
+	offsetY = layer.frameOffsetY;
+
+	// Apply layer scale and rotation
+	scaleX = layer.scaleX;
+	scaleY = layer.scaleY;
+	rotX = layer.rotX;
+	rotY = layer.rotY;
+	rotZ = layer.rotZ;
+	AFRT = layer.AFRT;
+}
+
+void Render::DrawIds()
+{
+	if (!picker.Begin(clientRect.x, clientRect.y))
+		return;
+
+	// Same order as DrawLayers: parts, then sprites. Boxes can't be picked.
+	int origX = x;
+	int origY = y;
+	int origOffsetX = offsetX;
+	int origOffsetY = offsetY;
+	float origScaleX = scaleX;
+	float origScaleY = scaleY;
+	float origRotX = rotX;
+	float origRotY = rotY;
+	float origRotZ = rotZ;
+	bool origAFRT = AFRT;
+	float origColorRgba[4] = {colorRgba[0], colorRgba[1], colorRgba[2], colorRgba[3]};
+	CG* origCG = cg;
+
+	std::vector<int> targets(renderLayers.size(), -1);
+	for (size_t i = 0; i < renderLayers.size(); i++) {
+		const RenderLayer& layer = renderLayers[i];
+		if (layer.alpha != 0.0f)
+			targets[i] = picker.AddTarget({layer.spawnIndex, layer.frameLayer});
+	}
+
+	for (size_t i = 0; i < renderLayers.size(); i++)
+	{
+		const RenderLayer& layer = renderLayers[i];
+		Parts* layerParts = layer.sourceParts ? layer.sourceParts : m_parts;
+		if (!layer.usePat || targets[i] < 0 || layer.spriteId < 0 || !layerParts || !layerParts->loaded)
+			continue;
+
+		float layerColor[4] = {layer.tintColor.r, layer.tintColor.g, layer.tintColor.b, layer.alpha};
+		const Parts::CommandList* list = layerParts->BuildCommands(layer.spriteId, layer.spriteId, 0.0f, layerColor);
+		if (!list)
+			continue;
+
+		x = origX + layer.spawnOffsetX;
+		y = origY + layer.spawnOffsetY;
+		offsetX = layer.frameOffsetX;
+		offsetY = layer.frameOffsetY;
+
+		sPartId.Use();
+		glDisableVertexAttribArray(2);
+		auto setMatrix = [this](glm::mat4 partMatrix) {
+			glm::mat4 rview = projection;
+			rview = glm::scale(rview, glm::vec3(scale, scale, 1.f));
+			rview = glm::translate(rview, glm::vec3(x + offsetX, y + offsetY, 0));
+			rview = glm::translate(rview, glm::vec3(0, 0, 1024.f));
+			rview *= invOrtho;
+			SetMatrixPersp(lProjectionPartId, partMatrix, rview);
+		};
+		auto setFlip = [this](char flip) {
+			glUniform1i(lFlipPartId, (int)flip);
+		};
+		int target = targets[i];
+		auto setPart = [this, target](int group) {
+			int id[2];
+			IdPicker::Id(target, group, id);
+			glUniform2iv(lIdPart, 1, id);
+		};
+		layerParts->ExecuteCommands(*list, setMatrix, [](float, float, float) {}, setFlip, setPart);
+		GlState::BindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+
+	curImageId = -1;
+	// SwitchImage can flush too, so it has to know what's queued
+	idSprites = true;
+	for (size_t i = 0; i < renderLayers.size(); i++)
+	{
+		const RenderLayer& layer = renderLayers[i];
+		if (layer.usePat || targets[i] < 0)
+			continue;
+		if (layer.sourceCG && layer.sourceCG != cg)
+			SetCg(layer.sourceCG);
+		SetLayerTransform(layer, origX, origY);
+		int id[2];
+		IdPicker::Id(targets[i], -1, id);
+		colorRgba[0] = id[0];
+		colorRgba[1] = id[1];
+		colorRgba[2] = 0.f;
+		colorRgba[3] = 1.f;
+		SwitchImage(layer.spriteId);
+		QueueSprite();
+	}
+	FlushSprites();
+	idSprites = false;
+	picker.End();
+
+	if (cg != origCG)
+		SetCg(origCG);
+	x = origX;
+	y = origY;
+	offsetX = origOffsetX;
+	offsetY = origOffsetY;
+	scaleX = origScaleX;
+	scaleY = origScaleY;
+	rotX = origRotX;
+	rotY = origRotY;
+	rotZ = origRotZ;
+	AFRT = origAFRT;
+	for (int i = 0; i < 4; i++)
+		colorRgba[i] = origColorRgba[i];
+}
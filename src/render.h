@@ -6,8 +6,17 @@
 #include "shader.h"
 #include "vao.h"
 #include "hitbox.h"
+#include "sprite_atlas.h"
+#include "sprite_batch.h"
+#include "box_batch.h"
+#include "sprite_prefetch.h"
+#include "scene_cache.h"
+#include "frame_arena.h"
+#include "id_picker.h"
 #include <vector>
 #include <unordered_map>
+#include <unordered_set>
+#include <memory>
 #include <glm/mat4x4.hpp>
 #include <glm/vec4.hpp>
 
@@ -27,7 +36,7 @@ struct RenderLayer {
 	float alpha;
 	glm::vec4 tintColor;
 	bool isSpawned;
-	BoxList hitboxes;  // Hitboxes for this layer
+	const BoxList* hitboxes;  // Frame's hitboxes (layer 0 only), nullptr if none. Must outlive DrawLayers.
 	CG* sourceCG;          // CG to pull sprite from (for effect.ha6 support)
 	bool usePat;           // True if layer uses PAT rendering
 	Parts* sourceParts;    // Parts to use (for PAT rendering, like sourceCG)
@@ -36,6 +45,10 @@ struct RenderLayer {
 	int spawnFlagset1;     // From effect parameters[2]
 	int spawnFlagset2;     // From effect parameters[3]
 
+	// What picking reports for this layer
+	int spawnIndex;        // In the spawn list it was built from, -1 for the main pattern
+	int frameLayer;        // In the frame's AF layers
+
 	RenderLayer() :
 		spriteId(-1), spawnOffsetX(0), spawnOffsetY(0),
 		frameOffsetX(0), frameOffsetY(0),
@@ -44,52 +57,109 @@ struct RenderLayer {
 		AFRT(false),
 		blendMode(0), zPriority(0),
 		alpha(1.0f), tintColor(1.0f, 1.0f, 1.0f, 1.0f),
-		isSpawned(false), sourceCG(nullptr),
+		isSpawned(false), hitboxes(nullptr), sourceCG(nullptr),
 		usePat(false), sourceParts(nullptr),
-		spawnFlagset1(0), spawnFlagset2(0) {}
+		spawnFlagset1(0), spawnFlagset2(0),
+		spawnIndex(-1), frameLayer(0) {}
 };
 
 class Render
 {
+public:
+	struct LayerStats
+	{
+		int layers;
+		uint64_t allocations; // Heap allocations on this thread from ClearLayers to DrawLayers, last frame.
+		FrameArena::Stats arena;
+	};
+
 private:
 	glm::mat4 projection, view;
 	glm::mat4 perspective;  // Perspective projection for PAT rendering
 	glm::mat4 invOrtho;     // Inverse orthographic for coordinate transforms
+	glm::mat4 simpleMatrix; // Last one sSimple got, the boxes are drawn with it too
 
 	CG *cg;
 	Parts *m_parts;
 	Vao vSprite;
 	Vao vGeometry;
 	Shader sPartShader;
-	enum{
-		LINES = 0,
-		BOXES,
-		GEO_SIZE
-	};
-	int geoParts[GEO_SIZE];
+	int geoLines;
 	float imageVertex[6*4];
-	std::vector<float> clientQuads;
-	int quadsToDraw;
+	BoxBatch boxBatch;      // Hitboxes and the UV rectangle, any number of them
 
 	int lProjectionS, lProjectionT, lProjectionParts;
 	int lAlphaS;
 	int lFlipParts, lAddColorParts;
 	Shader sSimple;
 	Shader sTextured;
-	Texture texture;
+	Shader sBox;            // Instanced boxes, BoxBatch::vertexSource
+	int lProjectionBox, lAlphaBox;
+	// Id pass versions of the parts and sprite shaders
+	Shader sPartId;
+	Shader sSpriteId;
+	int lProjectionPartId, lFlipPartId, lIdPart;
+	int lProjectionSpriteId;
+	IdPicker picker;
+	SpriteAtlas atlas;
+	// Sprites too big for an atlas page, or that didn't fit next to the
+	// frame's others, as textures of their own. Kept until the slot is needed
+	// so they aren't decoded again every time they're switched to.
+	struct Standalone
+	{
+		uint64_t key;
+		Texture texture;
+		int offsetX, offsetY, width, height;
+		bool linearFilter;
+		unsigned int lastUsed;
+	};
+	static constexpr int maxStandalones = 8;
+	Standalone standalones[maxStandalones];
+	int standalone;         // Slot of the current sprite, -1 if none
+	unsigned int standaloneUse;
+	SpritePrefetcher prefetcher;
+	// Sprites decoded on demand that didn't fit the atlas, used as standalone
+	// textures the next time they're switched to.
+	std::unordered_map<uint64_t, std::unique_ptr<ImageData>> lateImages;
+	std::vector<uint64_t> demanded;
+	// Sprites the workers couldn't decode (bad id, no image, 0x0). They're
+	// skipped instead of being asked for again every frame.
+	std::unordered_set<uint64_t> brokenSprites;
+	int spritePage;         // Atlas page of the current sprite, -1 if none
+	SpriteBatch spriteBatch;
+	bool idSprites;         // What's queued is the id pass, see DrawIds
+	SpriteBatch::Stats batchStats; // Last DrawLayers call
+	SceneCache scene;
+	int sceneMisses;        // Sprites and parts textures that weren't decoded yet since the scene was started
+	bool sceneBound;        // Drawing into the scene cache's framebuffer
 	float colorRgba[4];
 
 	int curImageId;
 
 	// Multi-layer rendering support
-	std::vector<RenderLayer> renderLayers;
+	// The layer list lives in layerArena and is rebuilt every frame.
+	FrameArena layerArena;
+	std::vector<RenderLayer, ArenaAllocator<RenderLayer>> renderLayers;
 	int currentLayerIndex;
+	LayerStats layerStats;
+	uint64_t layerAllocStart;
 
-	void AdjustImageQuad(int x, int y, int w, int h);
+	void AdjustImageQuad(int x, int y, int w, int h, const float *uv = nullptr);
+	bool UseStandalone(uint64_t key);
+	void AddStandalone(uint64_t key, ImageData *image);
+	bool BindSprite();
 	void SetModelView(glm::mat4&& view);
 	void SetMatrix(int location);
+	void SetSimpleMatrix(); // SetMatrix(lProjectionS), remembered for DrawBoxes
 	void SetMatrixPersp(int location, glm::mat4 view, glm::mat4 pre);  // For PAT perspective rendering
-	void SetBlendingMode();
+	void SetBlendingMode(int mode);
+	glm::mat4 SpriteModelView() const;
+	void QueueSprite();     // Adds the current sprite to spriteBatch
+	void FlushSprites();
+	void SetLayerTransform(const RenderLayer &layer, int baseX, int baseY);
+	void DrawIds();         // The picker's pass over the layers just drawn
+	void AddHitboxes(const BoxList &hitboxes, float dx, float dy);
+	void DrawBoxes();
 
 public:
 	bool filter;
@@ -106,6 +176,10 @@ public:
 	int curPattern = 0;
 	int curNextPattern = 0;
 	float curInterp = 0.0f;
+
+	// Decode missing sprites in the background and show them once ready,
+	// instead of stalling the frame.
+	bool asyncSprites = true;
 	
 	Render();
 	void Draw();
@@ -130,6 +204,38 @@ public:
 	void DrawLayers();
 	bool HasLayers() const { return !renderLayers.empty(); }
 
+	// Picking: what's at x, y (client area) is found with an id pass the
+	// next time layers are drawn and comes back from PollPick a few frames
+	// later, see IdPicker.
+	void RequestPick(int x, int y) { picker.Request(x, y); }
+	bool PickRequested() const { return picker.Requested(); }
+	bool PickPending() const { return picker.Busy(); }
+	bool PollPick(IdPicker::Pick &pick) { return picker.Poll(pick); }
+
+	SpriteAtlas::Stats GetAtlasStats() const { return atlas.GetStats(); }
+	SpriteBatch::Stats GetBatchStats() const { return batchStats; }
+	BoxBatch::Stats GetBoxStats() const { return boxBatch.GetStats(); }
+	SceneCache::Stats GetSceneStats() const { return scene.GetStats(); }
+	LayerStats GetLayerStats() const { return layerStats; }
+
+	// Adds what the renderer itself contributes to the scene (view, zoom,
+	// filtering, colors, highlighted box) to the caller's inputs.
+	uint64_t SceneKey(SceneCache::Hasher inputs) const;
+	// Blits the cached scene if it was drawn from the same key. Otherwise
+	// returns false and the scene has to be drawn between BeginScene and
+	// EndScene, which draw it into the cache and blit it to the window.
+	bool DrawCachedScene(uint64_t key);
+	void BeginScene();
+	void EndScene(uint64_t key);
+
+	// Decode sprites in the background (in the given order) so they're already
+	// in the atlas when playback reaches them.
+	void PrefetchSprites(const std::vector<SpritePrefetcher::Request> &sprites);
+	// Moves decoded sprites into the atlas until budgetMs is spent.
+	void UploadPrefetched(double budgetMs);
+	// Decoded sprites are still waiting for UploadPrefetched.
+	bool HasPendingUploads() { return prefetcher.HasReady(); }
+
 	enum blendType{
 		normal,
 		additive,
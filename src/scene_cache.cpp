@@ -0,0 +1,93 @@
+#include "scene_cache.h"
+#include "gl_ext.h"
+#include "gl_state.h"
+
+SceneCache::SceneCache():
+fbo(0),
+texture(0),
+depth(0),
+width(0), height(0),
+key(0),
+valid(false),
+stats{}
+{
+}
+
+SceneCache::~SceneCache()
+{
+	if(fbo)
+		GlExt::DeleteFramebuffers(1, &fbo);
+	if(depth)
+		GlExt::DeleteRenderbuffers(1, &depth);
+	if(texture)
+	{
+		GlState::ForgetTexture(texture);
+		glDeleteTextures(1, &texture);
+	}
+}
+
+bool SceneCache::Valid(uint64_t key_, int w, int h) const
+{
+	return valid && key == key_ && width == w && height == h;
+}
+
+bool SceneCache::Begin(int w, int h)
+{
+	if(w <= 0 || h <= 0)
+		return false;
+
+	if(!fbo)
+	{
+		GlExt::GenFramebuffers(1, &fbo);
+		GlExt::GenRenderbuffers(1, &depth);
+		glGenTextures(1, &texture);
+	}
+	GlExt::BindFramebuffer(GlExt::FRAMEBUFFER, fbo);
+	if(w != width || h != height)
+	{
+		valid = false;
+		GlState::BindTexture(texture);
+		//Blitted 1:1, filtering never kicks in.
+		GlState::TexFilter(GL_NEAREST);
+		GlState::TexParameter(GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		GlState::TexParameter(GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+		GlExt::BindRenderbuffer(GlExt::RENDERBUFFER, depth);
+		GlExt::RenderbufferStorage(GlExt::RENDERBUFFER, GlExt::DEPTH24_STENCIL8, w, h);
+		GlExt::BindRenderbuffer(GlExt::RENDERBUFFER, 0);
+		GlExt::FramebufferTexture2D(GlExt::FRAMEBUFFER, GlExt::COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
+		GlExt::FramebufferRenderbuffer(GlExt::FRAMEBUFFER, GlExt::DEPTH_STENCIL_ATTACHMENT, GlExt::RENDERBUFFER, depth);
+		width = w;
+		height = h;
+	}
+	if(GlExt::CheckFramebufferStatus(GlExt::FRAMEBUFFER) != GlExt::FRAMEBUFFER_COMPLETE)
+	{
+		GlExt::BindFramebuffer(GlExt::FRAMEBUFFER, 0);
+		valid = false;
+		return false;
+	}
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+	return true;
+}
+
+void SceneCache::End(uint64_t key_, bool keep)
+{
+	GlExt::BindFramebuffer(GlExt::FRAMEBUFFER, 0);
+	if(!keep)
+	{
+		valid = false;
+		++stats.skipped;
+		return;
+	}
+	key = key_;
+	valid = true;
+	++stats.captures;
+}
+
+void SceneCache::Present() const
+{
+	GlExt::BindFramebuffer(GlExt::READ_FRAMEBUFFER, fbo);
+	GlExt::BindFramebuffer(GlExt::DRAW_FRAMEBUFFER, 0);
+	GlExt::BlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+	GlExt::BindFramebuffer(GlExt::FRAMEBUFFER, 0);
+}
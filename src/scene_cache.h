@@ -0,0 +1,76 @@
+#ifndef SCENE_CACHE_H_GUARD
+#define SCENE_CACHE_H_GUARD
+
+#include <cstddef>
+#include <cstdint>
+
+// Draws the scene (grid, sprites, parts and boxes, before imgui draws on top)
+// into a texture-backed framebuffer and blits it to the window. The texture is
+// tagged with a hash of everything it was drawn from, and while the hash
+// doesn't change the scene doesn't need to be drawn again.
+class SceneCache
+{
+public:
+	//FNV-1a over whatever the scene depends on.
+	class Hasher
+	{
+	public:
+		Hasher(): hash(0xcbf29ce484222325ull) {}
+
+		void Add(const void *data, size_t size)
+		{
+			const unsigned char *bytes = (const unsigned char*)data;
+			for(size_t i = 0; i < size; ++i)
+				hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+		}
+		template<typename T>
+		void Add(const T &value) { Add(&value, sizeof(T)); }
+
+		uint64_t Get() const { return hash; }
+
+	private:
+		uint64_t hash;
+	};
+
+	struct Stats
+	{
+		int hits;     //Frames that reused the texture.
+		int captures; //Frames that drew the scene and kept it.
+		int skipped;  //Frames that drew the scene but couldn't keep it.
+	};
+
+	SceneCache();
+	~SceneCache();
+
+	//Whether the texture holds a scene with this key and size.
+	bool Valid(uint64_t key, int w, int h) const;
+	//Binds the framebuffer, sized w*h with depth and stencil, and clears it
+	//to the current clear color. False if it can't be made, draw to the
+	//window instead.
+	bool Begin(int w, int h);
+	//Back to the window. The scene is kept under key if keep is set.
+	void End(uint64_t key, bool keep);
+	//Copies the texture to the window's lower left corner.
+	void Present() const;
+	void Invalidate() { valid = false; }
+
+	unsigned int Texture() const { return texture; }
+	unsigned int Framebuffer() const { return fbo; }
+	int Width() const { return width; }
+	int Height() const { return height; }
+
+	void CountHit() { ++stats.hits; }
+	void CountSkip() { ++stats.skipped; }
+	Stats GetStats() const { return stats; }
+
+private:
+	unsigned int fbo;
+	unsigned int texture;
+	unsigned int depth;
+	int width, height;
+	uint64_t key;
+	bool valid;
+	Stats stats;
+};
+
+#endif /* SCENE_CACHE_H_GUARD */
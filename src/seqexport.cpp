@@ -0,0 +1,489 @@
+// Headless pattern renderer: plays patterns tick by tick with their spawns,
+// composites them on the CPU like the editor's viewport does and writes a
+// PNG sequence, an animated PNG or a Y4M video per pattern.
+// Built as seqexport.exe. No GL involved, so it also runs on Linux.
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "cg.h"
+#include "framedata.h"
+#include "framestate.h"
+#include "layer_order.h"
+#include "png.h"
+#include "soft_compositor.h"
+
+namespace fs = std::filesystem;
+
+enum class Format { Png, Apng, Y4m };
+
+struct Options
+{
+	fs::path outDir = ".";
+	Format format = Format::Png;
+	int width = 512, height = 512;
+	int originX = -1, originY = -1; //Pixels, default centered near the bottom.
+	float zoom = 1;
+	int maxTicks = 600;
+	bool boxes = true;
+	float background[4] = {0, 0, 0, 0};
+	int threads = std::thread::hardware_concurrency();
+};
+
+struct Character
+{
+	FrameData frameData;
+	CG cg;
+	bool loaded = false;
+};
+
+//One layer of one tick, before the sprite is decoded.
+struct Item
+{
+	CG *cg;
+	int spriteId;
+	int zPriority;
+	SoftCompositor::Layer layer;
+};
+
+static void Usage()
+{
+	printf("Usage: seqexport [options] <file.ha6> <file.cg> <pattern | all>...\n"
+		"  -o <dir>      Output folder (default: current folder)\n"
+		"  -f <format>   png (one file per tick), apng or y4m (default: png)\n"
+		"  -e <ha6> <cg> Effect data for type 8 spawns\n"
+		"  -p <file>     Palette file (default: the .pal next to the .cg)\n"
+		"  -n <index>    Palette number\n"
+		"  -s <w>x<h>    Image size (default: 512x512)\n"
+		"  -c <x>,<y>    Where the character's origin goes (default: centered, 7/8 down)\n"
+		"  -z <zoom>     Scale (default: 1)\n"
+		"  -t <ticks>    Longest pattern to render, looping ones stop here (default: 600)\n"
+		"  -b <rrggbbaa> Background color (default: 00000000)\n"
+		"  -x            No boxes\n"
+		"  -j <count>    Worker threads (default: all cores)\n"
+		"One tick is one frame at 60 FPS.\n");
+}
+
+static bool LoadCharacter(Character &character, const char *ha6, const char *cgFile, const std::string &palFile, int palNumber)
+{
+	if(!character.frameData.load(ha6))
+	{
+		printf("Can't load %s\n", ha6);
+		return false;
+	}
+	if(!character.cg.load(cgFile))
+	{
+		printf("Can't load %s\n", cgFile);
+		return false;
+	}
+
+	fs::path pal = palFile.empty() ? fs::path(cgFile).replace_extension(".pal") : fs::path(palFile);
+	std::error_code ec;
+	if(fs::exists(pal, ec))
+	{
+		if(!character.cg.loadPalette(pal.string().c_str()))
+			printf("Can't load palette %s\n", pal.string().c_str());
+		else if(!character.cg.changePaletteNumber(palNumber))
+			printf("%s has no palette %d\n", pal.string().c_str(), palNumber);
+	}
+	character.loaded = true;
+	return true;
+}
+
+//Ticks until the pattern stops. Looping patterns go on until maxTicks.
+static int PatternLength(FrameData *frameData, int pattern, int maxTicks)
+{
+	auto seq = frameData->get_sequence(pattern);
+	int last = -1, run = 0;
+	for(int tick = 0; tick < maxTicks; ++tick)
+	{
+		int frame = SimulateAnimationFlow(frameData, pattern, tick);
+		run = frame == last ? run + 1 : 1;
+		last = frame;
+
+		auto &af = seq->frames[frame].AF;
+		bool ends = af.aniType == 0 || (af.aniType == 1 && frame + 1 >= (int)seq->frames.size());
+		if(ends && run >= std::max(1, af.duration))
+			return tick + 1;
+	}
+	return maxTicks;
+}
+
+static void AddLayer(std::vector<Item> &items, CG *cg, const Layer<> &data, const Frame_AF &af,
+	int zPriority, const BoxList *hitboxes)
+{
+	if(data.usePat) //Needs the parts renderer, boxes included.
+		return;
+
+	Item item;
+	item.cg = cg;
+	item.spriteId = data.spriteId;
+	item.zPriority = zPriority;
+	SoftCompositor::Layer &layer = item.layer;
+	layer.image = nullptr;
+	layer.spawnOffsetX = layer.spawnOffsetY = 0;
+	layer.frameOffsetX = data.offset_x;
+	layer.frameOffsetY = data.offset_y;
+	layer.scaleX = data.scale[0];
+	layer.scaleY = data.scale[1];
+	layer.rotX = data.rotation[0];
+	layer.rotY = data.rotation[1];
+	layer.rotZ = data.rotation[2];
+	layer.AFRT = af.AFRT;
+	layer.blendMode = data.blend_mode;
+	memcpy(layer.color, data.rgba, sizeof(layer.color));
+	layer.hitboxes = hitboxes;
+	items.push_back(item);
+}
+
+//Same layers MainFrame::DrawBack builds for a paused frame with spawns.
+//The spawn visualization tint is left out.
+static std::vector<Item> BuildTick(Character &main, Character *effect, int pattern, int tick)
+{
+	std::vector<Item> items;
+	auto seq = main.frameData.get_sequence(pattern);
+	auto &frame = seq->frames[SimulateAnimationFlow(&main.frameData, pattern, tick)];
+	static const Layer<> defaultLayer;
+
+	size_t layerCount = std::max<size_t>(1, frame.AF.layers.size());
+	for(size_t i = 0; i < layerCount; ++i)
+	{
+		const auto &data = frame.AF.layers.empty() ? defaultLayer : frame.AF.layers[i];
+		AddLayer(items, &main.cg, data, frame.AF, frame.AF.priority, i == 0 ? &frame.hitboxes : nullptr);
+	}
+	const auto &parentLayer = frame.AF.layers.empty() ? defaultLayer : frame.AF.layers[0];
+
+	std::vector<ActiveSpawnInstance> spawns;
+	SimulateSpawnsToTick(&main.frameData, effect ? &effect->frameData : nullptr, pattern, tick, spawns);
+	for(const auto &spawn : spawns)
+	{
+		if(spawn.isPresetEffect)
+			continue;
+		Character *source = spawn.usesEffectHA6 && effect ? effect : &main;
+		auto spawnSeq = source->frameData.get_sequence(spawn.patternId);
+		if(!spawnSeq || spawn.currentFrame < 0 || spawn.currentFrame >= (int)spawnSeq->frames.size())
+			continue;
+
+		auto &spawnFrame = spawnSeq->frames[spawn.currentFrame];
+		layerCount = std::max<size_t>(1, spawnFrame.AF.layers.size());
+		for(size_t i = 0; i < layerCount; ++i)
+		{
+			const auto &data = spawnFrame.AF.layers.empty() ? defaultLayer : spawnFrame.AF.layers[i];
+			size_t first = items.size();
+			AddLayer(items, &source->cg, data, spawnFrame.AF, spawn.currentZPriority,
+				i == 0 ? &spawnFrame.hitboxes : nullptr);
+			if(items.size() == first)
+				continue;
+
+			SoftCompositor::Layer &layer = items.back().layer;
+			layer.spawnOffsetX = spawn.offsetX;
+			layer.spawnOffsetY = spawn.offsetY;
+			layer.rotZ += spawn.angle / 10000.0f;
+			if(spawn.flagset1 & (1 << 11)) //Flip facing
+			{
+				layer.scaleX *= -1.0f;
+				layer.spawnOffsetX *= -1;
+			}
+			if(spawn.flagset1 & (1 << 8)) //Inherit parent rotation
+			{
+				layer.rotX += parentLayer.rotation[0];
+				layer.rotY += parentLayer.rotation[1];
+				layer.rotZ += parentLayer.rotation[2];
+			}
+		}
+	}
+
+	SortLayersByZ(items.begin(), items.end(), [](const Item &item) { return item.zPriority; });
+	return items;
+}
+
+typedef std::map<std::pair<CG*, int>, std::unique_ptr<ImageData>> SpriteCache;
+
+//Decodes every sprite the ticks use that isn't in the cache yet, on all threads.
+static void DecodeSprites(std::vector<std::vector<Item>> &ticks, SpriteCache &cache, int threadCount)
+{
+	std::vector<std::pair<CG*, int>> missing;
+	for(auto &items : ticks)
+	{
+		for(auto &item : items)
+		{
+			auto key = std::make_pair(item.cg, item.spriteId);
+			if(item.spriteId >= 0 && !cache.count(key))
+			{
+				cache[key] = nullptr;
+				missing.push_back(key);
+			}
+		}
+	}
+
+	std::vector<std::unique_ptr<ImageData>> images(missing.size());
+	std::atomic<size_t> next(0);
+	auto worker = [&]() {
+		size_t i;
+		while((i = next++) < missing.size())
+			images[i].reset(missing[i].first->draw_texture(missing[i].second, false, false));
+	};
+	std::vector<std::thread> threads;
+	for(int i = 0; i < threadCount; ++i)
+		threads.emplace_back(worker);
+	for(auto &thread : threads)
+		thread.join();
+
+	for(size_t i = 0; i < missing.size(); ++i)
+		cache[missing[i]] = std::move(images[i]);
+
+	for(auto &items : ticks)
+	{
+		for(auto &item : items)
+		{
+			auto found = cache.find(std::make_pair(item.cg, item.spriteId));
+			item.layer.image = found != cache.end() ? found->second.get() : nullptr;
+		}
+	}
+}
+
+//Planar 4:4:4 BT.601 with the usual limited range, alpha is dropped.
+static void ToYuv(std::vector<unsigned char> &out, const std::vector<unsigned char> &rgba, int width, int height)
+{
+	size_t count = (size_t)width * height;
+	out.resize(count * 3);
+	unsigned char *yp = out.data(), *up = yp + count, *vp = up + count;
+	for(size_t i = 0; i < count; ++i)
+	{
+		float r = rgba[i*4] / 255.f, g = rgba[i*4+1] / 255.f, b = rgba[i*4+2] / 255.f;
+		yp[i] = (unsigned char)(16.f + 65.481f*r + 128.553f*g + 24.966f*b + 0.5f);
+		up[i] = (unsigned char)(128.f - 37.797f*r - 74.203f*g + 112.f*b + 0.5f);
+		vp[i] = (unsigned char)(128.f + 112.f*r - 93.786f*g - 18.214f*b + 0.5f);
+	}
+}
+
+static bool ExportPattern(Character &main, Character *effect, int pattern, const Options &opt, SpriteCache &cache)
+{
+	auto seq = main.frameData.get_sequence(pattern);
+	if(!seq || seq->frames.empty())
+		return true;
+
+	int length = PatternLength(&main.frameData, pattern, opt.maxTicks);
+	std::vector<std::vector<Item>> ticks(length);
+	for(int tick = 0; tick < length; ++tick)
+		ticks[tick] = BuildTick(main, effect, pattern, tick);
+	DecodeSprites(ticks, cache, opt.threads);
+
+	char name[16];
+	sprintf(name, "%03d", pattern);
+	fs::path base = opt.outDir / name;
+	std::error_code ec;
+
+	FILE *y4m = nullptr;
+	Png::Apng apng;
+	if(opt.format == Format::Png)
+	{
+		fs::create_directories(base, ec);
+		if(ec)
+		{
+			printf("Can't create %s\n", base.string().c_str());
+			return false;
+		}
+	}
+	else if(opt.format == Format::Apng)
+	{
+		if(!apng.Open((base.string() + ".png").c_str(), opt.width, opt.height, length, 1, 60))
+		{
+			printf("Can't write %s.png\n", base.string().c_str());
+			return false;
+		}
+	}
+	else
+	{
+		y4m = fopen((base.string() + ".y4m").c_str(), "wb");
+		if(!y4m)
+		{
+			printf("Can't write %s.y4m\n", base.string().c_str());
+			return false;
+		}
+		fprintf(y4m, "YUV4MPEG2 W%d H%d F60:1 Ip A1:1 C444\n", opt.width, opt.height);
+	}
+
+	float originX = opt.originX >= 0 ? opt.originX : opt.width / 2;
+	float originY = opt.originY >= 0 ? opt.originY : opt.height * 7 / 8;
+
+	//Ticks are composited and encoded in parallel a batch at a time, then
+	//written in order.
+	std::atomic<bool> failed(false);
+	int batch = std::max(1, opt.threads) * 2;
+	std::vector<std::vector<unsigned char>> encoded(batch);
+	for(int start = 0; start < length; start += batch)
+	{
+		int count = std::min(batch, length - start);
+		std::atomic<int> next(0);
+		auto worker = [&]() {
+			SoftCompositor compositor(opt.width, opt.height);
+			compositor.SetView(originX / opt.zoom, originY / opt.zoom, opt.zoom);
+			std::vector<SoftCompositor::Layer> layers;
+			int i;
+			while((i = next++) < count)
+			{
+				layers.clear();
+				for(auto &item : ticks[start + i])
+					layers.push_back(item.layer);
+				compositor.Clear(opt.background);
+				compositor.Draw(layers, opt.boxes);
+				const auto &pixels = compositor.Pixels();
+
+				if(opt.format == Format::Png)
+				{
+					char file[16];
+					sprintf(file, "%04d.png", start + i);
+					if(!Png::Write((base / file).string().c_str(), pixels.data(), opt.width, opt.height, opt.width * 4))
+						failed = true;
+				}
+				else if(opt.format == Format::Apng)
+					Png::Compress(encoded[i], pixels.data(), opt.width, opt.height, opt.width * 4);
+				else
+					ToYuv(encoded[i], pixels, opt.width, opt.height);
+			}
+		};
+
+		std::vector<std::thread> threads;
+		for(int i = 0; i < std::min(opt.threads, count); ++i)
+			threads.emplace_back(worker);
+		for(auto &thread : threads)
+			thread.join();
+
+		for(int i = 0; i < count; ++i)
+		{
+			if(opt.format == Format::Apng && !apng.AddFrame(encoded[i]))
+				failed = true;
+			else if(y4m && (fputs("FRAME\n", y4m) < 0 ||
+				fwrite(encoded[i].data(), 1, encoded[i].size(), y4m) != encoded[i].size()))
+				failed = true;
+		}
+	}
+
+	if(opt.format == Format::Apng && !apng.Close())
+		failed = true;
+	if(y4m && fclose(y4m) != 0)
+		failed = true;
+
+	if(failed)
+		printf("Pattern %d: writing failed\n", pattern);
+	else
+		printf("Pattern %d: %d ticks\n", pattern, length);
+	return !failed;
+}
+
+int main(int argc, char **argv)
+{
+	Options opt;
+	std::string palFile;
+	int palNumber = 0;
+	const char *effectHa6 = nullptr, *effectCg = nullptr;
+	std::vector<const char*> args;
+
+	for(int i = 1; i < argc; ++i)
+	{
+		bool hasValue = i + 1 < argc;
+		if(!strcmp(argv[i], "-o") && hasValue)
+			opt.outDir = argv[++i];
+		else if(!strcmp(argv[i], "-f") && hasValue)
+		{
+			std::string format = argv[++i];
+			if(format == "png")
+				opt.format = Format::Png;
+			else if(format == "apng")
+				opt.format = Format::Apng;
+			else if(format == "y4m")
+				opt.format = Format::Y4m;
+			else
+			{
+				Usage();
+				return 1;
+			}
+		}
+		else if(!strcmp(argv[i], "-e") && i + 2 < argc)
+		{
+			effectHa6 = argv[++i];
+			effectCg = argv[++i];
+		}
+		else if(!strcmp(argv[i], "-p") && hasValue)
+			palFile = argv[++i];
+		else if(!strcmp(argv[i], "-n") && hasValue)
+			palNumber = atoi(argv[++i]);
+		else if(!strcmp(argv[i], "-s") && hasValue)
+			sscanf(argv[++i], "%dx%d", &opt.width, &opt.height);
+		else if(!strcmp(argv[i], "-c") && hasValue)
+			sscanf(argv[++i], "%d,%d", &opt.originX, &opt.originY);
+		else if(!strcmp(argv[i], "-z") && hasValue)
+			opt.zoom = atof(argv[++i]);
+		else if(!strcmp(argv[i], "-t") && hasValue)
+			opt.maxTicks = atoi(argv[++i]);
+		else if(!strcmp(argv[i], "-b") && hasValue)
+		{
+			unsigned int rgba = strtoul(argv[++i], nullptr, 16);
+			for(int c = 0; c < 4; ++c)
+				opt.background[c] = ((rgba >> (24 - c*8)) & 0xff) / 255.f;
+		}
+		else if(!strcmp(argv[i], "-x"))
+			opt.boxes = false;
+		else if(!strcmp(argv[i], "-j") && hasValue)
+			opt.threads = atoi(argv[++i]);
+		else if(argv[i][0] == '-')
+		{
+			Usage();
+			return 1;
+		}
+		else
+			args.push_back(argv[i]);
+	}
+
+	if(args.size() < 3 || opt.width <= 0 || opt.height <= 0 || opt.zoom <= 0 || opt.maxTicks <= 0)
+	{
+		Usage();
+		return 1;
+	}
+	if(opt.threads < 1)
+		opt.threads = 1;
+
+	std::unique_ptr<Character> main(new Character);
+	if(!LoadCharacter(*main, args[0], args[1], palFile, palNumber))
+		return 1;
+	std::unique_ptr<Character> effect;
+	if(effectHa6)
+	{
+		effect.reset(new Character);
+		if(!LoadCharacter(*effect, effectHa6, effectCg, "", 0))
+			return 1;
+	}
+
+	std::vector<int> patterns;
+	for(size_t i = 2; i < args.size(); ++i)
+	{
+		if(!strcmp(args[i], "all"))
+		{
+			for(int p = 0; p < main->frameData.get_sequence_count(); ++p)
+				patterns.push_back(p);
+		}
+		else
+			patterns.push_back(atoi(args[i]));
+	}
+
+	std::error_code ec;
+	fs::create_directories(opt.outDir, ec);
+
+	SpriteCache cache;
+	int failed = 0;
+	for(int pattern : patterns)
+	{
+		if(!ExportPattern(*main, effect.get(), pattern, opt, cache))
+			++failed;
+	}
+	return failed ? 1 : 0;
+}
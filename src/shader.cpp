@@ -5,6 +5,7 @@
 #include <string>
 #include <windows.h>
 #include <glad/glad.h>
+#include "gl_state.h"
 
 std::string ReadFile(const char *filePath)
 {
@@ -62,6 +63,7 @@ Shader::Shader(): program(0)
 }
 Shader::~Shader()
 {
+	GlState::ForgetProgram(program);
 	glDeleteProgram(program);
 }
 Shader::Shader(const char *vertex_path, const char *fragment_path): Shader()
@@ -134,5 +136,5 @@ void Shader::LoadShader(const char *vertex_path, const char *fragment_path, bool
 
 void Shader::Use()
 {
-	glUseProgram(program);
+	GlState::UseProgram(program);
 }
\ No newline at end of file
@@ -0,0 +1,246 @@
+#include "soft_compositor.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+	//Column vectors like glm, m[row][col].
+	struct Mat
+	{
+		float m[4][4];
+
+		static Mat Identity()
+		{
+			Mat r{};
+			for(int i = 0; i < 4; ++i)
+				r.m[i][i] = 1;
+			return r;
+		}
+
+		Mat operator*(const Mat &b) const
+		{
+			Mat r{};
+			for(int i = 0; i < 4; ++i)
+				for(int j = 0; j < 4; ++j)
+					for(int k = 0; k < 4; ++k)
+						r.m[i][j] += m[i][k] * b.m[k][j];
+			return r;
+		}
+	};
+
+	Mat Scale(float x, float y, float z)
+	{
+		Mat r = Mat::Identity();
+		r.m[0][0] = x;
+		r.m[1][1] = y;
+		r.m[2][2] = z;
+		return r;
+	}
+
+	Mat Translate(float x, float y)
+	{
+		Mat r = Mat::Identity();
+		r.m[0][3] = x;
+		r.m[1][3] = y;
+		return r;
+	}
+
+	//axis 0, 1, 2 for X, Y, Z. Same direction as glm::rotate.
+	Mat Rotate(float angle, int axis)
+	{
+		Mat r = Mat::Identity();
+		float c = cosf(angle), s = sinf(angle);
+		int a = (axis + 1) % 3, b = (axis + 2) % 3;
+		r.m[a][a] = c;
+		r.m[a][b] = -s;
+		r.m[b][a] = s;
+		r.m[b][b] = c;
+		return r;
+	}
+
+	void Blend(float *d, const float *s, float sa, int mode)
+	{
+		switch(mode)
+		{
+		case 2: //GL_SRC_ALPHA, GL_ONE
+			for(int c = 0; c < 4; ++c)
+				d[c] = std::min(1.f, d[c] + s[c]*sa);
+			break;
+		case 3: //Same, reverse subtract
+			for(int c = 0; c < 4; ++c)
+				d[c] = std::max(0.f, d[c] - s[c]*sa);
+			break;
+		default: //GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA
+			for(int c = 0; c < 4; ++c)
+				d[c] = s[c]*sa + d[c]*(1.f - sa);
+			break;
+		}
+	}
+}
+
+SoftCompositor::SoftCompositor(int width_, int height_):
+width(width_), height(height_),
+x(0), y(0), scale(1),
+canvas((size_t)width_ * height_ * 4, 0.f),
+pixels((size_t)width_ * height_ * 4, 0)
+{
+}
+
+void SoftCompositor::SetView(float x_, float y_, float scale_)
+{
+	x = x_;
+	y = y_;
+	scale = scale_;
+}
+
+void SoftCompositor::Clear(const float rgba[4])
+{
+	for(size_t i = 0; i < canvas.size(); i += 4)
+		std::copy(rgba, rgba + 4, &canvas[i]);
+}
+
+void SoftCompositor::Draw(const std::vector<Layer> &layers, bool boxes)
+{
+	for(const Layer &layer : layers)
+	{
+		if(layer.image && layer.color[3] != 0.f)
+			DrawSprite(layer);
+	}
+	if(boxes)
+		DrawBoxes(layers);
+}
+
+const std::vector<unsigned char> &SoftCompositor::Pixels()
+{
+	for(size_t i = 0; i < canvas.size(); ++i)
+		pixels[i] = (unsigned char)(canvas[i] * 255.f + 0.5f);
+	return pixels;
+}
+
+void SoftCompositor::DrawSprite(const Layer &layer)
+{
+	//Same steps as Render::SpriteModelView.
+	constexpr float tau = 6.28318530717958647692f;
+	Mat view = Scale(scale, scale, 1) * Translate(x + layer.spawnOffsetX, y + layer.spawnOffsetY);
+	view = view * Scale(layer.scaleX, layer.scaleY, 0);
+	if(layer.AFRT)
+		view = view * Rotate(layer.rotX*tau, 0) * Rotate(layer.rotY*tau, 1) * Rotate(layer.rotZ*tau, 2);
+	else
+		view = view * Rotate(layer.rotZ*tau, 2) * Rotate(layer.rotY*tau, 1) * Rotate(layer.rotX*tau, 0);
+	view = view * Translate(-128 + layer.frameOffsetX, -224 + layer.frameOffsetY);
+
+	//The quad has z = 0 and the projection drops z, so it's a 2D affine map.
+	float a = view.m[0][0], b = view.m[0][1], c = view.m[0][3];
+	float d = view.m[1][0], e = view.m[1][1], f = view.m[1][3];
+	float det = a*e - b*d;
+	if(fabsf(det) < 1e-6f)
+		return; //Seen edge on.
+
+	const ImageData *image = layer.image;
+	float ox = image->offsetX, oy = image->offsetY;
+	float w = image->width, h = image->height;
+
+	float minX = width, minY = height, maxX = 0, maxY = 0;
+	const float corners[4][2] = {{ox, oy}, {ox+w, oy}, {ox+w, oy+h}, {ox, oy+h}};
+	for(auto &p : corners)
+	{
+		float sx = a*p[0] + b*p[1] + c;
+		float sy = d*p[0] + e*p[1] + f;
+		minX = std::min(minX, sx);
+		maxX = std::max(maxX, sx);
+		minY = std::min(minY, sy);
+		maxY = std::max(maxY, sy);
+	}
+	int x0 = std::max(0, (int)floorf(minX));
+	int y0 = std::max(0, (int)floorf(minY));
+	int x1 = std::min(width, (int)ceilf(maxX));
+	int y1 = std::min(height, (int)ceilf(maxY));
+
+	//Screen to sprite space, stepped along each row.
+	float ia = e/det, ib = -b/det;
+	float id = -d/det, ie = a/det;
+	int r = image->bgr ? 2 : 0;
+	const unsigned char *texels = image->pixels;
+	int tw = image->width, th = image->height;
+	const float *color = layer.color;
+	float src[4];
+
+	for(int py = y0; py < y1; ++py)
+	{
+		float sy = py + 0.5f - f;
+		float sx = x0 + 0.5f - c;
+		float u = ia*sx + ib*sy - ox;
+		float v = id*sx + ie*sy - oy;
+		float *dst = &canvas[((size_t)py * width + x0) * 4];
+		for(int px = x0; px < x1; ++px, u += ia, v += id, dst += 4)
+		{
+			int tx = (int)floorf(u), ty = (int)floorf(v);
+			if(tx < 0 || ty < 0 || tx >= tw || ty >= th)
+				continue;
+			const unsigned char *t = texels + ((size_t)ty * tw + tx) * 4;
+			if(!t[3])
+				continue;
+			src[0] = t[r] * (1.f/255.f) * color[0];
+			src[1] = t[1] * (1.f/255.f) * color[1];
+			src[2] = t[2-r] * (1.f/255.f) * color[2];
+			src[3] = t[3] * (1.f/255.f) * color[3];
+			Blend(dst, src, src[3], layer.blendMode);
+		}
+	}
+}
+
+void SoftCompositor::FillRect(int rx1, int ry1, int rx2, int ry2, const float *rgb, float alpha)
+{
+	rx1 = std::max(rx1, 0);
+	ry1 = std::max(ry1, 0);
+	rx2 = std::min(rx2, width);
+	ry2 = std::min(ry2, height);
+	const float src[4] = {rgb[0], rgb[1], rgb[2], 1.f};
+	for(int py = ry1; py < ry2; ++py)
+	{
+		float *dst = &canvas[((size_t)py * width + rx1) * 4];
+		for(int px = rx1; px < rx2; ++px, dst += 4)
+			Blend(dst, src, alpha, 0);
+	}
+}
+
+void SoftCompositor::DrawBoxes(const std::vector<Layer> &layers)
+{
+	//Render::DrawBoxes: every outline, then every fill. No depth writes, so
+	//it's plain drawing order.
+	struct Box
+	{
+		int x1, y1, x2, y2;
+		const float *color;
+	};
+	std::vector<Box> boxes;
+	for(const Layer &layer : layers)
+	{
+		if(!layer.hitboxes)
+			continue;
+		for(const auto &pair : *layer.hitboxes)
+		{
+			const int *xy = pair.second.xy;
+			auto toX = [&](int v) { return (int)floorf(scale * (x + v + layer.spawnOffsetX) + 0.5f); };
+			auto toY = [&](int v) { return (int)floorf(scale * (y + v + layer.spawnOffsetY) + 0.5f); };
+			Box box{toX(xy[0]), toY(xy[1]), toX(xy[2]), toY(xy[3]), HitboxColor(pair.first)};
+			if(box.x1 > box.x2)
+				std::swap(box.x1, box.x2);
+			if(box.y1 > box.y2)
+				std::swap(box.y1, box.y2);
+			boxes.push_back(box);
+		}
+	}
+
+	//Each edge leaves out its last pixel so corners aren't blended twice.
+	for(const Box &b : boxes)
+	{
+		FillRect(b.x1, b.y1, b.x2, b.y1+1, b.color, 0.6f);
+		FillRect(b.x2, b.y1, b.x2+1, b.y2, b.color, 0.6f);
+		FillRect(b.x1+1, b.y2, b.x2+1, b.y2+1, b.color, 0.6f);
+		FillRect(b.x1, b.y1+1, b.x1+1, b.y2+1, b.color, 0.6f);
+	}
+	for(const Box &b : boxes)
+		FillRect(b.x1, b.y1, b.x2, b.y2, b.color, 0.3f);
+}
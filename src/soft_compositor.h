@@ -0,0 +1,53 @@
+#ifndef SOFT_COMPOSITOR_H_GUARD
+#define SOFT_COMPOSITOR_H_GUARD
+
+#include "cg.h"
+#include "hitbox.h"
+#include <vector>
+
+// Draws what Render::DrawLayers draws, on the CPU: sprites with the same
+// transform, tint, blending and order, then every layer's boxes on top.
+// PAT layers are left out, they need the parts renderer.
+// One instance per thread, nothing is shared.
+class SoftCompositor
+{
+public:
+	struct Layer
+	{
+		const ImageData *image;   //RGBA, nullptr to draw only the boxes.
+		int spawnOffsetX, spawnOffsetY;
+		int frameOffsetX, frameOffsetY;
+		float scaleX, scaleY;
+		float rotX, rotY, rotZ;
+		bool AFRT;
+		int blendMode;            //Same values as the frame data, 2 additive, 3 subtractive.
+		float color[4];           //Tint and alpha.
+		const BoxList *hitboxes;  //Can be nullptr.
+	};
+
+	SoftCompositor(int width, int height);
+
+	//Same meaning as Render::x, Render::y and Render::scale.
+	void SetView(float x, float y, float scale);
+	void Clear(const float rgba[4]);
+
+	//Layers in drawing order, see SortLayersByZ.
+	void Draw(const std::vector<Layer> &layers, bool boxes);
+
+	//RGBA8, rows top to bottom.
+	const std::vector<unsigned char> &Pixels();
+	int Width() const { return width; }
+	int Height() const { return height; }
+
+private:
+	int width, height;
+	float x, y, scale;
+	std::vector<float> canvas; //RGBA, 0-1
+	std::vector<unsigned char> pixels;
+
+	void DrawSprite(const Layer &layer);
+	void FillRect(int x1, int y1, int x2, int y2, const float *rgb, float alpha);
+	void DrawBoxes(const std::vector<Layer> &layers);
+};
+
+#endif /* SOFT_COMPOSITOR_H_GUARD */
@@ -0,0 +1,281 @@
+#include "sprite_atlas.h"
+#include "misc.h"
+
+#include <glad/glad.h>
+#include "gl_state.h"
+#include "pixel_upload.h"
+#include <algorithm>
+#include <cstring>
+
+SpriteAtlas::SpriteAtlas():
+pageSize(0), frame(0), revision(0), evictions(0), repacks(0)
+{
+}
+
+SpriteAtlas::~SpriteAtlas()
+{
+	Clear();
+}
+
+uint64_t SpriteAtlas::MakeKey(const CG *cg, int id)
+{
+	return ((uint64_t)cg->getSerial() << 40) |
+		((uint64_t)(cg->getCurrentPalette() & 0xff) << 32) |
+		(uint32_t)id;
+}
+
+void SpriteAtlas::BeginFrame()
+{
+	++frame;
+}
+
+const SpriteAtlas::Entry *SpriteAtlas::Find(const CG *cg, int id)
+{
+	auto it = entries.find(MakeKey(cg, id));
+	if(it == entries.end())
+		return nullptr;
+	it->second.lastUsed = frame;
+	return &it->second;
+}
+
+unsigned int SpriteAtlas::PageTexture(int page) const
+{
+	return pages[page].texture;
+}
+
+void SpriteAtlas::BindPage(int page, bool linearFilter)
+{
+	Page &p = pages[page];
+	GlState::BindTexture(p.texture);
+	if(p.linearFilter != linearFilter)
+	{
+		GLint mode = linearFilter ? GL_LINEAR : GL_NEAREST;
+		GlState::TexParameter(GL_TEXTURE_MAG_FILTER, mode);
+		GlState::TexParameter(GL_TEXTURE_MIN_FILTER, mode);
+		p.linearFilter = linearFilter;
+	}
+}
+
+bool SpriteAtlas::CreatePage()
+{
+	if(pageSize == 0)
+	{
+		GLint maxSize = 0;
+		glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxSize);
+		pageSize = std::min(2048, (int)maxSize);
+		if(pageSize <= 0)
+			return false;
+	}
+
+	Page page;
+	page.packer.Reset(pageSize, pageSize);
+	page.linearFilter = false;
+	glGenTextures(1, &page.texture);
+	GlState::BindTexture(page.texture);
+	GlState::TexParameter(GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	GlState::TexParameter(GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	GlState::TexParameter(GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	GlState::TexParameter(GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+
+	//Padding texels are never written, so the page has to start out transparent.
+	std::vector<unsigned char> zero((size_t)pageSize*pageSize*4, 0);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, pageSize, pageSize, 0, GL_RGBA, GL_UNSIGNED_BYTE, zero.data());
+
+	pages.push_back(page);
+	return true;
+}
+
+void SpriteAtlas::SetUv(Entry &entry)
+{
+	float inv = 1.f/pageSize;
+	entry.uv[0] = entry.rect.x * inv;
+	entry.uv[1] = entry.rect.y * inv;
+	entry.uv[2] = (entry.rect.x + entry.rect.w) * inv;
+	entry.uv[3] = (entry.rect.y + entry.rect.h) * inv;
+}
+
+bool SpriteAtlas::Place(int page, const ImageData *image, Entry &entry)
+{
+	SkylinePacker::Rect rect;
+	if(!pages[page].packer.Insert(image->width + padding*2, image->height + padding*2, rect))
+		return false;
+
+	entry.page = page;
+	entry.rect = SkylinePacker::Rect{rect.x + padding, rect.y + padding, image->width, image->height};
+	entry.offsetX = image->offsetX;
+	entry.offsetY = image->offsetY;
+	entry.lastUsed = frame;
+	SetUv(entry);
+
+	GlState::BindTexture(pages[page].texture);
+	PixelUpload::SubImage(entry.rect.x, entry.rect.y, entry.rect.w, entry.rect.h, GL_RGBA, image->pixels);
+	return true;
+}
+
+const SpriteAtlas::Entry *SpriteAtlas::Insert(const CG *cg, int id, const ImageData *image)
+{
+	return Insert(MakeKey(cg, id), image);
+}
+
+const SpriteAtlas::Entry *SpriteAtlas::Insert(uint64_t key, const ImageData *image)
+{
+	if(!image || !image->pixels || image->is8bpp || image->width <= 0 || image->height <= 0)
+		return nullptr;
+
+	auto it = entries.find(key);
+	if(it != entries.end())
+	{
+		it->second.lastUsed = frame;
+		return &it->second;
+	}
+
+	if(pages.empty() && !CreatePage())
+		return nullptr;
+	if(image->width + padding*2 > pageSize || image->height + padding*2 > pageSize)
+		return nullptr;
+
+	Entry entry;
+	bool placed = false;
+	for(int i = 0; i < (int)pages.size() && !placed; ++i)
+		placed = Place(i, image, entry);
+
+	if(!placed && (int)pages.size() < maxPages && CreatePage())
+		placed = Place(pages.size()-1, image, entry);
+
+	if(!placed)
+	{
+		int page = EvictStale();
+		if(page >= 0)
+		{
+			Repack(page);
+			placed = Place(page, image, entry);
+		}
+	}
+
+	if(!placed)
+		return nullptr;
+	return &(entries[key] = entry);
+}
+
+//Drops everything not drawn this frame from the page that has the least live area this frame.
+int SpriteAtlas::EvictStale()
+{
+	std::vector<long long> liveArea(pages.size(), 0);
+	std::vector<int> staleCount(pages.size(), 0);
+	for(const auto &pair : entries)
+	{
+		const Entry &e = pair.second;
+		if(e.lastUsed == frame)
+			liveArea[e.page] += (long long)e.rect.w * e.rect.h;
+		else
+			++staleCount[e.page];
+	}
+
+	int victim = -1;
+	for(int i = 0; i < (int)pages.size(); ++i)
+	{
+		if(staleCount[i] == 0)
+			continue;
+		if(victim < 0 || liveArea[i] < liveArea[victim])
+			victim = i;
+	}
+	if(victim < 0)
+		return -1;
+
+	for(auto it = entries.begin(); it != entries.end();)
+	{
+		if(it->second.page == victim && it->second.lastUsed != frame)
+		{
+			const SkylinePacker::Rect &r = it->second.rect;
+			pages[victim].packer.Release(SkylinePacker::Rect{r.x, r.y, r.w + padding*2, r.h + padding*2});
+			it = entries.erase(it);
+			++evictions;
+		}
+		else
+			++it;
+	}
+	return victim;
+}
+
+//Moves the surviving sprites of a page into a fresh skyline. Texels are read back once
+//so we don't need the CG that produced them anymore.
+void SpriteAtlas::Repack(int pageIndex)
+{
+	Page &page = pages[pageIndex];
+	size_t pitch = (size_t)pageSize*4;
+	std::vector<unsigned char> oldTexels(pitch*pageSize);
+	std::vector<unsigned char> newTexels(pitch*pageSize, 0);
+
+	GlState::BindTexture(page.texture);
+	glPixelStorei(GL_PACK_ALIGNMENT, 4);
+	glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, oldTexels.data());
+
+	std::vector<Entry*> survivors;
+	for(auto &pair : entries)
+		if(pair.second.page == pageIndex)
+			survivors.push_back(&pair.second);
+	std::sort(survivors.begin(), survivors.end(), [](const Entry *a, const Entry *b){
+		return a->rect.h > b->rect.h;
+	});
+
+	page.packer.Clear();
+	for(Entry *e : survivors)
+	{
+		SkylinePacker::Rect rect;
+		if(!page.packer.Insert(e->rect.w + padding*2, e->rect.h + padding*2, rect))
+		{
+			//Can't happen in practice since everything fit before; drop it and let it decode again.
+			e->page = -1;
+			continue;
+		}
+		SkylinePacker::Rect dst{rect.x + padding, rect.y + padding, e->rect.w, e->rect.h};
+		for(int row = 0; row < dst.h; ++row)
+		{
+			memcpy(&newTexels[(dst.y+row)*pitch + dst.x*4],
+				&oldTexels[(e->rect.y+row)*pitch + e->rect.x*4], dst.w*4);
+		}
+		e->rect = dst;
+		SetUv(*e);
+	}
+
+	for(auto it = entries.begin(); it != entries.end();)
+	{
+		if(it->second.page < 0)
+			it = entries.erase(it);
+		else
+			++it;
+	}
+
+	PixelUpload::SubImage(0, 0, pageSize, pageSize, GL_RGBA, newTexels.data());
+	++repacks;
+	++revision;
+}
+
+void SpriteAtlas::Clear()
+{
+	for(auto &page : pages)
+	{
+		GlState::ForgetTexture(page.texture);
+		glDeleteTextures(1, &page.texture);
+	}
+	pages.clear();
+	entries.clear();
+	++revision;
+}
+
+SpriteAtlas::Stats SpriteAtlas::GetStats() const
+{
+	Stats stats{};
+	stats.pages = pages.size();
+	stats.sprites = entries.size();
+	stats.pageTexels = (long long)pages.size() * pageSize * pageSize;
+	for(const auto &pair : entries)
+	{
+		const Entry &e = pair.second;
+		stats.usedTexels += (long long)e.rect.w * e.rect.h;
+		stats.pow2Texels += (long long)to_pow2(e.rect.w) * to_pow2(e.rect.h);
+	}
+	stats.evictions = evictions;
+	stats.repacks = repacks;
+	return stats;
+}
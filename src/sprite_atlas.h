@@ -0,0 +1,90 @@
+#ifndef SPRITE_ATLAS_H_GUARD
+#define SPRITE_ATLAS_H_GUARD
+
+#include "atlas_packer.h"
+#include "cg.h"
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+// Packs decoded CG sprites into a few large shared pages instead of one
+// texture per sprite, so consecutive layers rarely need a texture switch
+// and no VRAM goes to pow2 padding.
+class SpriteAtlas
+{
+public:
+	struct Entry
+	{
+		int page;
+		SkylinePacker::Rect rect; //Texels used inside the page, padding excluded.
+		int offsetX, offsetY;     //Same meaning as in ImageData.
+		float uv[4];              //u0, v0, u1, v1
+		unsigned int lastUsed;
+	};
+
+	struct Stats
+	{
+		int pages;
+		int sprites;
+		long long usedTexels;
+		long long pageTexels;
+		long long pow2Texels; //What the same sprites would take as pow2 textures.
+		int evictions;
+		int repacks;
+	};
+
+	SpriteAtlas();
+	~SpriteAtlas();
+
+	//Identifies a decoded sprite. Changes with the CG's palette and serial.
+	static uint64_t MakeKey(const CG *cg, int id);
+
+	//Entries used during the current frame are never evicted.
+	void BeginFrame();
+
+	//Returns nullptr on a miss. Marks the entry as used this frame.
+	const Entry *Find(const CG *cg, int id);
+	//Copies the image into a page. Returns nullptr if it can't be placed,
+	//either because it's too big or the frame's working set fills every page.
+	const Entry *Insert(const CG *cg, int id, const ImageData *image);
+	const Entry *Insert(uint64_t key, const ImageData *image);
+	bool Contains(uint64_t key) const { return entries.count(key) != 0; }
+
+	//Binds the page texture and applies the requested filtering.
+	void BindPage(int page, bool linearFilter);
+	unsigned int PageTexture(int page) const;
+	int PageSize() const { return pageSize; }
+
+	//Incremented whenever texels or uvs of existing entries move.
+	unsigned int Revision() const { return revision; }
+
+	void Clear();
+	Stats GetStats() const;
+
+private:
+	struct Page
+	{
+		unsigned int texture;
+		SkylinePacker packer;
+		bool linearFilter;
+	};
+
+	static constexpr int padding = 1; //Transparent border so bilinear sampling doesn't bleed.
+	static constexpr int maxPages = 4;
+
+	int pageSize;
+	std::vector<Page> pages;
+	std::unordered_map<uint64_t, Entry> entries;
+	unsigned int frame;
+	unsigned int revision;
+	int evictions;
+	int repacks;
+
+	bool CreatePage();
+	bool Place(int page, const ImageData *image, Entry &entry);
+	int EvictStale();
+	void Repack(int page);
+	void SetUv(Entry &entry);
+};
+
+#endif /* SPRITE_ATLAS_H_GUARD */
@@ -0,0 +1,73 @@
+#include "sprite_batch.h"
+#include <glad/glad.h>
+#include "gl_state.h"
+#include <cstddef>
+
+SpriteBatch::SpriteBatch():
+vbo(0),
+capacity(0),
+stats{}
+{
+}
+
+SpriteBatch::~SpriteBatch()
+{
+	GlState::ForgetBuffer(vbo);
+	glDeleteBuffers(1, &vbo);
+}
+
+void SpriteBatch::Add(int page, unsigned int texture, int blend, const Vertex *quad)
+{
+	int first = vertices.size();
+	vertices.insert(vertices.end(), quad, quad + 6);
+	++stats.sprites;
+
+	if(!runs.empty())
+	{
+		Run &last = runs.back();
+		if(last.page == page && last.texture == texture && last.blend == blend)
+		{
+			last.count += 6;
+			return;
+		}
+	}
+	runs.push_back(Run{page, texture, blend, first, 6});
+}
+
+void SpriteBatch::Flush(const std::function<void(const Run&)> &bind)
+{
+	if(runs.empty())
+		return;
+
+	if(!vbo)
+		glGenBuffers(1, &vbo);
+	GlState::BindBuffer(GL_ARRAY_BUFFER, vbo);
+
+	//Orphan the old storage so we don't wait on draws still reading it.
+	size_t size = vertices.size() * sizeof(Vertex);
+	if(size > capacity)
+		capacity = size * 2;
+	glBufferData(GL_ARRAY_BUFFER, capacity, nullptr, GL_STREAM_DRAW);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, size, vertices.data());
+
+	constexpr int stride = sizeof(Vertex);
+	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(Vertex, x));
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(Vertex, u));
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(Vertex, r));
+	glEnableVertexAttribArray(2);
+
+	for(const Run &run : runs)
+	{
+		bind(run);
+		glDrawArrays(GL_TRIANGLES, run.first, run.count);
+		++stats.draws;
+	}
+
+	//Everything else feeds the color through a constant attribute.
+	glDisableVertexAttribArray(2);
+
+	vertices.clear();
+	runs.clear();
+}
@@ -0,0 +1,57 @@
+#ifndef SPRITE_BATCH_H_GUARD
+#define SPRITE_BATCH_H_GUARD
+
+#include <functional>
+#include <vector>
+
+// Collects already transformed sprite quads into one vertex stream and draws
+// them in submission order, one draw call per run of quads that share a
+// texture and blend mode.
+class SpriteBatch
+{
+public:
+	struct Vertex
+	{
+		float x, y;
+		float u, v;
+		float r, g, b, a;
+	};
+
+	struct Run
+	{
+		int page;             //Atlas page, -1 if texture is used instead.
+		unsigned int texture;
+		int blend;
+		int first;
+		int count;
+	};
+
+	struct Stats
+	{
+		int sprites;
+		int draws;
+	};
+
+	SpriteBatch();
+	~SpriteBatch();
+
+	//Two triangles, six vertices.
+	void Add(int page, unsigned int texture, int blend, const Vertex *quad);
+	bool Empty() const { return runs.empty(); }
+
+	//Uploads the queued vertices and draws them. bind is called before each
+	//run to set up its texture and blending. Uses attributes 0-2.
+	void Flush(const std::function<void(const Run&)> &bind);
+
+	void ResetStats() { stats = {}; }
+	Stats GetStats() const { return stats; }
+
+private:
+	std::vector<Vertex> vertices;
+	std::vector<Run> runs;
+	unsigned int vbo;
+	size_t capacity; //In bytes.
+	Stats stats;
+};
+
+#endif /* SPRITE_BATCH_H_GUARD */
@@ -0,0 +1,178 @@
+#include "sprite_prefetch.h"
+#include "sprite_atlas.h"
+
+#include <algorithm>
+#include <cstring>
+
+SpritePrefetcher *SpritePrefetcher::instance = nullptr;
+void (*SpritePrefetcher::readyHook)() = nullptr;
+
+SpritePrefetcher::SpritePrefetcher():
+quit(false)
+{
+	//Leave a core for the UI thread, decoding is memory bound anyway.
+	int count = std::thread::hardware_concurrency();
+	count = std::max(1, std::min(count - 1, 3));
+
+	inFlight.resize(count, nullptr);
+	inFlightKeys.resize(count, 0);
+	for(int i = 0; i < count; ++i)
+		workers.emplace_back(&SpritePrefetcher::Worker, this, i);
+
+	instance = this;
+	CG::freeHook = &SpritePrefetcher::OnCGFree;
+}
+
+SpritePrefetcher::~SpritePrefetcher()
+{
+	CG::freeHook = nullptr;
+	instance = nullptr;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		quit = true;
+		queue.clear();
+	}
+	wake.notify_all();
+	for(auto &worker : workers)
+		worker.join();
+}
+
+void SpritePrefetcher::OnCGFree(const CG *cg)
+{
+	if(instance)
+		instance->Cancel(cg);
+}
+
+bool SpritePrefetcher::MakeJob(const Request &request, Job &job)
+{
+	if(!request.cg || !request.cg->m_loaded || !request.cg->getPalette())
+		return false;
+	job.cg = request.cg;
+	job.id = request.id;
+	job.key = SpriteAtlas::MakeKey(request.cg, request.id);
+	memcpy(job.palette, request.cg->getPalette(), sizeof(job.palette));
+	return true;
+}
+
+void SpritePrefetcher::Submit(const std::vector<Request> &requests)
+{
+	std::deque<Job> jobs;
+	for(const auto &request : requests)
+	{
+		Job job;
+		if(MakeJob(request, job))
+			jobs.push_back(job);
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		queue.swap(jobs);
+	}
+	wake.notify_all();
+}
+
+bool SpritePrefetcher::Demand(const Request &request)
+{
+	Job job;
+	if(workers.empty() || !MakeJob(request, job))
+		return false;
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		uint64_t key = job.key;
+		for(size_t i = 0; i < inFlight.size(); ++i)
+			if(inFlight[i] && inFlightKeys[i] == key)
+				return true;
+		for(const auto &result : ready)
+			if(result.key == key)
+				return true;
+
+		auto queued = std::find_if(queue.begin(), queue.end(), [key](const Job &j){
+			return j.key == key;
+		});
+		if(queued != queue.end())
+		{
+			if(queued == queue.begin())
+				return true;
+			queue.erase(queued);
+		}
+		queue.push_front(job);
+	}
+	wake.notify_one();
+	return true;
+}
+
+bool SpritePrefetcher::PopReady(Result &out)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	if(ready.empty())
+		return false;
+	out = std::move(ready.front());
+	ready.pop_front();
+	return true;
+}
+
+void SpritePrefetcher::Supply(unsigned char *buffer, size_t size)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	buffers.emplace_back(buffer, size);
+}
+
+size_t SpritePrefetcher::Supplied()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return buffers.size();
+}
+
+bool SpritePrefetcher::HasReady()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return !ready.empty();
+}
+
+void SpritePrefetcher::Cancel(const CG *cg)
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	queue.erase(std::remove_if(queue.begin(), queue.end(), [cg](const Job &job){
+		return job.cg == cg;
+	}), queue.end());
+	done.wait(lock, [this, cg]{
+		return std::find(inFlight.begin(), inFlight.end(), cg) == inFlight.end();
+	});
+}
+
+void SpritePrefetcher::Worker(int index)
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	while(true)
+	{
+		wake.wait(lock, [this]{ return quit || !queue.empty(); });
+		if(quit)
+			return;
+
+		Job job = queue.front();
+		queue.pop_front();
+		inFlight[index] = job.cg;
+		inFlightKeys[index] = job.key;
+		std::pair<unsigned char*, size_t> buffer(nullptr, 0);
+		if(!buffers.empty())
+		{
+			buffer = buffers.back();
+			buffers.pop_back();
+		}
+		lock.unlock();
+
+		ImageData *image = job.cg->draw_texture(job.id, false, false, job.palette, buffer.first, buffer.second);
+
+		lock.lock();
+		inFlight[index] = nullptr;
+		//Too big for it, or nothing was decoded
+		if(buffer.first && !(image && image->staged))
+			buffers.push_back(buffer);
+		//Failures are handed over as well so they aren't asked for again.
+		ready.push_back(Result{job.key, std::unique_ptr<ImageData>(image)});
+		done.notify_all();
+		if(readyHook)
+			readyHook();
+	}
+}
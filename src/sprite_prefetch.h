@@ -0,0 +1,83 @@
+#ifndef SPRITE_PREFETCH_H_GUARD
+#define SPRITE_PREFETCH_H_GUARD
+
+#include "cg.h"
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Decodes CG sprites on worker threads ahead of playback.
+// Finished images wait in a ready queue until the main thread uploads them;
+// nothing here touches GL. The main thread can supply mapped buffers to
+// decode into, so the upload doesn't have to copy the pixels again.
+class SpritePrefetcher
+{
+public:
+	struct Request
+	{
+		CG *cg;
+		int id;
+	};
+
+	struct Result
+	{
+		uint64_t key; //SpriteAtlas key, taken when the request was submitted.
+		std::unique_ptr<ImageData> image; //Null if it couldn't be decoded.
+	};
+
+	SpritePrefetcher();
+	~SpritePrefetcher();
+
+	//Replaces anything still queued. Sprites are decoded in the given order.
+	void Submit(const std::vector<Request> &requests);
+	//Needed on screen right now: decoded before anything queued.
+	//Does nothing if it's already queued, being decoded or ready.
+	//Returns false if it can't be decoded in the background.
+	bool Demand(const Request &request);
+	//Oldest finished sprite first. Returns false if none is ready.
+	bool PopReady(Result &out);
+	//A buffer of size bytes for the next sprite that fits. It comes back
+	//as a staged Result::image, or stays here until the next one.
+	void Supply(unsigned char *buffer, size_t size);
+	//Buffers supplied and not used yet.
+	size_t Supplied();
+	bool HasReady();
+
+	//Drops queued work for cg and waits until no worker is decoding it.
+	void Cancel(const CG *cg);
+
+	//Called from a worker thread whenever a sprite becomes ready.
+	static void (*readyHook)();
+
+private:
+	struct Job
+	{
+		CG *cg;
+		int id;
+		uint64_t key;
+		unsigned int palette[256]; //Snapshot, the CG's palette can be freed while we decode.
+	};
+
+	std::vector<std::thread> workers;
+	std::vector<const CG*> inFlight; //One slot per worker.
+	std::vector<uint64_t> inFlightKeys;
+	std::deque<Job> queue;
+	std::deque<Result> ready;
+	std::vector<std::pair<unsigned char*, size_t>> buffers;
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable done;
+	bool quit;
+
+	void Worker(int index);
+	static bool MakeJob(const Request &request, Job &job);
+	static void OnCGFree(const CG *cg);
+	static SpritePrefetcher *instance;
+};
+
+#endif /* SPRITE_PREFETCH_H_GUARD */
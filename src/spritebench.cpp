@@ -0,0 +1,626 @@
+// Sprite batch benchmark. The same frames of CG layers are drawn the way
+// DrawSpriteOnly did it per layer before SpriteBatch (one quad in a static
+// buffer, a matrix upload and a draw per layer) and the way FlushSprites does
+// it now. The frames are made up from a fixed seed: sprites of a few atlas
+// pages, some with a texture of their own, mostly normal blending.
+// First pass: the glad entry points go to a stub that counts what reaches the
+// driver per frame and checks that every sprite is drawn in order with its
+// own texture and blend mode bound.
+// Second pass, when built with SPRITEBENCH_EGL: both paths take turns on a
+// real offscreen context (Mesa's llvmpipe where there's no GPU) and the CPU
+// time of the submission and of the whole frame up to glFinish is measured.
+// Built as spritebench.exe. Usage: spritebench [frames] (default 1000)
+#include <cstdio>
+#include <chrono>
+#include <cstdlib>
+#include <random>
+#include <vector>
+#include "sprite_batch.h"
+#include "vao.h"
+#include "gl_ext.h"
+#include "gl_state.h"
+#ifdef SPRITEBENCH_EGL
+#define EGL_NO_X11
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+static const int width = 1280, height = 720;
+static const int pageCount = 4, ownCount = 8;
+static const int spriteCount = 512;
+static const int pageSize = 1024, ownSize = 256;
+
+enum {normal, additive, subtractive};
+
+struct SpriteInfo
+{
+	int page; //-1 for a texture of its own.
+	int own;
+	float w, h;
+	float uv[4];
+};
+
+struct Layer
+{
+	int id;
+	int blend;
+	float x, y;
+	float color[4];
+};
+
+//What a path draws with, stub ids or real objects.
+struct Scene
+{
+	GLuint program;
+	GLint projection;
+	GLuint pages[pageCount];
+	GLuint own[ownCount];
+};
+
+static std::vector<SpriteInfo> sprites;
+static std::vector<std::vector<Layer>> frames;
+
+//Sprites of a character sit next to each other in a page, the last few are
+//too big for the atlas. Layers mostly follow on from the one before.
+static void MakeFrames(int count)
+{
+	std::mt19937 random(1);
+	for(int id = 0; id < spriteCount; ++id)
+	{
+		SpriteInfo info;
+		info.own = id >= spriteCount - 32;
+		info.page = info.own ? -1 : id * pageCount / (spriteCount - 32);
+		info.own = info.own ? id % ownCount : 0;
+		info.w = 16 + random() % 177;
+		info.h = 16 + random() % 177;
+		int size = info.page >= 0 ? pageSize : ownSize;
+		float u = info.page >= 0 ? random() % (pageSize - 192) : 0;
+		float v = info.page >= 0 ? random() % (pageSize - 192) : 0;
+		info.uv[0] = u / size;
+		info.uv[1] = v / size;
+		info.uv[2] = (u + info.w) / size;
+		info.uv[3] = (v + info.h) / size;
+		sprites.push_back(info);
+	}
+
+	frames.resize(count);
+	int id = 0, blend = normal;
+	for(auto &frame : frames)
+	{
+		int layers = 8 + random() % 121;
+		for(int i = 0; i < layers; ++i)
+		{
+			if(random() % 5 == 0)
+				id = random() % spriteCount;
+			else
+				id = (id + 1 + random() % 3) % spriteCount;
+			if(random() % 8 == 0)
+			{
+				int roll = random() % 20;
+				blend = roll < 16 ? normal : roll < 19 ? additive : subtractive;
+			}
+			const SpriteInfo &info = sprites[id];
+			Layer layer;
+			layer.id = id;
+			layer.blend = blend;
+			layer.x = random() % (int)(width - info.w);
+			layer.y = random() % (int)(height - info.h);
+			for(int c = 0; c < 3; ++c)
+				layer.color[c] = random() % 4 ? 1.f : 0.5f + (random() % 128) / 256.f;
+			layer.color[3] = random() % 4 ? 1.f : 0.25f + (random() % 192) / 256.f;
+			frame.push_back(layer);
+		}
+	}
+}
+
+static GLuint TextureOf(const Scene &scene, const SpriteInfo &info)
+{
+	return info.page >= 0 ? scene.pages[info.page] : scene.own[info.own];
+}
+
+//Pixels to clip space, moved by x, y. Column major.
+static void Projection(float *m, float x, float y)
+{
+	for(int i = 0; i < 16; ++i)
+		m[i] = 0;
+	m[0] = 2.f / width;
+	m[5] = -2.f / height;
+	m[10] = 1.f;
+	m[12] = -1.f + 2.f * x / width;
+	m[13] = 1.f - 2.f * y / height;
+	m[15] = 1.f;
+}
+
+static const float corners[6][2] = {{0, 0}, {1, 0}, {1, 1}, {1, 1}, {0, 1}, {0, 0}};
+
+static void SetBlendingMode(int blend)
+{
+	if(blend == additive)
+		GlState::BlendFunc(GL_SRC_ALPHA, GL_ONE);
+	else if(blend == subtractive)
+	{
+		GlState::BlendFunc(GL_SRC_ALPHA, GL_ONE);
+		GlState::BlendEquation(GL_FUNC_REVERSE_SUBTRACT);
+	}
+}
+
+//Before SpriteBatch: SwitchImage wrote the quad of a new sprite into the one
+//static buffer, then DrawSpriteOnly drew it alone.
+static void DrawPerSprite(const Scene &scene, Vao &quad, int &current, const std::vector<Layer> &layers)
+{
+	for(const Layer &layer : layers)
+	{
+		const SpriteInfo &info = sprites[layer.id];
+		if(layer.id != current)
+		{
+			float vertices[6*4];
+			for(int i = 0; i < 6; ++i)
+			{
+				float *v = &vertices[i*4];
+				v[0] = corners[i][0] * info.w;
+				v[1] = corners[i][1] * info.h;
+				v[2] = info.uv[corners[i][0] ? 2 : 0];
+				v[3] = info.uv[corners[i][1] ? 3 : 1];
+			}
+			quad.UpdateBuffer(0, vertices);
+			current = layer.id;
+		}
+
+		float m[16];
+		Projection(m, layer.x, layer.y);
+		GlState::UseProgram(scene.program);
+		glUniformMatrix4fv(scene.projection, 1, GL_FALSE, m);
+		GlState::BindTexture(TextureOf(scene, info));
+		SetBlendingMode(layer.blend);
+		glDisableVertexAttribArray(2);
+		glVertexAttrib4fv(2, layer.color);
+		quad.Bind();
+		quad.Draw(0);
+		GlState::BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+		GlState::BlendEquation(GL_FUNC_ADD);
+	}
+}
+
+//DrawLayers queueing view space quads, then FlushSprites.
+static void DrawBatched(const Scene &scene, SpriteBatch &batch, const std::vector<Layer> &layers)
+{
+	for(const Layer &layer : layers)
+	{
+		const SpriteInfo &info = sprites[layer.id];
+		SpriteBatch::Vertex quad[6];
+		for(int i = 0; i < 6; ++i)
+		{
+			quad[i] = {
+				layer.x + corners[i][0] * info.w, layer.y + corners[i][1] * info.h,
+				info.uv[corners[i][0] ? 2 : 0], info.uv[corners[i][1] ? 3 : 1],
+				layer.color[0], layer.color[1], layer.color[2], layer.color[3]};
+		}
+		batch.Add(info.page, info.page >= 0 ? 0 : scene.own[info.own], layer.blend, quad);
+	}
+
+	float m[16];
+	Projection(m, 0, 0);
+	GlState::UseProgram(scene.program);
+	glUniformMatrix4fv(scene.projection, 1, GL_FALSE, m);
+	batch.Flush([&scene](const SpriteBatch::Run &run) {
+		GlState::BindTexture(run.page >= 0 ? scene.pages[run.page] : run.texture);
+		GlState::BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+		GlState::BlendEquation(GL_FUNC_ADD);
+		SetBlendingMode(run.blend);
+	});
+	GlState::BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	GlState::BlendEquation(GL_FUNC_ADD);
+}
+
+//What reached the stub.
+struct Counts
+{
+	long long calls;
+	long long draws;
+	long long textures;
+	long long blends;
+	long long uniforms;
+	long long uploads;
+	long long orphans;
+	long long bytes;
+};
+
+static Counts counts;
+static int errors = 0;
+static GLuint nextBuffer = 1;
+static GLenum unit = GL_TEXTURE0;
+static GLuint texture;
+static GLenum blendSrc, blendDst, blendEquation;
+static const std::vector<Layer> *drawing;
+static bool batched;
+static int nextLayer;
+
+static void Error(const char *what, long long a, long long b)
+{
+	if(errors++ < 10)
+		printf("  %s (%lld, %lld)\n", what, a, b);
+}
+
+static Scene stubScene;
+
+//The sprite has to be drawn with its own texture and blending.
+static void CheckLayer(int index)
+{
+	const Layer &layer = (*drawing)[index];
+	if(texture != TextureOf(stubScene, sprites[layer.id]))
+		Error("layer drawn with the wrong texture", index, texture);
+	bool add = layer.blend == normal || layer.blend == additive;
+	GLenum dst = layer.blend == normal ? GL_ONE_MINUS_SRC_ALPHA : GL_ONE;
+	if(blendSrc != GL_SRC_ALPHA || blendDst != dst || blendEquation != (add ? GL_FUNC_ADD : GL_FUNC_REVERSE_SUBTRACT))
+		Error("layer drawn with the wrong blending", index, layer.blend);
+}
+
+static void APIENTRY GenBuffers(GLsizei n, GLuint *ids)
+{
+	for(GLsizei i = 0; i < n; ++i)
+		ids[i] = nextBuffer++;
+}
+
+static void APIENTRY DeleteBuffers(GLsizei, const GLuint *) {}
+static void APIENTRY BindBuffer(GLenum, GLuint) { ++counts.calls; }
+
+static void APIENTRY BufferData(GLenum, GLsizeiptr size, const void *data, GLenum)
+{
+	++counts.calls;
+	if(data)
+	{
+		++counts.uploads;
+		counts.bytes += size;
+	}
+	else
+		++counts.orphans;
+}
+
+static void APIENTRY BufferSubData(GLenum, GLintptr, GLsizeiptr size, const void *)
+{
+	++counts.calls;
+	++counts.uploads;
+	counts.bytes += size;
+}
+
+static void APIENTRY VertexAttribPointer(GLuint, GLint, GLenum, GLboolean, GLsizei, const void *) { ++counts.calls; }
+static void APIENTRY EnableVertexAttribArray(GLuint) { ++counts.calls; }
+static void APIENTRY DisableVertexAttribArray(GLuint) { ++counts.calls; }
+static void APIENTRY VertexAttrib4fv(GLuint, const GLfloat *) { ++counts.calls; }
+static void APIENTRY UseProgram(GLuint) { ++counts.calls; }
+
+static void APIENTRY UniformMatrix4fv(GLint, GLsizei, GLboolean, const GLfloat *)
+{
+	++counts.calls;
+	++counts.uniforms;
+}
+
+static void APIENTRY ActiveTexture(GLenum unit_)
+{
+	++counts.calls;
+	unit = unit_;
+}
+
+static void APIENTRY BindTexture(GLenum, GLuint id)
+{
+	++counts.calls;
+	++counts.textures;
+	if(unit == GL_TEXTURE0)
+		texture = id;
+}
+
+static void APIENTRY BlendFunc(GLenum src, GLenum dst)
+{
+	++counts.calls;
+	++counts.blends;
+	blendSrc = src;
+	blendDst = dst;
+}
+
+static void APIENTRY BlendEquation(GLenum mode)
+{
+	++counts.calls;
+	++counts.blends;
+	blendEquation = mode;
+}
+
+static void APIENTRY DrawArrays(GLenum, GLint first, GLsizei count)
+{
+	++counts.calls;
+	++counts.draws;
+	if(batched)
+	{
+		if(first != nextLayer * 6 || count <= 0 || count % 6)
+		{
+			Error("batch draws out of order", first, count);
+			return;
+		}
+		for(int i = 0; i < count / 6; ++i)
+			CheckLayer(nextLayer++);
+	}
+	else
+	{
+		if(first != 0 || count != 6)
+			Error("layer drawn from the wrong vertices", first, count);
+		CheckLayer(nextLayer++);
+	}
+}
+
+//Draw() leaves normal blending behind, the layers come after it.
+static void StartFrame()
+{
+	GlState::Invalidate();
+	blendSrc = GL_SRC_ALPHA;
+	blendDst = GL_ONE_MINUS_SRC_ALPHA;
+	blendEquation = GL_FUNC_ADD;
+}
+
+static void Print(const char *what, long long before, long long after, int count)
+{
+	printf("  %-16s %12.1f %12.1f\n", what, (double)before / count, (double)after / count);
+}
+
+//Runs every frame through both paths against the stub.
+static void Count()
+{
+	glad_glGenBuffers = GenBuffers;
+	glad_glDeleteBuffers = DeleteBuffers;
+	glad_glBindBuffer = BindBuffer;
+	glad_glBufferData = BufferData;
+	glad_glBufferSubData = BufferSubData;
+	glad_glVertexAttribPointer = VertexAttribPointer;
+	glad_glEnableVertexAttribArray = EnableVertexAttribArray;
+	glad_glDisableVertexAttribArray = DisableVertexAttribArray;
+	glad_glVertexAttrib4fv = VertexAttrib4fv;
+	glad_glUseProgram = UseProgram;
+	glad_glUniformMatrix4fv = UniformMatrix4fv;
+	glad_glActiveTexture = ActiveTexture;
+	glad_glBindTexture = BindTexture;
+	glad_glBlendFunc = BlendFunc;
+	glad_glBlendEquation = BlendEquation;
+	glad_glDrawArrays = DrawArrays;
+	GlState::Invalidate();
+
+	stubScene.program = 1;
+	stubScene.projection = 0;
+	for(int i = 0; i < pageCount; ++i)
+		stubScene.pages[i] = 1 + i;
+	for(int i = 0; i < ownCount; ++i)
+		stubScene.own[i] = 101 + i;
+
+	Counts before, after;
+	long long layers = 0;
+	{
+		Vao quad(Vao::F2F2, GL_STATIC_DRAW);
+		quad.Prepare(6*4*sizeof(float), nullptr);
+		quad.Load();
+		int current = -1;
+		counts = {};
+		batched = false;
+		for(const auto &frame : frames)
+		{
+			StartFrame();
+			drawing = &frame;
+			nextLayer = 0;
+			DrawPerSprite(stubScene, quad, current, frame);
+			if(nextLayer != (int)frame.size())
+				Error("layers left out", nextLayer, frame.size());
+			layers += frame.size();
+		}
+		before = counts;
+	}
+	{
+		SpriteBatch batch;
+		counts = {};
+		batched = true;
+		for(const auto &frame : frames)
+		{
+			StartFrame();
+			drawing = &frame;
+			nextLayer = 0;
+			DrawBatched(stubScene, batch, frame);
+			if(nextLayer != (int)frame.size())
+				Error("layers left out", nextLayer, frame.size());
+		}
+		after = counts;
+	}
+
+	int count = frames.size();
+	printf("Per frame over %d frames, %.1f layers each, against the stub:\n", count, (double)layers / count);
+	printf("  %-16s %12s %12s\n", "", "per sprite", "batched");
+	Print("GL calls", before.calls, after.calls, count);
+	Print("draws", before.draws, after.draws, count);
+	Print("texture binds", before.textures, after.textures, count);
+	Print("blend changes", before.blends, after.blends, count);
+	Print("matrix uploads", before.uniforms, after.uniforms, count);
+	Print("buffer uploads", before.uploads, after.uploads, count);
+	Print("buffer orphans", before.orphans, after.orphans, count);
+	Print("bytes uploaded", before.bytes, after.bytes, count);
+}
+
+#ifdef SPRITEBENCH_EGL
+static const char *vertexSource = R"(#version 330 core
+layout (location = 0) in vec2 Position;
+layout (location = 1) in vec2 UV;
+layout (location = 2) in vec4 Color;
+uniform mat4 Projection;
+out vec2 uv;
+out vec4 color;
+void main()
+{
+	gl_Position = Projection * vec4(Position, 0.0, 1.0);
+	uv = UV;
+	color = Color;
+}
+)";
+
+static const char *fragmentSource = R"(#version 330 core
+in vec2 uv;
+in vec4 color;
+uniform sampler2D Texture;
+out vec4 result;
+void main()
+{
+	result = texture(Texture, uv) * color;
+}
+)";
+
+static GLuint Compile(GLenum type, const char *source)
+{
+	GLuint shader = glCreateShader(type);
+	glShaderSource(shader, 1, &source, nullptr);
+	glCompileShader(shader);
+	GLint ok;
+	glGetShaderiv(shader, GL_COMPILE_STATUS, &ok);
+	if(!ok)
+	{
+		char log[512];
+		glGetShaderInfoLog(shader, sizeof(log), nullptr, log);
+		Error(log, type, 0);
+	}
+	return shader;
+}
+
+static GLuint Texture(int size, unsigned seed)
+{
+	std::mt19937 random(seed);
+	std::vector<uint32_t> pixels((size_t)size * size);
+	for(auto &pixel : pixels)
+		pixel = random() | 0x80000000u;
+	GLuint id;
+	glGenTextures(1, &id);
+	GlState::BindTexture(id);
+	GlState::TexFilter(GL_NEAREST);
+	GlState::TexParameter(GL_TEXTURE_MAX_LEVEL, 0);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, size, size, 0, GL_BGRA, GL_UNSIGNED_BYTE, pixels.data());
+	return id;
+}
+
+template<typename T>
+static bool Load(T &proc, const char *name)
+{
+	proc = (T)eglGetProcAddress(name);
+	return proc != nullptr;
+}
+
+//A surfaceless context drawing into a framebuffer object.
+static bool CreateContext()
+{
+	auto getDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+	EGLDisplay display = getDisplay ? getDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr) : EGL_NO_DISPLAY;
+	if(display == EGL_NO_DISPLAY || !eglInitialize(display, nullptr, nullptr) || !eglBindAPI(EGL_OPENGL_API))
+		return false;
+	const EGLint attribs[] = {
+		EGL_CONTEXT_MAJOR_VERSION, 3, EGL_CONTEXT_MINOR_VERSION, 3,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_COMPATIBILITY_PROFILE_BIT,
+		EGL_NONE};
+	EGLContext context = eglCreateContext(display, EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT, attribs);
+	if(context == EGL_NO_CONTEXT || !eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context))
+		return false;
+	if(!gladLoadGLLoader((GLADloadproc)eglGetProcAddress))
+		return false;
+
+	bool ok = true;
+	ok &= Load(GlExt::GenFramebuffers, "glGenFramebuffers");
+	ok &= Load(GlExt::BindFramebuffer, "glBindFramebuffer");
+	ok &= Load(GlExt::GenRenderbuffers, "glGenRenderbuffers");
+	ok &= Load(GlExt::BindRenderbuffer, "glBindRenderbuffer");
+	ok &= Load(GlExt::RenderbufferStorage, "glRenderbufferStorage");
+	ok &= Load(GlExt::FramebufferRenderbuffer, "glFramebufferRenderbuffer");
+	ok &= Load(GlExt::CheckFramebufferStatus, "glCheckFramebufferStatus");
+	if(!ok)
+		return false;
+	GLuint framebuffer, color;
+	GlExt::GenFramebuffers(1, &framebuffer);
+	GlExt::BindFramebuffer(GlExt::FRAMEBUFFER, framebuffer);
+	GlExt::GenRenderbuffers(1, &color);
+	GlExt::BindRenderbuffer(GlExt::RENDERBUFFER, color);
+	GlExt::RenderbufferStorage(GlExt::RENDERBUFFER, GL_RGBA8, width, height);
+	GlExt::FramebufferRenderbuffer(GlExt::FRAMEBUFFER, GlExt::COLOR_ATTACHMENT0, GlExt::RENDERBUFFER, color);
+	return GlExt::CheckFramebufferStatus(GlExt::FRAMEBUFFER) == GlExt::FRAMEBUFFER_COMPLETE;
+}
+
+//Both paths take turns frame by frame so they see the same machine.
+static void Time()
+{
+	if(!CreateContext())
+	{
+		printf("\nNo EGL context, skipping the timed pass\n");
+		return;
+	}
+	GlState::Invalidate();
+
+	Scene scene;
+	scene.program = glCreateProgram();
+	glAttachShader(scene.program, Compile(GL_VERTEX_SHADER, vertexSource));
+	glAttachShader(scene.program, Compile(GL_FRAGMENT_SHADER, fragmentSource));
+	glLinkProgram(scene.program);
+	scene.projection = glGetUniformLocation(scene.program, "Projection");
+	for(int i = 0; i < pageCount; ++i)
+		scene.pages[i] = Texture(pageSize, 10 + i);
+	for(int i = 0; i < ownCount; ++i)
+		scene.own[i] = Texture(ownSize, 20 + i);
+
+	glViewport(0, 0, width, height);
+	glEnable(GL_BLEND);
+	GlState::BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	GlState::BlendEquation(GL_FUNC_ADD);
+
+	using Clock = std::chrono::steady_clock;
+	const int warmup = 50;
+	double submit[2] = {}, total[2] = {};
+	{
+		Vao quad(Vao::F2F2, GL_STATIC_DRAW);
+		quad.Prepare(6*4*sizeof(float), nullptr);
+		quad.Load();
+		int current = -1;
+		SpriteBatch batch;
+		for(size_t frame = 0; frame < frames.size(); ++frame)
+		{
+			for(int turn = 0; turn < 2; ++turn)
+			{
+				int path = (turn + frame) % 2;
+				glClear(GL_COLOR_BUFFER_BIT);
+				auto start = Clock::now();
+				if(path == 0)
+					DrawPerSprite(scene, quad, current, frames[frame]);
+				else
+					DrawBatched(scene, batch, frames[frame]);
+				auto submitted = Clock::now();
+				glFinish();
+				auto done = Clock::now();
+				if(frame >= warmup)
+				{
+					submit[path] += std::chrono::duration<double, std::micro>(submitted - start).count();
+					total[path] += std::chrono::duration<double, std::milli>(done - start).count();
+				}
+			}
+		}
+	}
+	GLenum error = glGetError();
+	if(error != GL_NO_ERROR)
+		Error("GL error", error, 0);
+
+	int count = frames.size() - warmup;
+	printf("\nPer frame over %d frames on %s, %s:\n", count, glGetString(GL_RENDERER), glGetString(GL_VERSION));
+	printf("  %-16s %12s %12s\n", "", "per sprite", "batched");
+	printf("  %-16s %12.1f %12.1f\n", "submission us", submit[0] / count, submit[1] / count);
+	printf("  %-16s %12.3f %12.3f\n", "to glFinish ms", total[0] / count, total[1] / count);
+}
+#endif
+
+int main(int argc, char **argv)
+{
+	int count = argc > 1 ? atoi(argv[1]) : 1000;
+	if(count < 100)
+		count = 100;
+	MakeFrames(count);
+
+	Count();
+#ifdef SPRITEBENCH_EGL
+	Time();
+#endif
+
+	printf("\nResult: %d failures\n", errors);
+	return errors > 0 ? 2 : 0;
+}
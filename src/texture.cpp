@@ -1,6 +1,8 @@
 #include "texture.h"
 #include "cg.h"
 #include <glad/glad.h>
+#include "gl_state.h"
+#include "pixel_upload.h"
 
 #include <fstream>
 #include <iostream>
@@ -74,12 +76,12 @@ void Texture::LoadCompressed(char* data, int width, int height, size_t compresse
 	isApplied = true;
 
 	glGenTextures(1, &id);
-	glBindTexture(GL_TEXTURE_2D, id);
+	GlState::BindTexture(id);
 
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	GlState::TexParameter(GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	GlState::TexParameter(GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	GlState::TexParameter(GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	GlState::TexParameter(GL_TEXTURE_MIN_FILTER, GL_LINEAR);
 
 	// Determine OpenGL format
 	GLenum format;
@@ -100,9 +102,6 @@ void Texture::LoadCompressed(char* data, int width, int height, size_t compresse
 		printf("[LoadCompressed] GL ERROR 0x%X uploading %dx%d type=%d compressed texture (size=%zu)\n",
 			err, width, height, type, compressedSize);
 		printf("[LoadCompressed] Format=0x%X, data=%p\n", format, data);
-	} else {
-		printf("[LoadCompressed] SUCCESS: %dx%d type=%d DXT%d texture (GL ID=%u, size=%zu)\n",
-			width, height, type, (type == 1 ? 1 : 5), id, compressedSize);
 	}
 
 	// Create minimal ImageData for compatibility
@@ -125,32 +124,34 @@ void Texture::Apply(bool repeat, bool linearFilter)
 	isApplied = true;
 	glGenTextures(1, &id);
 
-	glBindTexture(GL_TEXTURE_2D, id);
+	GlState::BindTexture(id);
 	if(repeat)
 	{
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT );
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT );
+		GlState::TexParameter(GL_TEXTURE_WRAP_S, GL_REPEAT );
+		GlState::TexParameter(GL_TEXTURE_WRAP_T, GL_REPEAT );
 	}
 	else
 	{
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE );
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
+		GlState::TexParameter(GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE );
+		GlState::TexParameter(GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
 	}
 	if(linearFilter)
 	{
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		GlState::TexParameter(GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		GlState::TexParameter(GL_TEXTURE_MIN_FILTER, GL_LINEAR);
 	}
 	else
 	{
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		GlState::TexParameter(GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		GlState::TexParameter(GL_TEXTURE_MIN_FILTER, GL_NEAREST);
 	}
 
 	GLenum extType = image->bgr ? GL_BGRA : GL_RGBA;
 	GLenum intType = GL_RGBA8;
 
-	glTexImage2D(GL_TEXTURE_2D, 0, intType, image->width, image->height, 0, extType, GL_UNSIGNED_BYTE, image->pixels);
+	//Allocate only, the texels go through the upload ring.
+	glTexImage2D(GL_TEXTURE_2D, 0, intType, image->width, image->height, 0, extType, GL_UNSIGNED_BYTE, nullptr);
+	PixelUpload::SubImage(0, 0, image->width, image->height, extType, image->pixels);
 
 }
 void Texture::Unapply()
@@ -161,7 +162,8 @@ void Texture::Unapply()
 
 	isApplied = false;
 	// Unbind texture before deleting to prevent GL_INVALID_OPERATION
-	glBindTexture(GL_TEXTURE_2D, 0);
+	GlState::BindTexture(0);
+	GlState::ForgetTexture(id);
 	glDeleteTextures(1, &id);
 	id = 0;  // Reset ID after deletion
 }
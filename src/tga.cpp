@@ -0,0 +1,164 @@
+#include "tga.h"
+
+#include <cstdio>
+#include <cstring>
+
+namespace
+{
+	//A pixel of the given depth to RGBA. TGA stores BGR(A).
+	void ToRgba(unsigned char *dst, const unsigned char *p, int bits, bool grey)
+	{
+		if(grey)
+		{
+			dst[0] = dst[1] = dst[2] = p[0];
+			dst[3] = bits == 16 ? p[1] : 255;
+		}
+		else if(bits == 15 || bits == 16)
+		{
+			int v = p[0] | p[1] << 8;
+			dst[0] = ((v >> 10) & 31) * 255 / 31;
+			dst[1] = ((v >> 5) & 31) * 255 / 31;
+			dst[2] = (v & 31) * 255 / 31;
+			dst[3] = bits == 16 && !(v & 0x8000) ? 0 : 255;
+		}
+		else
+		{
+			dst[0] = p[2];
+			dst[1] = p[1];
+			dst[2] = p[0];
+			dst[3] = bits == 32 ? p[3] : 255;
+		}
+	}
+}
+
+namespace Tga
+{
+	bool Decode(std::vector<unsigned char> &rgba, int &width, int &height, const unsigned char *data, size_t size)
+	{
+		if(size < 18)
+			return false;
+		int idLength = data[0];
+		int mapType = data[1];
+		int type = data[2];
+		int mapFirst = data[3] | data[4] << 8;
+		int mapLength = data[5] | data[6] << 8;
+		int mapBits = data[7];
+		width = data[12] | data[13] << 8;
+		height = data[14] | data[15] << 8;
+		int bits = data[16];
+		int descriptor = data[17];
+
+		bool rle = type >= 9;
+		int kind = type & 7; //1 mapped, 2 true colour, 3 grey
+		if(width <= 0 || height <= 0 || kind < 1 || kind > 3 || (type & ~11))
+			return false;
+		if(kind == 1 && (mapType != 1 || bits != 8 || (mapBits != 15 && mapBits != 16 && mapBits != 24 && mapBits != 32)))
+			return false;
+		if(kind == 2 && bits != 15 && bits != 16 && bits != 24 && bits != 32)
+			return false;
+		if(kind == 3 && bits != 8 && bits != 16)
+			return false;
+
+		size_t pos = 18 + idLength;
+		int mapBytes = (mapBits + 7) / 8;
+		std::vector<unsigned char> map;
+		if(mapType == 1)
+		{
+			size_t mapSize = (size_t)mapLength * mapBytes;
+			if(pos + mapSize > size)
+				return false;
+			if(kind == 1)
+			{
+				map.resize((size_t)(mapFirst + mapLength) * 4, 0);
+				for(int i = 0; i < mapLength; ++i)
+					ToRgba(&map[(mapFirst + i) * 4], data + pos + i * mapBytes, mapBits, false);
+			}
+			pos += mapSize;
+		}
+
+		int pixelBytes = (bits + 7) / 8;
+		//16 bit pixels only have alpha if the descriptor gives them an attribute bit.
+		int colorBits = kind == 2 && bits == 16 && !(descriptor & 15) ? 15 : bits;
+		size_t count = (size_t)width * height;
+		rgba.resize(count * 4);
+		auto put = [&](size_t i, const unsigned char *p) {
+			unsigned char *dst = &rgba[i * 4];
+			if(kind == 1)
+			{
+				if((size_t)p[0] * 4 + 4 > map.size())
+					return false;
+				memcpy(dst, &map[p[0] * 4], 4);
+			}
+			else
+				ToRgba(dst, p, colorBits, kind == 3);
+			return true;
+		};
+
+		for(size_t i = 0; i < count;)
+		{
+			int run = 1;
+			bool repeat = false;
+			if(rle)
+			{
+				if(pos >= size)
+					return false;
+				int header = data[pos++];
+				run = (header & 127) + 1;
+				repeat = header & 128;
+				if(i + run > count)
+					return false;
+			}
+			size_t need = (size_t)(repeat ? 1 : run) * pixelBytes;
+			if(pos + need > size)
+				return false;
+			for(int j = 0; j < run; ++j, ++i)
+			{
+				if(!put(i, data + pos + (repeat ? 0 : j * pixelBytes)))
+					return false;
+			}
+			pos += need;
+		}
+
+		//Bottom to top unless bit 5 says otherwise, bit 4 mirrors.
+		size_t rowSize = (size_t)width * 4;
+		if(!(descriptor & 0x20))
+		{
+			std::vector<unsigned char> row(rowSize);
+			for(int y = 0; y < height / 2; ++y)
+			{
+				unsigned char *a = &rgba[y * rowSize], *b = &rgba[(height - 1 - y) * rowSize];
+				memcpy(row.data(), a, rowSize);
+				memcpy(a, b, rowSize);
+				memcpy(b, row.data(), rowSize);
+			}
+		}
+		if(descriptor & 0x10)
+		{
+			for(int y = 0; y < height; ++y)
+			{
+				unsigned int *row = (unsigned int*)&rgba[y * rowSize];
+				for(int x = 0; x < width / 2; ++x)
+				{
+					unsigned int t = row[x];
+					row[x] = row[width - 1 - x];
+					row[width - 1 - x] = t;
+				}
+			}
+		}
+		return true;
+	}
+
+	bool Read(const char *filename, std::vector<unsigned char> &rgba, int &width, int &height)
+	{
+		FILE *file = fopen(filename, "rb");
+		if(!file)
+			return false;
+		std::vector<unsigned char> data;
+		unsigned char buffer[65536];
+		size_t n;
+		while((n = fread(buffer, 1, sizeof(buffer), file)) > 0)
+			data.insert(data.end(), buffer, buffer + n);
+		fclose(file);
+		return Decode(rgba, width, height, data.data(), data.size());
+	}
+}
@@ -0,0 +1,15 @@
+#ifndef TGA_H_GUARD
+#define TGA_H_GUARD
+
+#include <cstddef>
+#include <vector>
+
+// TGA reader for texture import: true colour (16, 24 or 32 bit), grey and
+// colour mapped images, raw or RLE. Output is RGBA8, rows top to bottom.
+namespace Tga
+{
+	bool Decode(std::vector<unsigned char> &rgba, int &width, int &height, const unsigned char *data, size_t size);
+	bool Read(const char *filename, std::vector<unsigned char> &rgba, int &width, int &height);
+}
+
+#endif /* TGA_H_GUARD */
@@ -503,6 +503,7 @@ void MainFrame::Menu(unsigned int errorPopupId)
 
 			// Global windows
 			if (ImGui::MenuItem("Vectors Guide")) vectors.drawWindow = !vectors.drawWindow;
+			if (ImGui::MenuItem("Render Profiler")) profilerWindow.isVisible = !profilerWindow.isVisible;
 			ImGui::EndMenu();
 		}
 		if (ImGui::BeginMenu("Help"))
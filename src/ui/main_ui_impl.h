@@ -423,6 +423,14 @@ void MainFrame::DrawUi()
 			if (view->getShapePane() && view->getShapePane()->isVisible) view->getShapePane()->Draw();
 			if (view->getTexturePane() && view->getTexturePane()->isVisible) view->getTexturePane()->Draw();
 			if (view->getToolPane() && view->getToolPane()->isVisible) view->getToolPane()->Draw();
+
+			// The panes write straight into the parts. A widget edited or
+			// released (buttons and selectables act on release) may have
+			// changed them, anything drawn from them is out of date.
+			ImGuiContext& g = *ImGui::GetCurrentContext();
+			bool released = g.ActiveIdPreviousFrame != 0 && g.ActiveId != g.ActiveIdPreviousFrame;
+			if (character && (g.ActiveIdHasBeenEditedThisFrame || released))
+				character->parts.MarkEdited();
 		}
 
 		// End undo frame - commit snapshot if anything was modified
@@ -432,6 +440,7 @@ void MainFrame::DrawUi()
 	}
 	aboutWindow.Draw();
 	vectors.Draw();
+	profilerWindow.Draw(render);
 
 	RenderUpdate();
 }
@@ -1182,6 +1191,37 @@ void MainFrame::RightClick(int x_, int y_)
 	                  (y_ - active->renderY - clientRect.y/2)/render.scale);
 }
 
+void MainFrame::LeftClick(int x_, int y_)
+{
+	if (getActiveView() && getActiveCharacter())
+		render.RequestPick(x_, y_);
+}
+
+void MainFrame::ApplyPick(const IdPicker::Pick &pick)
+{
+	// The view may have changed while the pick was on its way
+	auto* view = getActiveView();
+	auto* active = getActiveCharacter();
+	if (!view || !active || !pick.hit) return;
+
+	auto& state = view->getState();
+	if (pick.spawn >= 0) {
+		// Only the static spawn tree can be selected, active spawns come and go
+		bool useActiveSpawns = state.animating || !state.activeSpawns.empty();
+		if (!useActiveSpawns && pick.spawn < (int)state.spawnedPatterns.size())
+			state.selectedSpawnedPattern = pick.spawn;
+		return;
+	}
+
+	state.selectedLayer = pick.layer;
+	if (view->isPatEditor() && pick.part >= 0) {
+		state.partProp = pick.part;
+		// Follow the selection if the part set pane is highlighting it
+		if (active->parts.partHighlight != -1)
+			active->parts.partHighlight = pick.part;
+	}
+}
+
 bool MainFrame::HandleKeys(uint64_t vkey)
 {
 	bool ctrlPressed = GetKeyState(VK_CONTROL) & 0x8000;
@@ -1,10 +1,25 @@
 #include "vao.h"
 #include <glad/glad.h>
+#include "gl_ext.h"
+#include "gl_state.h"
+#ifdef _WIN32
 #include <windows.h>
+#endif
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
 #include <sstream>
 
+//Stream buffers start at least this big so small per-part loads share one.
+constexpr size_t minRingSize = 256*1024;
+//Past this a ring waits for the GPU instead of growing.
+constexpr size_t maxRingSize = 64*1024*1024;
+
+Vao::Stats Vao::stats = {};
+
 Vao::Vao(AttribType _type, unsigned int _usage):
 type(_type), usage(_usage), loaded(false), stride(0), totalSize(0), vaoId(0), vboId(0),
+capacity(0), cursor(0), base(0), fences{}, written{},
 quadCount(nullptr), quadIndexes(nullptr)
 {
 	switch(type)
@@ -18,12 +33,25 @@ quadCount(nullptr), quadIndexes(nullptr)
 	case F3F4:
 		stride = 7 * sizeof(float); // x,y,z,s,t,p,q
 		break;
+	case F2:
+		stride = 2 * sizeof(float);
+		break;
+	case F4F4:
+		stride = 8 * sizeof(float);
+		break;
 	}
 }
 
 Vao::~Vao()
 {
-	glDeleteBuffers(1, &vboId);
+	DropFences();
+	if(vboId)
+	{
+		GlState::ForgetBuffer(vboId);
+		glDeleteBuffers(1, &vboId);
+		--stats.buffers;
+		stats.bytes -= capacity;
+	}
 	delete[] quadIndexes;
 }
 
@@ -33,24 +61,59 @@ int Vao::Prepare(size_t size, void *ptr)
 	{
 		std::stringstream ss;
 		ss << "Size "<<size<<" is not a multiple of the stride "<<stride;
+#ifdef _WIN32
 		MessageBoxA(nullptr, ss.str().c_str(), __FUNCTION__, MB_ICONWARNING);
+#else
+		printf("%s: %s\n", __FUNCTION__, ss.str().c_str());
+#endif
 		size -= alignment;
 	}
 
 	dataPointers.push_back(memPtr{
 		(uint8_t*) ptr,
 		size,
-		totalSize/stride
+		totalSize/stride,
+		false
 	});
 	totalSize += size;
 	return dataPointers.size() - 1;
 }
 
+int Vao::Append(const void *ptr, size_t size)
+{
+	size_t where = totalSize;
+	int which = Prepare(size, nullptr);
+	size = dataPointers[which].size;
+	if(staging.size() < totalSize)
+		staging.resize(totalSize);
+	memcpy(staging.data() + where, ptr, size);
+	dataPointers[which].staged = true;
+	return which;
+}
+
 void Vao::Draw(int which, size_t count, int mode)
 {
 	if(count == 0)
 		count = dataPointers[which].size/stride;
-	glDrawArrays(mode, dataPointers[which].location, count);
+	glDrawArrays(mode, base + dataPointers[which].location, count);
+}
+
+void Vao::DrawInstances(int which, int vertices, int mode)
+{
+	//No base instance before 4.2, the pointers start at the first one instead.
+	GlState::BindBuffer(GL_ARRAY_BUFFER, vboId);
+	size_t offset = (base + dataPointers[which].location)*stride;
+	glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, stride, (void*)offset);
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, stride, (void*)(offset + sizeof(float)*4));
+	glEnableVertexAttribArray(2);
+	GlExt::VertexAttribDivisor(1, 1);
+	GlExt::VertexAttribDivisor(2, 1);
+	GlExt::DrawArraysInstanced(mode, 0, vertices, dataPointers[which].size/stride);
+	//Everything else reads 1 per vertex and 2 as a constant.
+	GlExt::VertexAttribDivisor(1, 0);
+	GlExt::VertexAttribDivisor(2, 0);
+	glDisableVertexAttribArray(2);
 }
 
 void Vao::InitQuads(int which)
@@ -62,7 +125,7 @@ void Vao::InitQuads(int which)
 		quadCount = quadIndexes+quadSize;
 		for(int i = 0; i < quadSize; i++)
 		{
-			quadIndexes[i] = dataPointers[which].location + i*4;
+			quadIndexes[i] = base + dataPointers[which].location + i*4;
 			quadCount[i] = 4;
 		}
 	}
@@ -81,15 +144,20 @@ void Vao::UpdateBuffer(int which, void *data, size_t count)
 	if(count == 0)
 		count = dataPointers[which].size;
 
-	glBindBuffer(GL_ARRAY_BUFFER, vboId);
-	glBufferSubData(GL_ARRAY_BUFFER, dataPointers[which].location*stride, count, data);
+	GlState::BindBuffer(GL_ARRAY_BUFFER, vboId);
+	glBufferSubData(GL_ARRAY_BUFFER, (base + dataPointers[which].location)*stride, count, data);
 
 }
 
 void Vao::Bind()
 {
 	//Since we now have to keep the state ourselves.
-	glBindBuffer(GL_ARRAY_BUFFER, vboId);
+	GlState::BindBuffer(GL_ARRAY_BUFFER, vboId);
+	SetPointers();
+}
+
+void Vao::SetPointers()
+{
 	switch(type)
 	{
 	case F3F3:
@@ -112,49 +180,156 @@ void Vao::Bind()
 		glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, stride, (void*)(sizeof(float)*3));
 		glEnableVertexAttribArray(1);
 		break;
+	case F2:
+		glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, stride, nullptr);
+		glEnableVertexAttribArray(0);
+		break;
+	case F4F4:
+		//Depend on the instances drawn, set in DrawInstances.
+		break;
 	}
 }
 
-void Vao::Load()
+void Vao::Gather(uint8_t *dst)
 {
-	glGenBuffers(1, &vboId);
-	glBindBuffer(GL_ARRAY_BUFFER, vboId);
-	glBufferData(GL_ARRAY_BUFFER, totalSize, nullptr, usage);
-
-	uint8_t *data = (uint8_t*)glMapBuffer(GL_ARRAY_BUFFER, GL_WRITE_ONLY);
-	size_t where = 0;
+	bool inPlace = dst == staging.data();
+	//Staged data is copied in runs, boxes append many small pieces.
+	size_t where = 0, run = 0;
 	for(auto &subData : dataPointers)
 	{
-		if(subData.ptr)
-			memcpy(data+where, subData.ptr, subData.size);
+		if(!subData.staged)
+		{
+			if(!inPlace && run < where)
+				memcpy(dst + run, staging.data() + run, where - run);
+			if(subData.ptr)
+				memcpy(dst + where, subData.ptr, subData.size);
+			else
+				memset(dst + where, 0, subData.size);
+			run = where + subData.size;
+		}
 		where += subData.size;
 	}
-	glUnmapBuffer(GL_ARRAY_BUFFER);
+	if(!inPlace && run < where)
+		memcpy(dst + run, staging.data() + run, where - run);
+}
 
-	switch(type)
+void Vao::Allocate(size_t size)
+{
+	//Fresh storage, the old one goes once the GPU is done with it.
+	DropFences();
+	stats.bytes -= capacity;
+	capacity = size;
+	stats.bytes += capacity;
+	glBufferData(GL_ARRAY_BUFFER, capacity, nullptr, usage);
+	cursor = 0;
+}
+
+bool Vao::Guard(size_t start, bool wrapped, bool wait)
+{
+	size_t segment = (capacity + segments - 1)/segments;
+	int first = start/segment;
+	int last = (start + totalSize - 1)/segment;
+
+	//Every draw from the earlier loads is queued by now. Only the segment
+	//this load carries on in stays open.
+	for(int i = 0; i < segments; ++i)
 	{
-	case F3F3:
-		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, nullptr);
-		glEnableVertexAttribArray(0);
-		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, (void*)(sizeof(float)*3));
-		glEnableVertexAttribArray(1);
-		break;
-	case F2F2:
-		glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, stride, nullptr);
-		glEnableVertexAttribArray(0);
-		glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, stride, (void*)(sizeof(float)*2));
-		glEnableVertexAttribArray(1);
-		break;
-	case F3F4:
-		// Position: x,y,z (attribute 0)
-		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, nullptr);
-		glEnableVertexAttribArray(0);
-		// TexCoord: s,t,p,q (attribute 1)
-		glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, stride, (void*)(sizeof(float)*3));
-		glEnableVertexAttribArray(1);
-		break;
+		if(written[i] && (i != first || wrapped))
+		{
+			fences[i] = GlExt::FenceSync(GlExt::SYNC_GPU_COMMANDS_COMPLETE, 0);
+			written[i] = false;
+		}
 	}
 
+	for(int i = first; i <= last; ++i)
+	{
+		if(!fences[i])
+			continue;
+		GLenum result = GlExt::ClientWaitSync(fences[i], GlExt::SYNC_FLUSH_COMMANDS_BIT, 0);
+		if(result == GlExt::TIMEOUT_EXPIRED)
+		{
+			if(!wait)
+				return false;
+			++stats.waits;
+			while(result == GlExt::TIMEOUT_EXPIRED)
+				result = GlExt::ClientWaitSync(fences[i], GlExt::SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+		}
+		GlExt::DeleteSync(fences[i]);
+		fences[i] = nullptr;
+	}
+	for(int i = first; i <= last; ++i)
+		written[i] = true;
+	return true;
+}
+
+void Vao::DropFences()
+{
+	for(int i = 0; i < segments; ++i)
+	{
+		if(fences[i])
+			GlExt::DeleteSync(fences[i]);
+		fences[i] = nullptr;
+		written[i] = false;
+	}
+}
+
+void Vao::Load()
+{
+	if(staging.size() < totalSize)
+		staging.resize(totalSize);
+	if(!vboId)
+	{
+		glGenBuffers(1, &vboId);
+		++stats.buffers;
+	}
+	GlState::BindBuffer(GL_ARRAY_BUFFER, vboId);
+
+	if(usage != GL_STREAM_DRAW)
+	{
+		if(totalSize > capacity)
+			Allocate(totalSize);
+		cursor = 0;
+		Gather(staging.data());
+		if(totalSize)
+			glBufferSubData(GL_ARRAY_BUFFER, 0, totalSize, staging.data());
+	}
+	else
+	{
+		if(totalSize > capacity)
+			Allocate(std::max(totalSize*2, minRingSize));
+		bool wrapped = cursor + totalSize > capacity;
+		if(wrapped)
+		{
+			cursor = 0;
+			++stats.wraps;
+		}
+		if(totalSize && !Guard(cursor, wrapped, capacity >= maxRingSize))
+		{
+			//The GPU is less than a lap behind, give it more room.
+			Allocate(std::min(capacity*2, maxRingSize));
+			Guard(cursor, false, true);
+		}
+
+		void *dst = nullptr;
+		if(totalSize)
+			dst = GlExt::MapBufferRange(GL_ARRAY_BUFFER, cursor, totalSize,
+				GlExt::MAP_WRITE_BIT | GlExt::MAP_INVALIDATE_RANGE_BIT | GlExt::MAP_UNSYNCHRONIZED_BIT);
+		if(dst)
+		{
+			Gather((uint8_t*)dst);
+			glUnmapBuffer(GL_ARRAY_BUFFER);
+		}
+		else if(totalSize)
+		{
+			Gather(staging.data());
+			glBufferSubData(GL_ARRAY_BUFFER, cursor, totalSize, staging.data());
+		}
+	}
+	base = cursor/stride;
+	cursor += totalSize;
+	loaded = true;
+
+	SetPointers();
 }
 
 void Vao::Clear()
@@ -162,4 +337,4 @@ void Vao::Clear()
 	dataPointers.clear();
 	totalSize = 0;
 	loaded = false;
-}
\ No newline at end of file
+}
@@ -1,10 +1,18 @@
 #ifndef VAO_H_GUARD
 #define VAO_H_GUARD
 #include <vector>
+#include <cstddef>
 #include <cstdint>
 #include <glad/glad.h>
 
 //Not really a VAO since this is OGL 2.1
+//Owns a single buffer for its whole life. With GL_STREAM_DRAW it works as a
+//ring: every Load() goes after the previous one, written through an
+//unsynchronized mapping. The ring is split in segments and each one is fenced
+//once the loads in it have been drawn; the next lap waits for that fence
+//before writing there. A lap that would have to wait doubles the ring
+//instead (up to maxRingSize), so it settles at what the frames in flight
+//use and per-frame reloads neither create GL objects nor reallocate.
 class Vao
 {
 public:
@@ -12,7 +20,17 @@ public:
 	{
 		F2F2, //Textures (x,y,s,t)
 		F3F3, //Color only (x,y,z,r,g,b)
-		F3F4  //Parts (x,y,z,s,t,p,q) - position + normal/flipped UVs
+		F3F4, //Parts (x,y,z,s,t,p,q) - position + normal/flipped UVs
+		F2,   //Unit shapes (x,y) drawn once per instance
+		F4F4  //Instances (x1,y1,x2,y2,r,g,b,z) as attributes 1 and 2, see DrawInstances
+	};
+
+	struct Stats
+	{
+		int buffers;   //Live buffer objects over all Vaos.
+		size_t bytes;  //Their allocated size.
+		int wraps;     //Ring laps since startup.
+		int waits;     //Laps that caught up with the GPU and had to block.
 	};
 
 private:
@@ -26,32 +44,62 @@ private:
 		uint8_t *ptr;
 		size_t size;
 		size_t location;
+		bool staged; //Already copied into staging by Append().
 	};
 
 	size_t totalSize;
 	std::vector<memPtr> dataPointers;
+	std::vector<uint8_t> staging; //Appended data, and what Load() uploads.
 	unsigned int vaoId;
 	unsigned int vboId;
+	size_t capacity;
+	size_t cursor;
+	size_t base; //First vertex of the last Load() inside the buffer.
+
+	static constexpr int segments = 4;
+	GLsync fences[segments];
+	bool written[segments]; //Loaded into since its last fence.
 
 	GLint *quadIndexes;
 	GLint *quadCount;
 	GLsizei quadSize;
 
+	static Stats stats;
+
+	void SetPointers();
+	//Copies the prepared data to dst, what Append() staged included.
+	//staging has to hold totalSize bytes.
+	void Gather(uint8_t *dst);
+	void Allocate(size_t size);
+	//Fences what earlier loads left and waits for the segments the load at
+	//start is going to write. False if the GPU still reads one of them.
+	bool Guard(size_t start, bool wrapped, bool wait);
+	void DropFences();
+
 public:
 	Vao(AttribType type, unsigned int usage);
 	~Vao();
 
 	//Returns index of object that can be drawn.
+	//ptr must stay valid until Load(). nullptr reserves zeroed space.
 	int Prepare(size_t size, void *ptr);
+	//Like Prepare, but copies the data right away into storage that's
+	//kept across Clear(), so steady use doesn't allocate.
+	int Append(const void *ptr, size_t size);
 	void Draw(int which, size_t count = 0, int mode = GL_TRIANGLES);
+	//F4F4 only. Draws the first vertices of whatever is bound to attribute 0
+	//once per element of which.
+	void DrawInstances(int which, int vertices, int mode);
 
+	//Quads are only valid while the data from the first Load() is in use.
 	void InitQuads(int which);
 	void DrawQuads(int mode = GL_LINE_LOOP, int numberOf =-1);
 	void UpdateBuffer(int which, void *data, size_t count = 0);
 	void Bind();
 	void Load();
-	void Clear(); // Clear all prepared data
+	void Clear(); // Clear all prepared data, the buffer is kept for the next Load
 
+	static Stats GetStats() { return stats; }
 };
 
 #endif /* VAO_H_GUARD */
@@ -0,0 +1,336 @@
+// Vao soak run without a context: the glad buffer entry points go to a stub
+// that tracks buffer objects and their storage, then a few Vaos are used the
+// way the renderer does for many frames. The number of GL objects and their
+// size has to stop changing once the rings have grown, and every upload and
+// draw has to stay inside the storage it goes to.
+// The stub also plays a GPU that finishes a frame's draws gpuLag frames
+// later, or when a fence after them is waited for. An unsynchronized mapping
+// over a draw it hasn't finished is an error.
+// Built as vaosoak.exe. Usage: vaosoak [frames] (default 100000)
+#include <cstdio>
+#include <algorithm>
+#include <cstdlib>
+#include <deque>
+#include <random>
+#include <unordered_map>
+#include <vector>
+#include "vao.h"
+#include "gl_ext.h"
+#include "gl_state.h"
+
+struct StubBuffer
+{
+	size_t size;
+	int storage; //Changes with every glBufferData.
+};
+
+//Draws the GPU hasn't finished, adjacent ones merged.
+struct StubDraw
+{
+	GLuint buffer;
+	int storage;
+	size_t begin, end;
+	int frame;
+	unsigned serial;
+};
+
+static const int gpuLag = 2;
+
+static std::unordered_map<GLuint, StubBuffer> buffers;
+static GLuint nextId = 1, bound = 0;
+static int bufferDataCalls = 0, errors = 0;
+static int lastStride = 0;
+static int storages = 0;
+static std::deque<StubDraw> inFlight;
+static std::unordered_map<GLsync, unsigned> fences;
+static uintptr_t nextFence = 1;
+static unsigned drawSerial = 0, finished = 0;
+static int gpuFrame = 0, blockingWaits = 0;
+static std::vector<uint8_t> mapping;
+static bool mapped = false;
+
+static void Error(const char *what, long long a, long long b)
+{
+	if(errors++ < 10)
+		printf("  %s (%lld, %lld)\n", what, a, b);
+}
+
+static void APIENTRY GenBuffers(GLsizei n, GLuint *ids)
+{
+	for(GLsizei i = 0; i < n; ++i)
+	{
+		ids[i] = nextId++;
+		buffers[ids[i]] = {0};
+	}
+}
+
+static void APIENTRY DeleteBuffers(GLsizei n, const GLuint *ids)
+{
+	for(GLsizei i = 0; i < n; ++i)
+	{
+		if(!buffers.erase(ids[i]))
+			Error("deleting an unknown buffer", ids[i], 0);
+		if(bound == ids[i])
+			bound = 0;
+	}
+}
+
+static void APIENTRY BindBuffer(GLenum, GLuint id)
+{
+	if(id && !buffers.count(id))
+		Error("binding an unknown buffer", id, 0);
+	bound = id;
+}
+
+static void APIENTRY BufferData(GLenum, GLsizeiptr size, const void *, GLenum)
+{
+	++bufferDataCalls;
+	if(!bound)
+		Error("allocating with no buffer bound", size, 0);
+	else
+		buffers[bound] = {(size_t)size, ++storages};
+}
+
+static void APIENTRY BufferSubData(GLenum, GLintptr offset, GLsizeiptr size, const void *)
+{
+	if(!bound || offset < 0 || (size_t)(offset + size) > buffers[bound].size)
+		Error("upload outside the buffer", offset, size);
+}
+
+static void APIENTRY VertexAttribPointer(GLuint, GLint, GLenum, GLboolean, GLsizei stride, const void *)
+{
+	lastStride = stride;
+}
+
+static void *APIENTRY MapBufferRange(GLenum, GLintptr offset, GLsizeiptr length, GLbitfield access)
+{
+	if(!bound || mapped || offset < 0 || (size_t)(offset + length) > buffers[bound].size)
+	{
+		Error("mapping outside the buffer", offset, length);
+		return nullptr;
+	}
+	if(access & GlExt::MAP_UNSYNCHRONIZED_BIT)
+	{
+		const StubBuffer &buffer = buffers[bound];
+		for(const StubDraw &draw : inFlight)
+		{
+			if(draw.buffer == bound && draw.storage == buffer.storage &&
+				draw.begin < (size_t)(offset + length) && (size_t)offset < draw.end)
+				Error("writing over a draw the GPU hasn't done", offset, length);
+		}
+	}
+	mapping.resize(length);
+	mapped = true;
+	return mapping.data();
+}
+
+static GLboolean APIENTRY UnmapBuffer(GLenum)
+{
+	if(!mapped)
+		Error("unmapping a buffer that isn't mapped", bound, 0);
+	mapped = false;
+	return GL_TRUE;
+}
+
+static void Finish(unsigned serial)
+{
+	while(!inFlight.empty() && inFlight.front().serial <= serial)
+		inFlight.pop_front();
+	finished = std::max(finished, serial);
+}
+
+//A frame's draws are done gpuLag frames later.
+static void EndFrame()
+{
+	++gpuFrame;
+	unsigned serial = finished;
+	for(const StubDraw &draw : inFlight)
+	{
+		if(draw.frame > gpuFrame - gpuLag)
+			break;
+		serial = draw.serial;
+	}
+	Finish(serial);
+}
+
+static GLsync APIENTRY FenceSync(GLenum, GLbitfield)
+{
+	GLsync sync = (GLsync)nextFence++;
+	fences[sync] = drawSerial;
+	return sync;
+}
+
+static GLenum APIENTRY ClientWaitSync(GLsync sync, GLbitfield, GLuint64 timeout)
+{
+	auto fence = fences.find(sync);
+	if(fence == fences.end())
+	{
+		Error("waiting for an unknown fence", (uintptr_t)sync, 0);
+		return GlExt::WAIT_FAILED;
+	}
+	if(fence->second <= finished)
+		return GlExt::ALREADY_SIGNALED;
+	if(!timeout)
+		return GlExt::TIMEOUT_EXPIRED;
+	++blockingWaits;
+	Finish(fence->second);
+	return 0x911C; //GL_CONDITION_SATISFIED
+}
+
+static void APIENTRY DeleteSync(GLsync sync)
+{
+	if(!fences.erase(sync))
+		Error("deleting an unknown fence", (uintptr_t)sync, 0);
+}
+
+static void APIENTRY EnableVertexAttribArray(GLuint) {}
+
+static void APIENTRY DrawArrays(GLenum, GLint first, GLsizei count)
+{
+	if(!bound || !lastStride || (size_t)(first + count) * lastStride > buffers[bound].size)
+	{
+		Error("drawing past the end of the buffer", first, count);
+		return;
+	}
+	if(mapped)
+		Error("drawing from a mapped buffer", first, count);
+	StubDraw draw = {bound, buffers[bound].storage, (size_t)first * lastStride,
+		(size_t)(first + count) * lastStride, gpuFrame, ++drawSerial};
+	if(!inFlight.empty())
+	{
+		StubDraw &last = inFlight.back();
+		if(last.buffer == draw.buffer && last.storage == draw.storage && last.frame == draw.frame &&
+			draw.begin <= last.end && last.begin <= draw.end)
+		{
+			last.begin = std::min(last.begin, draw.begin);
+			last.end = std::max(last.end, draw.end);
+			last.serial = draw.serial;
+			return;
+		}
+	}
+	inFlight.push_back(draw);
+}
+
+//Vertices as floats for a type, count whole vertices.
+static std::vector<float> Vertices(int floatsPerVertex, int count)
+{
+	return std::vector<float>((size_t)floatsPerVertex * count, 1.f);
+}
+
+int main(int argc, char **argv)
+{
+	int frames = argc > 1 ? atoi(argv[1]) : 100000;
+	if(frames < 2000)
+		frames = 2000;
+
+	glad_glGenBuffers = GenBuffers;
+	glad_glDeleteBuffers = DeleteBuffers;
+	glad_glBindBuffer = BindBuffer;
+	glad_glBufferData = BufferData;
+	glad_glBufferSubData = BufferSubData;
+	glad_glVertexAttribPointer = VertexAttribPointer;
+	glad_glEnableVertexAttribArray = EnableVertexAttribArray;
+	glad_glDrawArrays = DrawArrays;
+	glad_glUnmapBuffer = UnmapBuffer;
+	GlExt::MapBufferRange = MapBufferRange;
+	GlExt::FenceSync = FenceSync;
+	GlExt::ClientWaitSync = ClientWaitSync;
+	GlExt::DeleteSync = DeleteSync;
+	GlState::Invalidate();
+
+	std::mt19937 random(1);
+	const int warmup = 1000;
+	Vao::Stats settled = {};
+	size_t settledObjects = 0;
+	int settledBufferData = 0, settledWraps = 0, settledWaits = 0, settledStubWaits = 0;
+	int changes = 0;
+	{
+		//Parts meshes: several loads per frame into one stream ring.
+		Vao parts(Vao::F3F4, GL_STREAM_DRAW);
+		//Boxes: appended and loaded once per frame.
+		Vao boxes(Vao::F3F3, GL_STREAM_DRAW);
+		//The sprite quad: loaded once, then only updated.
+		Vao sprite(Vao::F2F2, GL_STATIC_DRAW);
+		std::vector<float> quad = Vertices(4, 6);
+		sprite.Prepare(quad.size() * sizeof(float), quad.data());
+		sprite.Load();
+
+		for(int frame = 0; frame < frames; ++frame)
+		{
+			//The largest frames come first, as many as the GPU has in flight,
+			//so the rings have grown by the end of the warm up.
+			bool largest = frame <= gpuLag;
+			int loads = largest ? 12 : 1 + random() % 12;
+			for(int i = 0; i < loads; ++i)
+			{
+				int vertices = largest ? 4096 : 6 + random() % 4090;
+				std::vector<float> data = Vertices(7, vertices);
+				parts.Clear();
+				int which = parts.Append(data.data(), data.size() * sizeof(float));
+				parts.Load();
+				parts.Draw(which);
+			}
+
+			boxes.Clear();
+			int boxCount = largest ? 256 : random() % 257;
+			std::vector<float> box = Vertices(6, 8);
+			std::vector<int> drawn;
+			for(int i = 0; i < boxCount; ++i)
+				drawn.push_back(boxes.Append(box.data(), box.size() * sizeof(float)));
+			boxes.Load();
+			for(int which : drawn)
+				boxes.Draw(which, 0, GL_LINE_LOOP);
+
+			sprite.UpdateBuffer(0, quad.data());
+			sprite.Bind();
+			sprite.Draw(0);
+			EndFrame();
+
+			if(frame == warmup)
+			{
+				settled = Vao::GetStats();
+				settledObjects = buffers.size();
+				settledBufferData = bufferDataCalls;
+				settledWraps = settled.wraps;
+				settledWaits = settled.waits;
+				settledStubWaits = blockingWaits;
+			}
+			else if(frame > warmup)
+			{
+				Vao::Stats now = Vao::GetStats();
+				if(now.buffers != settled.buffers || now.bytes != settled.bytes || buffers.size() != settledObjects)
+				{
+					if(changes++ < 10)
+						printf("  frame %d: %d buffers, %zu bytes (%zu in the stub)\n", frame, now.buffers, now.bytes, buffers.size());
+					settled.buffers = now.buffers;
+					settled.bytes = now.bytes;
+					settledObjects = buffers.size();
+				}
+			}
+		}
+
+		Vao::Stats end = Vao::GetStats();
+		int wraps = end.wraps - settledWraps;
+		int waits = end.waits - settledWaits;
+		int allocations = bufferDataCalls - settledBufferData;
+		printf("After %d frames: %d buffers, %zu bytes, %zu objects in the stub\n", frames, end.buffers, end.bytes, buffers.size());
+		printf("Since frame %d: %d ring wraps, %d glBufferData calls, %d blocking fence waits\n", warmup, wraps, allocations, waits);
+		//Past the warm up the rings are big enough for the frames in flight:
+		//they wrap onto storage the GPU is done with.
+		if(allocations || waits || blockingWaits != settledStubWaits)
+		{
+			printf("  the rings still grow or wait\n");
+			++changes;
+		}
+	}
+
+	if(!buffers.empty() || !fences.empty() || Vao::GetStats().buffers != 0 || Vao::GetStats().bytes != 0)
+	{
+		printf("  %zu buffers and %zu fences left after the Vaos are gone\n", buffers.size(), fences.size());
+		++changes;
+	}
+
+	int failures = changes + errors;
+	printf("\nResult: %d failures\n", failures);
+	return failures > 0 ? 2 : 0;
+}